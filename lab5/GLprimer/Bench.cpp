@@ -0,0 +1,457 @@
+/*
+ * tnm046-bench - microbenchmarks for the hot functions of the TNM046 framework.
+ *
+ * Usage: tnm046-bench [--filter TEXT] [--iterations N] [--warmup N] [--json FILE]
+ *
+ * Run from the GLprimer directory, so that meshes/, textures/ and ../shaders/ are found.
+ *
+ * Every benchmark is run a number of warm-up times first, then timed for a number
+ * of iterations. By default the number of iterations is chosen from the warm-up runs
+ * to take about one second (at least 10 and at most 1000 iterations); use --iterations
+ * to fix it for comparisons between builds. Very fast functions are timed in batches,
+ * and all times are reported per call.
+ * With --json the results are also written as JSON (use "-" for stdout).
+ *
+ * Benchmarks that need an OpenGL context (createSphere, readOBJ, createTexture,
+ * createShader, dispatch) use an invisible window. Without a context, readOBJ is replaced by
+ * the CPU part loadOBJ and the others are skipped.
+ *
+ * This code is in the public domain.
+ */
+#if defined(WIN32) && !defined(_USE_MATH_DEFINES)
+#define _USE_MATH_DEFINES
+#endif
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "BlockCompress.hpp"
+#include "Matrix.hpp"
+#include "MipChain.hpp"
+#include "Noise.hpp"
+#include "ProgramPipeline.hpp"
+#include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "StorageBuffer.hpp"
+#include "Texture.hpp"
+#include "TextureContainer.hpp"
+#include "TriangleSoup.hpp"
+#include "Utilities.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string filter;
+    int iterations = 0;  // 0 means automatic
+    int warmup = 3;
+    std::string jsonFile;
+};
+
+struct Result {
+    std::string name;
+    int warmup = 0;
+    int iterations = 0;
+    int batch = 1;  // calls per timed sample
+    double median = 0.0;  // all times in nanoseconds per call
+    double p99 = 0.0;
+    double mean = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+// Results of the computations are written here so the compiler can not remove them
+volatile float sink = 0.0f;
+
+double percentile(const std::vector<double>& sorted, double p) {
+    // Nearest rank on the sorted samples
+    const size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+/*
+ * Time 'fn', which performs 'batch' calls of the benchmarked function.
+ */
+Result run(const std::string& name, const Options& options, int batch,
+           const std::function<void()>& fn) {
+    using clock = std::chrono::steady_clock;
+
+    Result result;
+    result.name = name;
+    result.batch = batch;
+    result.warmup = options.warmup;
+
+    double warmupTime = 0.0;
+    for (int i = 0; i < options.warmup; ++i) {
+        const auto start = clock::now();
+        fn();
+        warmupTime += std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    result.iterations = options.iterations;
+    if (result.iterations <= 0) {
+        const double perSample = options.warmup > 0 ? warmupTime / options.warmup : 0.0;
+        result.iterations =
+            perSample > 0.0 ? static_cast<int>(std::clamp(1.0 / perSample, 10.0, 1000.0)) : 100;
+    }
+
+    std::vector<double> samples(static_cast<size_t>(result.iterations));
+    for (double& sample : samples) {
+        const auto start = clock::now();
+        fn();
+        sample = std::chrono::duration<double, std::nano>(clock::now() - start).count() / batch;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    result.median = percentile(samples, 0.5);
+    result.p99 = percentile(samples, 0.99);
+    result.min = samples.front();
+    result.max = samples.back();
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    result.mean = sum / static_cast<double>(samples.size());
+    return result;
+}
+
+std::string formatTime(double ns) {
+    char buf[32];
+    if (ns < 1e3) {
+        snprintf(buf, sizeof(buf), "%.1f ns", ns);
+    } else if (ns < 1e6) {
+        snprintf(buf, sizeof(buf), "%.2f us", ns / 1e3);
+    } else {
+        snprintf(buf, sizeof(buf), "%.2f ms", ns / 1e6);
+    }
+    return buf;
+}
+
+void writeJSON(std::ostream& out, const std::vector<Result>& results, bool haveContext) {
+    out << "{\n  \"context\": " << (haveContext ? "true" : "false") << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"warmup\": " << r.warmup
+            << ", \"iterations\": " << r.iterations << ", \"batch\": " << r.batch
+            << ", \"unit\": \"ns\", \"median\": " << r.median << ", \"p99\": " << r.p99
+            << ", \"mean\": " << r.mean << ", \"min\": " << r.min << ", \"max\": " << r.max
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.jsonFile = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter TEXT] [--iterations N] [--warmup N] [--json FILE]\n";
+            return 1;
+        }
+    }
+
+    const bool haveContext = util::createHiddenContext(64, 64);
+    if (!haveContext) {
+        std::cerr << "No OpenGL context, benchmarks needing one are skipped or reduced.\n";
+    }
+
+    std::vector<Result> results;
+    auto bench = [&](const std::string& name, int batch, const std::function<void()>& fn) {
+        if (name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        results.push_back(run(name, options, batch, fn));
+        const Result& r = results.back();
+        std::printf("%-40s median %12s   p99 %12s   (%d iterations x %d)\n", r.name.c_str(),
+                    formatTime(r.median).c_str(), formatTime(r.p99).c_str(), r.iterations,
+                    r.batch);
+        std::fflush(stdout);
+    };
+
+    // Matrix functions, batched since a single call takes only nanoseconds
+    const int matBatch = 10000;
+    bench("mat4mult", matBatch, [] {
+        std::array<float, 16> m = mat4rotx(0.1f);
+        const std::array<float, 16> r = mat4roty(0.2f);
+        for (int i = 0; i < matBatch; ++i) {
+            m = mat4mult(r, m);
+        }
+        sink = m[0];
+    });
+    bench("mat4rotx", matBatch, [] {
+        float s = 0.0f;
+        for (int i = 0; i < matBatch; ++i) {
+            s += mat4rotx(static_cast<float>(i) * 1e-3f)[5];
+        }
+        sink = s;
+    });
+    bench("mat4roty", matBatch, [] {
+        float s = 0.0f;
+        for (int i = 0; i < matBatch; ++i) {
+            s += mat4roty(static_cast<float>(i) * 1e-3f)[0];
+        }
+        sink = s;
+    });
+    bench("mat4rotz", matBatch, [] {
+        float s = 0.0f;
+        for (int i = 0; i < matBatch; ++i) {
+            s += mat4rotz(static_cast<float>(i) * 1e-3f)[0];
+        }
+        sink = s;
+    });
+
+    if (haveContext) {
+        for (int segments : {8, 16, 32, 64, 128, 256, 512}) {
+            bench("createSphere/" + std::to_string(segments), 1, [segments] {
+                TriangleSoup sphere;
+                sphere.createSphere(1.0f, segments);
+                glFinish();
+            });
+        }
+    }
+
+    for (const char* mesh : {"onetriangle.obj", "pyramid.obj", "teapot_coarse.obj", "teapot.obj",
+                             "trex.obj"}) {
+        const std::string filename = std::string("meshes/") + mesh;
+        // Silence the "loadObj(...): found ..." message printed for every load
+        std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+        if (haveContext) {
+            bench("readOBJ/" + std::string(mesh), 1, [&filename] {
+                TriangleSoup soup;
+                soup.readOBJ(filename);
+                glFinish();
+            });
+        } else {
+            bench("loadOBJ/" + std::string(mesh), 1, [&filename] {
+                TriangleSoup soup;
+                soup.loadOBJ(filename);
+            });
+        }
+        std::cout.rdbuf(coutBuffer);
+        std::cout.clear();  // writing without a buffer sets the badbit
+    }
+
+    for (const char* texture : {"earth.tga", "moon.tga", "pyramid.tga", "sun.tga"}) {
+        const std::string filename = std::string("textures/") + texture;
+        std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+        bench("loadTGA/" + std::string(texture), 1, [&filename] {
+            Texture::ImageData image = Texture::loadTGA(filename);
+            sink = image.data.empty() ? 0.0f : static_cast<float>(image.data[0]);
+        });
+        const Texture::ImageData image = Texture::loadTGA(filename);
+        const unsigned int channels = image.format == GL_BGRA ? 4 : 3;
+        bench("buildMipChain/" + std::string(texture), 1, [&image, channels] {
+            const std::vector<MipLevel> levels =
+                buildMipChain(image.data.data(), image.width, image.height, channels);
+            sink = levels.empty() ? 0.0f : static_cast<float>(levels.back().data[0]);
+        });
+        const BlockFormat format = channels == 4 ? BlockFormat::BC3 : BlockFormat::BC1;
+        for (BlockQuality quality : {BlockQuality::Fast, BlockQuality::High}) {
+            bench(std::string("compressBlocks/") + (channels == 4 ? "BC3" : "BC1") +
+                      (quality == BlockQuality::High ? "-high/" : "-fast/") + texture,
+                  1, [&image, channels, format, quality] {
+                      const std::vector<unsigned char> blocks = compressBlocks(
+                          image.data.data(), image.width, image.height, channels, format, quality);
+                      sink = static_cast<float>(blocks[0]);
+                  });
+        }
+        if (haveContext) {
+            bench("createTexture/" + std::string(texture), 1, [&filename] {
+                Texture tex(filename);
+                glFinish();
+            });
+            // The same with the mip levels read from the cache (written by the warm-up)
+            setMipCacheDirectory(
+                (std::filesystem::temp_directory_path() / "tnm046-bench-mips").string());
+            bench("createTexture+mipcache/" + std::string(texture), 1, [&filename] {
+                Texture tex(filename);
+                glFinish();
+            });
+            setMipCacheDirectory("");
+            // The same prebaked into KTX2 files, uncompressed and block compressed
+            for (bool compressed : {false, true}) {
+                std::vector<MipLevel> levels(1);
+                levels[0].width = image.width;
+                levels[0].height = image.height;
+                levels[0].data = image.data;
+                for (MipLevel& mipmap :
+                     buildMipChain(image.data.data(), image.width, image.height, channels)) {
+                    levels.push_back(std::move(mipmap));
+                }
+                if (compressed) {
+                    for (MipLevel& level : levels) {
+                        level.data = compressBlocks(level.data.data(), level.width,
+                                                    level.height, channels, format,
+                                                    BlockQuality::Fast);
+                    }
+                }
+                const std::string baked =
+                    (std::filesystem::temp_directory_path() /
+                     (std::string("tnm046-bench-") + texture + (compressed ? "-bc" : "") +
+                      ".ktx2"))
+                        .string();
+                if (writeKTX2(baked, levels, compressed, blockFormatGL(format), channels)) {
+                    const char* name =
+                        compressed ? "createTexture+ktx2-bc/" : "createTexture+ktx2/";
+                    bench(name + std::string(texture), 1, [&baked] {
+                        Texture tex(baked);
+                        glFinish();
+                    });
+                }
+            }
+        }
+        std::cout.rdbuf(coutBuffer);
+        std::cout.clear();  // writing without a buffer sets the badbit
+    }
+
+    // Six octaves of noise for a 1024 x 1024 texture, in one thread and in all of them
+    for (NoiseType type : {NoiseType::Simplex, NoiseType::Perlin}) {
+        for (NoiseMapping mapping : {NoiseMapping::Plane, NoiseMapping::Sphere}) {
+            NoiseSettings settings;
+            settings.type = type;
+            settings.mapping = mapping;
+            const std::string name = std::string("generateNoise/") +
+                                     (type == NoiseType::Simplex ? "simplex-" : "perlin-") +
+                                     (mapping == NoiseMapping::Plane ? "plane" : "sphere");
+            for (unsigned int threads : {1u, 0u}) {
+                bench(name + (threads == 1 ? "-1thread" : ""), 1, [&settings, threads] {
+                    sink = static_cast<float>(generateNoise(settings, threads)[0]);
+                });
+            }
+        }
+    }
+
+    for (const char* shader : {"vertex.glsl", "fragment.glsl"}) {
+        const std::string filename = std::string("../shaders/") + shader;
+        bench("Shader readFile/" + std::string(shader), 1, [&filename] {
+            sink = static_cast<float>(readFile(filename).size());
+        });
+        bench("Shader preprocessShader/" + std::string(shader), 1, [&filename] {
+            sink = static_cast<float>(preprocessShader(filename, {"SPECULAR 0"}).text.size());
+        });
+    }
+    if (haveContext) {
+        bench("createShader", 1, [] {
+            Shader shader("../shaders/vertex.glsl", "../shaders/fragment.glsl");
+            glFinish();
+        });
+        // The variant without the specular term, as ShaderPermutations builds it
+        bench("createShader-diffuse", 1, [] {
+            Shader shader("../shaders/vertex.glsl", "../shaders/fragment.glsl",
+                          {"TEXTURED 1", "SPECULAR 0"});
+            glFinish();
+        });
+        // The same with the program binary read from the cache (written by the warm-up)
+        Shader::setBinaryCacheDirectory(
+            (std::filesystem::temp_directory_path() / "tnm046-bench-programs").string());
+        bench("createShader+binarycache", 1, [] {
+            Shader shader("../shaders/vertex.glsl", "../shaders/fragment.glsl");
+            glFinish();
+        });
+        Shader::setBinaryCacheDirectory("");
+
+        // One stage of the program above, compiled as a separable program
+        bench("createStage/vertex", 1, [] {
+            Shader stage;
+            stage.createStage(GL_VERTEX_SHADER, "../shaders/vertex.glsl");
+            glFinish();
+        });
+        bench("createStage/fragment", 1, [] {
+            Shader stage;
+            stage.createStage(GL_FRAGMENT_SHADER, "../shaders/fragment.glsl");
+            glFinish();
+        });
+
+        // Switching between two fragment shaders, as two linked programs and as two
+        // stages of a pipeline
+        Shader specular("../shaders/vertex.glsl", "../shaders/fragment.glsl");
+        Shader diffuse("../shaders/vertex.glsl", "../shaders/fragment.glsl", {"SPECULAR 0"});
+        bench("Shader use/switch", 64, [&specular, &diffuse] {
+            for (int i = 0; i < 32; ++i) {
+                specular.use();
+                diffuse.use();
+            }
+        });
+        Shader::useNone();
+        Shader vertexStage;
+        Shader specularStage;
+        Shader diffuseStage;
+        if (vertexStage.createStage(GL_VERTEX_SHADER, "../shaders/vertex.glsl") &&
+            specularStage.createStage(GL_FRAGMENT_SHADER, "../shaders/fragment.glsl") &&
+            diffuseStage.createStage(GL_FRAGMENT_SHADER, "../shaders/fragment.glsl",
+                                     {"SPECULAR 0"})) {
+            ProgramPipeline pipeline;
+            pipeline.setStage(vertexStage);
+            pipeline.use();
+            bench("ProgramPipeline setStage/switch", 64, [&] {
+                for (int i = 0; i < 32; ++i) {
+                    pipeline.setStage(specularStage);
+                    pipeline.setStage(diffuseStage);
+                }
+            });
+            ProgramPipeline::useNone();
+        }
+
+        // The particle update of the headless particle scenes, one step of 65536
+        // particles, waiting for the GPU
+        if (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object) {
+            bench("createComputeShader/particles", 1, [] {
+                Shader update;
+                update.createComputeShader("../shaders/particles_compute.glsl");
+                glFinish();
+            });
+            const int count = 65536;
+            Shader update;
+            update.createComputeShader("../shaders/particles_compute.glsl");
+            StorageBuffer particles;
+            particles.create(static_cast<size_t>(count) * 8 * sizeof(GLfloat));
+            particles.bind(0);
+            update.use();
+            update.setUniform("count", count);
+            update.setUniform("timestep", 1.0f / 60.0f);
+            bench("Shader dispatch/particles-65536", 1, [&update] {
+                update.dispatchThreads(static_cast<GLuint>(count));
+                glFinish();
+            });
+            Shader::useNone();
+        }
+    }
+
+    if (!options.jsonFile.empty()) {
+        if (options.jsonFile == "-") {
+            writeJSON(std::cout, results, haveContext);
+        } else {
+            std::ofstream out(options.jsonFile);
+            writeJSON(out, results, haveContext);
+        }
+    }
+
+    if (haveContext) {
+        util::destroyHiddenContext();
+    }
+    return 0;
+}
@@ -0,0 +1,389 @@
+/*
+ * A CPU encoder for the BC1 and BC3 block compressed texture formats.
+ *
+ * This code is in the public domain.
+ */
+#include "BlockCompress.hpp"
+#include "Utilities.hpp"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// The 16 pixels of a 4 x 4 block, in row order
+struct Block {
+    int rgb[16][3];
+    int alpha[16];
+};
+
+/*
+ * Read the block at block coordinates (bx, by), repeating the edge pixels of the
+ * image for blocks which reach past it
+ */
+void readBlock(const unsigned char* pixels, unsigned int width, unsigned int height,
+               unsigned int channels, bool bgr, unsigned int bx, unsigned int by, Block& block) {
+    const int r = bgr ? 2 : 0;
+    const int b = bgr ? 0 : 2;
+    for (unsigned int i = 0; i < 16; ++i) {
+        const unsigned int x = std::min(bx * 4 + i % 4, width - 1);
+        const unsigned int y = std::min(by * 4 + i / 4, height - 1);
+        const unsigned char* p = pixels + (size_t(y) * width + x) * channels;
+        block.rgb[i][0] = p[r];
+        block.rgb[i][1] = p[1];
+        block.rgb[i][2] = p[b];
+        block.alpha[i] = channels == 4 ? p[3] : 255;
+    }
+}
+
+// Colors are stored with 5 bits red, 6 bits green and 5 bits blue
+uint16_t pack565(const int rgb[3]) {
+    const int r = (std::clamp(rgb[0], 0, 255) * 31 + 127) / 255;
+    const int g = (std::clamp(rgb[1], 0, 255) * 63 + 127) / 255;
+    const int b = (std::clamp(rgb[2], 0, 255) * 31 + 127) / 255;
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpack565(uint16_t color, int rgb[3]) {
+    const int r = (color >> 11) & 31;
+    const int g = (color >> 5) & 63;
+    const int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+/*
+ * Choose the closest of the four colors between the endpoints for every pixel.
+ * Returns the 2-bit indices of the 16 pixels and sets 'error' to the sum of the
+ * squared differences.
+ */
+uint32_t selectIndices(const Block& block, uint16_t c0, uint16_t c1, int& error) {
+    int palette[4][3];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    error = 0;
+    for (int i = 0; i < 16; ++i) {
+        int best = 0;
+        int bestDistance = 1 << 30;
+        for (int p = 0; p < 4; ++p) {
+            int distance = 0;
+            for (int c = 0; c < 3; ++c) {
+                const int d = block.rgb[i][c] - palette[p][c];
+                distance += d * d;
+            }
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= static_cast<uint32_t>(best) << (2 * i);
+        error += bestDistance;
+    }
+    return indices;
+}
+
+/*
+ * Endpoints from the bounding box of the colors. The box's diagonal is flipped
+ * in green and blue when they fall as red rises.
+ */
+void boundingBoxEndpoints(const Block& block, int high[3], int low[3]) {
+    int mean[3] = {0, 0, 0};
+    for (int c = 0; c < 3; ++c) {
+        high[c] = 0;
+        low[c] = 255;
+        for (int i = 0; i < 16; ++i) {
+            high[c] = std::max(high[c], block.rgb[i][c]);
+            low[c] = std::min(low[c], block.rgb[i][c]);
+            mean[c] += block.rgb[i][c];
+        }
+        // Inset the box a little, the extremes are seldom worth their own color
+        const int inset = (high[c] - low[c]) / 16;
+        high[c] -= inset;
+        low[c] += inset;
+    }
+    for (int c = 1; c < 3; ++c) {
+        int covariance = 0;
+        for (int i = 0; i < 16; ++i) {
+            covariance += (16 * block.rgb[i][0] - mean[0]) * (16 * block.rgb[i][c] - mean[c]);
+        }
+        if (covariance < 0) {
+            std::swap(high[c], low[c]);
+        }
+    }
+}
+
+/*
+ * Endpoints from the extremes of the colors along their principal axis. Returns
+ * false, leaving the endpoints unchanged, if the colors have no variance.
+ */
+bool principalAxisEndpoints(const Block& block, int high[3], int low[3]) {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            mean[c] += static_cast<float>(block.rgb[i][c]) / 16.0f;
+        }
+    }
+    float cov[3][3] = {};
+    for (int i = 0; i < 16; ++i) {
+        float d[3];
+        for (int c = 0; c < 3; ++c) {
+            d[c] = static_cast<float>(block.rgb[i][c]) - mean[c];
+        }
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                cov[j][k] += d[j] * d[k];
+            }
+        }
+    }
+
+    // Power iteration for the eigenvector with the largest eigenvalue, from the
+    // column of the channel which varies most. A fixed start such as gray would be
+    // orthogonal to the axis of some blocks (red against green) and collapse to zero.
+    int start = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (cov[c][c] > cov[start][start]) {
+            start = c;
+        }
+    }
+    if (cov[start][start] < 1e-6f) {
+        return false;  // All colors equal
+    }
+    float axis[3] = {cov[0][start], cov[1][start], cov[2][start]};
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[3];
+        for (int j = 0; j < 3; ++j) {
+            next[j] = cov[j][0] * axis[0] + cov[j][1] * axis[1] + cov[j][2] * axis[2];
+        }
+        const float length = std::max({std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2])});
+        if (length < 1e-6f) {
+            break;
+        }
+        for (int j = 0; j < 3; ++j) {
+            axis[j] = next[j] / length;
+        }
+    }
+
+    int highest = 0;
+    int lowest = 0;
+    float highDot = -1e30f;
+    float lowDot = 1e30f;
+    for (int i = 0; i < 16; ++i) {
+        const float dot = static_cast<float>(block.rgb[i][0]) * axis[0] +
+                          static_cast<float>(block.rgb[i][1]) * axis[1] +
+                          static_cast<float>(block.rgb[i][2]) * axis[2];
+        if (dot > highDot) {
+            highDot = dot;
+            highest = i;
+        }
+        if (dot < lowDot) {
+            lowDot = dot;
+            lowest = i;
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        high[c] = block.rgb[highest][c];
+        low[c] = block.rgb[lowest][c];
+    }
+    return true;
+}
+
+/*
+ * The endpoints which fit the colors best, in the least squares sense, when every
+ * pixel uses the palette color given by 'indices'. Returns false if they are not
+ * defined (all pixels use the same endpoint).
+ */
+bool refineEndpoints(const Block& block, uint32_t indices, int high[3], int low[3]) {
+    // Weight of the first endpoint for each index
+    const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[3] = {0.0f, 0.0f, 0.0f};
+    float bx[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i) {
+        const float a = weights[(indices >> (2 * i)) & 3];
+        const float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < 3; ++c) {
+            ax[c] += a * static_cast<float>(block.rgb[i][c]);
+            bx[c] += b * static_cast<float>(block.rgb[i][c]);
+        }
+    }
+    const float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+    for (int c = 0; c < 3; ++c) {
+        high[c] = static_cast<int>(std::lround((ax[c] * bb - bx[c] * ab) / determinant));
+        low[c] = static_cast<int>(std::lround((bx[c] * aa - ax[c] * ab) / determinant));
+    }
+    return true;
+}
+
+void writeColorBlock(uint16_t c0, uint16_t c1, uint32_t indices, unsigned char* out) {
+    out[0] = static_cast<unsigned char>(c0);
+    out[1] = static_cast<unsigned char>(c0 >> 8);
+    out[2] = static_cast<unsigned char>(c1);
+    out[3] = static_cast<unsigned char>(c1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+        out[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+/*
+ * Encode the colors of a block in the 8 byte BC1 layout, always in the four color
+ * mode (first endpoint larger than the second), which BC3 requires
+ */
+void encodeColor(const Block& block, BlockQuality quality, unsigned char* out) {
+    int high[3];
+    int low[3];
+    if (quality != BlockQuality::High || !principalAxisEndpoints(block, high, low)) {
+        boundingBoxEndpoints(block, high, low);
+    }
+
+    uint16_t c0 = pack565(high);
+    uint16_t c1 = pack565(low);
+    int error;
+    uint32_t indices = selectIndices(block, c0, c1, error);
+
+    if (quality == BlockQuality::High) {
+        // Never worse than Fast: start from the bounding box if it fits better
+        int boxHigh[3];
+        int boxLow[3];
+        boundingBoxEndpoints(block, boxHigh, boxLow);
+        const uint16_t b0 = pack565(boxHigh);
+        const uint16_t b1 = pack565(boxLow);
+        int boxError;
+        const uint32_t boxIndices = selectIndices(block, b0, b1, boxError);
+        if (boxError < error) {
+            std::copy(boxHigh, boxHigh + 3, high);
+            std::copy(boxLow, boxLow + 3, low);
+            c0 = b0;
+            c1 = b1;
+            indices = boxIndices;
+            error = boxError;
+        }
+
+        for (int iteration = 0; iteration < 2 && error > 0; ++iteration) {
+            if (!refineEndpoints(block, indices, high, low)) {
+                break;
+            }
+            const uint16_t r0 = pack565(high);
+            const uint16_t r1 = pack565(low);
+            int refinedError;
+            const uint32_t refined = selectIndices(block, r0, r1, refinedError);
+            if (refinedError >= error) {
+                break;
+            }
+            c0 = r0;
+            c1 = r1;
+            indices = refined;
+            error = refinedError;
+        }
+    }
+
+    if (c0 < c1) {
+        // Swap the endpoints, and with them indices 0 <-> 1 and 2 <-> 3
+        std::swap(c0, c1);
+        indices ^= 0x55555555;
+    } else if (c0 == c1) {
+        indices = 0;  // A single color, and the three color mode: index 0 is c0
+    }
+    writeColorBlock(c0, c1, indices, out);
+}
+
+/*
+ * Encode the alpha of a block in the 8 byte BC3 alpha layout: two endpoints and a
+ * 3-bit index for each pixel, choosing between them and six values in between
+ */
+void encodeAlpha(const Block& block, unsigned char* out) {
+    int a0 = 0;
+    int a1 = 255;
+    for (int i = 0; i < 16; ++i) {
+        a0 = std::max(a0, block.alpha[i]);
+        a1 = std::min(a1, block.alpha[i]);
+    }
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+
+    uint64_t indices = 0;
+    if (a0 > a1) {
+        // Index 0 is a0, 1 is a1 and 2..7 are ((8 - i) * a0 + (i - 1) * a1) / 7
+        int palette[8] = {a0, a1};
+        for (int i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            int bestDistance = 256;
+            for (int p = 0; p < 8; ++p) {
+                const int distance = std::abs(block.alpha[i] - palette[p]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; ++i) {
+        out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+}  // namespace
+
+unsigned int blockFormatGL(BlockFormat format) {
+    return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                                      : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+size_t blockCompressedSize(BlockFormat format, unsigned int width, unsigned int height) {
+    const size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == BlockFormat::BC1 ? 8 : 16);
+}
+
+std::vector<unsigned char> compressBlocks(const unsigned char* pixels, unsigned int width,
+                                          unsigned int height, unsigned int channels,
+                                          BlockFormat format, BlockQuality quality, bool bgr,
+                                          unsigned int threads) {
+    if (!pixels || width == 0 || height == 0 || (channels != 3 && channels != 4)) {
+        return {};
+    }
+    std::vector<unsigned char> out(blockCompressedSize(format, width, height));
+    const unsigned int blocksX = (width + 3) / 4;
+    const unsigned int blocksY = (height + 3) / 4;
+    const size_t blockSize = format == BlockFormat::BC1 ? 8 : 16;
+
+    // A thread pays off for a few hundred blocks
+    const size_t minBlocksPerThread = quality == BlockQuality::High ? 256 : 1024;
+    util::parallelFor(blocksY, minBlocksPerThread / blocksX + 1, threads,
+                      [&](size_t rowBegin, size_t rowEnd) {
+                          Block block;
+                          for (size_t by = rowBegin; by < rowEnd; ++by) {
+                              for (unsigned int bx = 0; bx < blocksX; ++bx) {
+                                  unsigned char* dst =
+                                      out.data() + (by * blocksX + bx) * blockSize;
+                                  readBlock(pixels, width, height, channels, bgr, bx,
+                                            static_cast<unsigned int>(by), block);
+                                  if (format == BlockFormat::BC3) {
+                                      encodeAlpha(block, dst);
+                                      dst += 8;
+                                  }
+                                  encodeColor(block, quality, dst);
+                              }
+                          }
+                      });
+    return out;
+}
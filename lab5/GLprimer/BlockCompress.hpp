@@ -0,0 +1,52 @@
+/*
+ * A CPU encoder for the BC1 and BC3 block compressed texture formats
+ * (also known as DXT1 and DXT5, or S3TC).
+ *
+ * Usage: call compressBlocks() with the pixels of an image (or of a mipmap level)
+ *        and upload the result with glCompressedTexImage2D(), using the OpenGL
+ *        format from blockFormatGL().
+ *
+ * Both formats store 4 x 4 pixel blocks: BC1 in 8 bytes (RGB, 0.5 bytes per pixel)
+ * and BC3 in 16 bytes (BC1 color plus 8 bytes of alpha, 1 byte per pixel), a
+ * fourth or an eighth of the 4 bytes per pixel of GL_RGBA. Each block stores two
+ * endpoint colors and, for every pixel, which of four colors between them to use.
+ *   BlockQuality::Fast picks the corners of the bounding box of the block's colors.
+ *   BlockQuality::High picks the endpoints along the principal axis of the colors
+ *   and refines them with a least squares fit to the chosen indices.
+ * Blocks are encoded in parallel threads, in bands of block rows.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class BlockFormat {
+    BC1,  // RGB, 8 bytes per block
+    BC3,  // RGBA, 16 bytes per block
+};
+
+enum class BlockQuality {
+    Fast,
+    High,
+};
+
+// The OpenGL internal format for glCompressedTexImage2D()
+unsigned int blockFormatGL(BlockFormat format);
+
+// The size in bytes of an image of 'width' x 'height' pixels
+size_t blockCompressedSize(BlockFormat format, unsigned int width, unsigned int height);
+
+/*
+ * Encode 'width' x 'height' pixels with 'channels' bytes each (3 or 4), in B, G, R(, A)
+ * order as in TGA files, or in R, G, B(, A) order if 'bgr' is false. Partial blocks at
+ * the right and bottom edges are padded by repeating the edge pixels. BC3 without an
+ * alpha channel encodes alpha as opaque. 'threads' is the number of threads to use,
+ * 0 for all cores.
+ */
+std::vector<unsigned char> compressBlocks(const unsigned char* pixels, unsigned int width,
+                                          unsigned int height, unsigned int channels,
+                                          BlockFormat format, BlockQuality quality,
+                                          bool bgr = true, unsigned int threads = 0);
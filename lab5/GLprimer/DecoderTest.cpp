@@ -0,0 +1,49 @@
+/*
+ * tnm046-decodertest - regression tests for the image decoders of the TNM046 framework.
+ *
+ * Usage: tnm046-decodertest (or "ctest" in the build directory)
+ *
+ * The decoders are given malformed files, made in memory, which once made them
+ * write out of bounds, and must reject every one. The errors the decoders print for
+ * them are expected and kept out of the output. Returns 1, after printing which
+ * file was accepted, if one is decoded. No OpenGL context is needed.
+ *
+ * This code is in the public domain.
+ */
+#include "ImageCodec.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int main() {
+    // A JPEG file with a DHT segment declaring 100 codes of one bit, of which there
+    // are only two
+    std::vector<unsigned char> huffman = {0xFF, 0xD8, 0xFF, 0xC4, 0x00, 2 + 1 + 16 + 100,
+                                          0x00, 100};
+    huffman.resize(huffman.size() + 15 + 100, 0);
+    huffman.insert(huffman.end(), {0xFF, 0xD9});
+
+    const struct {
+        const char* name;
+        const std::vector<unsigned char>& data;
+    } files[] = {{"malformed/huffman-overflow.jpg", huffman}};
+    int failures = 0;
+    for (const auto& file : files) {
+        const ImageCodec* codec = findImageCodec(file.data.data(), file.data.size());
+        DecodedImage image;
+        std::ostringstream expected;
+        std::streambuf* cerr = std::cerr.rdbuf(expected.rdbuf());
+        const bool decoded =
+            codec && codec->decode(file.data.data(), file.data.size(), file.name, image, 1);
+        std::cerr.rdbuf(cerr);
+        if (decoded) {
+            std::cerr << "A malformed file was decoded ('" << file.name << "')\n";
+            ++failures;
+        }
+    }
+    std::cout << sizeof(files) / sizeof(files[0]) - static_cast<size_t>(failures) << " of "
+              << sizeof(files) / sizeof(files[0]) << " malformed files rejected\n";
+    return failures > 0 ? 1 : 0;
+}
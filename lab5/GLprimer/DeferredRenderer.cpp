@@ -0,0 +1,255 @@
+/*
+ * A deferred renderer with a G-buffer and point lights shaded in screen rectangles.
+ *
+ * This code is in the public domain.
+ */
+#include <GL/glew.h>
+
+#include "DeferredRenderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+enum { colorTexture, normalTexture, depthTexture, lightTexture };
+
+// Create a texture of 'width' x 'height' pixels with no mipmaps, for rendering into
+GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(internalFormat), width, height, 0, format,
+                 type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+bool checkFramebuffer(const char* name) {
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "The " << name << " framebuffer is incomplete (0x" << std::hex << status
+                  << std::dec << ")\n";
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The pixels around the sphere of influence of a light, as x, y, width and height
+ * for glScissor(). The sphere is bounded by a box in view space, whose corners are
+ * projected. Returns false if the light is outside of the view.
+ */
+bool lightRectangle(const PointLight& light, const std::array<float, 16>& P, int width,
+                    int height, std::array<GLint, 4>& rectangle) {
+    const float znear = P[14] / (P[10] - 1.0f);
+    const float x = light.position[0];
+    const float y = light.position[1];
+    const float z = light.position[2];
+    const float r = light.radius;
+    if (z - r > -znear) {
+        return false;  // Behind the near plane
+    }
+    float xmin = -1.0f;
+    float xmax = 1.0f;
+    float ymin = -1.0f;
+    float ymax = 1.0f;
+    if (z + r < -znear) {
+        xmin = ymin = 1.0f;
+        xmax = ymax = -1.0f;
+        for (float cz : {z - r, z + r}) {
+            for (float cx : {x - r, x + r}) {
+                const float px = P[0] * cx / -cz;
+                xmin = std::min(xmin, px);
+                xmax = std::max(xmax, px);
+            }
+            for (float cy : {y - r, y + r}) {
+                const float py = P[5] * cy / -cz;
+                ymin = std::min(ymin, py);
+                ymax = std::max(ymax, py);
+            }
+        }
+        xmin = std::max(xmin, -1.0f);
+        xmax = std::min(xmax, 1.0f);
+        ymin = std::max(ymin, -1.0f);
+        ymax = std::min(ymax, 1.0f);
+    }
+    const float w = static_cast<float>(width);
+    const float h = static_cast<float>(height);
+    const GLint left = static_cast<GLint>(std::floor((xmin * 0.5f + 0.5f) * w));
+    const GLint right = static_cast<GLint>(std::ceil((xmax * 0.5f + 0.5f) * w));
+    const GLint bottom = static_cast<GLint>(std::floor((ymin * 0.5f + 0.5f) * h));
+    const GLint top = static_cast<GLint>(std::ceil((ymax * 0.5f + 0.5f) * h));
+    if (right <= left || top <= bottom) {
+        return false;
+    }
+    rectangle = {left, bottom, right - left, top - bottom};
+    return true;
+}
+
+}  // namespace
+
+DeferredRenderer::DeferredRenderer()
+    : gbufferFBO_(0), lightFBO_(0), textures_{}, emptyVAO_(0), width_(0), height_(0) {}
+
+DeferredRenderer::~DeferredRenderer() {
+    release();
+    if (emptyVAO_ != 0) {
+        glDeleteVertexArrays(1, &emptyVAO_);
+    }
+}
+
+void DeferredRenderer::release() {
+    if (gbufferFBO_ != 0) {
+        glDeleteFramebuffers(1, &gbufferFBO_);
+        glDeleteFramebuffers(1, &lightFBO_);
+        glDeleteTextures(static_cast<GLsizei>(textures_.size()), textures_.data());
+    }
+    gbufferFBO_ = 0;
+    lightFBO_ = 0;
+    textures_ = {};
+    width_ = 0;
+    height_ = 0;
+}
+
+bool DeferredRenderer::create(int width, int height, const std::string& shaderDirectory) {
+    release();
+    if (geometry_.id() == 0) {
+        geometry_.createShader(shaderDirectory + "vertex.glsl",
+                               shaderDirectory + "gbuffer_fragment.glsl");
+        directional_.createShader(shaderDirectory + "fullscreen_vertex.glsl",
+                                  shaderDirectory + "deferred_directional.glsl");
+        point_.createShader(shaderDirectory + "fullscreen_vertex.glsl",
+                            shaderDirectory + "deferred_point.glsl");
+        glGenVertexArrays(1, &emptyVAO_);
+    }
+
+    width_ = width;
+    height_ = height;
+    textures_[colorTexture] = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    textures_[normalTexture] = createTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+    textures_[depthTexture] =
+        createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+    textures_[lightTexture] = createTarget(GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, width, height);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &gbufferFBO_);
+    glBindFramebuffer(GL_FRAMEBUFFER, gbufferFBO_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           textures_[colorTexture], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                           textures_[normalTexture], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                           textures_[depthTexture], 0);
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+    bool complete = checkFramebuffer("G-buffer");
+
+    glGenFramebuffers(1, &lightFBO_);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFBO_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           textures_[lightTexture], 0);
+    complete = checkFramebuffer("light buffer") && complete;
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous));
+
+    if (!complete) {
+        release();
+    }
+    return complete;
+}
+
+void DeferredRenderer::beginGeometry() {
+    glBindFramebuffer(GL_FRAMEBUFFER, gbufferFBO_);
+    glViewport(0, 0, width_, height_);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);  // Alpha 0 marks the background
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void DeferredRenderer::shade(const std::array<float, 16>& P, const std::array<float, 16>& T,
+                             const std::vector<PointLight>& lights,
+                             const std::array<float, 3>& background) {
+    if (gbufferFBO_ == 0) {
+        return;
+    }
+    const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFBO_);
+    glViewport(0, 0, width_, height_);
+    glClearColor(background[0], background[1], background[2], 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    for (GLuint unit = 0; unit < 3; ++unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, textures_[unit]);
+    }
+    glBindVertexArray(emptyVAO_);
+    auto setGBuffer = [&P](const Shader& program) {
+        program.use();
+        program.setUniform("gAlbedo", 0);
+        program.setUniform("gNormal", 1);
+        program.setUniform("gDepth", 2);
+        program.setUniform("projection", P[0], P[5], P[10], P[14]);
+    };
+
+    setGBuffer(directional_);
+    directional_.setUniform("T", T);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    setGBuffer(point_);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_SCISSOR_TEST);
+    std::array<GLint, 4> rectangle;
+    for (const PointLight& light : lights) {
+        if (!lightRectangle(light, P, width_, height_, rectangle)) {
+            ++stats_.lightsCulled;
+            continue;
+        }
+        glScissor(rectangle[0], rectangle[1], rectangle[2], rectangle[3]);
+        point_.setUniform("lightPosition", light.position[0], light.position[1],
+                          light.position[2]);
+        point_.setUniform("lightColor", light.color[0], light.color[1], light.color[2]);
+        point_.setUniform("lightRadius", light.radius);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        ++stats_.lightsDrawn;
+        stats_.pixelsLit += static_cast<size_t>(rectangle[2]) * static_cast<size_t>(rectangle[3]);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+
+    glBindVertexArray(0);
+    for (GLuint unit = 3; unit-- > 0;) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    Shader::useNone();
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+}
+
+void DeferredRenderer::resolve(GLuint target, bool depth) const {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, lightFBO_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+    glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT,
+                      GL_NEAREST);
+    if (depth) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gbufferFBO_);
+        glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_DEPTH_BUFFER_BIT,
+                          GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
+
+size_t DeferredRenderer::memorySize() const {
+    // 4 bytes for each of color, normal, depth (24 bits, padded) and light
+    return static_cast<size_t>(width_) * static_cast<size_t>(height_) * 16;
+}
@@ -0,0 +1,106 @@
+/*
+ * A deferred renderer: the surfaces are drawn once into a G-buffer, and then
+ * shaded for all lights from it, so that the cost of the lights depends on the
+ * pixels they light and not on the objects drawn or on how often they overlap.
+ *
+ * Usage: create() the buffers for the size of the viewport, draw the opaque
+ *        objects between beginGeometry() and shade(), with geometryShader() (or a
+ *        program with the same outputs, see gbuffer_fragment.glsl), and copy the
+ *        result to the framebuffer with resolve():
+ *
+ *            DeferredRenderer deferred;
+ *            deferred.create(width, height);
+ *            ...
+ *            deferred.beginGeometry();
+ *            deferred.geometryShader().use();
+ *            // Set MV, P and tex, and draw
+ *            deferred.shade(matP, T, lights);
+ *            deferred.resolve(0);
+ *
+ * The G-buffer holds 12 bytes per pixel: the color (GL_RGBA8), the view space
+ * normal in two 16-bit channels (GL_RG16, octahedral mapping) and the depth, from
+ * which the lighting passes reconstruct the position. Light is added up in a
+ * GL_R11F_G11F_B10F buffer, so that many lights do not saturate it before resolve().
+ *
+ * shade() first lights every surface with the ambient and directional light of the
+ * forward shaders (lighting.glsl). Each point light is then added with the
+ * scissor test set to the screen rectangle around its sphere of influence, so
+ * only those pixels are shaded, and lights outside of the view are skipped.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include "Shader.hpp"
+
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct PointLight {
+    std::array<float, 3> position;  // In view space
+    float radius;                   // The light falls off to nothing at this distance
+    std::array<float, 3> color;
+};
+
+class DeferredRenderer {
+public:
+    DeferredRenderer();
+    ~DeferredRenderer();
+
+    DeferredRenderer(const DeferredRenderer&) = delete;
+    DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+    // Create the buffers for 'width' x 'height' pixels and load the programs from
+    // 'shaderDirectory'. Call again when the viewport changes size. Returns false,
+    // after printing why, if the buffers can not be rendered to.
+    bool create(int width, int height, const std::string& shaderDirectory = "../shaders/");
+
+    // Bind and clear the G-buffer, and set the viewport, for drawing the surfaces
+    void beginGeometry();
+
+    // The program writing the G-buffer, for vertex.glsl inputs and a texture "tex"
+    const Shader& geometryShader() const { return geometry_; }
+
+    // Light the G-buffer with the light of lighting.glsl, rotated by 'T', and the
+    // point lights, into the light buffer. 'P' is the projection the surfaces were
+    // drawn with. The background keeps the color 'background'.
+    void shade(const std::array<float, 16>& P, const std::array<float, 16>& T,
+               const std::vector<PointLight>& lights,
+               const std::array<float, 3>& background = {0.3f, 0.3f, 0.3f});
+
+    // Copy the lit image to the framebuffer 'target' (0 for the window), and the
+    // depth too if 'depth' is true, which needs a GL_DEPTH_COMPONENT24 depth buffer
+    void resolve(GLuint target, bool depth = false) const;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // The GPU memory of the buffers, in bytes
+    size_t memorySize() const;
+
+    struct Stats {
+        size_t lightsDrawn = 0;   // Point lights shaded by shade()
+        size_t lightsCulled = 0;  // Point lights outside of the view
+        size_t pixelsLit = 0;     // In the screen rectangles of the lights drawn
+    };
+    const Stats& stats() const { return stats_; }
+    void resetStats() { stats_ = Stats(); }
+
+private:
+    // Delete the framebuffers and textures
+    void release();
+
+    GLuint gbufferFBO_;
+    GLuint lightFBO_;
+    std::array<GLuint, 4> textures_;  // Color, normal, depth and light
+    GLuint emptyVAO_;                 // For the full screen triangle
+    int width_;
+    int height_;
+    Shader geometry_;
+    Shader directional_;
+    Shader point_;
+    Stats stats_;
+};
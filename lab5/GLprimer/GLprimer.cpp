@@ -39,6 +39,8 @@
 // --- Add this line to your includes
 #include "Utilities.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 // --- Add this to the includes ---------------------------------------------------
 #include "Shader.hpp"
@@ -48,109 +50,16 @@
 #include "TriangleSoup.hpp"
 
 #include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "TextureStream.hpp"
 
 #include "Rotator.hpp"
 
-// Multiply 4x4 matrices m1 and m2 and return the result
-std::array<float, 16> mat4mult(const std::array<float, 16>& m1, const std::array<float, 16>& m2) {
-    std::array<float, 16> result;
-    // Your code goes here: compute and set each element of result, e.g.:6// result[0] = m1[0] * m2[0] +
-    // m1[4] * m2[1] + m1[8] * m2[2] + m1[12] * m2[3];7// etc. for the remaining 15 elements.8return
-    
-    result[0] = m1[0] * m2[0] + m1[4] * m2[1] + m1[8] * m2[2] + m1[12] * m2[3];
-    result[1] = m1[1] * m2[0] + m1[5] * m2[1] + m1[9] * m2[2] + m1[13] * m2[3];
-    result[2] = m1[2] * m2[0] + m1[6] * m2[1] + m1[10] * m2[2] + m1[14] * m2[3];
-    result[3] = m1[3] * m2[0] + m1[7] * m2[1] + m1[11] * m2[2] + m1[15] * m2[3];
-
-    result[4] = m1[0] * m2[4] + m1[4] * m2[5] + m1[8] * m2[6] + m1[12] * m2[7];
-    result[5] = m1[1] * m2[4] + m1[5] * m2[5] + m1[9] * m2[6] + m1[13] * m2[7];
-    result[6] = m1[2] * m2[4] + m1[6] * m2[5] + m1[10] * m2[6] + m1[14] * m2[7];
-    result[7] = m1[3] * m2[4] + m1[7] * m2[5] + m1[11] * m2[6] + m1[15] * m2[7];
-
-    result[8] = m1[0] * m2[8] + m1[4] * m2[9] + m1[8] * m2[10] + m1[12] * m2[11];
-    result[9] = m1[1] * m2[8] + m1[5] * m2[9] + m1[9] * m2[10] + m1[13] * m2[11];
-    result[10] = m1[2] * m2[8] + m1[6] * m2[9] + m1[10] * m2[10] + m1[14] * m2[11];
-    result[11] = m1[3] * m2[8] + m1[7] * m2[9] + m1[11] * m2[10] + m1[15] * m2[11];
-
-    result[12] = m1[0] * m2[12] + m1[4] * m2[13] + m1[8] * m2[14] + m1[12] * m2[15];
-    result[13] = m1[1] * m2[12] + m1[5] * m2[13] + m1[9] * m2[14] + m1[13] * m2[15];
-    result[14] = m1[2] * m2[12] + m1[6] * m2[13] + m1[10] * m2[14] + m1[14] * m2[15];
-    result[15] = m1[3] * m2[12] + m1[7] * m2[13] + m1[11] * m2[14] + m1[15] * m2[15];
-
-    return result;
-}
-
-// Print the elements of a matrix m
-void mat4print(const std::array<float, 16>& m) {
-    printf("Matrix: \n");
-    printf("%6.2f %6.2f %6.2f %6.2f \n", m[0], m[4], m[8], m[12]);
-    printf("%6.2f %6.2f %6.2f %6.2f \n", m[1], m[5], m[9], m[13]);
-    printf("%6.2f %6.2f %6.2f %6.2f \n", m[2], m[6], m[10], m[14]);
-    printf("%6.2f %6.2f %6.2f %6.2f \n", m[3], m[7], m[11], m[15]);
-    printf("\n");
-}
-
-std::array<float, 16> mat4identity() {
-    std::array<float, 16> temp = {
-        1.0f, 0.0f, 0.0f, 0.0f, 
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f, 
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
-    return temp;
-}
-
-std::array<float, 16> mat4rotx(float angle) {
-    std::array<float, 16> temp = {
-        1.0f, 0.0f,         0.0f,        0.0f, 
-        0.0f, cos(angle), sin(angle), 0.0f,
-        0.0f, -sin(angle), cos(angle), 0.0f, 
-        0.0f, 0.0f,         0.0f,       1.0f
-    };
-    return temp;
-}
+#include "Matrix.hpp"
 
-std::array<float, 16> mat4roty(float angle) {
-    std::array<float, 16> temp = {
-        cos(angle), 0.0f, sin(angle), 0.0f, 
-        0.0f,       1.0f, 0.0f,         0.0f,                          
-        -sin(angle), 0.0f, cos(angle), 0.0f, 
-        0.0f,       0.0f, 0.0f,         1.0f
-    };
-    return temp;
-}
+#include "Headless.hpp"
 
-std::array<float, 16> mat4rotz(float angle) {
-    std::array<float, 16> temp = {
-        cos(angle), sin(angle), 0.0f, 0.0f, 
-        -sin(angle), cos(angle), 0.0f, 0.0f,               
-        0.0f,       0.0f,       1.0f, 0.0f, 
-        0.0f,       0.0f,       0.0f, 1.0f
-    };
-    return temp;
-}
-
-std::array<float, 16> mat4scale(float scale) {
-    std::array<float, 16> temp = {
-        scale, 0.0f, 0.0f, 0, 
-        0.0f, scale, 0.0f, 0,                 
-        0.0f, 0.0f, scale, 0, 
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
-    return temp;
-}
-
-std::array<float, 16> mat4translate(float x, float y, float z) {
-    
-    std::array<float, 16> temp = {
-        1.0f, 0.0f, 0.0f, 0.0f, 
-        0.0f, 1.0f, 0.0f, 0.0f,                  
-        0.0f, 0.0f, 1.0f, 0.0f, 
-        x,      y,      z, 1.0f
-    };
-
-    return temp;
-}
+#include "InputLog.hpp"
 
 GLuint createVertexBuffer(int location, int dimensions, const std::vector<float>& vertices) {
     GLuint bufferID;
@@ -168,6 +77,20 @@ GLuint createVertexBuffer(int location, int dimensions, const std::vector<float>
     return bufferID;
 }
 
+// The time and rotations for drawing a frame, from the input the rotators were polled with
+FrameInput frameInput(const InputState& state, const KeyRotator& keyRotator,
+                      const MouseRotator& mouseRotator, int width, int height) {
+    FrameInput input;
+    input.time = static_cast<float>(state.time);
+    input.keyPhi = keyRotator.phi();
+    input.keyTheta = keyRotator.theta();
+    input.mousePhi = mouseRotator.phi();
+    input.mouseTheta = mouseRotator.theta();
+    input.width = width;
+    input.height = height;
+    return input;
+}
+
 GLuint createIndexBuffer(const std::vector<unsigned int>& indices) {
     GLuint bufferID;
     // Generate buffer, activate it and copy the data
@@ -179,32 +102,10 @@ GLuint createIndexBuffer(const std::vector<unsigned int>& indices) {
     return bufferID;
 }
 
-// create and return a perspective matrix
-//
-// vfov is the vertical field of view (in the y direction)
-// aspect is the aspect ratio of the viewport (width/height)
-// znear is the distance to the near clip plane (znear > 0)
-// zfar is the distance to the far clip plane (zfar > znear)
-std::array<float, 16> mat4perspective(float vfov, float aspect, float znear, float zfar) {
-    //float f = cos(vfov / 2) / sin(vfov / 2);
-
-    float f = 1 / tan(vfov / 2);
-
-    std::array<float, 16> temp = {
-        f/aspect, 0.0f, 0.0f, 0.0f, 
-        0.0f, f, 0.0f, 0.0f,
-        0.0f, 0.0f, -(zfar + znear)/(zfar - znear), -1.0f, 
-        0.0f, 0.0f, -(2 * zfar * znear)/(zfar - znear), 0.0f
-    };
-
-    return temp;
-
-}
-
 /*
  * main(int argc, char *argv[]) - the standard C++ entry point for the program
  */
-int main(int, char *[]) {
+int main(int argc, char *argv[]) {
 
     // --- Add this to the variable declarations --------------------------------------
     Shader myShader;
@@ -212,59 +113,86 @@ int main(int, char *[]) {
   int width, height;
 
   const GLFWvidmode
-      *vidmode;        // GLFW struct to hold information about the display
-  GLFWwindow *window;  // GLFW struct to hold information about the window
-
-  // Initialise GLFW
-  glfwInit();
-
-  // Determine the desktop size
-  vidmode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-
-  // Make sure we are getting a GL context of at least version 3.3
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  // Exclude old legacy cruft from the context. We don't need it, and we don't
-  // want it
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-
-  // Open a square window (aspect 1:1) to fill half the screen height
-  window = glfwCreateWindow(vidmode->height / 2, vidmode->height / 2,
-                            "GLprimer", NULL, NULL);
-  if (!window) {
-    std::cout << "Unable to open window. Terminating.\n";
-    glfwTerminate();  // No window was opened, so we can't continue in any
-                      // useful way
+      *vidmode = nullptr;  // GLFW struct to hold information about the display
+  GLFWwindow *window = nullptr;  // GLFW struct to hold information about the window
+
+  // Run without a visible window if --headless was given, see Headless.hpp
+  HeadlessOptions headless;
+  if (!parseHeadlessOptions(argc, argv, headless)) {
     return -1;
   }
 
-  // Make the newly created window the "current context" for OpenGL
-  // (This step is strictly required, or things will simply not work)
-  glfwMakeContextCurrent(window);
-
-  // initialize glew
-  GLenum err = glewInit();
-  if (GLEW_OK != err) {
-    std::cerr << "Error: " << glewGetErrorString(err) << "\n";
-    glfwTerminate();
+  // Record the keyboard and mouse input, or replay it, see InputLog.hpp
+  InputRecorder recorder;
+  InputReplay replay;
+  if (!headless.recordFile.empty() && !recorder.open(headless.recordFile)) {
+    return -1;
+  }
+  if (!headless.replayFile.empty() && !replay.open(headless.replayFile)) {
+    return -1;
+  }
+  InputState inputState;
+  if (replay.isOpen() && !replay.next(inputState)) {
+    std::cerr << "The input log '" << headless.replayFile << "' is empty\n";
     return -1;
   }
 
-  // Show some useful information on the GL context
-  std::cout << "GL vendor:       " << glGetString(GL_VENDOR)
-            << "\nGL renderer:     " << glGetString(GL_RENDERER)
-            << "\nGL version:      " << glGetString(GL_VERSION)
-            << "\nDesktop size:    " << vidmode->width << " x "
-            << vidmode->height << "\n";
+  if (headless.enabled) {
+    if (!util::createHiddenContext(headless.width, headless.height)) {
+      return -1;
+    }
+  } else {
+    // Initialise GLFW
+    glfwInit();
+
+    // Determine the desktop size
+    vidmode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+
+    // Make sure we are getting a GL context of at least version 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // Exclude old legacy cruft from the context. We don't need it, and we don't
+    // want it
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+    // Open a square window (aspect 1:1) to fill half the screen height
+    window = glfwCreateWindow(vidmode->height / 2, vidmode->height / 2,
+                              "GLprimer", NULL, NULL);
+    if (!window) {
+      std::cout << "Unable to open window. Terminating.\n";
+      glfwTerminate();  // No window was opened, so we can't continue in any
+                        // useful way
+      return -1;
+    }
 
-  // Get window size. It may start out different from the requested
-  // size, and will change if the user resizes the window
-  // glfwGetWindowSize(window, &width, &height);
-  // Set viewport. This is the pixel rectangle we want to draw into
-  // glViewport(0, 0, width, height);  // The entire window
+    // Make the newly created window the "current context" for OpenGL
+    // (This step is strictly required, or things will simply not work)
+    glfwMakeContextCurrent(window);
+
+    // initialize glew
+    GLenum err = glewInit();
+    if (GLEW_OK != err) {
+      std::cerr << "Error: " << glewGetErrorString(err) << "\n";
+      glfwTerminate();
+      return -1;
+    }
 
-  glfwSwapInterval(0);  // Do not wait for screen refresh between frames, base value 0
+    // Show some useful information on the GL context
+    std::cout << "GL vendor:       " << glGetString(GL_VENDOR)
+              << "\nGL renderer:     " << glGetString(GL_RENDERER)
+              << "\nGL version:      " << glGetString(GL_VERSION)
+              << "\nDesktop size:    " << vidmode->width << " x "
+              << vidmode->height << "\n";
+
+    // Get window size. It may start out different from the requested
+    // size, and will change if the user resizes the window
+    // glfwGetWindowSize(window, &width, &height);
+    // Set viewport. This is the pixel rectangle we want to draw into
+    // glViewport(0, 0, width, height);  // The entire window
+
+    glfwSwapInterval(0);  // Do not wait for screen refresh between frames, base value 0
+  }
  
   // --- Add this in main() after glewInit() and before the rendering loop ----
   myShader.createShader("../shaders/vertex.glsl", "../shaders/fragment.glsl");
@@ -272,8 +200,9 @@ int main(int, char *[]) {
   
   // Do this before the rendering loop
 
-  GLint locationTime = glGetUniformLocation(myShader.id(), "time");
-  if (locationTime == -1) {  // If the variable is not found, -1 is returned
+  // The uniforms are looked up when the shader is linked, setUniform() finds them
+  // by a hash of their names (see Shader.hpp)
+  if (!myShader.findUniform("time")) {  // If the variable is not found, nullptr is returned
       std::cout << "Unable to locate variable'time'in shader!\n";
   }
 
@@ -291,24 +220,19 @@ int main(int, char *[]) {
   glEnable(GL_CULL_FACE);
   glEnable(GL_DEPTH_TEST);
   // --- Put this before the rendering loop
-  // Locate the sampler2D uniform in the shader program
-  GLint locationTex = glGetUniformLocation(myShader.id(), "tex");
-  // Generate one texture object with data from a TGA file
-  Texture myTexture;
-  myTexture.createTexture("textures/earth.tga");
-  Texture myDinoTex;
-  myDinoTex.createTexture("textures/trex.tga");
-
-  // --- Put this before the rendering loop, but after the window is opened.
-  KeyRotator myKeyRotator(window);
-  MouseRotator myMouseRotator(window);
-
-
-  // Main loop
-  while (!glfwWindowShouldClose(window)) {
-    // move to while loop
-    glfwGetWindowSize(window, &width, &height);
-    glViewport(0, 0, width, height);
+  // Generate one texture object with data from a TGA file. The files are
+  // loaded in the background (see TextureStream.hpp), and objects using the
+  // same file share one texture (see TextureCache.hpp).
+  TextureStreamer textureStreamer;
+  textureStreamer.setProgressive(true);  // Show the small mipmaps first
+  TextureCache textureCache(0, &textureStreamer);
+  std::shared_ptr<Texture> myTexture = textureCache.get("textures/earth.tga");
+  std::shared_ptr<Texture> myDinoTex = textureCache.get("textures/trex.tga");
+
+  // Draw one frame of the scene. The time and the rotations come from the
+  // rotators in the interactive loop below, or from a script in headless runs.
+  auto drawScene = [&](const FrameInput& input) {
+    glViewport(0, 0, input.width, input.height);
     
     // Set the clear color to a dark gray (RGBA)
     glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
@@ -317,38 +241,27 @@ int main(int, char *[]) {
 
     /* ---- Rendering code should go here ---- */
 
-    glUseProgram(myShader.id());
+    myShader.use();
 
-    /*
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr); // was 3
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);                   // GL_FILL
-    glCullFace(GL_BACK);
-    */
-    
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr); // was 3
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);                   // LINE
     glCullFace(GL_BACK);                                        // GL_FRONT
     
     // Do this in the rendering loop to update the uniform variable "time"
-    float time = static_cast<float>(glfwGetTime());  // Number of seconds since the program was started
-    glUseProgram(myShader.id());            // Activate the shader to set its variables
-    glUniform1f(locationTime, time);        // Copy the value to the shader program
+    float time = input.time;  // Number of seconds since the program was started
+    myShader.use();                         // Activate the shader to set its variables
+    myShader.setUniform("time", time);      // Copy the value to the shader program
 
 
-    // --- Put this in the rendering loop
-    myKeyRotator.poll();
     // Create a rotation matrix that depends on myKeyRotator.phi and myKeyRotator.theta
     std::array<GLfloat, 16> matKeyRotator =
-        mat4mult(mat4rotx(-myKeyRotator.theta()), mat4roty(-myKeyRotator.phi()));
-    myMouseRotator.poll();
+        mat4mult(mat4rotx(-input.keyTheta), mat4roty(-input.keyPhi));
     // Create rotation matrix that depends on myMouseRotator.phi and myMouseRotator.theta
     std::array<GLfloat, 16> matMouseRotator =
-        mat4mult(mat4rotx(myMouseRotator.theta()), mat4roty(-myMouseRotator.phi()));
+        mat4mult(mat4rotx(input.mouseTheta), mat4roty(-input.mousePhi));
 
 
     std::array<GLfloat, 16> matT = matMouseRotator;
-    GLint locationT = glGetUniformLocation(myShader.id(), "T");
-    glUniformMatrix4fv(locationT, 1, GL_FALSE, matT.data());  // Copy the value
+    myShader.setUniform("T", matT);  // Copy the value
    
     std::array<GLfloat, 16> matVrid = mat4rotx(-M_PI / 2);
     std::array<GLfloat, 16> matMinska = mat4scale(0.2f);
@@ -367,25 +280,23 @@ int main(int, char *[]) {
     
 
     std::array<GLfloat, 16> matP = mat4perspective((M_PI / 4), 1.0f, 0.1f, 100.0f);
-    GLint locationP = glGetUniformLocation(myShader.id(), "P");
     // glUseProgram(myShader.id());  // Activate the shader to set its variables
-    glUniformMatrix4fv(locationP, 1, GL_FALSE, matP.data());  // Copy the value
+    myShader.setUniform("P", matP);  // Copy the value
 
     // --- Put this in the rendering loop
     // Draw the TriangleSoup object mySphere
     // with a shader program that uses a texture
     //glUseProgram(myShader.id());
-    glUniform1i(locationTex, 0);
+    myShader.setUniform("tex", 0);  // The sampler2D uniform, texture unit 0
 
     // earth below
 
     std::array<GLfloat, 16> matMV = mat4mult(mat4mult(mat4translate(0.0f, 0.0f, -2.5f), matE), mat4scale(3.0f));
 
-    GLint locationMV = glGetUniformLocation(myShader.id(), "MV");
     //glUseProgram(myShader.id());  // Activate the shader to set its variables
-    glUniformMatrix4fv(locationMV, 1, GL_FALSE, matMV.data());  // Copy the value
+    myShader.setUniform("MV", matMV);  // Copy the value
     
-    glBindTexture(GL_TEXTURE_2D, myTexture.id());
+    glBindTexture(GL_TEXTURE_2D, myTexture->id());
     myShape.render();
 
 
@@ -393,14 +304,69 @@ int main(int, char *[]) {
 
     matMV = mat4mult(mat4mult(mat4translate(0.0f, 0.0f, -2.5f), matKeyRotator), mat4scale(0.6f));
 
-    glUniformMatrix4fv(locationMV, 1, GL_FALSE, matMV.data());  // Copy the value
+    myShader.setUniform("MV", matMV);  // Copy the value
 
-    glBindTexture(GL_TEXTURE_2D, myDinoTex.id());
+    glBindTexture(GL_TEXTURE_2D, myDinoTex->id());
     myDino.render();
     
     // restore previous state (no texture, no shader)
     glBindTexture(GL_TEXTURE_2D, 0);
-    glUseProgram(0);
+    Shader::useNone();
+  };
+
+  if (headless.enabled) {
+    textureStreamer.finish();  // Render every frame with the real textures
+    if (replay.isOpen()) {
+      // Run the replayed input through the rotators, as in the interactive loop
+      KeyRotator keyRotator(inputState);
+      MouseRotator mouseRotator(inputState);
+      while (replay.next(inputState)) {
+        keyRotator.poll(inputState);
+        mouseRotator.poll(inputState);
+        headless.script.push_back(frameInput(inputState, keyRotator, mouseRotator,
+                                             headless.width, headless.height));
+      }
+      headless.frames = std::max<int>(1, static_cast<int>(headless.script.size()));
+    }
+    const int result = runHeadless(headless, drawScene);
+    util::destroyHiddenContext();
+    return result;
+  }
+
+  // --- Put this before the rendering loop, but after the window is opened.
+  if (!replay.isOpen()) {
+    inputState = InputState::capture(window);
+  }
+  recorder.write(inputState);
+  KeyRotator myKeyRotator(inputState);
+  MouseRotator myMouseRotator(inputState);
+
+  const double replayStart = glfwGetTime();
+  size_t replayedFrames = 0;
+
+  // Main loop
+  while (!glfwWindowShouldClose(window)) {
+    // move to while loop
+    glfwGetWindowSize(window, &width, &height);
+
+    // Live input, or the next recorded frame until the log ends
+    if (replay.isOpen()) {
+      if (!replay.next(inputState)) {
+        break;
+      }
+      ++replayedFrames;
+    } else {
+      inputState = InputState::capture(window);
+    }
+    recorder.write(inputState);
+
+    textureStreamer.update();
+
+    // --- Put this in the rendering loop
+    myKeyRotator.poll(inputState);
+    myMouseRotator.poll(inputState);
+
+    drawScene(frameInput(inputState, myKeyRotator, myMouseRotator, width, height));
 
     // --- Put this in the rendering loop
     // Draw the triangle
@@ -421,6 +387,17 @@ int main(int, char *[]) {
     }
   }
 
+  if (recorder.isOpen()) {
+    std::cout << "Recorded " << recorder.numFrames() << " frames to " << headless.recordFile
+              << "\n";
+    recorder.close();
+  }
+  if (replay.isOpen()) {
+    const double seconds = glfwGetTime() - replayStart;
+    std::cout << "Replayed " << replayedFrames << " frames in " << seconds << " s ("
+              << static_cast<double>(replayedFrames) / seconds << " frames/s)\n";
+  }
+
   // Close the OpenGL window and terminate GLFW
   glfwDestroyWindow(window);
   glfwTerminate();
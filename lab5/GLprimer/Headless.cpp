@@ -0,0 +1,707 @@
+/*
+ * Headless benchmark mode for the GLprimer program.
+ *
+ * This code is in the public domain.
+ */
+#if defined(WIN32) && !defined(_USE_MATH_DEFINES)
+#define _USE_MATH_DEFINES
+#endif
+
+#include <GL/glew.h>
+
+#include "DeferredRenderer.hpp"
+#include "Headless.hpp"
+#include "Matrix.hpp"
+#include "Shader.hpp"
+#include "ShaderPermutations.hpp"
+#include "StorageBuffer.hpp"
+#include "Texture.hpp"
+#include "TexturePack.hpp"
+#include "TriangleSoup.hpp"
+#include "UniformBuffer.hpp"
+#include "VirtualTexture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+// Frames rendered before the timed ones of every run
+const int warmupFrames = 3;
+
+// Frame time statistics in milliseconds
+struct Stats {
+    double mean = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+struct RunResult {
+    std::string scene;
+    int objects = 0;
+    Stats cpu;    // Time to issue the frame's OpenGL commands
+    Stats gpu;    // GL_TIME_ELAPSED for the frame
+    Stats frame;  // Issue plus glFinish(), the complete frame
+    // Per frame, uniforms set and skipped as unchanged (see Shader::stats())
+    double uniformCalls = 0.0;
+    double uniformCallsSkipped = 0.0;
+};
+
+Stats computeStats(std::vector<double> samples) {
+    Stats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        const size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+        return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+    double sum = 0.0;
+    for (double s : samples) {
+        sum += s;
+    }
+    stats.mean = sum / static_cast<double>(samples.size());
+    stats.median = percentile(0.5);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.min = samples.front();
+    stats.max = samples.back();
+    return stats;
+}
+
+std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        const size_t comma = std::min(list.find(',', pos), list.size());
+        values.push_back(std::atoi(list.substr(pos, comma - pos).c_str()));
+        pos = comma + 1;
+    }
+    return values;
+}
+
+/*
+ * Render 'options.frames' frames with 'draw' and time them. The framebuffer
+ * object is bound by the caller. A few frames are rendered untimed first, as the
+ * first frames of a scene also compile shaders in the driver, allocate buffers
+ * and upload textures.
+ */
+RunResult timeFrames(const HeadlessOptions& options,
+                     const std::function<void(const FrameInput&)>& draw) {
+    using clock = std::chrono::steady_clock;
+
+    GLuint query;
+    glGenQueries(1, &query);
+
+    std::vector<double> cpu;
+    std::vector<double> gpu;
+    std::vector<double> frame;
+    for (int i = 0; i < warmupFrames; ++i) {
+        draw(scriptedFrame(i, options));
+    }
+    glFinish();
+    Shader::resetStats();
+    for (int i = 0; i < options.frames; ++i) {
+        const FrameInput input = scriptedFrame(i, options);
+
+        const auto start = clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        draw(input);
+        glEndQuery(GL_TIME_ELAPSED);
+        const auto issued = clock::now();
+        glFinish();  // Stands in for glfwSwapBuffers(), one frame at a time
+        const auto finished = clock::now();
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+        cpu.push_back(std::chrono::duration<double, std::milli>(issued - start).count());
+        frame.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+        gpu.push_back(static_cast<double>(elapsed) * 1e-6);
+    }
+    glDeleteQueries(1, &query);
+
+    RunResult result;
+    result.cpu = computeStats(cpu);
+    result.gpu = computeStats(gpu);
+    result.frame = computeStats(frame);
+    const double frames = std::max(1, options.frames);
+    result.uniformCalls = static_cast<double>(Shader::stats().uniformCalls) / frames;
+    result.uniformCallsSkipped = static_cast<double>(Shader::stats().uniformCallsSkipped) / frames;
+    return result;
+}
+
+// The textures of the objects in a scalability scene, used in turn
+struct SceneTextures {
+    std::vector<const Texture*> textures;    // Bound before each object, if more than one
+    const TexturePacker* packer = nullptr;   // Or packed, see TexturePack.hpp
+};
+
+/*
+ * The scalability scenes: 'count' small textured spheres in a cubic grid,
+ * each spinning on its own and drawn with its own draw call. Packed textures
+ * are drawn one array texture at a time, with a layer and a texture coordinate
+ * transform for each object instead of a texture bind. With 'transforms' the
+ * matrices P and MV are set in that uniform buffer, bound to binding point 0, and
+ * uploaded before each draw call instead of being set as uniforms.
+ */
+RunResult runScalability(const HeadlessOptions& options, int count, const Shader& shader,
+                         const TriangleSoup& sphere, const SceneTextures& textures,
+                         UniformBuffer* transforms = nullptr) {
+    const int side = std::max(1, static_cast<int>(std::ceil(std::cbrt(count))));
+    const float spacing = 2.0f / static_cast<float>(side);
+
+    auto draw = [&](const FrameInput& input) {
+        glViewport(0, 0, input.width, input.height);
+        glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use();
+        shader.setUniform("time", input.time);
+        shader.setUniform("tex", 0);
+
+        const std::array<float, 16> camera =
+            mat4mult(mat4rotx(static_cast<float>(input.mouseTheta)),
+                     mat4roty(static_cast<float>(-input.mousePhi)));
+        shader.setUniform("T", camera);
+        const std::array<float, 16> matP = mat4perspective(
+            static_cast<float>(M_PI / 4),
+            static_cast<float>(input.width) / static_cast<float>(input.height), 0.1f, 100.0f);
+        if (transforms) {
+            transforms->set("P", matP);
+            transforms->bind(0);
+        } else {
+            shader.setUniform("P", matP);
+        }
+
+        const std::array<float, 16> view = mat4mult(mat4translate(0.0f, 0.0f, -4.0f), camera);
+        auto drawObject = [&](int i) {
+            const float x = (static_cast<float>(i % side) + 0.5f) * spacing - 1.0f;
+            const float y = (static_cast<float>((i / side) % side) + 0.5f) * spacing - 1.0f;
+            const float z = (static_cast<float>(i / (side * side)) + 0.5f) * spacing - 1.0f;
+            const std::array<float, 16> model =
+                mat4mult(mat4translate(x, y, z),
+                         mat4mult(mat4roty(input.time + static_cast<float>(i)),
+                                  mat4scale(0.8f * spacing)));
+            const std::array<float, 16> matMV = mat4mult(view, model);
+            if (transforms) {
+                transforms->set("MV", matMV);
+                transforms->upload();
+            } else {
+                shader.setUniform("MV", matMV);
+            }
+            sphere.render();
+        };
+
+        if (textures.packer) {
+            const TexturePacker& packer = *textures.packer;
+            for (GLuint array : packer.textures()) {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+                for (int i = 0; i < count; ++i) {
+                    const TextureSlot& slot = packer.slot(static_cast<size_t>(i) % packer.size());
+                    if (slot.texture == array) {
+                        shader.setUniform("layer", slot.layer);
+                        shader.setUniform("stTransform", slot.transform[0], slot.transform[1],
+                                          slot.transform[2], slot.transform[3]);
+                        drawObject(i);
+                    }
+                }
+            }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        } else {
+            const std::vector<const Texture*>& list = textures.textures;
+            glBindTexture(GL_TEXTURE_2D, list.front()->id());
+            for (int i = 0; i < count; ++i) {
+                if (list.size() > 1) {
+                    glBindTexture(GL_TEXTURE_2D, list[static_cast<size_t>(i) % list.size()]->id());
+                }
+                drawObject(i);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        Shader::useNone();
+    };
+
+    return timeFrames(options, draw);
+}
+
+/*
+ * The virtual texture scene: a large sphere with a virtual texture, close to the
+ * camera, with a feedback pass and update() in every frame
+ */
+RunResult runVirtual(const HeadlessOptions& options, VirtualTexture& texture) {
+    Shader shader("../shaders/vertex.glsl", "../shaders/fragment_virtual.glsl");
+    Shader feedbackShader("../shaders/vertex.glsl", "../shaders/feedback_virtual.glsl");
+    TriangleSoup sphere;
+    sphere.createSphere(1.0f, 64);
+
+    auto draw = [&](const FrameInput& input) {
+        const std::array<float, 16> camera =
+            mat4mult(mat4rotx(static_cast<float>(input.mouseTheta)),
+                     mat4roty(static_cast<float>(-input.mousePhi)));
+        const std::array<float, 16> matP = mat4perspective(
+            static_cast<float>(M_PI / 4),
+            static_cast<float>(input.width) / static_cast<float>(input.height), 0.1f, 100.0f);
+        const std::array<float, 16> matMV =
+            mat4mult(mat4translate(0.0f, 0.0f, -2.2f),
+                     mat4mult(camera, mat4roty(0.2f * input.time)));
+        auto drawSphere = [&](const Shader& program, bool feedback) {
+            program.use();
+            texture.bind(program, 0, feedback);
+            program.setUniform("T", camera);
+            program.setUniform("P", matP);
+            program.setUniform("MV", matMV);
+            sphere.render();
+        };
+
+        glViewport(0, 0, input.width, input.height);
+        texture.beginFeedback(input.width, input.height);
+        drawSphere(feedbackShader, true);
+        texture.endFeedback();
+        texture.update();
+
+        glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawSphere(shader, false);
+        Shader::useNone();
+    };
+
+    RunResult result = timeFrames(options, draw);
+    result.scene = "virtual";
+    result.objects = 1;
+    return result;
+}
+
+/*
+ * The deferred scenes: 64 textured spheres in a cubic grid, drawn into the G-buffer
+ * of 'deferred' and lit by 'count' point lights circling around them, resolved into
+ * the framebuffer 'target'
+ */
+RunResult runDeferred(const HeadlessOptions& options, int count, const TriangleSoup& sphere,
+                      const Texture& texture, DeferredRenderer& deferred, GLuint target) {
+    // Positions, speeds and colors from a fixed seed
+    struct Light {
+        float x, y, z, speed;
+        std::array<float, 3> color;
+    };
+    std::vector<Light> scene(static_cast<size_t>(count));
+    uint32_t seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / 16777216.0f;  // In [0, 1)
+    };
+    for (Light& light : scene) {
+        light.x = 2.4f * random() - 1.2f;
+        light.y = 2.4f * random() - 1.2f;
+        light.z = 2.4f * random() - 1.2f;
+        light.speed = random() - 0.5f;
+        light.color = {random(), random(), random()};
+    }
+    std::vector<PointLight> lights(scene.size());
+
+    const int side = 4;
+    const float spacing = 2.0f / static_cast<float>(side);
+    auto draw = [&](const FrameInput& input) {
+        const std::array<float, 16> camera =
+            mat4mult(mat4rotx(static_cast<float>(input.mouseTheta)),
+                     mat4roty(static_cast<float>(-input.mousePhi)));
+        const std::array<float, 16> matP = mat4perspective(
+            static_cast<float>(M_PI / 4),
+            static_cast<float>(input.width) / static_cast<float>(input.height), 0.1f, 100.0f);
+        const std::array<float, 16> view = mat4mult(mat4translate(0.0f, 0.0f, -4.0f), camera);
+
+        deferred.beginGeometry();
+        const Shader& shader = deferred.geometryShader();
+        shader.use();
+        shader.setUniform("tex", 0);
+        shader.setUniform("P", matP);
+        glBindTexture(GL_TEXTURE_2D, texture.id());
+        for (int i = 0; i < side * side * side; ++i) {
+            const float x = (static_cast<float>(i % side) + 0.5f) * spacing - 1.0f;
+            const float y = (static_cast<float>((i / side) % side) + 0.5f) * spacing - 1.0f;
+            const float z = (static_cast<float>(i / (side * side)) + 0.5f) * spacing - 1.0f;
+            shader.setUniform("MV", mat4mult(view, mat4mult(mat4translate(x, y, z),
+                                                            mat4scale(0.8f * spacing))));
+            sphere.render();
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // The lights circle around the y axis, and are lit in view space
+        for (size_t i = 0; i < scene.size(); ++i) {
+            const Light& light = scene[i];
+            const std::array<float, 16> model = mat4mult(
+                mat4roty(light.speed * input.time), mat4translate(light.x, light.y, light.z));
+            const std::array<float, 16> matMV = mat4mult(view, model);
+            lights[i].position = {matMV[12], matMV[13], matMV[14]};
+            lights[i].radius = 0.5f;
+            lights[i].color = light.color;
+        }
+        deferred.shade(matP, camera, lights);
+        deferred.resolve(target);
+    };
+
+    return timeFrames(options, draw);
+}
+
+/*
+ * The particle scenes: 'count' particles moved by a compute program in a storage
+ * buffer, which is then drawn from as a vertex buffer without leaving the GPU
+ */
+RunResult runParticles(const HeadlessOptions& options, int count, const Shader& update,
+                       const Shader& shader) {
+    // Positions and velocities, as in particles_compute.glsl, from a fixed seed
+    std::vector<GLfloat> particles(static_cast<size_t>(count) * 8, 0.0f);
+    uint32_t seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / 8388608.0f - 1.0f;  // In [-1, 1)
+    };
+    for (size_t i = 0; i < particles.size(); i += 8) {
+        for (size_t c = 0; c < 3; ++c) {
+            particles[i + c] = random();
+            particles[i + 4 + c] = 2.0f * random();
+        }
+    }
+    StorageBuffer buffer;
+    buffer.create(particles.size() * sizeof(GLfloat), particles.data());
+
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.id());
+    const GLsizei stride = 8 * sizeof(GLfloat);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(4 * sizeof(GLfloat)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    auto draw = [&](const FrameInput& input) {
+        update.use();
+        update.setUniform("count", count);
+        update.setUniform("timestep", static_cast<float>(options.timestep));
+        buffer.bind(0);
+        update.dispatchThreads(static_cast<GLuint>(count));
+
+        glViewport(0, 0, input.width, input.height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const std::array<float, 16> camera =
+            mat4mult(mat4rotx(static_cast<float>(input.mouseTheta)),
+                     mat4roty(static_cast<float>(-input.mousePhi)));
+        const std::array<float, 16> matP = mat4perspective(
+            static_cast<float>(M_PI / 4),
+            static_cast<float>(input.width) / static_cast<float>(input.height), 0.1f, 100.0f);
+        shader.use();
+        shader.setUniform("P", matP);
+        shader.setUniform("MV", mat4mult(mat4translate(0.0f, 0.0f, -4.0f), camera));
+        Shader::memoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_POINTS, 0, count);
+        glBindVertexArray(0);
+        Shader::useNone();
+    };
+
+    RunResult result = timeFrames(options, draw);
+    glDeleteVertexArrays(1, &vao);
+    return result;
+}
+
+// 'text' as a JSON string, in quotes, with quotes, backslashes and control characters
+// escaped, e.g. for Windows paths
+std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[7];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+void writeStats(std::ostream& out, const char* name, const Stats& s) {
+    out << "\"" << name << "\": {\"mean\": " << s.mean << ", \"median\": " << s.median
+        << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"min\": " << s.min
+        << ", \"max\": " << s.max << "}";
+}
+
+void writeJSON(std::ostream& out, const HeadlessOptions& options,
+               const std::vector<RunResult>& results) {
+    const std::string renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    const std::string version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    out << "{\n  \"renderer\": " << jsonString(renderer) << ",\n  \"version\": "
+        << jsonString(version) << ",\n  \"width\": " << options.width
+        << ",\n  \"height\": " << options.height << ",\n  \"frames\": " << options.frames
+        << ",\n  \"timestep\": " << options.timestep;
+    if (!options.replayFile.empty()) {
+        out << ",\n  \"replay\": " << jsonString(options.replayFile);
+    }
+    out << ",\n  \"unit\": \"ms\",\n  \"runs\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult& r = results[i];
+        out << "    {\"scene\": \"" << r.scene << "\", \"objects\": " << r.objects << ", ";
+        writeStats(out, "cpu", r.cpu);
+        out << ", ";
+        writeStats(out, "gpu", r.gpu);
+        out << ", ";
+        writeStats(out, "frame", r.frame);
+        out << ", \"uniforms\": {\"set\": " << r.uniformCalls
+            << ", \"skipped\": " << r.uniformCallsSkipped << "}";
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+}  // namespace
+
+bool parseHeadlessOptions(int argc, char* argv[], HeadlessOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            options.enabled = true;
+        } else if (arg == "--frames" && hasValue) {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--size" && hasValue) {
+            const std::string size = argv[++i];
+            const size_t x = size.find('x');
+            options.width = std::max(1, std::atoi(size.substr(0, x).c_str()));
+            options.height = x == std::string::npos
+                                 ? options.width
+                                 : std::max(1, std::atoi(size.substr(x + 1).c_str()));
+        } else if (arg == "--timestep" && hasValue) {
+            options.timestep = std::atof(argv[++i]);
+        } else if (arg == "--objects" && hasValue) {
+            options.objectCounts = parseList(argv[++i]);
+        } else if (arg == "--json" && hasValue) {
+            options.jsonFile = argv[++i];
+        } else if (arg == "--record" && hasValue) {
+            options.recordFile = argv[++i];
+        } else if (arg == "--replay" && hasValue) {
+            options.replayFile = argv[++i];
+        } else if (arg == "--virtual" && hasValue) {
+            options.virtualTexture = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--headless [--frames N] [--size WxH] [--timestep SECONDS]"
+                         " [--objects N[,N...]] [--json FILE] [--virtual FILE.vtex]]"
+                         " [--record FILE | --replay FILE]\n";
+            return false;
+        }
+    }
+    if (!options.recordFile.empty() && (options.enabled || !options.replayFile.empty())) {
+        std::cerr << "--record can not be combined with --headless or --replay\n";
+        return false;
+    }
+    return true;
+}
+
+FrameInput scriptedFrame(int frame, const HeadlessOptions& options) {
+    if (!options.script.empty()) {
+        FrameInput input = options.script[static_cast<size_t>(frame) % options.script.size()];
+        input.width = options.width;
+        input.height = options.height;
+        return input;
+    }
+    FrameInput input;
+    const double t = frame * options.timestep;
+    input.time = static_cast<float>(t);
+    // A slow orbit with some up and down motion, as if dragged with the mouse
+    input.mousePhi = std::fmod(0.4 * t, 2.0 * M_PI);
+    input.mouseTheta = 0.35 * std::sin(0.5 * t);
+    // The dinosaur turns as if the arrow keys were held (90 degrees per second)
+    input.keyPhi = std::fmod(t * M_PI / 2.0, 2.0 * M_PI);
+    input.keyTheta = 0.25 * std::sin(0.3 * t);
+    input.width = options.width;
+    input.height = options.height;
+    return input;
+}
+
+int runHeadless(const HeadlessOptions& options,
+                const std::function<void(const FrameInput&)>& drawScene) {
+    std::cout << "Headless run: " << options.frames << " frames at " << options.width << " x "
+              << options.height << " on " << glGetString(GL_RENDERER) << "\n";
+
+    // Offscreen render target with the same attachments as a default framebuffer
+    GLuint fbo;
+    GLuint renderbuffers[2];
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, options.width, options.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                              renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                              renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Unable to create the offscreen framebuffer.\n";
+        return -1;
+    }
+
+    std::vector<RunResult> results;
+
+    results.push_back(timeFrames(options, drawScene));
+    results.back().scene = "lab";
+    results.back().objects = 2;
+
+    {
+        // The lab shader with all its features, without the specular term, and with
+        // its matrices in a uniform block
+        ShaderPermutations lit("../shaders/vertex.glsl", "../shaders/fragment.glsl",
+                               {"TEXTURED", "SPECULAR", "TRANSFORM_BLOCK"});
+        const uint32_t textured = lit.feature("TEXTURED");
+        const Shader& shader = lit.get(textured | lit.feature("SPECULAR"));
+        const Shader& diffuseShader = lit.get(textured);
+        const Shader& blockShader =
+            lit.get(textured | lit.feature("SPECULAR") | lit.feature("TRANSFORM_BLOCK"));
+        Shader arrayShader("../shaders/vertex.glsl", "../shaders/fragment_array.glsl");
+        TriangleSoup sphere;
+        sphere.createSphere(0.5f, 8);
+
+        // One texture for all objects, four textures bound in turn, and the same
+        // four packed into array textures
+        const char* files[] = {"textures/earth.tga", "textures/moon.tga", "textures/sun.tga",
+                               "textures/pyramid.tga"};
+        std::vector<std::unique_ptr<Texture>> loaded;
+        TexturePacker packer;
+        for (const char* file : files) {
+            loaded.push_back(std::make_unique<Texture>(file));
+            packer.add(file);
+        }
+        packer.pack();
+        SceneTextures single;
+        single.textures.push_back(loaded.front().get());
+        SceneTextures binds;
+        for (const auto& texture : loaded) {
+            binds.textures.push_back(texture.get());
+        }
+        SceneTextures packed;
+        packed.packer = &packer;
+
+        const struct {
+            const char* name;
+            const Shader& shader;
+            const SceneTextures& textures;
+        } scenes[] = {{"scalability", shader, single},
+                      {"diffuse", diffuseShader, single},
+                      {"binds", shader, binds},
+                      {"packed", arrayShader, packed}};
+        for (const auto& scene : scenes) {
+            for (int count : options.objectCounts) {
+                results.push_back(runScalability(options, std::max(1, count), scene.shader,
+                                                 sphere, scene.textures));
+                results.back().scene = scene.name;
+                results.back().objects = std::max(1, count);
+            }
+        }
+
+        UniformBuffer transforms;
+        if (transforms.create(blockShader, "Transforms")) {
+            blockShader.bindUniformBlock("Transforms", 0);
+            for (int count : options.objectCounts) {
+                transforms.resetStats();
+                results.push_back(runScalability(options, std::max(1, count), blockShader,
+                                                 sphere, single, &transforms));
+                results.back().scene = "block";
+                results.back().objects = std::max(1, count);
+                const UniformBuffer::Stats& stats = transforms.stats();
+                // Counted over the warm-up frames too
+                const double frames = options.frames + warmupFrames;
+                std::cout << "Uniform block, " << std::max(1, count) << " objects: "
+                          << static_cast<double>(stats.uploads) / frames << " uploads of "
+                          << static_cast<double>(stats.bytesUploaded) / frames << " bytes, "
+                          << static_cast<double>(stats.setsSkipped) / frames
+                          << " unchanged values skipped per frame\n";
+            }
+        }
+
+        // The object counts are the numbers of lights here
+        DeferredRenderer deferred;
+        if (deferred.create(options.width, options.height)) {
+            for (int count : options.objectCounts) {
+                deferred.resetStats();
+                results.push_back(runDeferred(options, std::max(1, count), sphere,
+                                              *loaded.front(), deferred, fbo));
+                results.back().scene = "deferred";
+                results.back().objects = std::max(1, count);
+                const DeferredRenderer::Stats& stats = deferred.stats();
+                // Counted over the warm-up frames too
+                const double frames = options.frames + warmupFrames;
+                std::cout << "Deferred, " << std::max(1, count) << " lights: "
+                          << static_cast<double>(stats.lightsDrawn) / frames << " drawn, "
+                          << static_cast<double>(stats.lightsCulled) / frames << " culled, "
+                          << static_cast<double>(stats.pixelsLit) / frames
+                          << " light pixels per frame\n";
+            }
+        }
+    }
+
+    if (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object) {
+        Shader update;
+        update.createComputeShader("../shaders/particles_compute.glsl");
+        Shader shader("../shaders/vertex_particles.glsl", "../shaders/fragment_particles.glsl");
+        for (int count : options.objectCounts) {
+            results.push_back(runParticles(options, std::max(1, count), update, shader));
+            results.back().scene = "particles";
+            results.back().objects = std::max(1, count);
+        }
+    } else {
+        std::cout << "No compute shaders (OpenGL 4.3), skipping the particle scenes\n";
+    }
+
+    if (!options.virtualTexture.empty()) {
+        VirtualTexture texture(options.virtualTexture);
+        if (texture.isOpen()) {
+            results.push_back(runVirtual(options, texture));
+            const VirtualTexture::Stats& stats = texture.stats();
+            std::cout << "Virtual texture: " << texture.width() << " x " << texture.height()
+                      << ", " << stats.resident << " tiles resident, " << stats.missing
+                      << " missing, " << stats.uploads << " uploads, " << stats.evictions
+                      << " evictions, " << texture.memorySize() / (1024 * 1024)
+                      << " MB on the GPU\n";
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &fbo);
+
+    for (const RunResult& r : results) {
+        std::printf("%-12s %7d objects: cpu %8.3f ms  gpu %8.3f ms  frame %8.3f ms"
+                    " (median, p99 frame %.3f ms), uniforms %.0f set %.0f skipped per frame\n",
+                    r.scene.c_str(), r.objects, r.cpu.median, r.gpu.median, r.frame.median,
+                    r.frame.p99, r.uniformCalls, r.uniformCallsSkipped);
+    }
+
+    std::ofstream out(options.jsonFile);
+    if (!out) {
+        std::cerr << "Could not write '" << options.jsonFile << "'\n";
+        return -1;
+    }
+    writeJSON(out, options, results);
+    std::cout << "Results written to " << options.jsonFile << "\n";
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Headless benchmark mode for the GLprimer program.
+ *
+ * Usage: GLprimer --headless [--frames N] [--size WxH] [--timestep SECONDS]
+ *                            [--objects N[,N...]] [--json FILE] [--replay FILE]
+ *                            [--virtual FILE.vtex]
+ *        GLprimer [--record FILE | --replay FILE]
+ *
+ * Renders into a framebuffer object in an invisible context (see
+ * util::createHiddenContext()), so it runs on machines without a display,
+ * e.g. with Mesa llvmpipe. Time does not come from glfwGetTime() but advances
+ * by a fixed timestep per frame, and the camera follows a fixed script instead of
+ * the keyboard and mouse, which makes every run render exactly the same frames.
+ * With --replay the frames of a recorded input log (see InputLog.hpp) are
+ * rendered instead of the script; interactive runs can --record such logs.
+ *
+ * First the lab scene is rendered, then scalability scenes with the given numbers
+ * of objects (one draw call each): with one texture, with one texture and a shader
+ * specialized without the specular term (see ShaderPermutations.hpp), with four
+ * textures bound in turn, with the same four packed into array textures (see
+ * TexturePack.hpp), and with one texture and the matrices in a uniform buffer
+ * uploaded for each object (see UniformBuffer.hpp). The deferred scenes light a
+ * grid of 64 spheres with the given numbers of point lights instead (see
+ * DeferredRenderer.hpp). Then, with OpenGL 4.3, as many particles are moved by a
+ * compute program and drawn as points (see StorageBuffer.hpp).
+ * With --virtual, a sphere with that virtual texture (see VirtualTexture.hpp) is
+ * rendered last, with its feedback pass and tile uploads in every frame.
+ * CPU, GPU and total frame time statistics for every run are written to a JSON
+ * file. GPU times come from GL_TIME_ELAPSED queries, which software renderers
+ * like llvmpipe do not measure reliably.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// The input to drawing one frame of a scene: animation time, camera rotations
+// and viewport size. Interactive runs take this from glfwGetTime() and the
+// rotators, headless runs from a script.
+struct FrameInput {
+    float time = 0.0f;
+    double keyPhi = 0.0;
+    double keyTheta = 0.0;
+    double mousePhi = 0.0;
+    double mouseTheta = 0.0;
+    int width = 0;
+    int height = 0;
+};
+
+struct HeadlessOptions {
+    bool enabled = false;
+    int frames = 300;
+    int width = 512;
+    int height = 512;
+    double timestep = 1.0 / 60.0;
+    std::vector<int> objectCounts = {1, 10, 100, 1000, 10000, 100000};
+    std::string virtualTexture;  // For the virtual texture scene, if not empty
+    std::string jsonFile = "headless.json";
+    // Input log to write or to read instead of the keyboard and mouse (InputLog.hpp)
+    std::string recordFile;
+    std::string replayFile;
+    // Frames to render instead of scriptedFrame(), e.g. from a replayed input log
+    std::vector<FrameInput> script;
+};
+
+// Parse the command line. Returns false, after printing the usage, on unknown arguments.
+bool parseHeadlessOptions(int argc, char* argv[], HeadlessOptions& options);
+
+// The scripted camera and animation time for a frame, from 'options.script'
+// if it is not empty
+FrameInput scriptedFrame(int frame, const HeadlessOptions& options);
+
+// Run the benchmark. Requires a current context (util::createHiddenContext()).
+// 'drawScene' draws one frame of the lab scene. Returns 0 on success.
+int runHeadless(const HeadlessOptions& options,
+                const std::function<void(const FrameInput&)>& drawScene);
@@ -0,0 +1,42 @@
+/*
+ * Decoders for the image file formats textures are loaded from, chosen by the
+ * signature at the start of a file rather than by its name.
+ *
+ * This code is in the public domain.
+ */
+#include "ImageCodec.hpp"
+
+#include <mutex>
+
+namespace {
+
+std::mutex registryMutex;
+
+// Latest first. Codecs are never removed, so the pointers handed out stay valid.
+std::vector<std::unique_ptr<ImageCodec>>& registry() {
+    static std::vector<std::unique_ptr<ImageCodec>> codecs = [] {
+        std::vector<std::unique_ptr<ImageCodec>> builtIn;
+        builtIn.push_back(createPNGCodec());
+        builtIn.push_back(createJPEGCodec());
+        return builtIn;
+    }();
+    return codecs;
+}
+
+}  // namespace
+
+void registerImageCodec(std::unique_ptr<ImageCodec> codec) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::vector<std::unique_ptr<ImageCodec>>& codecs = registry();
+    codecs.insert(codecs.begin(), std::move(codec));
+}
+
+const ImageCodec* findImageCodec(const unsigned char* data, size_t size) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ImageCodec>& codec : registry()) {
+        if (codec->matches(data, size)) {
+            return codec.get();
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,64 @@
+/*
+ * Decoders for the image file formats textures are loaded from, chosen by the
+ * signature at the start of a file rather than by its name.
+ *
+ * Usage: findImageCodec() returns the codec for the contents of a file (see
+ *        MappedFile.hpp), or nullptr, and its decode() gives the pixels in the
+ *        byte order and row order of a TGA file, so they go through the same
+ *        mipmap filtering and block compression. Texture::createTexture() does
+ *        this for every file which is not a DDS, KTX2 or TGA file. To add a
+ *        format, derive from ImageCodec and pass one to registerImageCodec().
+ *
+ * Built in are PNG (all color types and bit depths, 16 bits are reduced to 8,
+ * not interlaced) and baseline JPEG (grayscale or YCbCr, any chroma subsampling
+ * up to 2 x 2, not progressive). Both decode in parallel threads: PNG inflates
+ * the compressed data in one thread while the calling thread unfilters and
+ * converts the rows that are done, and JPEG decodes the segments between restart
+ * markers in parallel if the file has them, and otherwise runs the inverse DCT
+ * of each band of MCU rows while the next one is decoded. The color conversion
+ * is split into bands of rows too. Subsampled chroma is scaled up by repeating
+ * samples, so colors may differ slightly from libjpeg's smoother default.
+ * TGA files have no signature, so they are what is left when no codec matches.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct DecodedImage {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int channels = 0;          // 3 or 4
+    std::vector<unsigned char> pixels;  // B, G, R(, A), bottom row first, as in a TGA file
+};
+
+class ImageCodec {
+public:
+    virtual ~ImageCodec() = default;
+
+    // The name of the format, for messages
+    virtual const char* name() const = 0;
+
+    // True if the file starts with the signature of this format
+    virtual bool matches(const unsigned char* data, size_t size) const = 0;
+
+    // Decode a whole file into 'image' in up to 'threads' threads (0 for one per
+    // core). Returns false, after printing why, if the file is invalid or uses a
+    // feature which is not supported. 'filename' is only for messages.
+    virtual bool decode(const unsigned char* data, size_t size, const std::string& filename,
+                        DecodedImage& image, unsigned int threads = 0) const = 0;
+};
+
+// Add a codec, which is asked before those registered earlier and the built in ones
+void registerImageCodec(std::unique_ptr<ImageCodec> codec);
+
+// The codec whose signature the data starts with, nullptr if none does
+const ImageCodec* findImageCodec(const unsigned char* data, size_t size);
+
+// The built in codecs, registered on first use of findImageCodec()
+std::unique_ptr<ImageCodec> createPNGCodec();
+std::unique_ptr<ImageCodec> createJPEGCodec();
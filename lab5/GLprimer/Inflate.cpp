@@ -0,0 +1,339 @@
+/*
+ * Decompression of zlib streams (RFC 1950) of DEFLATE data (RFC 1951).
+ *
+ * This code is in the public domain.
+ */
+#include "Inflate.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr int kFastBits = 10;                // Codes up to this long are found in one lookup
+constexpr size_t kProgressStep = 32 << 10;  // Bytes of output between calls to 'progress'
+
+const uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistanceBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385,
+                                    24577};
+const uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// The order in which the code lengths of the code length code are stored
+const uint8_t kCodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1,
+                                      15};
+
+// Reads bits least significant first, as DEFLATE stores them
+struct BitReader {
+    const unsigned char* data;
+    size_t size;
+    size_t pos = 0;
+    uint64_t bits = 0;
+    int count = 0;       // Bits in 'bits'
+    size_t overrun = 0;  // Zero bytes put into 'bits' after the end of the data
+
+    BitReader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    void refill() {
+        while (count <= 56) {
+            uint64_t byte = 0;
+            if (pos < size) {
+                byte = data[pos++];
+            } else {
+                ++overrun;
+            }
+            bits |= byte << count;
+            count += 8;
+        }
+    }
+
+    void consume(int n) {
+        bits >>= n;
+        count -= n;
+    }
+
+    uint32_t get(int n) {
+        if (count < n) {
+            refill();
+        }
+        const uint32_t value = static_cast<uint32_t>(bits & ((uint64_t(1) << n) - 1));
+        consume(n);
+        return value;
+    }
+
+    // True if more bits were used than there are in the data
+    bool exhausted() const { return overrun * 8 > static_cast<size_t>(count); }
+
+    // Skip to the next byte and give back the whole bytes in 'bits', for stored blocks
+    void alignToByte() {
+        consume(count & 7);
+        const size_t buffered = static_cast<size_t>(count / 8);
+        pos -= std::min(pos, buffered - std::min(buffered, overrun));
+        bits = 0;
+        count = 0;
+        overrun = 0;
+    }
+};
+
+struct Huffman {
+    uint16_t fast[1 << kFastBits];  // symbol << 4 | length for short codes, 0 for longer ones
+    uint16_t count[16];             // The number of codes of each length
+    uint16_t symbols[288];          // Sorted by code
+
+    // Build the canonical code from the code length of each symbol, 0 for unused ones.
+    // Returns false if there are more codes than fit.
+    bool build(const uint8_t* lengths, int n) {
+        std::fill(count, count + 16, uint16_t(0));
+        for (int i = 0; i < n; ++i) {
+            ++count[lengths[i]];
+        }
+        count[0] = 0;
+        int left = 1;
+        for (int len = 1; len < 16; ++len) {
+            left = 2 * left - count[len];
+            if (left < 0) {
+                return false;
+            }
+        }
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int len = 1; len < 15; ++len) {
+            offsets[len + 1] = static_cast<uint16_t>(offsets[len] + count[len]);
+        }
+        for (int i = 0; i < n; ++i) {
+            if (lengths[i] != 0) {
+                symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+            }
+        }
+
+        // Codes are stored first bit first, so the table is indexed by reversed codes
+        std::fill(fast, fast + (1 << kFastBits), uint16_t(0));
+        int code = 0;
+        int index = 0;
+        for (int len = 1; len <= kFastBits; ++len) {
+            for (int k = 0; k < count[len]; ++k, ++code, ++index) {
+                int reversed = 0;
+                for (int b = 0; b < len; ++b) {
+                    reversed |= ((code >> b) & 1) << (len - 1 - b);
+                }
+                const uint16_t entry = static_cast<uint16_t>(symbols[index] << 4 | len);
+                for (int j = reversed; j < (1 << kFastBits); j += 1 << len) {
+                    fast[j] = entry;
+                }
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    // The next symbol, -1 for a code which is not in the table
+    int decode(BitReader& in) const {
+        if (in.count < 16) {
+            in.refill();
+        }
+        const uint16_t entry = fast[in.bits & ((1 << kFastBits) - 1)];
+        if (entry != 0) {
+            in.consume(entry & 15);
+            return entry >> 4;
+        }
+        // Longer codes: the codes of each length are consecutive, after those of the
+        // shorter lengths
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (int len = 1; len < 16; ++len) {
+            code |= static_cast<int>(in.bits & 1);
+            in.consume(1);
+            if (code - first < count[len]) {
+                return symbols[index + code - first];
+            }
+            index += count[len];
+            first = (first + count[len]) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+};
+
+struct FixedCodes {
+    Huffman literals;
+    Huffman distances;
+
+    FixedCodes() {
+        uint8_t lengths[288];
+        std::fill(lengths, lengths + 144, uint8_t(8));
+        std::fill(lengths + 144, lengths + 256, uint8_t(9));
+        std::fill(lengths + 256, lengths + 280, uint8_t(7));
+        std::fill(lengths + 280, lengths + 288, uint8_t(8));
+        literals.build(lengths, 288);
+        std::fill(lengths, lengths + 30, uint8_t(5));
+        distances.build(lengths, 30);
+    }
+};
+
+// Read the codes of a block with dynamic Huffman codes
+bool readDynamicCodes(BitReader& in, Huffman& literals, Huffman& distances) {
+    const int numLiterals = static_cast<int>(in.get(5)) + 257;
+    const int numDistances = static_cast<int>(in.get(5)) + 1;
+    const int numCodeLengths = static_cast<int>(in.get(4)) + 4;
+
+    uint8_t codeLengths[19] = {};
+    for (int i = 0; i < numCodeLengths; ++i) {
+        codeLengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(in.get(3));
+    }
+    Huffman codeLengthCode;
+    if (!codeLengthCode.build(codeLengths, 19)) {
+        return false;
+    }
+
+    uint8_t lengths[288 + 32] = {};
+    const int total = numLiterals + numDistances;
+    for (int i = 0; i < total;) {
+        const int symbol = codeLengthCode.decode(in);
+        if (symbol < 0) {
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[i++] = static_cast<uint8_t>(symbol);
+            continue;
+        }
+        uint8_t value = 0;
+        int repeat;
+        if (symbol == 16) {
+            if (i == 0) {
+                return false;
+            }
+            value = lengths[i - 1];
+            repeat = 3 + static_cast<int>(in.get(2));
+        } else if (symbol == 17) {
+            repeat = 3 + static_cast<int>(in.get(3));
+        } else {
+            repeat = 11 + static_cast<int>(in.get(7));
+        }
+        if (i + repeat > total) {
+            return false;
+        }
+        std::fill(lengths + i, lengths + i + repeat, value);
+        i += repeat;
+    }
+    if (lengths[256] == 0) {
+        return false;  // No end of block code
+    }
+    return literals.build(lengths, numLiterals) &&
+           distances.build(lengths + numLiterals, numDistances);
+}
+
+// Copy the match of a length symbol to the end of the output
+bool copyMatch(BitReader& in, const Huffman& distances, int lengthCode, unsigned char* out,
+               size_t outSize, size_t& pos) {
+    if (lengthCode >= 29) {
+        return false;
+    }
+    const size_t length = kLengthBase[lengthCode] + in.get(kLengthExtra[lengthCode]);
+    const int distanceCode = distances.decode(in);
+    if (distanceCode < 0 || distanceCode >= 30) {
+        return false;
+    }
+    const size_t distance = kDistanceBase[distanceCode] + in.get(kDistanceExtra[distanceCode]);
+    if (distance > pos || outSize - pos < length) {
+        return false;
+    }
+    // Byte by byte, as the copy may overlap what it writes
+    const unsigned char* from = out + pos - distance;
+    unsigned char* to = out + pos;
+    for (size_t i = 0; i < length; ++i) {
+        to[i] = from[i];
+    }
+    pos += length;
+    return true;
+}
+
+}  // namespace
+
+bool inflateZlib(const unsigned char* data, size_t size, unsigned char* out, size_t outSize,
+                 size_t& written, const std::function<void(size_t)>& progress) {
+    written = 0;
+    // Only DEFLATE with a window of up to 32 kB and no preset dictionary
+    if (size < 2 || (data[0] & 15) != 8 || (data[0] >> 4) > 7 ||
+        (data[0] * 256u + data[1]) % 31 != 0 || (data[1] & 0x20) != 0) {
+        return false;
+    }
+    static const FixedCodes fixed;
+    BitReader in(data + 2, size - 2);
+    Huffman dynamicLiterals;
+    Huffman dynamicDistances;
+    size_t pos = 0;
+    size_t reported = 0;
+
+    bool last = false;
+    while (!last) {
+        last = in.get(1) != 0;
+        const uint32_t type = in.get(2);
+        if (type == 0) {
+            in.alignToByte();
+            if (in.size - in.pos < 4) {
+                return false;
+            }
+            const unsigned char* header = in.data + in.pos;
+            const size_t length = header[0] | header[1] << 8;
+            if (static_cast<size_t>(header[2] | header[3] << 8) != (~length & 0xffff) ||
+                in.size - in.pos - 4 < length || outSize - pos < length) {
+                return false;
+            }
+            std::memcpy(out + pos, header + 4, length);
+            in.pos += 4 + length;
+            pos += length;
+            if (progress) {
+                progress(pos);
+            }
+            reported = pos;
+        } else if (type == 3) {
+            return false;
+        } else {
+            const Huffman* literals = &fixed.literals;
+            const Huffman* distances = &fixed.distances;
+            if (type == 2) {
+                if (!readDynamicCodes(in, dynamicLiterals, dynamicDistances)) {
+                    return false;
+                }
+                literals = &dynamicLiterals;
+                distances = &dynamicDistances;
+            }
+            for (;;) {
+                const int symbol = literals->decode(in);
+                if (symbol < 256) {
+                    if (symbol < 0 || pos == outSize) {
+                        return false;
+                    }
+                    out[pos++] = static_cast<unsigned char>(symbol);
+                } else if (symbol == 256) {
+                    break;
+                } else if (!copyMatch(in, *distances, symbol - 257, out, outSize, pos)) {
+                    return false;
+                }
+                if (pos - reported >= kProgressStep) {
+                    if (in.exhausted()) {
+                        return false;
+                    }
+                    if (progress) {
+                        progress(pos);
+                    }
+                    reported = pos;
+                }
+            }
+        }
+        if (in.exhausted()) {
+            return false;
+        }
+    }
+    written = pos;
+    if (progress) {
+        progress(pos);
+    }
+    return true;
+}
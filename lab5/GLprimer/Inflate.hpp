@@ -0,0 +1,26 @@
+/*
+ * Decompression of zlib streams (RFC 1950) of DEFLATE data (RFC 1951), as found
+ * in PNG files.
+ *
+ * Usage: call inflateZlib() with the whole stream and a buffer for the output.
+ *        With a 'progress' function, the output which is complete can be used
+ *        by another thread while the rest is being decompressed.
+ *
+ * Huffman codes of up to 10 bits, which are most of them, are decoded with one
+ * table lookup, longer ones bit by bit. The Adler-32 checksum is not verified.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+/*
+ * Decompress 'size' bytes of a zlib stream into 'out', which has room for 'outSize'
+ * bytes. 'written' is set to the number of bytes of output. 'progress', if given,
+ * is called every few kilobytes with the number of bytes of output so far, which
+ * are not changed again. Returns false if the stream is invalid or does not fit.
+ */
+bool inflateZlib(const unsigned char* data, size_t size, unsigned char* out, size_t outSize,
+                 size_t& written, const std::function<void(size_t)>& progress = nullptr);
@@ -0,0 +1,164 @@
+/* InputLog.cpp
+ * Recording and replay of the per-frame input to KeyRotator and MouseRotator.
+ *
+ * This code is in the public domain.
+ */
+#include "InputLog.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char magic[8] = {'T', 'N', 'M', 'I', 'N', 'P', 'U', 'T'};
+const uint32_t version = 1;
+const size_t headerSize = 16;
+const size_t recordSize = 29;
+
+void putUint(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+uint64_t getUint(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+// Doubles are stored by their bit pattern, so replayed values are exact
+void putDouble(unsigned char* out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putUint(out, bits, 8);
+}
+
+double getDouble(const unsigned char* in) {
+    const uint64_t bits = getUint(in, 8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint16_t clampSize(int size) { return static_cast<uint16_t>(std::clamp(size, 0, 65535)); }
+
+}  // namespace
+
+InputRecorder::~InputRecorder() { close(); }
+
+bool InputRecorder::open(const std::string& filename) {
+    close();
+    file_ = fopen(filename.c_str(), "wb");
+    if (!file_) {
+        std::cerr << "Could not create input log '" << filename << "'\n";
+        return false;
+    }
+    unsigned char header[headerSize];
+    std::memcpy(header, magic, sizeof(magic));
+    putUint(header + 8, version, 4);
+    putUint(header + 12, recordSize, 4);
+    fwrite(header, 1, headerSize, file_);
+    numFrames_ = 0;
+    return true;
+}
+
+void InputRecorder::write(const InputState& state) {
+    if (!file_) {
+        return;
+    }
+    unsigned char record[recordSize];
+    putDouble(record, state.time);
+    putDouble(record + 8, state.cursorX);
+    putDouble(record + 16, state.cursorY);
+    putUint(record + 24, clampSize(state.windowWidth), 2);
+    putUint(record + 26, clampSize(state.windowHeight), 2);
+    record[28] = static_cast<unsigned char>(
+        (state.keyLeft ? 1 : 0) | (state.keyRight ? 2 : 0) | (state.keyUp ? 4 : 0) |
+        (state.keyDown ? 8 : 0) | (state.buttonLeft ? 16 : 0) | (state.buttonRight ? 32 : 0));
+    fwrite(record, 1, recordSize, file_);  // Buffered by stdio, errors are checked in close()
+    ++numFrames_;
+}
+
+bool InputRecorder::close() {
+    if (!file_) {
+        return true;
+    }
+    const bool ok = !ferror(file_);
+    fclose(file_);
+    file_ = nullptr;
+    if (!ok) {
+        std::cerr << "Error writing the input log\n";
+    }
+    return ok;
+}
+
+bool InputRecorder::isOpen() const { return file_ != nullptr; }
+
+size_t InputRecorder::numFrames() const { return numFrames_; }
+
+bool InputReplay::open(const std::string& filename) {
+    open_ = false;
+    records_.clear();
+    numFrames_ = 0;
+    position_ = 0;
+
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Could not open input log '" << filename << "'\n";
+        return false;
+    }
+    unsigned char header[headerSize];
+    if (fread(header, 1, headerSize, file) != headerSize ||
+        std::memcmp(header, magic, sizeof(magic)) != 0) {
+        std::cerr << "'" << filename << "' is not an input log\n";
+        fclose(file);
+        return false;
+    }
+    if (getUint(header + 8, 4) != version || getUint(header + 12, 4) != recordSize) {
+        std::cerr << "Unsupported input log version in '" << filename << "'\n";
+        fclose(file);
+        return false;
+    }
+
+    unsigned char buffer[64 * 1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        records_.insert(records_.end(), buffer, buffer + n);
+    }
+    fclose(file);
+
+    numFrames_ = records_.size() / recordSize;  // Ignore a truncated last record
+    open_ = true;
+    return true;
+}
+
+bool InputReplay::next(InputState& state) {
+    if (position_ >= numFrames_) {
+        return false;
+    }
+    const unsigned char* record = records_.data() + position_ * recordSize;
+    ++position_;
+
+    state.time = getDouble(record);
+    state.cursorX = getDouble(record + 8);
+    state.cursorY = getDouble(record + 16);
+    state.windowWidth = static_cast<int>(getUint(record + 24, 2));
+    state.windowHeight = static_cast<int>(getUint(record + 26, 2));
+    const unsigned char flags = record[28];
+    state.keyLeft = (flags & 1) != 0;
+    state.keyRight = (flags & 2) != 0;
+    state.keyUp = (flags & 4) != 0;
+    state.keyDown = (flags & 8) != 0;
+    state.buttonLeft = (flags & 16) != 0;
+    state.buttonRight = (flags & 32) != 0;
+    return true;
+}
+
+bool InputReplay::isOpen() const { return open_; }
+
+size_t InputReplay::numFrames() const { return numFrames_; }
@@ -0,0 +1,65 @@
+/* InputLog.hpp
+ * Recording and replay of the per-frame input to KeyRotator and MouseRotator.
+ *
+ * Usage: to record, open() an InputRecorder and write() the InputState of
+ * every frame, starting with the state the rotators were constructed from.
+ * To replay, open() an InputReplay and call next() once per frame instead of
+ * InputState::capture(); it returns false when the log ends. Replayed states
+ * are bit-identical to the recorded ones, timestamps included, so a replayed
+ * session renders exactly the same frames in every build.
+ *
+ * File format (all values little endian):
+ *   header: "TNMINPUT", uint32 version (1), uint32 record size (29)
+ *   one record per frame: float64 time, float64 cursorX, float64 cursorY,
+ *                         uint16 windowWidth, uint16 windowHeight,
+ *                         uint8 flags (bit 0-3 keys left/right/up/down,
+ *                                      bit 4-5 buttons left/right)
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include "Rotator.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder();
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    // Create the log file and write the header. Returns false on errors.
+    bool open(const std::string& filename);
+    // Append one frame. Does nothing if no log is open.
+    void write(const InputState& state);
+    // Flush and close the log. Returns false if writing failed.
+    bool close();
+
+    bool isOpen() const;
+    size_t numFrames() const;
+
+private:
+    FILE* file_ = nullptr;
+    size_t numFrames_ = 0;
+};
+
+class InputReplay {
+public:
+    // Read a whole log into memory. Returns false on errors.
+    bool open(const std::string& filename);
+    // The next recorded frame. Returns false after the last one.
+    bool next(InputState& state);
+
+    bool isOpen() const;
+    size_t numFrames() const;
+
+private:
+    std::vector<unsigned char> records_;
+    size_t numFrames_ = 0;
+    size_t position_ = 0;
+    bool open_ = false;
+};
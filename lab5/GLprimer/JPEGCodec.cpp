@@ -0,0 +1,745 @@
+/*
+ * Baseline JPEG decoding, in parallel threads by restart intervals or by bands of
+ * MCU rows.
+ *
+ * This code is in the public domain.
+ */
+#include "ImageCodec.hpp"
+#include "Utilities.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// The position in the block of each coefficient, in the order they are stored
+const uint8_t kNaturalOrder[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                   12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                   35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                   58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+constexpr int kFastBits = 9;  // Huffman codes up to this long are found in one lookup
+
+// MCU rows per band, when a file without restart markers is decoded in bands
+constexpr size_t kBandRows = 4;
+// Files with fewer MCUs than this are decoded in the calling thread only
+constexpr size_t kMinParallelMCUs = 1024;
+
+// Reads the entropy coded data of one restart interval, most significant bit first,
+// with the zero bytes stuffed after 0xFF bytes removed. Past the end it reads zeros.
+struct EntropyReader {
+    const unsigned char* pos;
+    const unsigned char* end;
+    uint64_t bits = 0;  // The next bit is the most significant one
+    int count = 0;
+
+    EntropyReader(const unsigned char* begin, const unsigned char* end) : pos(begin), end(end) {}
+
+    void refill() {
+        while (count <= 56) {
+            uint64_t byte = 0;
+            if (pos < end) {
+                byte = *pos++;
+                if (byte == 0xFF && pos < end && *pos == 0) {
+                    ++pos;
+                }
+            }
+            bits |= byte << (56 - count);
+            count += 8;
+        }
+    }
+
+    uint32_t peek(int n) const { return static_cast<uint32_t>(bits >> (64 - n)); }
+
+    void consume(int n) {
+        bits <<= n;
+        count -= n;
+    }
+
+    // 'n' bits as a signed value of its magnitude category (F.2.2.1 in the standard)
+    int receiveExtend(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        if (count < n) {
+            refill();
+        }
+        const int value = static_cast<int>(peek(n));
+        consume(n);
+        return value < (1 << (n - 1)) ? value - (1 << n) + 1 : value;
+    }
+};
+
+struct HuffmanTable {
+    bool defined = false;
+    uint8_t fastLength[1 << kFastBits];  // 0 for longer codes
+    uint8_t fastSymbol[1 << kFastBits];
+    int32_t maxCode[18];    // The largest code of each length, -1 if there are none
+    int32_t valueOffset[18];  // Index in 'symbols' of a code of each length, minus the code
+    uint8_t symbols[256];
+
+    // Build the table from the number of codes of each length and the symbols in order.
+    // Returns false if there are more codes than fit.
+    bool build(const uint8_t* counts, const uint8_t* values, int numValues) {
+        std::memcpy(symbols, values, static_cast<size_t>(numValues));
+        std::fill(fastLength, fastLength + (1 << kFastBits), uint8_t(0));
+        int32_t code = 0;
+        int index = 0;
+        for (int len = 1; len <= 16; ++len) {
+            // Checked before filling the fast table, which more codes would overrun
+            if (code + counts[len - 1] > 1 << len) {
+                return false;
+            }
+            valueOffset[len] = index - code;
+            for (int i = 0; i < counts[len - 1]; ++i, ++code, ++index) {
+                if (len <= kFastBits) {
+                    const int first = code << (kFastBits - len);
+                    for (int j = 0; j < 1 << (kFastBits - len); ++j) {
+                        fastLength[first + j] = static_cast<uint8_t>(len);
+                        fastSymbol[first + j] = symbols[index];
+                    }
+                }
+            }
+            maxCode[len] = counts[len - 1] > 0 ? code - 1 : -1;
+            code <<= 1;
+        }
+        maxCode[17] = 0x7fffffff;
+        defined = true;
+        return true;
+    }
+
+    // The next symbol, -1 for a code which is not in the table
+    int decode(EntropyReader& in) const {
+        if (in.count < 16) {
+            in.refill();
+        }
+        const uint32_t index = in.peek(kFastBits);
+        if (fastLength[index] != 0) {
+            in.consume(fastLength[index]);
+            return fastSymbol[index];
+        }
+        for (int len = kFastBits + 1; len <= 16; ++len) {
+            const int32_t code = static_cast<int32_t>(in.peek(len));
+            if (code <= maxCode[len]) {
+                in.consume(len);
+                return symbols[code + valueOffset[len]];
+            }
+        }
+        return -1;
+    }
+};
+
+struct Component {
+    int id = 0;
+    int h = 1;  // Sampling factors
+    int v = 1;
+    int quant = 0;  // Table indices
+    int dc = 0;
+    int ac = 0;
+    size_t blocksW = 0;  // Of the whole image, rounded up to whole MCUs
+    size_t blocksH = 0;
+    std::vector<uint8_t> plane;  // blocksW * 8 x blocksH * 8 samples
+};
+
+struct Frame {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    int numComponents = 0;
+    Component components[3];
+    int hmax = 1;
+    int vmax = 1;
+    size_t mcusX = 0;
+    size_t mcusY = 0;
+    bool rgb = false;  // The components are R, G and B rather than Y, Cb and Cr
+    unsigned int restartInterval = 0;
+    uint16_t quant[4][64] = {};  // In natural order
+    bool quantDefined[4] = {};
+    HuffmanTable dc[4];
+    HuffmanTable ac[4];
+
+    size_t numMCUs() const { return mcusX * mcusY; }
+};
+
+uint16_t readBE16(const unsigned char* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+uint8_t clampByte(int value) { return static_cast<uint8_t>(std::clamp(value, 0, 255)); }
+
+/*
+ * Decode the quantized coefficients of one block, in natural order. Returns false
+ * for invalid data.
+ */
+bool decodeBlock(EntropyReader& in, const HuffmanTable& dc, const HuffmanTable& ac,
+                 int& predictor, int16_t* coefficients) {
+    std::fill(coefficients, coefficients + 64, int16_t(0));
+    const int category = dc.decode(in);
+    if (category < 0 || category > 11) {
+        return false;
+    }
+    predictor += in.receiveExtend(category);
+    coefficients[0] = static_cast<int16_t>(predictor);
+    for (int k = 1; k < 64;) {
+        const int rs = ac.decode(in);
+        if (rs < 0) {
+            return false;
+        }
+        const int run = rs >> 4;
+        const int size = rs & 15;
+        if (size == 0) {
+            if (run != 15) {
+                break;  // End of block
+            }
+            k += 16;
+            continue;
+        }
+        k += run;
+        if (k > 63) {
+            return false;
+        }
+        coefficients[kNaturalOrder[k++]] = static_cast<int16_t>(in.receiveExtend(size));
+    }
+    return true;
+}
+
+// Fixed point constants of the inverse DCT, with 12 fractional bits
+constexpr int fix(float x) { return static_cast<int>(x * 4096.0f + 0.5f); }
+
+struct Idct1D {
+    int x0, x1, x2, x3;  // The even part
+    int t0, t1, t2, t3;  // The odd part
+};
+
+// One dimensional inverse DCT of 8 values, the separable factorization of the IJG
+// library's "islow" version
+inline Idct1D idct1D(int s0, int s1, int s2, int s3, int s4, int s5, int s6, int s7) {
+    Idct1D r;
+    int p1 = (s2 + s6) * fix(0.5411961f);
+    int t2 = p1 + s6 * -fix(1.847759065f);
+    int t3 = p1 + s2 * fix(0.765366865f);
+    int t0 = (s0 + s4) * 4096;
+    int t1 = (s0 - s4) * 4096;
+    r.x0 = t0 + t3;
+    r.x3 = t0 - t3;
+    r.x1 = t1 + t2;
+    r.x2 = t1 - t2;
+
+    t0 = s7;
+    t1 = s5;
+    t2 = s3;
+    t3 = s1;
+    int p3 = t0 + t2;
+    int p4 = t1 + t3;
+    p1 = t0 + t3;
+    int p2 = t1 + t2;
+    const int p5 = (p3 + p4) * fix(1.175875602f);
+    t0 *= fix(0.298631336f);
+    t1 *= fix(2.053119869f);
+    t2 *= fix(3.072711026f);
+    t3 *= fix(1.501321110f);
+    p1 = p5 + p1 * -fix(0.899976223f);
+    p2 = p5 + p2 * -fix(2.562915447f);
+    p3 *= -fix(1.961570560f);
+    p4 *= -fix(0.390180644f);
+    r.t3 = t3 + p1 + p4;
+    r.t2 = t2 + p2 + p3;
+    r.t1 = t1 + p2 + p4;
+    r.t0 = t0 + p1 + p3;
+    return r;
+}
+
+/*
+ * Dequantize a block and write its inverse DCT to 8 x 8 samples at 'out'
+ */
+void idctBlock(const int16_t* coefficients, const uint16_t* quant, uint8_t* out, size_t stride) {
+    int values[64];
+    // Columns, with two more fractional bits kept
+    for (int i = 0; i < 8; ++i) {
+        const int16_t* c = coefficients + i;
+        const uint16_t* q = quant + i;
+        int* v = values + i;
+        if (c[8] == 0 && c[16] == 0 && c[24] == 0 && c[32] == 0 && c[40] == 0 && c[48] == 0 &&
+            c[56] == 0) {
+            const int dc = c[0] * q[0] * 4;
+            for (int j = 0; j < 64; j += 8) {
+                v[j] = dc;
+            }
+            continue;
+        }
+        Idct1D r = idct1D(c[0] * q[0], c[8] * q[8], c[16] * q[16], c[24] * q[24], c[32] * q[32],
+                          c[40] * q[40], c[48] * q[48], c[56] * q[56]);
+        r.x0 += 512;
+        r.x1 += 512;
+        r.x2 += 512;
+        r.x3 += 512;
+        v[0] = (r.x0 + r.t3) >> 10;
+        v[56] = (r.x0 - r.t3) >> 10;
+        v[8] = (r.x1 + r.t2) >> 10;
+        v[48] = (r.x1 - r.t2) >> 10;
+        v[16] = (r.x2 + r.t1) >> 10;
+        v[40] = (r.x2 - r.t1) >> 10;
+        v[24] = (r.x3 + r.t0) >> 10;
+        v[32] = (r.x3 - r.t0) >> 10;
+    }
+    // Rows, rounded, scaled by 1 / 8 and moved up by 128
+    for (int i = 0; i < 8; ++i, out += stride) {
+        const int* v = values + 8 * i;
+        Idct1D r = idct1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+        const int bias = 65536 + (128 << 17);
+        r.x0 += bias;
+        r.x1 += bias;
+        r.x2 += bias;
+        r.x3 += bias;
+        out[0] = clampByte((r.x0 + r.t3) >> 17);
+        out[7] = clampByte((r.x0 - r.t3) >> 17);
+        out[1] = clampByte((r.x1 + r.t2) >> 17);
+        out[6] = clampByte((r.x1 - r.t2) >> 17);
+        out[2] = clampByte((r.x2 + r.t1) >> 17);
+        out[5] = clampByte((r.x2 - r.t1) >> 17);
+        out[3] = clampByte((r.x3 + r.t0) >> 17);
+        out[4] = clampByte((r.x3 - r.t0) >> 17);
+    }
+}
+
+void idctToPlane(const Frame& frame, Component& component, size_t blockX, size_t blockY,
+                 const int16_t* coefficients) {
+    const size_t stride = component.blocksW * 8;
+    idctBlock(coefficients, frame.quant[component.quant],
+              component.plane.data() + blockY * 8 * stride + blockX * 8, stride);
+}
+
+/*
+ * Decode 'count' MCUs from MCU 'first' on, the whole of a restart interval or of a
+ * file without them up to some MCU, and call fn(component, block x, block y,
+ * coefficients) for each block. Returns false for invalid data.
+ */
+template <typename BlockFn>
+bool decodeMCUs(const Frame& frame, EntropyReader& in, int* predictors, size_t first,
+                size_t count, BlockFn&& fn) {
+    int16_t coefficients[64];
+    for (size_t mcu = first; mcu < first + count; ++mcu) {
+        const size_t mcuX = mcu % frame.mcusX;
+        const size_t mcuY = mcu / frame.mcusX;
+        for (int c = 0; c < frame.numComponents; ++c) {
+            const Component& component = frame.components[c];
+            for (int y = 0; y < component.v; ++y) {
+                for (int x = 0; x < component.h; ++x) {
+                    if (!decodeBlock(in, frame.dc[component.dc], frame.ac[component.ac],
+                                     predictors[c], coefficients)) {
+                        return false;
+                    }
+                    fn(c, mcuX * component.h + x, mcuY * component.v + y, coefficients);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Convert the rows [begin, end) of the component planes to B, G, R. Subsampled
+ * components are scaled up by repeating their samples.
+ */
+void convertRows(const Frame& frame, size_t begin, size_t end, DecodedImage& image) {
+    const size_t outRow = size_t(image.width) * 3;
+    // The sample of each component in each column, looked up rather than divided
+    std::vector<uint32_t> columns[3];
+    for (int c = 0; c < frame.numComponents; ++c) {
+        columns[c].resize(image.width);
+        for (uint32_t x = 0; x < image.width; ++x) {
+            columns[c][x] = x * static_cast<uint32_t>(frame.components[c].h) /
+                            static_cast<uint32_t>(frame.hmax);
+        }
+    }
+    for (size_t y = begin; y < end; ++y) {
+        uint8_t* out = image.pixels.data() + (image.height - 1 - y) * outRow;
+        const uint8_t* rows[3];
+        for (int c = 0; c < frame.numComponents; ++c) {
+            const Component& component = frame.components[c];
+            rows[c] = component.plane.data() +
+                      y * component.v / frame.vmax * component.blocksW * 8;
+        }
+        if (frame.numComponents == 1) {
+            for (size_t x = 0; x < image.width; ++x, out += 3) {
+                out[0] = out[1] = out[2] = rows[0][x];
+            }
+            continue;
+        }
+        for (size_t x = 0; x < image.width; ++x, out += 3) {
+            const int a = rows[0][columns[0][x]];
+            const int b = rows[1][columns[1][x]];
+            const int c = rows[2][columns[2][x]];
+            if (frame.rgb) {
+                out[0] = static_cast<uint8_t>(c);
+                out[1] = static_cast<uint8_t>(b);
+                out[2] = static_cast<uint8_t>(a);
+                continue;
+            }
+            // YCbCr to RGB as in JFIF, with 16 fractional bits
+            const int cb = b - 128;
+            const int cr = c - 128;
+            const int yy = (a << 16) + 32768;
+            out[2] = clampByte((yy + 91881 * cr) >> 16);
+            out[1] = clampByte((yy - 22554 * cb - 46802 * cr) >> 16);
+            out[0] = clampByte((yy + 116130 * cb) >> 16);
+        }
+    }
+}
+
+/*
+ * Find the entropy coded segments of a scan starting at 'pos', which are separated by
+ * restart markers. Returns the position after the scan.
+ */
+size_t findSegments(const unsigned char* data, size_t size, size_t pos,
+                    std::vector<std::pair<size_t, size_t>>& segments) {
+    size_t start = pos;
+    while (pos + 1 < size) {
+        if (data[pos] != 0xFF) {
+            ++pos;
+            continue;
+        }
+        const unsigned char next = data[pos + 1];
+        if (next == 0x00) {
+            pos += 2;
+        } else if (next == 0xFF) {
+            ++pos;  // A fill byte
+        } else if (next >= 0xD0 && next <= 0xD7) {
+            segments.emplace_back(start, pos);
+            pos += 2;
+            start = pos;
+        } else {
+            segments.emplace_back(start, pos);
+            return pos;
+        }
+    }
+    segments.emplace_back(start, size);
+    return size;
+}
+
+class JPEGCodec : public ImageCodec {
+public:
+    const char* name() const override { return "JPEG"; }
+
+    bool matches(const unsigned char* data, size_t size) const override {
+        return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+    }
+
+    bool decode(const unsigned char* data, size_t size, const std::string& filename,
+                DecodedImage& image, unsigned int threads) const override;
+
+private:
+    // Decode the scan whose entropy coded data starts at 'pos' into the planes
+    static bool decodeScan(Frame& frame, const unsigned char* data, size_t size, size_t pos,
+                           unsigned int threads);
+    static bool readFrame(Frame& frame, const unsigned char* segment, size_t length,
+                          const std::string& filename);
+    static bool readScanHeader(Frame& frame, const unsigned char* segment, size_t length,
+                               const std::string& filename);
+};
+
+bool JPEGCodec::readFrame(Frame& frame, const unsigned char* segment, size_t length,
+                          const std::string& filename) {
+    if (length < 6 || segment[0] != 8) {
+        std::cerr << "Only 8 bit JPEG files are supported ('" << filename << "')\n";
+        return false;
+    }
+    frame.height = readBE16(segment + 1);
+    frame.width = readBE16(segment + 3);
+    frame.numComponents = segment[5];
+    if (frame.numComponents != 1 && frame.numComponents != 3) {
+        std::cerr << "Only grayscale and color JPEG files are supported ('" << filename
+                  << "')\n";
+        return false;
+    }
+    if (length < 6 + 3 * size_t(frame.numComponents) || frame.width == 0 || frame.height == 0) {
+        std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+        return false;
+    }
+    for (int c = 0; c < frame.numComponents; ++c) {
+        Component& component = frame.components[c];
+        const unsigned char* p = segment + 6 + 3 * c;
+        component.id = p[0];
+        component.h = p[1] >> 4;
+        component.v = p[1] & 15;
+        component.quant = p[2];
+        if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 ||
+            component.quant > 3) {
+            std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+            return false;
+        }
+        if (frame.numComponents == 1) {
+            component.h = component.v = 1;  // A single component is not interleaved
+        }
+        frame.hmax = std::max(frame.hmax, component.h);
+        frame.vmax = std::max(frame.vmax, component.v);
+    }
+    for (int c = 0; c < frame.numComponents; ++c) {
+        const Component& component = frame.components[c];
+        if (frame.hmax % component.h != 0 || frame.vmax % component.v != 0) {
+            std::cerr << "Unsupported JPEG chroma subsampling ('" << filename << "')\n";
+            return false;
+        }
+    }
+    if (frame.numComponents == 3 && frame.components[0].id == 'R' &&
+        frame.components[1].id == 'G' && frame.components[2].id == 'B') {
+        frame.rgb = true;
+    }
+    frame.mcusX = (frame.width + 8 * frame.hmax - 1) / (8 * frame.hmax);
+    frame.mcusY = (frame.height + 8 * frame.vmax - 1) / (8 * frame.vmax);
+    for (int c = 0; c < frame.numComponents; ++c) {
+        Component& component = frame.components[c];
+        component.blocksW = frame.mcusX * component.h;
+        component.blocksH = frame.mcusY * component.v;
+        component.plane.resize(component.blocksW * component.blocksH * 64);
+    }
+    return true;
+}
+
+bool JPEGCodec::readScanHeader(Frame& frame, const unsigned char* segment, size_t length,
+                               const std::string& filename) {
+    if (frame.numComponents == 0 || length < 1 || length < 4 + 2 * size_t(segment[0])) {
+        std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+        return false;
+    }
+    if (segment[0] != frame.numComponents) {
+        std::cerr << "JPEG files with several scans are not supported ('" << filename << "')\n";
+        return false;
+    }
+    for (int i = 0; i < frame.numComponents; ++i) {
+        const unsigned char* p = segment + 1 + 2 * i;
+        Component* component = nullptr;
+        for (int c = 0; c < frame.numComponents; ++c) {
+            if (frame.components[c].id == p[0]) {
+                component = &frame.components[c];
+            }
+        }
+        if (component == nullptr || (p[1] >> 4) > 3 || (p[1] & 15) > 3 ||
+            !frame.dc[p[1] >> 4].defined || !frame.ac[p[1] & 15].defined ||
+            !frame.quantDefined[component->quant]) {
+            std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+            return false;
+        }
+        component->dc = p[1] >> 4;
+        component->ac = p[1] & 15;
+    }
+    return true;
+}
+
+bool JPEGCodec::decodeScan(Frame& frame, const unsigned char* data, size_t size, size_t pos,
+                           unsigned int threads) {
+    std::vector<std::pair<size_t, size_t>> segments;
+    findSegments(data, size, pos, segments);
+    const size_t numMCUs = frame.numMCUs();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    auto toPlanes = [&frame](int c, size_t x, size_t y, const int16_t* coefficients) {
+        idctToPlane(frame, frame.components[c], x, y, coefficients);
+    };
+
+    // Restart intervals start from scratch, so they are decoded in parallel
+    const size_t interval = frame.restartInterval;
+    if (interval > 0) {
+        const size_t numIntervals = (numMCUs + interval - 1) / interval;
+        if (segments.size() < numIntervals) {
+            return false;
+        }
+        std::atomic<bool> ok(true);
+        util::parallelFor(numIntervals, kMinParallelMCUs / interval + 1, threads,
+                          [&](size_t begin, size_t end) {
+                              for (size_t i = begin; i < end && ok; ++i) {
+                                  EntropyReader in(data + segments[i].first,
+                                                   data + segments[i].second);
+                                  int predictors[3] = {0, 0, 0};
+                                  const size_t first = i * interval;
+                                  if (!decodeMCUs(frame, in, predictors, first,
+                                                  std::min(interval, numMCUs - first),
+                                                  toPlanes)) {
+                                      ok = false;
+                                  }
+                              }
+                          });
+        return ok;
+    }
+
+    EntropyReader in(data + segments[0].first, data + segments[0].second);
+    int predictors[3] = {0, 0, 0};
+    if (threads == 1 || numMCUs < kMinParallelMCUs) {
+        return decodeMCUs(frame, in, predictors, 0, numMCUs, toPlanes);
+    }
+
+    // Otherwise the entropy decoding is sequential. It decodes bands of MCU rows into
+    // one of two buffers of coefficients, while another thread runs the inverse DCT
+    // of the band in the other buffer.
+    struct Band {
+        std::vector<int16_t> coefficients[3];  // Each component's blocks, row by row
+        size_t firstRow = 0;                   // In MCU rows
+        size_t numRows = 0;
+    };
+    Band bands[2];
+    for (Band& band : bands) {
+        for (int c = 0; c < frame.numComponents; ++c) {
+            const Component& component = frame.components[c];
+            band.coefficients[c].resize(kBandRows * component.v * component.blocksW * 64);
+        }
+    }
+    const unsigned int idctThreads = std::max(1u, threads - 1);
+    auto transform = [&frame, idctThreads](const Band& band) {
+        for (int c = 0; c < frame.numComponents; ++c) {
+            Component& component = frame.components[c];
+            const size_t blockRows = band.numRows * component.v;
+            util::parallelFor(blockRows, 1, idctThreads, [&](size_t begin, size_t end) {
+                for (size_t y = begin; y < end; ++y) {
+                    const int16_t* row = band.coefficients[c].data() + y * component.blocksW * 64;
+                    for (size_t x = 0; x < component.blocksW; ++x) {
+                        idctToPlane(frame, component, x, band.firstRow * component.v + y,
+                                    row + x * 64);
+                    }
+                }
+            });
+        }
+    };
+
+    bool ok = true;
+    std::thread transformer;
+    for (size_t row = 0, b = 0; row < frame.mcusY && ok; row += kBandRows, b ^= 1) {
+        Band& band = bands[b];
+        band.firstRow = row;
+        band.numRows = std::min(kBandRows, frame.mcusY - row);
+        ok = decodeMCUs(frame, in, predictors, row * frame.mcusX, band.numRows * frame.mcusX,
+                        [&](int c, size_t x, size_t y, const int16_t* coefficients) {
+                            const Component& component = frame.components[c];
+                            const size_t blockY = y - band.firstRow * component.v;
+                            int16_t* to = band.coefficients[c].data() +
+                                          (blockY * component.blocksW + x) * 64;
+                            std::memcpy(to, coefficients, 64 * sizeof(int16_t));
+                        });
+        // The other buffer is free once its band is transformed
+        if (transformer.joinable()) {
+            transformer.join();
+        }
+        if (ok) {
+            transformer = std::thread(transform, std::cref(band));
+        }
+    }
+    if (transformer.joinable()) {
+        transformer.join();
+    }
+    return ok;
+}
+
+bool JPEGCodec::decode(const unsigned char* data, size_t size, const std::string& filename,
+                       DecodedImage& image, unsigned int threads) const {
+    Frame frame;
+    size_t pos = 2;
+    for (;;) {
+        // Markers may be preceded by any number of fill bytes
+        while (pos < size && data[pos] == 0xFF) {
+            ++pos;
+        }
+        if (pos >= size || data[pos - 1] != 0xFF) {
+            std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+            return false;
+        }
+        const unsigned char marker = data[pos++];
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            continue;  // No length
+        }
+        if (marker == 0xD8 || marker == 0xD9 || size - pos < 2 || readBE16(data + pos) < 2 ||
+            readBE16(data + pos) > size - pos) {
+            std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+            return false;
+        }
+        const size_t length = readBE16(data + pos) - 2u;
+        const unsigned char* segment = data + pos + 2;
+        pos += 2 + length;
+
+        if (marker == 0xC0 || marker == 0xC1) {
+            if (!readFrame(frame, segment, length, filename)) {
+                return false;
+            }
+        } else if (marker == 0xC2 || marker == 0xC6 || marker == 0xCA || marker == 0xCE) {
+            std::cerr << "Progressive JPEG files are not supported ('" << filename << "')\n";
+            return false;
+        } else if ((marker >= 0xC3 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 &&
+                   marker != 0xCC) {
+            std::cerr << "Only baseline JPEG files are supported ('" << filename << "')\n";
+            return false;
+        } else if (marker == 0xC4) {
+            // Huffman tables: class and index, the number of codes of each length, the symbols
+            for (size_t i = 0; i < length;) {
+                const int index = segment[i] & 15;
+                const bool isAC = (segment[i] >> 4) != 0;
+                if (index > 3 || length - i < 17) {
+                    std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+                    return false;
+                }
+                const uint8_t* counts = segment + i + 1;
+                int numValues = 0;
+                for (int len = 0; len < 16; ++len) {
+                    numValues += counts[len];
+                }
+                HuffmanTable& table = isAC ? frame.ac[index] : frame.dc[index];
+                if (numValues > 256 || length - i - 17 < size_t(numValues) ||
+                    !table.build(counts, segment + i + 17, numValues)) {
+                    std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+                    return false;
+                }
+                i += 17 + numValues;
+            }
+        } else if (marker == 0xDB) {
+            // Quantization tables: precision and index, 64 values in zig-zag order
+            for (size_t i = 0; i < length;) {
+                const int index = segment[i] & 15;
+                const bool wide = (segment[i] >> 4) != 0;
+                if (index > 3 || length - i < 1 + (wide ? 128u : 64u)) {
+                    std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+                    return false;
+                }
+                for (int k = 0; k < 64; ++k) {
+                    const unsigned char* p = segment + i + 1 + (wide ? 2 * k : k);
+                    frame.quant[index][kNaturalOrder[k]] = wide ? readBE16(p) : p[0];
+                }
+                frame.quantDefined[index] = true;
+                i += 1 + (wide ? 128 : 64);
+            }
+        } else if (marker == 0xDD) {
+            if (length < 2) {
+                std::cerr << "Invalid JPEG file ('" << filename << "')\n";
+                return false;
+            }
+            frame.restartInterval = readBE16(segment);
+        } else if (marker == 0xEE) {
+            // An Adobe segment tells whether three components are YCbCr or RGB
+            if (length >= 12 && std::memcmp(segment, "Adobe", 5) == 0) {
+                frame.rgb = segment[11] == 0;
+            }
+        } else if (marker == 0xDA) {
+            if (!readScanHeader(frame, segment, length, filename)) {
+                return false;
+            }
+            break;
+        }
+    }
+
+    if (!decodeScan(frame, data, size, pos, threads)) {
+        std::cerr << "Corrupt JPEG image data ('" << filename << "')\n";
+        return false;
+    }
+
+    image = DecodedImage();
+    image.width = frame.width;
+    image.height = frame.height;
+    image.channels = 3;
+    image.pixels.resize(size_t(image.width) * image.height * 3);
+    util::parallelFor(image.height, 64, threads, [&](size_t begin, size_t end) {
+        convertRows(frame, begin, end, image);
+    });
+    return true;
+}
+
+}  // namespace
+
+std::unique_ptr<ImageCodec> createJPEGCodec() { return std::make_unique<JPEGCodec>(); }
@@ -0,0 +1,314 @@
+/*
+ * tnm046-loadbench - a scaling benchmark for the OBJ loader in TriangleSoup.
+ *
+ * Usage: tnm046-loadbench [--sizes 1000,10000,...] [--max-triangles N] [--dir DIR]
+ *                         [--no-upload] [--keep]
+ *
+ * Generates synthetic OBJ files of increasing size (a wavy grid mesh), in four
+ * variants: positions only, with texture coordinates, with normals, and with both.
+ * The files use a mix of line formats (tabs, extra spaces, comments, exponent
+ * notation, negative face indices) to exercise the parser like real exported files.
+ *
+ * Each file is loaded the same way as TriangleSoup::readOBJ() does it, timing the
+ * three phases separately:
+ *   parse  - TriangleSoup::parseOBJ(), reading the file
+ *   build  - TriangleSoup::buildOBJ(), creating the interleaved vertex array
+ *   upload - TriangleSoup::upload(), creating the VAO and buffers (plus glFinish)
+ * The upload phase needs an OpenGL context and is skipped if none can be created.
+ *
+ * The time per triangle should stay constant as the size grows. A growing value
+ * (see the "scale" column) indicates superlinear behaviour.
+ * Peak RSS is the high water mark of the whole process. Sizes are run in ascending
+ * order, so the value on each row is due to the largest mesh loaded so far.
+ *
+ * This code is in the public domain.
+ */
+#if defined(WIN32) && !defined(_USE_MATH_DEFINES)
+#define _USE_MATH_DEFINES
+#endif
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "TriangleSoup.hpp"
+#include "Utilities.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct Variant {
+    const char* name;
+    bool texcoords;
+    bool normals;
+};
+
+const Variant variants[] = {
+    {"v", false, false},
+    {"v/t", true, false},
+    {"v//n", false, true},
+    {"v/t/n", true, true},
+};
+
+// Peak resident set size of this process in bytes
+size_t peakRSS() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);  // bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // kilobytes on Linux
+#endif
+#endif
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Write an OBJ file with exactly 'numTriangles' triangles, forming a wavy grid.
+ * Returns false if the file could not be written.
+ */
+bool writeOBJ(const std::string& filename, size_t numTriangles, const Variant& variant) {
+    FILE* out = fopen(filename.c_str(), "w");
+    if (!out) {
+        std::cerr << "Could not create '" << filename << "'\n";
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    setvbuf(out, buffer.data(), _IOFBF, buffer.size());
+
+    const size_t cols = std::max<size_t>(
+        1, static_cast<size_t>(std::sqrt(static_cast<double>(numTriangles) / 2.0)));
+    const size_t rows = (numTriangles + 2 * cols - 1) / (2 * cols);
+    const size_t numVerts = (cols + 1) * (rows + 1);
+
+    fprintf(out, "# Synthetic mesh for tnm046-loadbench\n# %zu triangles\n\nmtllib none.mtl\n",
+            numTriangles);
+    fprintf(out, "o grid\ng grid\n");
+
+    for (size_t j = 0; j <= rows; ++j) {
+        for (size_t i = 0; i <= cols; ++i) {
+            const double x = static_cast<double>(i) / static_cast<double>(cols) - 0.5;
+            const double y = static_cast<double>(j) / static_cast<double>(rows) - 0.5;
+            const double z = 0.05 * std::sin(20.0 * x) * std::cos(20.0 * y);
+            switch ((j * (cols + 1) + i) % 4) {  // vary the number formatting
+                case 0:
+                    fprintf(out, "v %f %f %f\n", x, y, z);
+                    break;
+                case 1:
+                    fprintf(out, "v  %.7g\t%.7g %.7g\n", x, y, z);
+                    break;
+                case 2:
+                    fprintf(out, "v %e %e %e \n", x, y, z);
+                    break;
+                default:
+                    fprintf(out, "  v %.4f %.4f %.4f 1.0\n", x, y, z);
+                    break;
+            }
+            if ((j * (cols + 1) + i) % 5000 == 4999) {
+                fprintf(out, "# vertex %zu\n\n", j * (cols + 1) + i + 1);
+            }
+        }
+    }
+
+    if (variant.texcoords) {
+        for (size_t j = 0; j <= rows; ++j) {
+            for (size_t i = 0; i <= cols; ++i) {
+                fprintf(out, (i % 2) ? "vt %f %f\n" : "vt %.6g\t%.6g 0\n",
+                        static_cast<double>(i) / static_cast<double>(cols),
+                        static_cast<double>(j) / static_cast<double>(rows));
+            }
+        }
+    }
+
+    if (variant.normals) {
+        for (size_t j = 0; j <= rows; ++j) {
+            for (size_t i = 0; i <= cols; ++i) {
+                const double x = static_cast<double>(i) / static_cast<double>(cols) - 0.5;
+                const double y = static_cast<double>(j) / static_cast<double>(rows) - 0.5;
+                // Normal of the height field z(x, y) above
+                const double dzdx = 1.0 * std::cos(20.0 * x) * std::cos(20.0 * y);
+                const double dzdy = -1.0 * std::sin(20.0 * x) * std::sin(20.0 * y);
+                const double len = std::sqrt(dzdx * dzdx + dzdy * dzdy + 1.0);
+                fprintf(out, "vn %.5f %.5f %.5f\n", -dzdx / len, -dzdy / len, 1.0 / len);
+            }
+        }
+    }
+
+    fprintf(out, "\nusemtl default\ns off\n");
+
+    // All vertex data is written before the faces, so every other face uses negative
+    // (relative) indices, counting back from the last vertex.
+    const long long last = static_cast<long long>(numVerts) + 1;
+    size_t written = 0;
+    for (size_t j = 0; j < rows && written < numTriangles; ++j) {
+        for (size_t i = 0; i < cols && written < numTriangles; ++i) {
+            const long long v00 = static_cast<long long>(j * (cols + 1) + i) + 1;
+            const long long v10 = v00 + 1;
+            const long long v01 = v00 + static_cast<long long>(cols) + 1;
+            const long long v11 = v01 + 1;
+            const long long tris[2][3] = {{v00, v10, v11}, {v00, v11, v01}};
+            for (int t = 0; t < 2 && written < numTriangles; ++t, ++written) {
+                fputs((written % 3 == 0) ? "f" : "f ", out);
+                for (long long index : tris[t]) {
+                    const long long ref = (written % 2) ? index - last : index;
+                    if (variant.texcoords && variant.normals) {
+                        fprintf(out, " %lld/%lld/%lld", ref, ref, ref);
+                    } else if (variant.texcoords) {
+                        fprintf(out, " %lld/%lld", ref, ref);
+                    } else if (variant.normals) {
+                        fprintf(out, "\t%lld//%lld", ref, ref);
+                    } else {
+                        fprintf(out, " %lld", ref);
+                    }
+                }
+                fputs((written % 7 == 0) ? "  \n" : "\n", out);
+            }
+        }
+    }
+
+    const bool ok = !ferror(out);
+    fclose(out);
+    return ok;
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        const size_t comma = std::min(list.find(',', pos), list.size());
+        sizes.push_back(std::strtoull(list.substr(pos, comma - pos).c_str(), nullptr, 10));
+        pos = comma + 1;
+    }
+    return sizes;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000, 50000000};
+    size_t maxTriangles = 1000000;
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+    bool upload = true;
+    bool keep = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+            maxTriangles = 0;
+        } else if (arg == "--max-triangles" && i + 1 < argc) {
+            maxTriangles = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--no-upload") {
+            upload = false;
+        } else if (arg == "--keep") {
+            keep = true;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--sizes 1000,10000,...] [--max-triangles N] [--dir DIR]"
+                         " [--no-upload] [--keep]\n";
+            return 1;
+        }
+    }
+    if (maxTriangles > 0) {
+        sizes.erase(std::remove_if(sizes.begin(), sizes.end(),
+                                   [&](size_t s) { return s > maxTriangles; }),
+                    sizes.end());
+    }
+    std::sort(sizes.begin(), sizes.end());
+
+    const bool haveContext = upload && util::createHiddenContext(64, 64);
+    if (upload && !haveContext) {
+        std::cerr << "No OpenGL context, the upload phase is skipped.\n";
+    }
+
+    std::printf("%-6s %10s %9s | %9s %9s %9s %9s | %8s %8s %6s | %9s\n", "faces", "triangles",
+                "file MB", "parse s", "build s", "upload s", "total s", "MB/s", "ns/tri",
+                "scale", "peak RSS");
+
+    for (const Variant& variant : variants) {
+        double previousNsPerTri = 0.0;
+        for (size_t size : sizes) {
+            const std::filesystem::path file =
+                dir / ("tnm046-loadbench-" + std::to_string(size) + "-" +
+                       std::to_string(&variant - variants) + ".obj");
+            if (!writeOBJ(file.string(), size, variant)) {
+                return 1;
+            }
+            const double fileMB =
+                static_cast<double>(std::filesystem::file_size(file)) / (1024.0 * 1024.0);
+
+            double parseTime = 0.0;
+            double buildTime = 0.0;
+            double uploadTime = 0.0;
+            {
+                TriangleSoup soup;
+                TriangleSoup::OBJData data;
+
+                auto start = std::chrono::steady_clock::now();
+                if (!TriangleSoup::parseOBJ(file.string(), data)) {
+                    std::cerr << "Failed to parse '" << file.string() << "'\n";
+                    return 1;
+                }
+                parseTime = secondsSince(start);
+
+                start = std::chrono::steady_clock::now();
+                soup.buildOBJ(data);
+                buildTime = secondsSince(start);
+                data = TriangleSoup::OBJData();  // readOBJ() releases this before uploading
+
+                if (haveContext) {
+                    start = std::chrono::steady_clock::now();
+                    soup.upload();
+                    glFinish();
+                    uploadTime = secondsSince(start);
+                }
+            }
+
+            const double total = parseTime + buildTime + uploadTime;
+            const double nsPerTri = 1e9 * total / static_cast<double>(size);
+            std::printf(
+                "%-6s %10zu %9.1f | %9.4f %9.4f %9.4f %9.4f | %8.1f %8.1f %6.2f | %6.0f MB\n",
+                variant.name, size, fileMB, parseTime, buildTime, uploadTime, total,
+                fileMB / parseTime, nsPerTri,
+                previousNsPerTri > 0.0 ? nsPerTri / previousNsPerTri : 1.0,
+                static_cast<double>(peakRSS()) / (1024.0 * 1024.0));
+            std::fflush(stdout);
+            previousNsPerTri = nsPerTri;
+
+            if (!keep) {
+                std::filesystem::remove(file);
+            }
+        }
+    }
+
+    if (haveContext) {
+        util::destroyHiddenContext();
+    }
+    return 0;
+}
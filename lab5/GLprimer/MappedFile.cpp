@@ -0,0 +1,106 @@
+/*
+ * A read-only memory mapping of a whole file.
+ *
+ * This code is in the public domain.
+ */
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TNM046_HAVE_MMAP
+#endif
+
+MappedFile::MappedFile(const std::string& filename) { open(filename); }
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping_) {
+                data_ = static_cast<const unsigned char*>(
+                    MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+                if (data_) {
+                    size_ = static_cast<size_t>(fileSize.QuadPart);
+                    mapped_ = true;
+                } else {
+                    CloseHandle(mapping_);
+                    mapping_ = nullptr;
+                }
+            }
+        }
+        CloseHandle(file);  // The mapping keeps the file open
+    }
+#elif defined(TNM046_HAVE_MMAP)
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* address =
+                mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                // Loaders read the file front to back, so let the kernel read ahead
+                madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+                data_ = static_cast<const unsigned char*>(address);
+                size_ = static_cast<size_t>(info.st_size);
+                mapped_ = true;
+            }
+        }
+        ::close(fd);  // The mapping keeps the file open
+    }
+#endif
+
+    if (!mapped_) {
+        // Not mappable (or an empty file), read it the usual way
+        std::ifstream in(filename, std::ios_base::in | std::ios_base::binary);
+        if (!in.is_open()) {
+            return false;
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+    }
+    open_ = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped_) {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+#elif defined(TNM046_HAVE_MMAP)
+        munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+    }
+    buffer_ = std::vector<unsigned char>();
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+    mapped_ = false;
+}
+
+bool MappedFile::isOpen() const { return open_; }
+
+const unsigned char* MappedFile::data() const { return data_; }
+
+size_t MappedFile::size() const { return size_; }
@@ -0,0 +1,44 @@
+/*
+ * A read-only memory mapping of a whole file.
+ *
+ * Usage: construct with a file name, or call open(), and read the contents
+ *        through data() and size() for as long as the object lives. Files are
+ *        mapped with mmap() (POSIX) or MapViewOfFile() (Windows), so nothing is
+ *        copied until the pages are touched. On other systems, or if mapping
+ *        fails, the file is read into memory instead.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map the file, replacing any previous mapping. Returns false if the file can not be read.
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    size_t size() const;
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+    bool mapped_ = false;
+    std::vector<unsigned char> buffer_;  // The file contents if it could not be mapped
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
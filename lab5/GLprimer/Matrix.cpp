@@ -0,0 +1,139 @@
+/*
+ * 4x4 matrix functions for the TNM046 framework.
+ *
+ * Matrices are stored as std::array<float, 16> in column-major order,
+ * the same layout as OpenGL expects for glUniformMatrix4fv().
+ *
+ * This code is in the public domain.
+ */
+#if defined(WIN32) && !defined(_USE_MATH_DEFINES)
+#define _USE_MATH_DEFINES
+#endif
+
+#include "Matrix.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+// Multiply 4x4 matrices m1 and m2 and return the result
+std::array<float, 16> mat4mult(const std::array<float, 16>& m1, const std::array<float, 16>& m2) {
+    std::array<float, 16> result;
+    // Your code goes here: compute and set each element of result, e.g.:6// result[0] = m1[0] * m2[0] +
+    // m1[4] * m2[1] + m1[8] * m2[2] + m1[12] * m2[3];7// etc. for the remaining 15 elements.8return
+    
+    result[0] = m1[0] * m2[0] + m1[4] * m2[1] + m1[8] * m2[2] + m1[12] * m2[3];
+    result[1] = m1[1] * m2[0] + m1[5] * m2[1] + m1[9] * m2[2] + m1[13] * m2[3];
+    result[2] = m1[2] * m2[0] + m1[6] * m2[1] + m1[10] * m2[2] + m1[14] * m2[3];
+    result[3] = m1[3] * m2[0] + m1[7] * m2[1] + m1[11] * m2[2] + m1[15] * m2[3];
+
+    result[4] = m1[0] * m2[4] + m1[4] * m2[5] + m1[8] * m2[6] + m1[12] * m2[7];
+    result[5] = m1[1] * m2[4] + m1[5] * m2[5] + m1[9] * m2[6] + m1[13] * m2[7];
+    result[6] = m1[2] * m2[4] + m1[6] * m2[5] + m1[10] * m2[6] + m1[14] * m2[7];
+    result[7] = m1[3] * m2[4] + m1[7] * m2[5] + m1[11] * m2[6] + m1[15] * m2[7];
+
+    result[8] = m1[0] * m2[8] + m1[4] * m2[9] + m1[8] * m2[10] + m1[12] * m2[11];
+    result[9] = m1[1] * m2[8] + m1[5] * m2[9] + m1[9] * m2[10] + m1[13] * m2[11];
+    result[10] = m1[2] * m2[8] + m1[6] * m2[9] + m1[10] * m2[10] + m1[14] * m2[11];
+    result[11] = m1[3] * m2[8] + m1[7] * m2[9] + m1[11] * m2[10] + m1[15] * m2[11];
+
+    result[12] = m1[0] * m2[12] + m1[4] * m2[13] + m1[8] * m2[14] + m1[12] * m2[15];
+    result[13] = m1[1] * m2[12] + m1[5] * m2[13] + m1[9] * m2[14] + m1[13] * m2[15];
+    result[14] = m1[2] * m2[12] + m1[6] * m2[13] + m1[10] * m2[14] + m1[14] * m2[15];
+    result[15] = m1[3] * m2[12] + m1[7] * m2[13] + m1[11] * m2[14] + m1[15] * m2[15];
+
+    return result;
+}
+
+// Print the elements of a matrix m
+void mat4print(const std::array<float, 16>& m) {
+    printf("Matrix: \n");
+    printf("%6.2f %6.2f %6.2f %6.2f \n", m[0], m[4], m[8], m[12]);
+    printf("%6.2f %6.2f %6.2f %6.2f \n", m[1], m[5], m[9], m[13]);
+    printf("%6.2f %6.2f %6.2f %6.2f \n", m[2], m[6], m[10], m[14]);
+    printf("%6.2f %6.2f %6.2f %6.2f \n", m[3], m[7], m[11], m[15]);
+    printf("\n");
+}
+
+std::array<float, 16> mat4identity() {
+    std::array<float, 16> temp = {
+        1.0f, 0.0f, 0.0f, 0.0f, 
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f, 
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    return temp;
+}
+
+std::array<float, 16> mat4rotx(float angle) {
+    std::array<float, 16> temp = {
+        1.0f, 0.0f,         0.0f,        0.0f, 
+        0.0f, cos(angle), sin(angle), 0.0f,
+        0.0f, -sin(angle), cos(angle), 0.0f, 
+        0.0f, 0.0f,         0.0f,       1.0f
+    };
+    return temp;
+}
+
+std::array<float, 16> mat4roty(float angle) {
+    std::array<float, 16> temp = {
+        cos(angle), 0.0f, sin(angle), 0.0f, 
+        0.0f,       1.0f, 0.0f,         0.0f,                          
+        -sin(angle), 0.0f, cos(angle), 0.0f, 
+        0.0f,       0.0f, 0.0f,         1.0f
+    };
+    return temp;
+}
+
+std::array<float, 16> mat4rotz(float angle) {
+    std::array<float, 16> temp = {
+        cos(angle), sin(angle), 0.0f, 0.0f, 
+        -sin(angle), cos(angle), 0.0f, 0.0f,               
+        0.0f,       0.0f,       1.0f, 0.0f, 
+        0.0f,       0.0f,       0.0f, 1.0f
+    };
+    return temp;
+}
+
+std::array<float, 16> mat4scale(float scale) {
+    std::array<float, 16> temp = {
+        scale, 0.0f, 0.0f, 0, 
+        0.0f, scale, 0.0f, 0,                 
+        0.0f, 0.0f, scale, 0, 
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    return temp;
+}
+
+std::array<float, 16> mat4translate(float x, float y, float z) {
+    
+    std::array<float, 16> temp = {
+        1.0f, 0.0f, 0.0f, 0.0f, 
+        0.0f, 1.0f, 0.0f, 0.0f,                  
+        0.0f, 0.0f, 1.0f, 0.0f, 
+        x,      y,      z, 1.0f
+    };
+
+    return temp;
+}
+
+// create and return a perspective matrix
+//
+// vfov is the vertical field of view (in the y direction)
+// aspect is the aspect ratio of the viewport (width/height)
+// znear is the distance to the near clip plane (znear > 0)
+// zfar is the distance to the far clip plane (zfar > znear)
+std::array<float, 16> mat4perspective(float vfov, float aspect, float znear, float zfar) {
+    //float f = cos(vfov / 2) / sin(vfov / 2);
+
+    float f = 1 / tan(vfov / 2);
+
+    std::array<float, 16> temp = {
+        f/aspect, 0.0f, 0.0f, 0.0f, 
+        0.0f, f, 0.0f, 0.0f,
+        0.0f, 0.0f, -(zfar + znear)/(zfar - znear), -1.0f, 
+        0.0f, 0.0f, -(2 * zfar * znear)/(zfar - znear), 0.0f
+    };
+
+    return temp;
+
+}
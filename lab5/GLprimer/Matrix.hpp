@@ -0,0 +1,37 @@
+/*
+ * 4x4 matrix functions for the TNM046 framework.
+ *
+ * Matrices are stored as std::array<float, 16> in column-major order,
+ * the same layout as OpenGL expects for glUniformMatrix4fv().
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <array>
+
+// Multiply 4x4 matrices m1 and m2 and return the result
+std::array<float, 16> mat4mult(const std::array<float, 16>& m1, const std::array<float, 16>& m2);
+
+// Print the elements of a matrix m
+void mat4print(const std::array<float, 16>& m);
+
+std::array<float, 16> mat4identity();
+
+// Rotation around the x, y or z axis (angle in radians)
+std::array<float, 16> mat4rotx(float angle);
+std::array<float, 16> mat4roty(float angle);
+std::array<float, 16> mat4rotz(float angle);
+
+// Uniform scaling
+std::array<float, 16> mat4scale(float scale);
+
+std::array<float, 16> mat4translate(float x, float y, float z);
+
+// create and return a perspective matrix
+//
+// vfov is the vertical field of view (in the y direction)
+// aspect is the aspect ratio of the viewport (width/height)
+// znear is the distance to the near clip plane (znear > 0)
+// zfar is the distance to the far clip plane (zfar > znear)
+std::array<float, 16> mat4perspective(float vfov, float aspect, float znear, float zfar);
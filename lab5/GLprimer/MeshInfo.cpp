@@ -0,0 +1,303 @@
+/*
+ * tnm046-meshinfo - a command line tool to analyze meshes for the TNM046 framework.
+ *
+ * Usage: tnm046-meshinfo mesh.obj [mesh2.obj ...]
+ *
+ * Loads each mesh with TriangleSoup (CPU side only, no OpenGL context is needed)
+ * and prints statistics that help deciding which optimization passes to run on an
+ * asset: vertex reuse, simulated post-transform vertex cache efficiency (ACMR and
+ * ATVR) for several cache sizes, estimated overdraw, and GPU memory usage for a few
+ * vertex layouts.
+ *
+ * ACMR (average cache miss ratio) is the number of transformed vertices per triangle,
+ * 0.5 is the best possible for a large regular mesh and 3.0 the worst.
+ * ATVR (average transformed vertex ratio) is the number of transformed vertices per
+ * unique vertex, where 1.0 is optimal.
+ *
+ * This code is in the public domain.
+ */
+#include <GL/glew.h>
+
+#include "TriangleSoup.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const int floatsPerVertex = 8;  // x y z nx ny nz s t, see TriangleSoup
+
+// Bitwise hash and comparison of the 8 floats of an interleaved vertex
+struct VertexKey {
+    std::array<uint32_t, floatsPerVertex> bits;
+
+    bool operator==(const VertexKey& other) const { return bits == other.bits; }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        // FNV-1a over the raw vertex bits
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t b : key.bits) {
+            hash = (hash ^ b) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+VertexKey makeKey(const std::vector<GLfloat>& vertices, size_t vertex, int numFloats) {
+    VertexKey key{};
+    std::memcpy(key.bits.data(), &vertices[vertex * floatsPerVertex], numFloats * sizeof(float));
+    return key;
+}
+
+/*
+ * Weld bitwise identical vertices (considering the first numFloats components) and
+ * return a new index array which refers to the welded vertices. The number of unique
+ * vertices is returned in uniqueCount.
+ */
+std::vector<GLuint> weldIndices(const TriangleSoup& mesh, int numFloats, size_t& uniqueCount) {
+    const std::vector<GLfloat>& vertices = mesh.vertexArray();
+    const std::vector<GLuint>& indices = mesh.indexArray();
+
+    std::unordered_map<VertexKey, GLuint, VertexKeyHash> lookup;
+    lookup.reserve(static_cast<size_t>(mesh.numVertices()));
+    std::vector<GLuint> remap(static_cast<size_t>(mesh.numVertices()));
+    for (size_t i = 0; i < remap.size(); ++i) {
+        auto result = lookup.emplace(makeKey(vertices, i, numFloats),
+                                     static_cast<GLuint>(lookup.size()));
+        remap[i] = result.first->second;
+    }
+    uniqueCount = lookup.size();
+
+    std::vector<GLuint> welded(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        welded[i] = remap[indices[i]];
+    }
+    return welded;
+}
+
+/*
+ * Simulate a FIFO post-transform vertex cache of the given size and return the number
+ * of cache misses, i.e. the number of times the vertex shader has to run.
+ */
+size_t simulateFifoCache(const std::vector<GLuint>& indices, size_t cacheSize) {
+    // Timestamp of the last insertion of each vertex into the cache
+    GLuint maxIndex = 0;
+    for (GLuint i : indices) {
+        maxIndex = std::max(maxIndex, i);
+    }
+    std::vector<size_t> insertedAt(indices.empty() ? 0 : maxIndex + 1, 0);
+
+    size_t misses = 0;
+    for (GLuint i : indices) {
+        // A vertex is in the cache if fewer than cacheSize insertions happened after it
+        if (insertedAt[i] == 0 || misses - insertedAt[i] >= cacheSize) {
+            ++misses;
+            insertedAt[i] = misses;
+        }
+    }
+    return misses;
+}
+
+struct OverdrawResult {
+    double covered = 0.0;    // Pixels covered by the mesh
+    double fragments = 0.0;  // Front facing fragments, no depth test
+    double shaded = 0.0;     // Fragments passing an early depth test in submission order
+};
+
+/*
+ * Rasterize the mesh with an orthographic projection along 'viewDir' into a
+ * resolution x resolution grid, using back face culling like the render loop does.
+ */
+OverdrawResult rasterizeView(const TriangleSoup& mesh, const std::array<float, 3>& viewDir,
+                             int resolution) {
+    const std::vector<GLfloat>& vertices = mesh.vertexArray();
+    const std::vector<GLuint>& indices = mesh.indexArray();
+
+    // Orthonormal basis (u, v, w) with w pointing from the mesh towards the viewer
+    std::array<float, 3> w = {-viewDir[0], -viewDir[1], -viewDir[2]};
+    std::array<float, 3> up = std::fabs(w[1]) > 0.9f ? std::array<float, 3>{1.0f, 0.0f, 0.0f}
+                                                      : std::array<float, 3>{0.0f, 1.0f, 0.0f};
+    std::array<float, 3> u = {up[1] * w[2] - up[2] * w[1], up[2] * w[0] - up[0] * w[2],
+                              up[0] * w[1] - up[1] * w[0]};
+    const float ulen = std::sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+    u = {u[0] / ulen, u[1] / ulen, u[2] / ulen};
+    const std::array<float, 3> v = {w[1] * u[2] - w[2] * u[1], w[2] * u[0] - w[0] * u[2],
+                                    w[0] * u[1] - w[1] * u[0]};
+
+    // Project all vertices and find the extent in the view plane
+    const size_t nverts = static_cast<size_t>(mesh.numVertices());
+    std::vector<std::array<float, 3>> projected(nverts);
+    float umin = INFINITY, umax = -INFINITY, vmin = INFINITY, vmax = -INFINITY;
+    for (size_t i = 0; i < nverts; ++i) {
+        const float* p = &vertices[i * floatsPerVertex];
+        const float pu = p[0] * u[0] + p[1] * u[1] + p[2] * u[2];
+        const float pv = p[0] * v[0] + p[1] * v[1] + p[2] * v[2];
+        const float pw = p[0] * w[0] + p[1] * w[1] + p[2] * w[2];
+        projected[i] = {pu, pv, pw};
+        umin = std::min(umin, pu);
+        umax = std::max(umax, pu);
+        vmin = std::min(vmin, pv);
+        vmax = std::max(vmax, pv);
+    }
+    const float extent = std::max(umax - umin, vmax - vmin);
+    const float scale = extent > 0.0f ? static_cast<float>(resolution - 1) / extent : 0.0f;
+    for (auto& p : projected) {
+        p[0] = (p[0] - umin) * scale;
+        p[1] = (p[1] - vmin) * scale;
+    }
+
+    std::vector<float> depth(static_cast<size_t>(resolution) * resolution, -INFINITY);
+    std::vector<uint32_t> count(depth.size(), 0);
+    OverdrawResult result;
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const auto& a = projected[indices[t]];
+        const auto& b = projected[indices[t + 1]];
+        const auto& c = projected[indices[t + 2]];
+
+        const float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+        if (area <= 0.0f) {
+            continue;  // back facing (clockwise) or degenerate, culled
+        }
+
+        const int x0 = std::max(0, static_cast<int>(std::floor(std::min({a[0], b[0], c[0]}))));
+        const int x1 = std::min(resolution - 1,
+                                static_cast<int>(std::ceil(std::max({a[0], b[0], c[0]}))));
+        const int y0 = std::max(0, static_cast<int>(std::floor(std::min({a[1], b[1], c[1]}))));
+        const int y1 = std::min(resolution - 1,
+                                static_cast<int>(std::ceil(std::max({a[1], b[1], c[1]}))));
+
+        for (int y = y0; y <= y1; ++y) {
+            const float py = static_cast<float>(y) + 0.5f;
+            for (int x = x0; x <= x1; ++x) {
+                const float px = static_cast<float>(x) + 0.5f;
+                // Edge functions, all non-negative inside a counter-clockwise triangle
+                const float e0 = (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+                const float e1 = (c[0] - b[0]) * (py - b[1]) - (c[1] - b[1]) * (px - b[0]);
+                const float e2 = (a[0] - c[0]) * (py - c[1]) - (a[1] - c[1]) * (px - c[0]);
+                if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) {
+                    continue;
+                }
+                const float z = (e1 * a[2] + e2 * b[2] + e0 * c[2]) / area;
+                const size_t pixel = static_cast<size_t>(y) * resolution + x;
+                result.fragments += 1.0;
+                if (count[pixel]++ == 0) {
+                    result.covered += 1.0;
+                }
+                if (z > depth[pixel]) {  // larger w is closer to the viewer
+                    depth[pixel] = z;
+                    result.shaded += 1.0;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+double ratio(size_t numerator, size_t denominator) {
+    return static_cast<double>(numerator) / static_cast<double>(denominator);
+}
+
+void printMeshInfo(const std::string& filename) {
+    TriangleSoup mesh;
+    if (!mesh.loadOBJ(filename)) {
+        std::printf("%s: could not be loaded\n\n", filename.c_str());
+        return;
+    }
+
+    const size_t nverts = static_cast<size_t>(mesh.numVertices());
+    const size_t ntris = static_cast<size_t>(mesh.numTriangles());
+    const size_t nindices = mesh.indexArray().size();
+    if (ntris == 0) {
+        std::printf("%s: no triangles\n\n", filename.c_str());
+        return;
+    }
+
+    size_t uniqueVerts = 0;
+    size_t uniquePositions = 0;
+    const std::vector<GLuint> welded = weldIndices(mesh, floatsPerVertex, uniqueVerts);
+    weldIndices(mesh, 3, uniquePositions);
+
+    std::printf("%s\n", filename.c_str());
+    std::printf("  triangles         : %zu\n", ntris);
+    std::printf("  vertices          : %zu\n", nverts);
+    std::printf("  unique vertices   : %zu (%.1f%% of all vertices)\n", uniqueVerts,
+                100.0 * ratio(uniqueVerts, nverts));
+    std::printf("  unique positions  : %zu\n", uniquePositions);
+    std::printf("  index reuse       : %.2f as loaded, %.2f after welding (indices/vertex)\n",
+                ratio(nindices, nverts), ratio(nindices, uniqueVerts));
+
+    std::printf("  post-transform cache (FIFO)   as loaded          after welding\n");
+    std::printf("    size                        ACMR    ATVR       ACMR    ATVR\n");
+    for (size_t cacheSize : {8, 16, 24, 32, 64}) {
+        const size_t missesLoaded = simulateFifoCache(mesh.indexArray(), cacheSize);
+        const size_t missesWelded = simulateFifoCache(welded, cacheSize);
+        std::printf("    %4zu                      %6.3f  %6.3f     %6.3f  %6.3f\n", cacheSize,
+                    ratio(missesLoaded, ntris), ratio(missesLoaded, nverts),
+                    ratio(missesWelded, ntris), ratio(missesWelded, uniqueVerts));
+    }
+
+    // Orthographic views along the six coordinate axes
+    const std::array<std::array<float, 3>, 6> views = {{{1.0f, 0.0f, 0.0f},
+                                                        {-1.0f, 0.0f, 0.0f},
+                                                        {0.0f, 1.0f, 0.0f},
+                                                        {0.0f, -1.0f, 0.0f},
+                                                        {0.0f, 0.0f, 1.0f},
+                                                        {0.0f, 0.0f, -1.0f}}};
+    OverdrawResult total;
+    for (const auto& view : views) {
+        const OverdrawResult r = rasterizeView(mesh, view, 256);
+        total.covered += r.covered;
+        total.fragments += r.fragments;
+        total.shaded += r.shaded;
+    }
+    if (total.covered > 0.0) {
+        std::printf("  overdraw (6 axis views, 256x256, back face culled)\n");
+        std::printf("    rasterized fragments/pixel  : %.3f\n", total.fragments / total.covered);
+        std::printf("    shaded with early depth test: %.3f\n", total.shaded / total.covered);
+    }
+
+    // GPU memory for a few vertex layouts. Indices are 32 bit as in TriangleSoup, or
+    // 16 bit when all indices fit.
+    const size_t indexSize = uniqueVerts <= 65536 ? 2 : 4;
+    struct Layout {
+        const char* name;
+        size_t bytesPerVertex;
+    };
+    const std::array<Layout, 3> layouts = {{
+        {"float xyz, float normal, float st (current)", 32},
+        {"float xyz, int_2_10_10_10 normal, half st", 20},
+        {"half xyz (+pad), int_2_10_10_10 normal, half st", 16},
+    }};
+    std::printf("  GPU memory                                           as loaded      welded\n");
+    for (const Layout& layout : layouts) {
+        const size_t loaded = nverts * layout.bytesPerVertex + nindices * sizeof(GLuint);
+        const size_t compact = uniqueVerts * layout.bytesPerVertex + nindices * indexSize;
+        std::printf("    %-48s %8.2f MB  %8.2f MB\n", layout.name,
+                    ratio(loaded, 1024 * 1024), ratio(compact, 1024 * 1024));
+    }
+    std::printf("    (welded uses %zu bit indices)\n\n", indexSize * 8);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s mesh.obj [mesh2.obj ...]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        printMeshInfo(argv[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * CPU generation of mipmap chains, with an optional cache on disk.
+ *
+ * This code is in the public domain.
+ */
+#include "MipChain.hpp"
+#include "Utilities.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+namespace {
+
+// Linear values are fixed point numbers with this many steps. The sum of four of
+// them indexes the table converting back to sRGB directly, so the filter needs
+// no floating point math. This is fine enough that neighbouring sRGB values
+// never map to the same linear value, even near black.
+const unsigned int linearScale = 16383;
+
+struct GammaTables {
+    std::array<uint16_t, 256> toLinear;
+    std::vector<unsigned char> sumToSRGB;  // Indexed by the sum of four linear values
+
+    GammaTables() : sumToSRGB(4 * linearScale + 1) {
+        for (unsigned int i = 0; i < 256; ++i) {
+            const double c = i / 255.0;
+            const double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            toLinear[i] = static_cast<uint16_t>(std::lround(l * linearScale));
+        }
+        for (unsigned int i = 0; i < sumToSRGB.size(); ++i) {
+            const double l = i / (4.0 * linearScale);
+            const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            sumToSRGB[i] = static_cast<unsigned char>(std::lround(c * 255.0));
+        }
+    }
+};
+
+const GammaTables& gammaTables() {
+    static const GammaTables tables;
+    return tables;
+}
+
+// The level being filtered, which for the first level is the caller's base level
+struct Source {
+    const unsigned char* data;
+    unsigned int width;
+    unsigned int height;
+};
+
+/*
+ * Filter the rows [yBegin, yEnd) of 'dst' from 'src', which is twice as large
+ * (rounded down). Odd rows and columns at the far edge of 'src' are repeated.
+ */
+template <unsigned int Channels>
+void filterRows(const Source& src, MipLevel& dst, unsigned int yBegin, unsigned int yEnd) {
+    const GammaTables& tables = gammaTables();
+    const uint16_t* toLinear = tables.toLinear.data();
+    const unsigned char* sumToSRGB = tables.sumToSRGB.data();
+
+    const size_t srcStride = size_t(src.width) * Channels;
+    for (unsigned int y = yBegin; y < yEnd; ++y) {
+        const unsigned char* row0 = src.data + size_t(2 * y) * srcStride;
+        const unsigned char* row1 =
+            src.data + size_t(std::min(2 * y + 1, src.height - 1)) * srcStride;
+        unsigned char* out = dst.data.data() + size_t(y) * dst.width * Channels;
+        for (unsigned int x = 0; x < dst.width; ++x, out += Channels) {
+            const size_t x0 = size_t(2 * x) * Channels;
+            const size_t x1 = size_t(std::min(2 * x + 1, src.width - 1)) * Channels;
+            for (unsigned int c = 0; c < 3; ++c) {
+                out[c] = sumToSRGB[toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] +
+                                   toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]]];
+            }
+            if (Channels == 4) {
+                out[3] = static_cast<unsigned char>(
+                    (row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+            }
+        }
+    }
+}
+
+/*
+ * Filter 'dst' from 'src', splitting the rows into bands for up to 'threads' threads
+ */
+void filterLevel(const Source& src, MipLevel& dst, unsigned int channels, unsigned int threads) {
+    // Starting a thread costs about as much as filtering tens of thousands of pixels
+    const size_t minPixelsPerThread = 32 * 1024;
+    util::parallelFor(dst.height, minPixelsPerThread / dst.width + 1, threads,
+                      [&](size_t yBegin, size_t yEnd) {
+                          const unsigned int y0 = static_cast<unsigned int>(yBegin);
+                          const unsigned int y1 = static_cast<unsigned int>(yEnd);
+                          if (channels == 4) {
+                              filterRows<4>(src, dst, y0, y1);
+                          } else {
+                              filterRows<3>(src, dst, y0, y1);
+                          }
+                      });
+}
+
+// Identifies the source file of a cached chain, so changed files are detected
+struct CacheKey {
+    uint64_t fileSize = 0;
+    int64_t modified = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+    uint32_t encoding = 0;  // Also avoids padding, the key is compared with memcmp()
+};
+
+const char cacheMagic[8] = {'T', 'N', 'M', 'M', 'I', 'P', 'S', '2'};
+
+std::string& cacheDirectory() {
+    static std::string directory;
+    return directory;
+}
+
+/*
+ * The cache file for 'filename', named after the file and a hash of its full path.
+ * Returns an empty string if the cache is disabled or the file does not exist, or for
+ * an empty file name, which images made in memory have.
+ */
+std::string cacheFile(const std::string& filename, unsigned int width, unsigned int height,
+                      unsigned int channels, uint32_t encoding, CacheKey& key) {
+    if (cacheDirectory().empty() || filename.empty()) {
+        return {};
+    }
+    namespace fs = std::filesystem;
+    std::error_code error;
+    const fs::path path = fs::absolute(filename, error);
+    const uintmax_t size = fs::file_size(path, error);
+    if (error) {
+        return {};
+    }
+    const fs::file_time_type modified = fs::last_write_time(path, error);
+    if (error) {
+        return {};
+    }
+    key.fileSize = size;
+    key.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+    key.width = width;
+    key.height = height;
+    key.channels = channels;
+    key.encoding = encoding;
+
+    uint64_t hash = 14695981039346656037ull;  // FNV-1a
+    for (char c : path.string()) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "-%016llx-%x.mips", static_cast<unsigned long long>(hash),
+                  static_cast<unsigned int>(encoding));
+    return (fs::path(cacheDirectory()) / (path.stem().string() + suffix)).string();
+}
+
+}  // namespace
+
+std::vector<MipLevel> buildMipChain(const unsigned char* pixels, unsigned int width,
+                                    unsigned int height, unsigned int channels,
+                                    unsigned int threads) {
+    std::vector<MipLevel> levels;
+    if (!pixels || width == 0 || height == 0 || (channels != 3 && channels != 4)) {
+        return levels;
+    }
+    // The base level is read where it is, without copying it
+    const unsigned char* data = pixels;
+    while (width > 1 || height > 1) {
+        levels.push_back(filterMipLevel(data, width, height, channels, threads));
+        data = levels.back().data.data();
+        width = levels.back().width;
+        height = levels.back().height;
+    }
+    return levels;
+}
+
+MipLevel filterMipLevel(const unsigned char* pixels, unsigned int width, unsigned int height,
+                        unsigned int channels, unsigned int threads) {
+    MipLevel level;
+    if (!pixels || width == 0 || height == 0 || (channels != 3 && channels != 4)) {
+        return level;
+    }
+    const Source src = {pixels, width, height};
+    level.width = std::max(1u, width / 2);
+    level.height = std::max(1u, height / 2);
+    level.data.resize(size_t(level.width) * level.height * channels);
+    filterLevel(src, level, channels, threads);
+    return level;
+}
+
+void setMipCacheDirectory(const std::string& directory) {
+    cacheDirectory() = directory;
+    if (!directory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+    }
+}
+
+const std::string& mipCacheDirectory() { return cacheDirectory(); }
+
+bool readMipCache(const std::string& filename, unsigned int width, unsigned int height,
+                  unsigned int channels, std::vector<MipLevel>& levels, uint32_t encoding) {
+    CacheKey key;
+    const std::string cachename = cacheFile(filename, width, height, channels, encoding, key);
+    if (cachename.empty()) {
+        return false;
+    }
+    FILE* in = std::fopen(cachename.c_str(), "rb");
+    if (!in) {
+        return false;
+    }
+
+    // The cache is local to this machine and stored in its byte order
+    char magic[sizeof(cacheMagic)];
+    CacheKey stored;
+    uint32_t numLevels = 0;
+    bool ok = std::fread(magic, sizeof(magic), 1, in) == 1 &&
+              std::memcmp(magic, cacheMagic, sizeof(magic)) == 0 &&
+              std::fread(&stored, sizeof(stored), 1, in) == 1 &&
+              std::memcmp(&stored, &key, sizeof(key)) == 0 &&
+              std::fread(&numLevels, sizeof(numLevels), 1, in) == 1 && numLevels <= 32;
+
+    std::vector<MipLevel> cached(ok ? numLevels : 0);
+    for (MipLevel& level : cached) {
+        // Width, height and size in bytes. No level is larger than 4 bytes per pixel,
+        // or 16 bytes per 4 x 4 block for block compressed levels.
+        uint32_t size[3];
+        ok = std::fread(size, sizeof(size), 1, in) == 1 && size[0] <= width &&
+             size[1] <= height && size[2] <= (size_t(size[0]) + 3) * (size_t(size[1]) + 3) * 4;
+        if (!ok) {
+            break;
+        }
+        level.width = size[0];
+        level.height = size[1];
+        level.data.resize(size[2]);
+        ok = std::fread(level.data.data(), 1, level.data.size(), in) == level.data.size();
+        if (!ok) {
+            break;
+        }
+    }
+    std::fclose(in);
+
+    if (ok) {
+        levels = std::move(cached);
+    }
+    return ok;
+}
+
+bool writeMipCache(const std::string& filename, unsigned int width, unsigned int height,
+                   unsigned int channels, const std::vector<MipLevel>& levels,
+                   uint32_t encoding) {
+    CacheKey key;
+    const std::string cachename = cacheFile(filename, width, height, channels, encoding, key);
+    if (cachename.empty()) {
+        return mipCacheDirectory().empty();  // Nothing to do if the cache is disabled
+    }
+
+    const uint32_t numLevels = static_cast<uint32_t>(levels.size());
+    const bool ok = util::writeFileReplacing(cachename, [&](FILE* out) {
+        std::fwrite(cacheMagic, sizeof(cacheMagic), 1, out);
+        std::fwrite(&key, sizeof(key), 1, out);
+        std::fwrite(&numLevels, sizeof(numLevels), 1, out);
+        for (const MipLevel& level : levels) {
+            const uint32_t size[3] = {level.width, level.height,
+                                      static_cast<uint32_t>(level.data.size())};
+            std::fwrite(size, sizeof(size), 1, out);
+            std::fwrite(level.data.data(), 1, level.data.size(), out);
+        }
+    });
+    if (!ok) {
+        std::cerr << "Could not write mip cache file '" << cachename << "'\n";
+    }
+    return ok;
+}
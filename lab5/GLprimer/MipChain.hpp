@@ -0,0 +1,70 @@
+/*
+ * CPU generation of mipmap chains, with an optional cache on disk.
+ *
+ * Usage: call buildMipChain() with the pixels of the base level to get all
+ *        smaller levels, down to 1 x 1, and upload each of them with
+ *        glTexImage2D(). With a cache directory set (see setMipCacheDirectory()),
+ *        readMipCache() and writeMipCache() store the levels of a texture file,
+ *        so later loads of the same, unchanged file skip the filtering.
+ *
+ * The color channels are treated as sRGB and averaged in linear light, so the
+ * smaller levels do not get darker than the original the way a plain average of
+ * the stored values does. Alpha is averaged as it is. Every level is filtered
+ * from the one above it with a 2 x 2 box filter, and the rows of each level are
+ * split into bands which are filtered in parallel threads.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MipLevel {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<unsigned char> data;  // Tightly packed pixels, same layout as the base level,
+                                      // or compressed blocks (see BlockCompress.hpp)
+};
+
+/*
+ * Build the levels below a base level of 'width' x 'height' pixels with 'channels'
+ * bytes each (3 or 4, the fourth is alpha), down to 1 x 1. The base level itself
+ * is not included. 'threads' is the number of threads to use, 0 for all cores.
+ */
+std::vector<MipLevel> buildMipChain(const unsigned char* pixels, unsigned int width,
+                                    unsigned int height, unsigned int channels,
+                                    unsigned int threads = 0);
+
+/*
+ * Filter only the level below 'pixels', the way buildMipChain() does. As every output
+ * row comes from two input rows, a band of an even number of rows of a large image
+ * can be filtered at a time.
+ */
+MipLevel filterMipLevel(const unsigned char* pixels, unsigned int width, unsigned int height,
+                        unsigned int channels, unsigned int threads = 0);
+
+/*
+ * The mip cache. Disabled (the default) if the directory is empty.
+ */
+void setMipCacheDirectory(const std::string& directory);
+const std::string& mipCacheDirectory();
+
+/*
+ * Read the cached levels for the file 'filename', if the cache is enabled and
+ * holds levels for the file as it is now (same size and modification time) and
+ * for a base level of the given size. Returns false otherwise.
+ * 'encoding' tells different kinds of levels for the same file apart: 0 for the
+ * levels from buildMipChain(), or a tag for levels encoded some other way.
+ */
+bool readMipCache(const std::string& filename, unsigned int width, unsigned int height,
+                  unsigned int channels, std::vector<MipLevel>& levels, uint32_t encoding = 0);
+
+/*
+ * Store the levels for the file 'filename' in the cache, if it is enabled.
+ * Returns false if the cache file could not be written.
+ */
+bool writeMipCache(const std::string& filename, unsigned int width, unsigned int height,
+                   unsigned int channels, const std::vector<MipLevel>& levels,
+                   uint32_t encoding = 0);
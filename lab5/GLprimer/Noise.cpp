@@ -0,0 +1,378 @@
+/*
+ * Procedural textures of simplex or Perlin noise.
+ *
+ * This code is in the public domain.
+ */
+#if defined(WIN32) && !defined(_USE_MATH_DEFINES)
+#define _USE_MATH_DEFINES
+#endif
+
+#include "Noise.hpp"
+#include "Utilities.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+// Rows with fewer pixels than this are not split between threads
+constexpr size_t kMinPixelsPerThread = 16384;
+
+// The functions below are called from the loops over the pixels of a row. They have
+// no branches and no table lookups, so that those loops can be vectorized.
+
+inline int fastFloor(float x) {
+    const int i = static_cast<int>(x);
+    return i - (x < static_cast<float>(i));
+}
+
+// Hashes of lattice points, from which the gradients are picked
+inline uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+inline uint32_t hash(int i, int j, uint32_t seed) {
+    return mix(seed ^ (static_cast<uint32_t>(i) * 0x8da6b343u) ^
+               (static_cast<uint32_t>(j) * 0xd8163841u));
+}
+
+inline uint32_t hash(int i, int j, int k, uint32_t seed) {
+    return mix(seed ^ (static_cast<uint32_t>(i) * 0x8da6b343u) ^
+               (static_cast<uint32_t>(j) * 0xd8163841u) ^
+               (static_cast<uint32_t>(k) * 0xcb1ab31fu));
+}
+
+// The dot product of (x, y) with one of 8 gradients
+inline float gradient(uint32_t hash, float x, float y) {
+    const uint32_t h = hash & 7;
+    const float u = h < 4 ? x : y;
+    const float v = h < 4 ? y : x;
+    return ((h & 1) ? -1.0f : 1.0f) * u + ((h & 2) ? -2.0f : 2.0f) * v;
+}
+
+// The dot product of (x, y, z) with one of 12 gradients towards the edges of a cube
+// (4 of them twice)
+inline float gradient(uint32_t hash, float x, float y, float z) {
+    const uint32_t h = hash & 15;
+    const float u = h < 8 ? x : y;
+    const float v = h < 4 ? y : ((h & 13) == 12 ? x : z);
+    return ((h & 1) ? -1.0f : 1.0f) * u + ((h & 2) ? -1.0f : 1.0f) * v;
+}
+
+inline float fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+
+inline float lerp(float t, float a, float b) { return a + t * (b - a); }
+
+// The next lattice coordinate after 'i', wrapped around at 'period' unless it is 0
+inline int nextLattice(int i, int period) { return i + 1 == period ? 0 : i + 1; }
+
+// The functions below add 'amplitude' times the noise at 'count' points to 'sums'.
+// Each noise is computed nowhere else, so that it is inlined into the loop over the
+// points, and the coordinates which are the same for all of them are taken once.
+
+void addPerlin2(const float* xs, float y, unsigned int count, int periodX, int periodY,
+                uint32_t seed, float amplitude, float* sums) {
+    const int j0 = fastFloor(y);
+    const float fy = y - static_cast<float>(j0);
+    const int j1 = nextLattice(j0, periodY);
+    const float t = fade(fy);
+    const float scale = 0.507f * amplitude;
+    for (unsigned int n = 0; n < count; ++n) {
+        const int i0 = fastFloor(xs[n]);
+        const float fx = xs[n] - static_cast<float>(i0);
+        const int i1 = nextLattice(i0, periodX);
+        const float s = fade(fx);
+        const float n0 = lerp(t, gradient(hash(i0, j0, seed), fx, fy),
+                              gradient(hash(i0, j1, seed), fx, fy - 1.0f));
+        const float n1 = lerp(t, gradient(hash(i1, j0, seed), fx - 1.0f, fy),
+                              gradient(hash(i1, j1, seed), fx - 1.0f, fy - 1.0f));
+        sums[n] += scale * lerp(s, n0, n1);
+    }
+}
+
+void addPerlin3(const float* xs, const float* ys, float z, unsigned int count, int periodX,
+                int periodY, uint32_t seed, float amplitude, float* sums) {
+    const int k0 = fastFloor(z);
+    const float fz = z - static_cast<float>(k0);
+    const int k1 = k0 + 1;
+    const float t = fade(fz);
+    const float scale = 0.936f * amplitude;
+    for (unsigned int n = 0; n < count; ++n) {
+        const int i0 = fastFloor(xs[n]);
+        const int j0 = fastFloor(ys[n]);
+        const float fx = xs[n] - static_cast<float>(i0);
+        const float fy = ys[n] - static_cast<float>(j0);
+        const int i1 = nextLattice(i0, periodX);
+        const int j1 = nextLattice(j0, periodY);
+        const float r = fade(fx);
+        const float s = fade(fy);
+        const float n00 = lerp(t, gradient(hash(i0, j0, k0, seed), fx, fy, fz),
+                               gradient(hash(i0, j0, k1, seed), fx, fy, fz - 1.0f));
+        const float n01 = lerp(t, gradient(hash(i0, j1, k0, seed), fx, fy - 1.0f, fz),
+                               gradient(hash(i0, j1, k1, seed), fx, fy - 1.0f, fz - 1.0f));
+        const float n10 = lerp(t, gradient(hash(i1, j0, k0, seed), fx - 1.0f, fy, fz),
+                               gradient(hash(i1, j0, k1, seed), fx - 1.0f, fy, fz - 1.0f));
+        const float n11 =
+            lerp(t, gradient(hash(i1, j1, k0, seed), fx - 1.0f, fy - 1.0f, fz),
+                 gradient(hash(i1, j1, k1, seed), fx - 1.0f, fy - 1.0f, fz - 1.0f));
+        sums[n] += scale * lerp(r, lerp(s, n00, n01), lerp(s, n10, n11));
+    }
+}
+
+// The falloff of a simplex corner at squared distance 'd2', times its gradient
+inline float corner(float radius2, float d2, float gradientDot) {
+    float t = radius2 - d2;
+    t = 0.5f * (t + std::fabs(t));  // max(t, 0), in a form compilers vectorize
+    t *= t;
+    return t * t * gradientDot;
+}
+
+void addSimplex2(const float* xs, float y, unsigned int count, uint32_t seed, float amplitude,
+                 float* sums) {
+    const float F2 = 0.366025403f;  // (sqrt(3) - 1) / 2
+    const float G2 = 0.211324865f;  // (3 - sqrt(3)) / 6
+    const float scale = 40.0f * amplitude;
+    for (unsigned int n = 0; n < count; ++n) {
+        const float x = xs[n];
+        // The simplex cell, in a lattice skewed to squares
+        const float skew = (x + y) * F2;
+        const int i = fastFloor(x + skew);
+        const int j = fastFloor(y + skew);
+        const float unskew = static_cast<float>(i + j) * G2;
+        const float x0 = x - (static_cast<float>(i) - unskew);
+        const float y0 = y - (static_cast<float>(j) - unskew);
+        // The middle corner of the triangle
+        const int i1 = x0 > y0 ? 1 : 0;
+        const int j1 = 1 - i1;
+        const float x1 = x0 - static_cast<float>(i1) + G2;
+        const float y1 = y0 - static_cast<float>(j1) + G2;
+        const float x2 = x0 - 1.0f + 2.0f * G2;
+        const float y2 = y0 - 1.0f + 2.0f * G2;
+        const float n0 = corner(0.5f, x0 * x0 + y0 * y0, gradient(hash(i, j, seed), x0, y0));
+        const float n1 =
+            corner(0.5f, x1 * x1 + y1 * y1, gradient(hash(i + i1, j + j1, seed), x1, y1));
+        const float n2 =
+            corner(0.5f, x2 * x2 + y2 * y2, gradient(hash(i + 1, j + 1, seed), x2, y2));
+        sums[n] += scale * (n0 + n1 + n2);
+    }
+}
+
+void addSimplex3(const float* xs, const float* ys, float z, unsigned int count, uint32_t seed,
+                 float amplitude, float* sums) {
+    const float F3 = 1.0f / 3.0f;
+    const float G3 = 1.0f / 6.0f;
+    const float scale = 32.0f * amplitude;
+    for (unsigned int n = 0; n < count; ++n) {
+        const float x = xs[n];
+        const float y = ys[n];
+        const float skew = (x + y + z) * F3;
+        const int i = fastFloor(x + skew);
+        const int j = fastFloor(y + skew);
+        const int k = fastFloor(z + skew);
+        const float unskew = static_cast<float>(i + j + k) * G3;
+        const float x0 = x - (static_cast<float>(i) - unskew);
+        const float y0 = y - (static_cast<float>(j) - unskew);
+        const float z0 = z - (static_cast<float>(k) - unskew);
+        // The second and third corners of the tetrahedron, from the order of x0, y0, z0
+        const int xy = x0 >= y0;
+        const int xz = x0 >= z0;
+        const int yz = y0 >= z0;
+        const int i1 = xy & xz;
+        const int j1 = (1 - xy) & yz;
+        const int k1 = (1 - xz) & (1 - yz);
+        const int i2 = xy | xz;
+        const int j2 = (1 - xy) | yz;
+        const int k2 = (1 - xz) | (1 - yz);
+        const float x1 = x0 - static_cast<float>(i1) + G3;
+        const float y1 = y0 - static_cast<float>(j1) + G3;
+        const float z1 = z0 - static_cast<float>(k1) + G3;
+        const float x2 = x0 - static_cast<float>(i2) + 2.0f * G3;
+        const float y2 = y0 - static_cast<float>(j2) + 2.0f * G3;
+        const float z2 = z0 - static_cast<float>(k2) + 2.0f * G3;
+        const float x3 = x0 - 1.0f + 3.0f * G3;
+        const float y3 = y0 - 1.0f + 3.0f * G3;
+        const float z3 = z0 - 1.0f + 3.0f * G3;
+        const float n0 = corner(0.6f, x0 * x0 + y0 * y0 + z0 * z0,
+                                gradient(hash(i, j, k, seed), x0, y0, z0));
+        const float n1 = corner(0.6f, x1 * x1 + y1 * y1 + z1 * z1,
+                                gradient(hash(i + i1, j + j1, k + k1, seed), x1, y1, z1));
+        const float n2 = corner(0.6f, x2 * x2 + y2 * y2 + z2 * z2,
+                                gradient(hash(i + i2, j + j2, k + k2, seed), x2, y2, z2));
+        const float n3 = corner(0.6f, x3 * x3 + y3 * y3 + z3 * z3,
+                                gradient(hash(i + 1, j + 1, k + 1, seed), x3, y3, z3));
+        sums[n] += scale * (n0 + n1 + n2 + n3);
+    }
+}
+
+struct Octave {
+    float frequency;  // Across the width, or per unit of the sphere's radius
+    float amplitude;
+    int period;  // Of the lattice across the width, 0 if not tiled
+    int periodY;
+    uint32_t seed;
+};
+
+// The colors of 256 noise values evenly spaced over [-1, 1]
+std::array<std::array<unsigned char, 3>, 256> colorTable(const std::vector<NoiseColor>& stops) {
+    std::array<std::array<unsigned char, 3>, 256> table;
+    for (int i = 0; i < 256; ++i) {
+        const float value = static_cast<float>(i) / 127.5f - 1.0f;
+        if (stops.empty()) {
+            table[i] = {static_cast<unsigned char>(i), static_cast<unsigned char>(i),
+                        static_cast<unsigned char>(i)};
+            continue;
+        }
+        size_t next = 0;
+        while (next < stops.size() && stops[next].value < value) {
+            ++next;
+        }
+        const NoiseColor& a = stops[next == 0 ? 0 : next - 1];
+        const NoiseColor& b = stops[std::min(next, stops.size() - 1)];
+        const float span = b.value - a.value;
+        const float t = span > 0.0f ? std::clamp((value - a.value) / span, 0.0f, 1.0f) : 0.0f;
+        // B, G, R, as the pixels are stored
+        table[i] = {static_cast<unsigned char>(lerp(t, a.b, b.b) + 0.5f),
+                    static_cast<unsigned char>(lerp(t, a.g, b.g) + 0.5f),
+                    static_cast<unsigned char>(lerp(t, a.r, b.r) + 0.5f)};
+    }
+    return table;
+}
+
+}  // namespace
+
+std::vector<unsigned char> generateNoise(const NoiseSettings& settings, unsigned int threads) {
+    const unsigned int width = settings.width;
+    const unsigned int height = settings.height;
+    std::vector<unsigned char> pixels(size_t(width) * height * 3);
+    if (pixels.empty()) {
+        return pixels;
+    }
+    const bool sphere = settings.mapping == NoiseMapping::Sphere;
+    const bool tiled = settings.tiled && !sphere;
+    const bool perlin = settings.type == NoiseType::Perlin || tiled;
+    const float aspect = static_cast<float>(height) / static_cast<float>(width);
+
+    std::vector<Octave> octaves;
+    float frequency = settings.frequency;
+    float amplitude = 1.0f;
+    float totalAmplitude = 0.0f;
+    for (unsigned int o = 0; o < std::max(1u, settings.octaves); ++o) {
+        Octave octave;
+        octave.amplitude = amplitude;
+        octave.frequency = frequency;
+        octave.period = 0;
+        octave.periodY = 0;
+        if (tiled) {
+            octave.period = std::max(1, static_cast<int>(std::lround(frequency)));
+            octave.periodY = std::max(1, static_cast<int>(std::lround(frequency * aspect)));
+            octave.frequency = static_cast<float>(octave.period);
+        }
+        octave.seed = settings.seed + o * 0x9e3779b9u;
+        octaves.push_back(octave);
+        totalAmplitude += amplitude;
+        frequency *= settings.lacunarity;
+        amplitude *= settings.gain;
+    }
+
+    // Per column: the texture coordinate s, or the direction of the longitude
+    std::vector<float> columnS(width), columnCos(width), columnSin(width);
+    for (unsigned int x = 0; x < width; ++x) {
+        columnS[x] = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+        const double longitude = 2.0 * M_PI * columnS[x];
+        columnCos[x] = static_cast<float>(std::cos(longitude));
+        columnSin[x] = static_cast<float>(std::sin(longitude));
+    }
+    const auto colors = colorTable(settings.colors);
+    const float toIndex = 127.5f / std::max(totalAmplitude, 1e-6f);
+
+    auto generateRows = [&](size_t begin, size_t end) {
+        std::vector<float> sums(width), xs(width), ys(width);
+        for (size_t y = begin; y < end; ++y) {
+            std::fill(sums.begin(), sums.end(), 0.0f);
+            const float t = (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+            // Latitude from the south pole at t = 0 to the north pole at t = 1
+            const double latitude = M_PI * (t - 0.5);
+            const float ringRadius = static_cast<float>(std::cos(latitude));
+            const float ringZ = static_cast<float>(std::sin(latitude));
+
+            for (const Octave& o : octaves) {
+                const float f = o.frequency;
+                if (sphere) {
+                    for (unsigned int x = 0; x < width; ++x) {
+                        xs[x] = columnCos[x] * ringRadius * f;
+                        ys[x] = columnSin[x] * ringRadius * f;
+                    }
+                    if (perlin) {
+                        addPerlin3(xs.data(), ys.data(), ringZ * f, width, 0, 0, o.seed,
+                                   o.amplitude, sums.data());
+                    } else {
+                        addSimplex3(xs.data(), ys.data(), ringZ * f, width, o.seed, o.amplitude,
+                                    sums.data());
+                    }
+                    continue;
+                }
+                for (unsigned int x = 0; x < width; ++x) {
+                    xs[x] = columnS[x] * f;
+                }
+                // Across the height, the lattice is scaled like across the width, or
+                // wraps around at a whole period if tiled
+                const float v = tiled ? t * static_cast<float>(o.periodY) : t * aspect * f;
+                if (settings.mapping == NoiseMapping::Slice) {
+                    std::fill(ys.begin(), ys.end(), v);
+                    if (perlin) {
+                        addPerlin3(xs.data(), ys.data(), settings.z * f, width, o.period,
+                                   o.periodY, o.seed, o.amplitude, sums.data());
+                    } else {
+                        addSimplex3(xs.data(), ys.data(), settings.z * f, width, o.seed,
+                                    o.amplitude, sums.data());
+                    }
+                } else if (perlin) {
+                    addPerlin2(xs.data(), v, width, o.period, o.periodY, o.seed, o.amplitude,
+                               sums.data());
+                } else {
+                    addSimplex2(xs.data(), v, width, o.seed, o.amplitude, sums.data());
+                }
+            }
+
+            unsigned char* out = pixels.data() + y * width * 3;
+            for (unsigned int x = 0; x < width; ++x, out += 3) {
+                const int index = std::clamp(static_cast<int>(sums[x] * toIndex + 128.0f), 0, 255);
+                out[0] = colors[index][0];
+                out[1] = colors[index][1];
+                out[2] = colors[index][2];
+            }
+        }
+    };
+    util::parallelFor(height, kMinPixelsPerThread / width + 1, threads, generateRows);
+    return pixels;
+}
+
+float simplexNoise(float x, float y, uint32_t seed) {
+    float sum = 0.0f;
+    addSimplex2(&x, y, 1, seed, 1.0f, &sum);
+    return sum;
+}
+
+float simplexNoise(float x, float y, float z, uint32_t seed) {
+    float sum = 0.0f;
+    addSimplex3(&x, &y, z, 1, seed, 1.0f, &sum);
+    return sum;
+}
+
+float perlinNoise(float x, float y, uint32_t seed) {
+    float sum = 0.0f;
+    addPerlin2(&x, y, 1, 0, 0, seed, 1.0f, &sum);
+    return sum;
+}
+
+float perlinNoise(float x, float y, float z, uint32_t seed) {
+    float sum = 0.0f;
+    addPerlin3(&x, &y, z, 1, 0, 0, seed, 1.0f, &sum);
+    return sum;
+}
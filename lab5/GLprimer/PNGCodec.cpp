@@ -0,0 +1,393 @@
+/*
+ * PNG decoding, with the decompression and the unfiltering of the rows in
+ * parallel threads.
+ *
+ * This code is in the public domain.
+ */
+#include "ImageCodec.hpp"
+#include "Inflate.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const unsigned char kSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+// Images with less compressed data are decompressed before the rows are unfiltered,
+// in the calling thread, as a second thread is not worth starting for them
+constexpr size_t kMinPipelined = 128 << 10;
+
+// DEFLATE can not compress more than about 1032:1, larger images are corrupt
+constexpr size_t kMaxRatio = 1100;
+
+uint32_t readBE32(const unsigned char* p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+struct PNGInfo {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int bitDepth = 0;
+    int colorType = 0;  // 0 gray, 2 RGB, 3 palette, 4 gray + alpha, 6 RGBA
+    int samples = 0;    // Per pixel
+    unsigned char palette[256][4] = {};  // R, G, B, A
+    bool hasTransparency = false;        // A tRNS chunk
+    uint16_t transparent[3] = {};        // The transparent gray or RGB value, without palette
+};
+
+int samplesPerPixel(int colorType) {
+    switch (colorType) {
+    case 0: return 1;
+    case 2: return 3;
+    case 3: return 1;
+    case 4: return 2;
+    case 6: return 4;
+    default: return 0;
+    }
+}
+
+bool validBitDepth(int colorType, int bitDepth) {
+    const bool wholeBytes = bitDepth == 8 || bitDepth == 16;
+    const bool partBytes = bitDepth == 1 || bitDepth == 2 || bitDepth == 4;
+    switch (colorType) {
+    case 0: return wholeBytes || partBytes;
+    case 3: return bitDepth == 8 || partBytes;
+    default: return wholeBytes;
+    }
+}
+
+int paeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+/*
+ * Undo the filter of a row of 'length' bytes in place. 'previous' is the row above,
+ * already unfiltered, or nullptr for the first row. 'bpp' is the number of bytes of
+ * a pixel, at least 1. Returns false for an unknown filter.
+ */
+bool unfilterRow(int filter, unsigned char* row, const unsigned char* previous, size_t length,
+                 size_t bpp) {
+    switch (filter) {
+    case 0:
+        return true;
+    case 1:  // Sub
+        for (size_t i = bpp; i < length; ++i) {
+            row[i] = static_cast<unsigned char>(row[i] + row[i - bpp]);
+        }
+        return true;
+    case 2:  // Up
+        if (previous) {
+            for (size_t i = 0; i < length; ++i) {
+                row[i] = static_cast<unsigned char>(row[i] + previous[i]);
+            }
+        }
+        return true;
+    case 3:  // Average
+        for (size_t i = 0; i < length; ++i) {
+            const int left = i >= bpp ? row[i - bpp] : 0;
+            const int up = previous ? previous[i] : 0;
+            row[i] = static_cast<unsigned char>(row[i] + ((left + up) >> 1));
+        }
+        return true;
+    case 4:  // Paeth
+        for (size_t i = 0; i < length; ++i) {
+            const int left = i >= bpp ? row[i - bpp] : 0;
+            const int up = previous ? previous[i] : 0;
+            const int upLeft = previous && i >= bpp ? previous[i - bpp] : 0;
+            row[i] = static_cast<unsigned char>(row[i] + paeth(left, up, upLeft));
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Sample 'i' of an unfiltered row, at its full bit depth
+unsigned int rawSample(const unsigned char* row, size_t i, int bitDepth) {
+    if (bitDepth == 8) {
+        return row[i];
+    }
+    if (bitDepth == 16) {
+        return unsigned(row[2 * i]) << 8 | row[2 * i + 1];
+    }
+    const size_t bit = i * static_cast<size_t>(bitDepth);
+    const int shift = 8 - bitDepth - static_cast<int>(bit & 7);
+    return (row[bit >> 3] >> shift) & ((1u << bitDepth) - 1);
+}
+
+unsigned char toByte(unsigned int sample, int bitDepth) {
+    if (bitDepth == 16) {
+        return static_cast<unsigned char>(sample >> 8);
+    }
+    return static_cast<unsigned char>(sample * 255 / ((1u << bitDepth) - 1));
+}
+
+/*
+ * Convert an unfiltered row to 'channels' bytes per pixel in B, G, R(, A) order
+ */
+void convertRow(const PNGInfo& info, const unsigned char* row, unsigned char* out,
+                unsigned int channels) {
+    const int depth = info.bitDepth;
+    if (depth == 8 && (info.colorType == 2 || info.colorType == 6) && !info.hasTransparency) {
+        const int samples = info.samples;
+        for (uint32_t x = 0; x < info.width; ++x, row += samples, out += channels) {
+            out[0] = row[2];
+            out[1] = row[1];
+            out[2] = row[0];
+            if (channels == 4) {
+                out[3] = row[3];
+            }
+        }
+        return;
+    }
+
+    for (uint32_t x = 0; x < info.width; ++x, out += channels) {
+        const size_t i = size_t(x) * static_cast<size_t>(info.samples);
+        unsigned char r, g, b, a = 255;
+        if (info.colorType == 3) {
+            const unsigned char* color = info.palette[rawSample(row, i, depth)];
+            r = color[0];
+            g = color[1];
+            b = color[2];
+            a = color[3];
+        } else if (info.colorType == 0 || info.colorType == 4) {
+            const unsigned int gray = rawSample(row, i, depth);
+            r = g = b = toByte(gray, depth);
+            if (info.colorType == 4) {
+                a = toByte(rawSample(row, i + 1, depth), depth);
+            } else if (info.hasTransparency && gray == info.transparent[0]) {
+                a = 0;
+            }
+        } else {
+            const unsigned int red = rawSample(row, i, depth);
+            const unsigned int green = rawSample(row, i + 1, depth);
+            const unsigned int blue = rawSample(row, i + 2, depth);
+            r = toByte(red, depth);
+            g = toByte(green, depth);
+            b = toByte(blue, depth);
+            if (info.colorType == 6) {
+                a = toByte(rawSample(row, i + 3, depth), depth);
+            } else if (info.hasTransparency && red == info.transparent[0] &&
+                       green == info.transparent[1] && blue == info.transparent[2]) {
+                a = 0;
+            }
+        }
+        out[0] = b;
+        out[1] = g;
+        out[2] = r;
+        if (channels == 4) {
+            out[3] = a;
+        }
+    }
+}
+
+class PNGCodec : public ImageCodec {
+public:
+    const char* name() const override { return "PNG"; }
+
+    bool matches(const unsigned char* data, size_t size) const override {
+        return size >= sizeof(kSignature) && std::memcmp(data, kSignature, sizeof(kSignature)) == 0;
+    }
+
+    bool decode(const unsigned char* data, size_t size, const std::string& filename,
+                DecodedImage& image, unsigned int threads) const override;
+};
+
+bool PNGCodec::decode(const unsigned char* data, size_t size, const std::string& filename,
+                      DecodedImage& image, unsigned int threads) const {
+    PNGInfo info;
+    bool hasHeader = false;
+    bool hasPalette = false;
+    // The compressed data, split over the IDAT chunks. It is only copied if there are
+    // several of them.
+    const unsigned char* compressed = nullptr;
+    size_t compressedSize = 0;
+    std::vector<unsigned char> joined;
+
+    size_t pos = sizeof(kSignature);
+    bool ended = false;
+    while (!ended) {
+        if (size - pos < 12) {
+            std::cerr << "PNG file is truncated ('" << filename << "')\n";
+            return false;
+        }
+        const size_t length = readBE32(data + pos);
+        const unsigned char* type = data + pos + 4;
+        const unsigned char* chunk = data + pos + 8;
+        if (length > size - pos - 12) {
+            std::cerr << "PNG file is truncated ('" << filename << "')\n";
+            return false;
+        }
+        pos += 12 + length;
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length < 13) {
+                break;
+            }
+            info.width = readBE32(chunk);
+            info.height = readBE32(chunk + 4);
+            info.bitDepth = chunk[8];
+            info.colorType = chunk[9];
+            info.samples = samplesPerPixel(info.colorType);
+            if (info.samples == 0 || !validBitDepth(info.colorType, info.bitDepth) ||
+                chunk[10] != 0 || chunk[11] != 0) {
+                std::cerr << "Unsupported PNG format ('" << filename << "')\n";
+                return false;
+            }
+            if (chunk[12] != 0) {
+                std::cerr << "Interlaced PNG files are not supported ('" << filename << "')\n";
+                return false;
+            }
+            hasHeader = true;
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            for (size_t i = 0; i < length / 3 && i < 256; ++i) {
+                info.palette[i][0] = chunk[3 * i];
+                info.palette[i][1] = chunk[3 * i + 1];
+                info.palette[i][2] = chunk[3 * i + 2];
+                info.palette[i][3] = 255;
+            }
+            hasPalette = true;
+        } else if (std::memcmp(type, "tRNS", 4) == 0) {
+            info.hasTransparency = true;
+            if (info.colorType == 3) {
+                for (size_t i = 0; i < length && i < 256; ++i) {
+                    info.palette[i][3] = chunk[i];
+                }
+            } else {
+                for (size_t i = 0; i < 3 && 2 * i + 1 < length; ++i) {
+                    info.transparent[i] =
+                        static_cast<uint16_t>(chunk[2 * i] << 8 | chunk[2 * i + 1]);
+                }
+            }
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            if (compressed == nullptr) {
+                compressed = chunk;
+                compressedSize = length;
+            } else {
+                if (joined.empty()) {
+                    joined.assign(compressed, compressed + compressedSize);
+                }
+                joined.insert(joined.end(), chunk, chunk + length);
+            }
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        }
+    }
+    if (!joined.empty()) {
+        compressed = joined.data();
+        compressedSize = joined.size();
+    }
+    if (!hasHeader || compressed == nullptr || info.width == 0 || info.height == 0 ||
+        (info.colorType == 3 && !hasPalette)) {
+        std::cerr << "Invalid PNG file ('" << filename << "')\n";
+        return false;
+    }
+    // tRNS is not allowed for the color types with alpha
+    if (info.colorType == 4 || info.colorType == 6) {
+        info.hasTransparency = false;
+    }
+
+    // Every row starts with a byte for its filter
+    const size_t bitsPerPixel = static_cast<size_t>(info.samples) * info.bitDepth;
+    const size_t rowBytes = (info.width * bitsPerPixel + 7) / 8;
+    const size_t stride = rowBytes + 1;
+    const size_t bpp = std::max<size_t>(1, bitsPerPixel / 8);
+    const size_t rawSize = stride * info.height;
+    if (rawSize / info.height != stride || rawSize / kMaxRatio > compressedSize) {
+        std::cerr << "Invalid PNG file ('" << filename << "')\n";
+        return false;
+    }
+    std::vector<unsigned char> raw(rawSize);
+
+    image = DecodedImage();
+    image.width = info.width;
+    image.height = info.height;
+    image.channels = info.colorType == 4 || info.colorType == 6 || info.hasTransparency ? 4 : 3;
+    image.pixels.resize(size_t(image.width) * image.height * image.channels);
+    const size_t outRow = size_t(image.width) * image.channels;
+
+    // Unfilter and convert the rows in [begin, end), which are decompressed. They are
+    // unfiltered into a copy, as the decompression may still copy from the output.
+    std::vector<unsigned char> rows(2 * rowBytes);
+    bool rowsOK = true;
+    auto finishRows = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end && rowsOK; ++y) {
+            const unsigned char* in = raw.data() + y * stride;
+            unsigned char* row = rows.data() + (y & 1) * rowBytes;
+            const unsigned char* previous = y > 0 ? rows.data() + (~y & 1) * rowBytes : nullptr;
+            std::memcpy(row, in + 1, rowBytes);
+            rowsOK = unfilterRow(in[0], row, previous, rowBytes, bpp);
+            convertRow(info, row, image.pixels.data() + (info.height - 1 - y) * outRow,
+                       image.channels);
+        }
+    };
+
+    size_t written = 0;
+    bool inflated;
+    if (threads == 1 || compressedSize < kMinPipelined) {
+        inflated = inflateZlib(compressed, compressedSize, raw.data(), rawSize, written);
+        finishRows(0, inflated && written == rawSize ? info.height : 0);
+    } else {
+        // The inflating thread publishes how much of the output is complete, and this
+        // thread finishes the rows it covers while the rest is decompressed
+        std::mutex mutex;
+        std::condition_variable progressed;
+        size_t available = 0;
+        bool done = false;
+        std::thread inflater([&] {
+            const bool ok = inflateZlib(compressed, compressedSize, raw.data(), rawSize, written,
+                                        [&](size_t bytes) {
+                                            std::lock_guard<std::mutex> lock(mutex);
+                                            available = bytes;
+                                            progressed.notify_one();
+                                        });
+            std::lock_guard<std::mutex> lock(mutex);
+            inflated = ok;
+            done = true;
+            progressed.notify_one();
+        });
+        uint32_t row = 0;
+        for (;;) {
+            size_t complete;
+            bool finished;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                progressed.wait(lock, [&] { return done || available >= (row + 1) * stride; });
+                complete = available;
+                finished = done;
+            }
+            const uint32_t end =
+                static_cast<uint32_t>(std::min<size_t>(complete / stride, info.height));
+            finishRows(row, end);
+            row = end;
+            if (finished || row == info.height || !rowsOK) {
+                break;
+            }
+        }
+        inflater.join();
+        if (inflated) {
+            finishRows(row, static_cast<uint32_t>(std::min<size_t>(written / stride, info.height)));
+        }
+    }
+    if (!inflated || written != rawSize || !rowsOK) {
+        std::cerr << "Could not decompress PNG image data ('" << filename << "')\n";
+        image = DecodedImage();
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+std::unique_ptr<ImageCodec> createPNGCodec() { return std::make_unique<PNGCodec>(); }
@@ -0,0 +1,118 @@
+/*
+ * Program pipeline objects combining separable programs.
+ *
+ * This code is in the public domain.
+ */
+#include <GL/glew.h>
+
+#include "ProgramPipeline.hpp"
+
+#include <iostream>
+
+namespace {
+
+// The stages and their bits for glUseProgramStages(), in the order of 'stages_'
+const GLenum stageTypes[] = {GL_VERTEX_SHADER,          GL_TESS_CONTROL_SHADER,
+                             GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER,
+                             GL_FRAGMENT_SHADER,        GL_COMPUTE_SHADER};
+const GLbitfield stageBits[] = {GL_VERTEX_SHADER_BIT,          GL_TESS_CONTROL_SHADER_BIT,
+                                GL_TESS_EVALUATION_SHADER_BIT, GL_GEOMETRY_SHADER_BIT,
+                                GL_FRAGMENT_SHADER_BIT,        GL_COMPUTE_SHADER_BIT};
+
+// The index of a stage in 'stages_', or -1 for other enums
+int stageIndex(GLenum stage) {
+    for (int i = 0; i < 6; ++i) {
+        if (stageTypes[i] == stage) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// The pipeline bound, as far as ProgramPipeline::use() knows
+GLuint& currentPipeline() {
+    static GLuint pipeline = 0;
+    return pipeline;
+}
+
+}  // namespace
+
+ProgramPipeline::ProgramPipeline() : pipelineID_(0), stages_{} {}
+
+ProgramPipeline::~ProgramPipeline() {
+    if (pipelineID_ == 0) {
+        return;
+    }
+    if (currentPipeline() == pipelineID_) {
+        useNone();
+    }
+    glDeleteProgramPipelines(1, &pipelineID_);
+}
+
+bool ProgramPipeline::generate() {
+    if (pipelineID_ == 0 && GLEW_ARB_separate_shader_objects) {
+        glGenProgramPipelines(1, &pipelineID_);
+    }
+    return pipelineID_ != 0;
+}
+
+void ProgramPipeline::setStage(const Shader& program) {
+    const int index = stageIndex(program.stage());
+    if (index < 0) {
+        std::cerr << "Program " << program.id() << " is not a separable program of one stage\n";
+        return;
+    }
+    const size_t i = static_cast<size_t>(index);
+    if (stages_[i] == program.id() && pipelineID_ != 0) {
+        ++stats_.stageChangesSkipped;
+        return;
+    }
+    if (!generate()) {
+        return;
+    }
+    glUseProgramStages(pipelineID_, stageBits[i], program.id());
+    stages_[i] = program.id();
+    ++stats_.stageChanges;
+}
+
+void ProgramPipeline::clearStage(GLenum stage) {
+    const int index = stageIndex(stage);
+    if (index < 0 || stages_[static_cast<size_t>(index)] == 0) {
+        return;
+    }
+    glUseProgramStages(pipelineID_, stageBits[index], 0);
+    stages_[static_cast<size_t>(index)] = 0;
+    ++stats_.stageChanges;
+}
+
+void ProgramPipeline::use() {
+    Shader::useNone();
+    if (currentPipeline() == pipelineID_ || !generate()) {
+        return;
+    }
+    glBindProgramPipeline(pipelineID_);
+    currentPipeline() = pipelineID_;
+}
+
+void ProgramPipeline::useNone() {
+    if (currentPipeline() == 0) {
+        return;
+    }
+    glBindProgramPipeline(0);
+    currentPipeline() = 0;
+}
+
+bool ProgramPipeline::validate() {
+    if (!generate()) {
+        return false;
+    }
+    glValidateProgramPipeline(pipelineID_);
+    GLint valid = GL_FALSE;
+    glGetProgramPipelineiv(pipelineID_, GL_VALIDATE_STATUS, &valid);
+    if (valid == GL_FALSE) {
+        char buf[4096] = {0};
+        glGetProgramPipelineInfoLog(pipelineID_, sizeof(buf), nullptr, buf);
+        std::cerr << "Program pipeline " << pipelineID_ << " is not valid:\n" << buf << "\n";
+    }
+    return valid == GL_TRUE;
+}
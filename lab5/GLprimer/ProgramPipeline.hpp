@@ -0,0 +1,73 @@
+/*
+ * A program pipeline object, drawing with the stages of separable programs (see
+ * Shader::createStage()) instead of one program linked from all of them.
+ *
+ * Usage: create a program for each stage variant with Shader::createStage(),
+ *        put the ones to draw with into the pipeline with setStage() and call
+ *        use() before drawing:
+ *
+ *            Shader vertex, diffuse, specular;
+ *            vertex.createStage(GL_VERTEX_SHADER, "vertex.glsl");
+ *            diffuse.createStage(GL_FRAGMENT_SHADER, "fragment.glsl", {"SPECULAR 0"});
+ *            specular.createStage(GL_FRAGMENT_SHADER, "fragment.glsl");
+ *            ProgramPipeline pipeline;
+ *            pipeline.setStage(vertex);
+ *            pipeline.setStage(specular);
+ *            pipeline.use();
+ *
+ * N vertex and M fragment variants are then N + M compiled stages instead of
+ * N x M linked programs, and switching one stage with setStage() relinks nothing.
+ * The outputs of one stage are matched with the inputs of the next by name when
+ * drawing. Uniforms are set on the stage programs, which need not be in use.
+ *
+ * use() binds the pipeline with no program in use (Shader::useNone()), since a
+ * program in use takes the place of the pipeline. Like Shader::use(), it and
+ * setStage() skip the OpenGL call if nothing changes.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include "Shader.hpp"
+
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstddef>
+
+class ProgramPipeline {
+public:
+    ProgramPipeline();
+    ~ProgramPipeline();
+
+    ProgramPipeline(const ProgramPipeline&) = delete;
+    ProgramPipeline& operator=(const ProgramPipeline&) = delete;
+
+    // Use a program from Shader::createStage() for its stage
+    void setStage(const Shader& program);
+    // Use no program for a stage, e.g. GL_GEOMETRY_SHADER
+    void clearStage(GLenum stage);
+
+    // Bind the pipeline, with no program in use
+    void use();
+    // Bind no pipeline
+    static void useNone();
+
+    // Whether the stages can draw together, printing why not. Slow, for debugging.
+    bool validate();
+
+    GLuint id() const { return pipelineID_; }
+
+    struct Stats {
+        size_t stageChanges = 0;         // glUseProgramStages() calls made by setStage()
+        size_t stageChangesSkipped = 0;  // setStage() calls with the program already set
+    };
+    const Stats& stats() const { return stats_; }
+
+private:
+    // Generate the pipeline object, the first time it is needed
+    bool generate();
+
+    GLuint pipelineID_;
+    std::array<GLuint, 6> stages_;  // The program of each stage, see stageIndex()
+    Stats stats_;
+};
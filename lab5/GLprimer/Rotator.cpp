@@ -14,20 +14,40 @@
 #include <GLFW/glfw3.h>
 #include <cmath>
 
-KeyRotator::KeyRotator(GLFWwindow* window)
-    : window_(window), phi_(0.0), theta_(0.0), lastTime_(glfwGetTime()) {}
+InputState InputState::capture(GLFWwindow* window) {
+    InputState state;
+    state.time = glfwGetTime();
+    glfwGetCursorPos(window, &state.cursorX, &state.cursorY);
+    glfwGetWindowSize(window, &state.windowWidth, &state.windowHeight);
+    state.keyLeft = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+    state.keyRight = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+    state.keyUp = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS;
+    state.keyDown = glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS;
+    state.buttonLeft = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    state.buttonRight = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+    return state;
+}
+
+KeyRotator::KeyRotator(GLFWwindow* window) : KeyRotator(InputState::capture(window)) {
+    window_ = window;
+}
+
+KeyRotator::KeyRotator(const InputState& initial)
+    : window_(nullptr), phi_(0.0), theta_(0.0), lastTime_(initial.time) {}
 
-void KeyRotator::poll() {
-    const double currentTime = glfwGetTime();
+void KeyRotator::poll() { poll(InputState::capture(window_)); }
+
+void KeyRotator::poll(const InputState& input) {
+    const double currentTime = input.time;
     const double elapsedTime = currentTime - lastTime_;
     lastTime_ = currentTime;
 
-    if (glfwGetKey(window_, GLFW_KEY_RIGHT)) {
+    if (input.keyRight) {
         phi_ += elapsedTime * M_PI / 2.0;  // Rotate 90 degrees per second (pi/2)
         phi_ = fmod(phi_, M_PI * 2.0);     // Wrap around at 360 degrees (2*pi)
     }
 
-    if (glfwGetKey(window_, GLFW_KEY_LEFT)) {
+    if (input.keyLeft) {
         phi_ -= elapsedTime * M_PI / 2.0;  // Rotate 90 degrees per second (pi/2)
         phi_ = fmod(phi_, M_PI * 2.0);
         if (phi_ < 0.0) {
@@ -35,14 +55,14 @@ void KeyRotator::poll() {
         }
     }
 
-    if (glfwGetKey(window_, GLFW_KEY_UP)) {
+    if (input.keyUp) {
         theta_ += elapsedTime * M_PI / 2.0;  // Rotate 90 degrees per second
         if (theta_ >= M_PI / 2.0) {
             theta_ = M_PI / 2.0;  // Clamp at 90
         }
     }
 
-    if (glfwGetKey(window_, GLFW_KEY_DOWN)) {
+    if (input.keyDown) {
         theta_ -= elapsedTime * M_PI / 2.0;  // Rotate 90 degrees per second
         if (theta_ < -M_PI / 2.0) {
             theta_ = -M_PI / 2.0;  // Clamp at -90
@@ -54,24 +74,32 @@ double KeyRotator::phi() const { return phi_; }
 
 double KeyRotator::theta() const { return theta_; }
 
-MouseRotator::MouseRotator(GLFWwindow* window)
-    : window_(window), phi_(0.0), theta_(0.0), leftPressed_(false), rightPressed_(false) {
-    glfwGetCursorPos(window, &lastX_, &lastY_);
+MouseRotator::MouseRotator(GLFWwindow* window) : MouseRotator(InputState::capture(window)) {
+    window_ = window;
 }
 
-void MouseRotator::poll() {
-    // Find out where the mouse pointer is, and which buttons are pressed
-    double currentX;
-    double currentY;
-    glfwGetCursorPos(window_, &currentX, &currentY);
+MouseRotator::MouseRotator(const InputState& initial)
+    : window_(nullptr),
+      phi_(0.0),
+      theta_(0.0),
+      lastX_(initial.cursorX),
+      lastY_(initial.cursorY),
+      leftPressed_(false),
+      rightPressed_(false) {}
+
+void MouseRotator::poll() { poll(InputState::capture(window_)); }
+
+void MouseRotator::poll(const InputState& input) {
+    // Where the mouse pointer is, and which buttons are pressed
+    const double currentX = input.cursorX;
+    const double currentY = input.cursorY;
 
-    bool currentLeft = glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-    bool currentRight = glfwGetMouseButton(window_, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+    bool currentLeft = input.buttonLeft;
+    bool currentRight = input.buttonRight;
 
     if (currentLeft && leftPressed_) {  // If a left button drag is in progress
-        int windowWidth;
-        int windowHeight;
-        glfwGetWindowSize(window_, &windowWidth, &windowHeight);
+        const int windowWidth = input.windowWidth;
+        const int windowHeight = input.windowHeight;
 
         const double moveX = currentX - lastX_;
         const double moveY = currentY - lastY_;
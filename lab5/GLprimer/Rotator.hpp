@@ -6,6 +6,10 @@
  * read public members phi and theta to construct a rotation matrix.
  * The suggested composite rotation matrix is RotX(theta)*RotY(phi).
  *
+ * poll() reads the input from GLFW. To record or replay a session (see
+ * InputLog.hpp), construct the rotators from an InputState instead and pass
+ * the input for every frame to poll(const InputState&).
+ *
  * Authors: Stefan Gustavson (stegu@itn.liu.se) 2013-2015
  *          Martin Falk (martin.falk@liu.se) 2021
  */
@@ -13,11 +17,30 @@
 
 struct GLFWwindow;
 
+// Everything the rotators read from GLFW in one frame
+struct InputState {
+    double time = 0.0;  // glfwGetTime()
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    int windowWidth = 0;
+    int windowHeight = 0;
+    bool keyLeft = false;
+    bool keyRight = false;
+    bool keyUp = false;
+    bool keyDown = false;
+    bool buttonLeft = false;
+    bool buttonRight = false;
+
+    static InputState capture(GLFWwindow* window);
+};
+
 class KeyRotator {
 public:
     KeyRotator(GLFWwindow* window);
+    KeyRotator(const InputState& initial);
 
     void poll();
+    void poll(const InputState& input);
 
     double phi() const;
     double theta() const;
@@ -33,8 +56,10 @@ private:
 class MouseRotator {
 public:
     MouseRotator(GLFWwindow* window);
+    MouseRotator(const InputState& initial);
 
     void poll();
+    void poll(const InputState& input);
 
     double phi() const;
     double theta() const;
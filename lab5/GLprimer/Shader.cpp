@@ -10,20 +10,399 @@
 #include <GLFW/glfw3.h>
 
 #include "Shader.hpp"
+#include "ShaderSource.hpp"
+#include "Utilities.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
 
-Shader::Shader() : programID_(0) {}
+// A program being compiled and linked, by createShader() or in the background
+struct ShaderCompileJob {
+    struct Stage {
+        GLenum type = 0;
+        ShaderSource source;
+        GLuint shader = 0;
+    };
+    std::vector<Stage> stages;
+    bool separable = false;  // A program of one stage, see Shader::createStage()
+    std::string cachename;   // Of the program binary cache, empty if not used
+    uint64_t key = 0;
+    GLuint program = 0;
+    bool onThread = false;          // Compiled by the compile thread
+    std::atomic<bool> done{false};  // Set by the compile thread when it is
+};
 
-Shader::Shader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile) {
-    createShader(vertexshaderfile, fragmentshaderfile);
+namespace {
+
+const char binaryMagic[8] = {'T', 'N', 'M', 'P', 'R', 'O', 'G', '1'};
+
+std::string& binaryCacheDirectory() {
+    static std::string directory;
+    return directory;
 }
 
-Shader::~Shader() {
-    if (programID_ != 0) {
-        glDeleteProgram(programID_);  // free program resources
+// FNV-1a over the length and the characters of 's'
+uint64_t hashString(uint64_t hash, const char* s) {
+    const size_t length = s ? std::strlen(s) : 0;
+    for (size_t i = 0; i < sizeof(length); ++i) {
+        hash = (hash ^ ((length >> (8 * i)) & 0xff)) * 1099511628211ull;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(s[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+ * The binary cache file for a program linked from the sources, named after a hash of
+ * them and of the driver, whose binaries no other driver or version can load.
+ * Returns an empty string if the cache is disabled, a source is missing or the driver
+ * can not give out program binaries.
+ */
+std::string binaryCacheFile(const ShaderCompileJob& job, uint64_t& key) {
+    if (binaryCacheDirectory().empty() || !GLEW_ARB_get_program_binary) {
+        return {};
+    }
+    for (const ShaderCompileJob::Stage& stage : job.stages) {
+        if (stage.source.text.empty()) {
+            return {};
+        }
+    }
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    if (numFormats <= 0) {
+        return {};
+    }
+    uint64_t hash = 14695981039346656037ull;
+    for (const ShaderCompileJob::Stage& stage : job.stages) {
+        const char type[] = {static_cast<char>(stage.type >> 8), static_cast<char>(stage.type),
+                             job.separable ? 's' : 'p', '\0'};
+        hash = hashString(hash, type);
+        hash = hashString(hash, stage.source.text.c_str());
+    }
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        hash = hashString(hash, reinterpret_cast<const char*>(glGetString(name)));
+    }
+    key = hash;
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.glprog", static_cast<unsigned long long>(hash));
+    return (std::filesystem::path(binaryCacheDirectory()) / name).string();
+}
+
+/*
+ * Load the program from its cache file. Returns false if there is none, or if the
+ * driver rejects the binary, e.g. after an update which did not change its version.
+ */
+bool loadProgramBinary(GLuint program, const std::string& cachename, uint64_t key,
+                       bool separable) {
+    FILE* in = std::fopen(cachename.c_str(), "rb");
+    if (!in) {
+        return false;
+    }
+    char magic[sizeof(binaryMagic)];
+    uint64_t stored = 0;
+    uint32_t format = 0;
+    uint32_t length = 0;
+    bool ok = std::fread(magic, sizeof(magic), 1, in) == 1 &&
+              std::memcmp(magic, binaryMagic, sizeof(magic)) == 0 &&
+              std::fread(&stored, sizeof(stored), 1, in) == 1 && stored == key &&
+              std::fread(&format, sizeof(format), 1, in) == 1 &&
+              std::fread(&length, sizeof(length), 1, in) == 1 && length > 0 &&
+              length <= (256u << 20);
+    std::vector<char> binary(ok ? length : 0);
+    ok = ok && std::fread(binary.data(), 1, binary.size(), in) == binary.size();
+    std::fclose(in);
+    if (!ok) {
+        return false;
+    }
+
+    if (separable) {
+        glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+    }
+    glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(length));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+/*
+ * Store the binary of a linked program in its cache file. Returns false if the
+ * file could not be written.
+ */
+bool saveProgramBinary(GLuint program, const std::string& cachename, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return false;
+    }
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if (length <= 0) {
+        return false;
+    }
+
+    const uint32_t format32 = format;
+    const uint32_t length32 = static_cast<uint32_t>(length);
+    const bool ok = util::writeFileReplacing(cachename, [&](FILE* out) {
+        std::fwrite(binaryMagic, sizeof(binaryMagic), 1, out);
+        std::fwrite(&key, sizeof(key), 1, out);
+        std::fwrite(&format32, sizeof(format32), 1, out);
+        std::fwrite(&length32, sizeof(length32), 1, out);
+        std::fwrite(binary.data(), 1, length32, out);
+    });
+    if (!ok) {
+        std::cerr << "Could not write program binary file '" << cachename << "'\n";
+    }
+    return ok;
+}
+
+// The size of the largest value setUniform() keeps, a mat4
+const size_t maxValueSize = 16 * sizeof(GLfloat);
+
+// The program in use, as far as Shader::use() knows
+GLuint& currentProgram() {
+    static GLuint program = 0;
+    return program;
+}
+
+Shader::Stats& shaderStats() {
+    static Shader::Stats stats;
+    return stats;
+}
+
+// The glMemoryBarrier() bits not waited for since the last compute dispatch
+GLbitfield& pendingBarriers() {
+    static GLbitfield barriers = 0;
+    return barriers;
+}
+
+#ifndef NDEBUG
+// Samplers and images are set with glUniform1i(). Their types are in these ranges
+// of enums.
+bool isSampler(GLenum type) {
+    return (type >= GL_SAMPLER_1D && type <= GL_SAMPLER_2D_RECT_SHADOW) ||
+           (type >= GL_SAMPLER_1D_ARRAY && type <= GL_SAMPLER_CUBE_SHADOW) ||
+           (type >= GL_INT_SAMPLER_1D && type <= GL_UNSIGNED_INT_SAMPLER_BUFFER) ||
+           (type >= GL_SAMPLER_CUBE_MAP_ARRAY && type <= GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY) ||
+           (type >= GL_SAMPLER_2D_MULTISAMPLE &&
+            type <= GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY) ||
+           (type >= GL_IMAGE_1D && type <= GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY);
+}
+
+// True if a uniform of type 'actual' can be set with the glUniform*() function for
+// values of type 'expected'. Booleans can be set from floats or ints.
+bool typeMatches(GLenum expected, GLenum actual) {
+    if (expected == actual || (actual == GL_BOOL && (expected == GL_FLOAT || expected == GL_INT))) {
+        return true;
+    }
+    return expected == GL_INT && isSampler(actual);
+}
+#endif
+
+// Create a shader and start compiling it, without asking whether that worked,
+// which would wait for the compiler
+GLuint compileShader(GLenum shaderType, const ShaderSource& shaderSource) {
+    GLuint shader = glCreateShader(shaderType);
+    if (!shaderSource.text.empty()) {
+        const char* source = shaderSource.text.c_str();
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+    }
+    return shader;
+}
+
+// Print the log of a shader which failed to compile
+void checkShader(GLuint shader, const ShaderSource& shaderSource) {
+    GLint shaderCompiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+
+    if (shaderCompiled == GL_FALSE) {
+        // something went wrong, print the shader log
+        static char buf[4096] = {0};  // buffer for error messages from the GLSL compiler and linker
+        glGetShaderInfoLog(shader, sizeof(buf), nullptr, buf);
+        std::cerr << "Shader compile error ('" << shaderSource.files.front() << "'):\n" << buf;
+        if (shaderSource.files.size() > 1) {
+            std::cerr << "Source strings: " << sourceFileList(shaderSource) << "\n";
+        }
+        std::cerr << "\n";
+    }
+}
+
+// Create the shaders and the program of the job and start compiling and linking
+// them. Drivers with parallel compiling do that in the background.
+void startCompile(ShaderCompileJob& job) {
+    for (ShaderCompileJob::Stage& stage : job.stages) {
+        stage.shader = compileShader(stage.type, stage.source);
+    }
+
+    // Create a program object and attach the compiled shaders.
+    job.program = glCreateProgram();
+    for (const ShaderCompileJob::Stage& stage : job.stages) {
+        glAttachShader(job.program, stage.shader);
+    }
+    if (job.separable) {
+        glProgramParameteri(job.program, GL_PROGRAM_SEPARABLE, GL_TRUE);
     }
+    if (!job.cachename.empty()) {
+        glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(job.program);
+}
+
+// GL_KHR_parallel_shader_compile, or the ARB extension it came from
+bool driverCompilesInParallel() {
+    static const bool supported = [] {
+        if (GLEW_ARB_parallel_shader_compile) {
+            return true;
+        }
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const GLubyte* name = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i));
+            if (name && std::strcmp(reinterpret_cast<const char*>(name),
+                                    "GL_KHR_parallel_shader_compile") == 0) {
+                return true;
+            }
+        }
+        return false;
+    }();
+    return supported;
+}
+
+Shader::AsyncCompile& asyncCompileMode() {
+    static Shader::AsyncCompile mode = Shader::AsyncCompile::Driver;
+    return mode;
+}
+
+/*
+ * The thread compiling programs for createShaderAsync() when the driver can not
+ * do it in the background, on a context sharing objects with the OpenGL thread's.
+ * It is started by the first program, and compiles them in the order they came.
+ */
+class CompileThread {
+public:
+    // The context can not be destroyed here, after the window system may be gone
+    ~CompileThread() { join(); }
+
+    // Queue a program, starting the thread first if needed. Returns false if the
+    // thread could not get a context.
+    bool submit(const std::shared_ptr<ShaderCompileJob>& job) {
+        if (!thread_.joinable()) {
+            context_ = util::createSharedContext();
+            if (!context_) {
+                return false;
+            }
+            thread_ = std::thread(&CompileThread::run, this);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+        queued_.notify_one();
+        return true;
+    }
+
+    // Wait until the program of 'job' is compiled and linked
+    void wait(const ShaderCompileJob& job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [&job] { return job.done.load(); });
+    }
+
+    // Compile the programs in the queue, then stop the thread and destroy its context
+    void stop() {
+        join();
+        util::destroySharedContext(context_);
+        context_ = nullptr;
+    }
+
+private:
+    void run() {
+        util::setSharedContextCurrent(context_, true);
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            queued_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                break;
+            }
+            std::shared_ptr<ShaderCompileJob> job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+
+            startCompile(*job);
+            GLint linked = GL_FALSE;
+            glGetProgramiv(job->program, GL_LINK_STATUS, &linked);  // Waits for the compiler
+            glFinish();  // Objects changed in one context are complete for others after this
+
+            lock.lock();
+            job->done = true;
+            finished_.notify_all();
+        }
+        lock.unlock();
+        util::setSharedContextCurrent(context_, false);
+    }
+
+    void join() {
+        if (!thread_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        queued_.notify_one();
+        thread_.join();
+        stopping_ = false;
+    }
+
+    util::SharedContext* context_ = nullptr;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable queued_;    // For the thread, waiting for a program
+    std::condition_variable finished_;  // For wait(), waiting for the thread
+    std::deque<std::shared_ptr<ShaderCompileJob>> jobs_;
+    bool stopping_ = false;
+};
+
+CompileThread& compileThread() {
+    static CompileThread thread;
+    return thread;
+}
+
+// Read the files of the stages of a program
+std::shared_ptr<ShaderCompileJob> makeJob(
+    const std::vector<std::pair<GLenum, std::string>>& files,
+    const std::vector<std::string>& defines, bool separable) {
+    auto job = std::make_shared<ShaderCompileJob>();
+    for (const auto& file : files) {
+        job->stages.push_back({file.first, preprocessShader(file.second, defines), 0});
+    }
+    job->separable = separable;
+    return job;
+}
+
+}  // namespace
+
+Shader::Shader() : programID_(0), stage_(0), workGroupSize_{} {}
+
+Shader::Shader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile,
+               const std::vector<std::string>& defines)
+    : programID_(0), stage_(0), workGroupSize_{} {
+    createShader(vertexshaderfile, fragmentshaderfile, defines);
+}
+
+Shader::~Shader() {
+    deleteProgram();  // free program resources
 }
 
 GLuint Shader::id() const { return programID_; }
@@ -54,57 +433,431 @@ std::string readFile(const std::string& filename) {
     return buffer;
 }
 
-GLuint loadShader(GLenum shaderType, const std::string& filename) {
-    GLuint shader = glCreateShader(shaderType);
-    std::string shaderSource = readFile(filename);
-    if (!shaderSource.empty()) {
-        const char* source = shaderSource.c_str();
-        glShaderSource(shader, 1, &source, nullptr);
-        glCompileShader(shader);
+void Shader::createShader(const std::string& vertexshaderfile,
+                          const std::string& fragmentshaderfile,
+                          const std::vector<std::string>& defines) {
+    compile(makeJob({{GL_VERTEX_SHADER, vertexshaderfile}, {GL_FRAGMENT_SHADER, fragmentshaderfile}},
+                    defines, false),
+            AsyncCompile::Blocking);
+}
+
+void Shader::createShaderAsync(const std::string& vertexshaderfile,
+                               const std::string& fragmentshaderfile,
+                               const std::vector<std::string>& defines) {
+    compile(makeJob({{GL_VERTEX_SHADER, vertexshaderfile}, {GL_FRAGMENT_SHADER, fragmentshaderfile}},
+                    defines, false),
+            asyncCompileMode());
+}
+
+bool Shader::createStage(GLenum type, const std::string& shaderfile,
+                         const std::vector<std::string>& defines) {
+    if (!GLEW_ARB_separate_shader_objects) {
+        deleteProgram();
+        stage_ = 0;
+        std::cerr << "Separable programs need OpenGL 4.1 or GL_ARB_separate_shader_objects ('"
+                  << shaderfile << "')\n";
+        return false;
     }
+    compile(makeJob({{type, shaderfile}}, defines, true), AsyncCompile::Blocking);
+    return true;
+}
 
-    GLint shaderCompiled = GL_FALSE;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+bool Shader::createComputeShader(const std::string& computeshaderfile,
+                                 const std::vector<std::string>& defines) {
+    if (!GLEW_ARB_compute_shader || !GLEW_ARB_shader_storage_buffer_object) {
+        deleteProgram();
+        stage_ = 0;
+        std::cerr << "Compute shaders need OpenGL 4.3 or GL_ARB_compute_shader ('"
+                  << computeshaderfile << "')\n";
+        return false;
+    }
+    compile(makeJob({{GL_COMPUTE_SHADER, computeshaderfile}}, defines, false),
+            AsyncCompile::Blocking);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(programID_, GL_LINK_STATUS, &linked);
+    if (linked == GL_TRUE) {
+        glGetProgramiv(programID_, GL_COMPUTE_WORK_GROUP_SIZE, workGroupSize_.data());
+    }
+    return true;
+}
 
-    if (shaderCompiled == GL_FALSE) {
-        // something went wrong, print the shader log
-        static char buf[4096] = {0};  // buffer for error messages from the GLSL compiler and linker
-        glGetShaderInfoLog(shader, sizeof(buf), nullptr, buf);
-        std::cerr << "Shader compile error ('" << filename << "'):\n" << buf << "\n";
+void Shader::dispatch(GLuint groupsX, GLuint groupsY, GLuint groupsZ) const {
+    if (programID_ == 0 || workGroupSize_[0] == 0) {
+        return;
     }
+    use();
+    glDispatchCompute(groupsX, groupsY, groupsZ);
+    pendingBarriers() = GL_ALL_BARRIER_BITS;
+    ++shaderStats().dispatches;
+}
 
-    return shader;
+void Shader::dispatchThreads(GLuint x, GLuint y, GLuint z) const {
+    auto groups = [](GLuint threads, GLint size) {
+        const GLuint local = static_cast<GLuint>(std::max(size, 1));
+        return (threads + local - 1) / local;
+    };
+    dispatch(groups(x, workGroupSize_[0]), groups(y, workGroupSize_[1]),
+             groups(z, workGroupSize_[2]));
 }
 
-void Shader::createShader(const std::string& vertexshaderfile,
-                          const std::string& fragmentshaderfile) {
-    // If a program is already stored in this object, delete it
-    if (programID_ != 0) {
-        glDeleteProgram(programID_);
+void Shader::memoryBarrier(GLbitfield barriers) {
+    barriers &= pendingBarriers();
+    if (barriers == 0) {
+        ++shaderStats().barriersSkipped;
+        return;
     }
+    glMemoryBarrier(barriers);
+    pendingBarriers() &= ~barriers;
+    ++shaderStats().barriers;
+}
 
-    // Create the vertex shader.
-    GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexshaderfile);
-    GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentshaderfile);
+bool Shader::isReady() {
+    if (!pending_) {
+        return true;
+    }
+    if (pending_->onThread) {
+        if (!pending_->done) {
+            return false;
+        }
+    } else {
+        // GL_COMPLETION_STATUS_KHR has the same value
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending_->program, GL_COMPLETION_STATUS_ARB, &done);
+        if (done == GL_FALSE) {
+            return false;
+        }
+    }
+    finishCompile();
+    return true;
+}
 
-    // Create a program object and attach the two compiled shaders.
-    GLuint programObject = glCreateProgram();
-    glAttachShader(programObject, vertexShader);
-    glAttachShader(programObject, fragmentShader);
+void Shader::wait() {
+    if (!pending_) {
+        return;
+    }
+    if (pending_->onThread) {
+        compileThread().wait(*pending_);
+    }
+    finishCompile();  // The link status waits for drivers compiling in parallel
+}
 
-    // Link the program object and print out the info log.
-    glLinkProgram(programObject);
+void Shader::setAsyncCompile(AsyncCompile mode) { asyncCompileMode() = mode; }
+
+void Shader::stopCompileThread() { compileThread().stop(); }
+
+void Shader::compile(std::shared_ptr<ShaderCompileJob> job, AsyncCompile mode) {
+    // If a program is already stored in this object, delete it
+    deleteProgram();
+    stage_ = job->separable ? job->stages.front().type : 0;
+
+    // A program linked from the same sources before is loaded from the binary the
+    // driver gave out then, which skips the GLSL compiler. The sources are compared
+    // after preprocessing, so changed includes and other macros make a new binary.
+    job->cachename = binaryCacheFile(*job, job->key);
+    if (!job->cachename.empty()) {
+        GLuint programObject = glCreateProgram();
+        if (loadProgramBinary(programObject, job->cachename, job->key, job->separable)) {
+            programID_ = programObject;
+            reflectUniforms();
+            return;
+        }
+        glDeleteProgram(programObject);
+    }
+
+    if (mode == AsyncCompile::Driver && !driverCompilesInParallel()) {
+        mode = AsyncCompile::Thread;
+    }
+    if (mode == AsyncCompile::Thread) {
+        job->onThread = true;
+        if (compileThread().submit(job)) {
+            pending_ = std::move(job);
+            return;
+        }
+        job->onThread = false;  // No shared context, compile right here
+        mode = AsyncCompile::Blocking;
+    }
+    if (mode == AsyncCompile::Driver) {
+        // Let the driver use as many threads as it likes, which the ARB extension
+        // (not KHR) leaves up to the application
+        static bool threadsSet = false;
+        if (!threadsSet && GLEW_ARB_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsARB(0xffffffffu);
+            threadsSet = true;
+        }
+    }
+    startCompile(*job);
+    pending_ = std::move(job);
+    if (mode == AsyncCompile::Blocking) {
+        finishCompile();
+    }
+}
+
+void Shader::finishCompile() {
+    const std::shared_ptr<ShaderCompileJob> job = std::move(pending_);
 
     GLint shadersLinked = GL_FALSE;
-    glGetProgramiv(programObject, GL_LINK_STATUS, &shadersLinked);
+    glGetProgramiv(job->program, GL_LINK_STATUS, &shadersLinked);
 
     if (shadersLinked == GL_FALSE) {
+        for (const ShaderCompileJob::Stage& stage : job->stages) {
+            checkShader(stage.shader, stage.source);
+        }
         char buf[4096] = {0};
-        glGetProgramInfoLog(programObject, sizeof(buf), nullptr, buf);
+        glGetProgramInfoLog(job->program, sizeof(buf), nullptr, buf);
         std::cerr << "Shader program linker error:\n" << buf << "\n";
+    } else if (!job->cachename.empty()) {
+        saveProgramBinary(job->program, job->cachename, job->key);
+    }
+    for (const ShaderCompileJob::Stage& stage : job->stages) {
+        glDeleteShader(stage.shader);  // After successful linking, these are no longer needed
     }
-    glDeleteShader(vertexShader);    // After successful linking,
-    glDeleteShader(fragmentShader);  // these are no longer needed
 
-    programID_ = programObject;  // Save this value in the class variable
+    programID_ = job->program;  // Save this value in the class variable
+    reflectUniforms();
+}
+
+void Shader::setBinaryCacheDirectory(const std::string& directory) {
+    binaryCacheDirectory() = directory;
+    if (!directory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+    }
+}
+
+const std::vector<UniformInfo>& Shader::uniforms() const { return uniforms_; }
+
+const std::vector<UniformBlockInfo>& Shader::uniformBlocks() const { return uniformBlocks_; }
+
+const UniformInfo* Shader::findUniform(UniformName name) const {
+    auto it = std::lower_bound(
+        uniforms_.begin(), uniforms_.end(), name.hash,
+        [](const UniformInfo& uniform, uint32_t hash) { return uniform.hash < hash; });
+    return it != uniforms_.end() && it->hash == name.hash ? &*it : nullptr;
+}
+
+GLint Shader::update(UniformName name, GLenum type, const void* value, size_t size) const {
+    const UniformInfo* uniform = findUniform(name);
+    if (!uniform) {
+        return -1;
+    }
+#ifndef NDEBUG
+    if (!typeMatches(type, uniform->type)) {
+        std::cerr << "Uniform '" << name.name << "' is of type 0x" << std::hex << uniform->type
+                  << ", not 0x" << type << std::dec << "\n";
+        return -1;
+    }
+#else
+    (void)type;
+#endif
+    const size_t index = static_cast<size_t>(uniform - uniforms_.data());
+    unsigned char* last = values_.data() + index * maxValueSize;
+    if (valueSet_[index] && std::memcmp(last, value, size) == 0) {
+        ++shaderStats().uniformCallsSkipped;
+        return -1;
+    }
+    std::memcpy(last, value, size);
+    valueSet_[index] = true;
+    ++shaderStats().uniformCalls;
+    return uniform->location;
+}
+
+void Shader::setUniform(UniformName name, GLfloat value) const {
+    const GLint location = update(name, GL_FLOAT, &value, sizeof(value));
+    if (location >= 0 && stage_ != 0) {
+        glProgramUniform1f(programID_, location, value);
+    } else if (location >= 0) {
+        glUniform1f(location, value);
+    }
+}
+
+void Shader::setUniform(UniformName name, GLfloat x, GLfloat y) const {
+    const GLfloat value[] = {x, y};
+    const GLint location = update(name, GL_FLOAT_VEC2, value, sizeof(value));
+    if (location >= 0 && stage_ != 0) {
+        glProgramUniform2fv(programID_, location, 1, value);
+    } else if (location >= 0) {
+        glUniform2fv(location, 1, value);
+    }
+}
+
+void Shader::setUniform(UniformName name, GLfloat x, GLfloat y, GLfloat z) const {
+    const GLfloat value[] = {x, y, z};
+    const GLint location = update(name, GL_FLOAT_VEC3, value, sizeof(value));
+    if (location >= 0 && stage_ != 0) {
+        glProgramUniform3fv(programID_, location, 1, value);
+    } else if (location >= 0) {
+        glUniform3fv(location, 1, value);
+    }
+}
+
+void Shader::setUniform(UniformName name, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const {
+    const GLfloat value[] = {x, y, z, w};
+    const GLint location = update(name, GL_FLOAT_VEC4, value, sizeof(value));
+    if (location >= 0 && stage_ != 0) {
+        glProgramUniform4fv(programID_, location, 1, value);
+    } else if (location >= 0) {
+        glUniform4fv(location, 1, value);
+    }
+}
+
+void Shader::setUniform(UniformName name, GLint value) const {
+    const GLint location = update(name, GL_INT, &value, sizeof(value));
+    if (location >= 0 && stage_ != 0) {
+        glProgramUniform1i(programID_, location, value);
+    } else if (location >= 0) {
+        glUniform1i(location, value);
+    }
+}
+
+void Shader::setUniform(UniformName name, const std::array<GLfloat, 16>& matrix) const {
+    const GLint location = update(name, GL_FLOAT_MAT4, matrix.data(), sizeof(matrix));
+    if (location >= 0 && stage_ != 0) {
+        glProgramUniformMatrix4fv(programID_, location, 1, GL_FALSE, matrix.data());
+    } else if (location >= 0) {
+        glUniformMatrix4fv(location, 1, GL_FALSE, matrix.data());
+    }
+}
+
+void Shader::forgetUniforms() { valueSet_.assign(uniforms_.size(), false); }
+
+void Shader::bindUniformBlock(UniformName name, GLuint binding) const {
+    if (const UniformBlockInfo* block = findUniformBlock(name)) {
+        glUniformBlockBinding(programID_, block->index, binding);
+    }
+}
+
+void Shader::bindStorageBlock(UniformName name, GLuint binding) const {
+    const GLuint index =
+        glGetProgramResourceIndex(programID_, GL_SHADER_STORAGE_BLOCK, name.name);
+    if (index != GL_INVALID_INDEX) {
+        glShaderStorageBlockBinding(programID_, index, binding);
+    }
+}
+
+const UniformBlockInfo* Shader::findUniformBlock(UniformName name) const {
+    for (const UniformBlockInfo& block : uniformBlocks_) {
+        if (block.hash == name.hash) {
+            return &block;
+        }
+    }
+    return nullptr;
+}
+
+void Shader::use() const {
+    if (currentProgram() == programID_) {
+        ++shaderStats().programBindsSkipped;
+        return;
+    }
+    glUseProgram(programID_);
+    currentProgram() = programID_;
+    ++shaderStats().programBinds;
+}
+
+void Shader::useNone() {
+    if (currentProgram() == 0) {
+        ++shaderStats().programBindsSkipped;
+        return;
+    }
+    glUseProgram(0);
+    currentProgram() = 0;
+    ++shaderStats().programBinds;
+}
+
+const Shader::Stats& Shader::stats() { return shaderStats(); }
+
+void Shader::resetStats() { shaderStats() = Stats(); }
+
+void Shader::deleteProgram() {
+    if (pending_) {
+        // The compile thread may still be creating the objects
+        if (pending_->onThread) {
+            compileThread().wait(*pending_);
+        }
+        for (const ShaderCompileJob::Stage& stage : pending_->stages) {
+            glDeleteShader(stage.shader);
+        }
+        glDeleteProgram(pending_->program);
+        pending_.reset();
+    }
+    if (programID_ == 0) {
+        return;
+    }
+    // A new program could get the same name, which use() would take as in use
+    if (currentProgram() == programID_) {
+        useNone();
+    }
+    glDeleteProgram(programID_);
+    programID_ = 0;
+    workGroupSize_ = {};
+}
+
+void Shader::reflectUniforms() {
+    uniforms_.clear();
+    uniformBlocks_.clear();
+    GLint linked = GL_FALSE;
+    glGetProgramiv(programID_, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        forgetUniforms();
+        return;
+    }
+    auto byHash = [](const UniformInfo& a, const UniformInfo& b) { return a.hash < b.hash; };
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(programID_, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(programID_, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    std::vector<char> buffer(static_cast<size_t>(std::max(maxLength, 1)));
+    for (GLint i = 0; i < count; ++i) {
+        const GLuint index = static_cast<GLuint>(i);
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(programID_, index, maxLength, &length, buffer.data());
+        GLint dataSize = 0;
+        glGetActiveUniformBlockiv(programID_, index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+        std::string name(buffer.data(), static_cast<size_t>(length));
+        uniformBlocks_.push_back({uniformHash(name.c_str()), index, dataSize, name, {}});
+    }
+
+    glGetProgramiv(programID_, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(programID_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    buffer.resize(static_cast<size_t>(std::max(maxLength, 1)));
+    for (GLint i = 0; i < count; ++i) {
+        const GLuint index = static_cast<GLuint>(i);
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programID_, index, maxLength, &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), static_cast<size_t>(length));
+        GLint block = -1;
+        GLint offset = -1;
+        GLint matrixStride = 0;
+        GLint rowMajor = GL_FALSE;
+        glGetActiveUniformsiv(programID_, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+        glGetActiveUniformsiv(programID_, 1, &index, GL_UNIFORM_OFFSET, &offset);
+        glGetActiveUniformsiv(programID_, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &matrixStride);
+        glGetActiveUniformsiv(programID_, 1, &index, GL_UNIFORM_IS_ROW_MAJOR, &rowMajor);
+        // Arrays are named after their first element
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            name.resize(name.size() - 3);
+        }
+        const uint32_t hash = uniformHash(name.c_str());
+        if (block >= 0 && static_cast<size_t>(block) < uniformBlocks_.size()) {
+            uniformBlocks_[static_cast<size_t>(block)].members.push_back(
+                {hash, -1, type, size, offset, matrixStride, rowMajor != GL_FALSE, name});
+        } else if (block < 0) {
+            const GLint location = glGetUniformLocation(programID_, name.c_str());
+            uniforms_.push_back({hash, location, type, size, -1, 0, false, name});
+        }
+    }
+    std::sort(uniforms_.begin(), uniforms_.end(), byHash);
+    for (size_t i = 1; i < uniforms_.size(); ++i) {
+        if (uniforms_[i].hash == uniforms_[i - 1].hash) {
+            std::cerr << "Uniforms '" << uniforms_[i - 1].name << "' and '" << uniforms_[i].name
+                      << "' have the same hash, rename one of them\n";
+        }
+    }
+    for (UniformBlockInfo& block : uniformBlocks_) {
+        std::sort(block.members.begin(), block.members.end(), byHash);
+    }
+    values_.assign(uniforms_.size() * maxValueSize, 0);
+    forgetUniforms();
 }
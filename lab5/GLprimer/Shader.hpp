@@ -4,6 +4,55 @@
  * Usage: call createShader() to load and compile a program object
  * or use the constructor with two filenames.
  * Call glUseProgram() with the public member programID as argument.
+ * The files may #include others, and a list of macros to #define can be given
+ * to compile specialized variants of the same files (see ShaderSource.hpp and,
+ * for a cache of such variants, ShaderPermutations.hpp).
+ * Call setBinaryCacheDirectory() first to keep linked programs on disk as the
+ * driver's binaries (glGetProgramBinary()), so that later runs load them instead
+ * of compiling the same sources again. Binaries are only used with the driver
+ * that made them (same vendor, renderer and version), and programs are compiled
+ * as usual if the driver rejects them.
+ *
+ * The active uniforms and uniform blocks are looked up once, when the program is
+ * linked, into a table of locations, types and sizes. Set uniforms through
+ * setUniform() with their names, which are hashed at compile time, instead of
+ * calling glGetUniformLocation() in the rendering loop:
+ *
+ *     shader.use();
+ *     shader.setUniform("MV", matMV);
+ *
+ * Uniforms which are not active, e.g. because the compiler removed them, are
+ * skipped like location -1 is by OpenGL. Debug builds (without NDEBUG) print a
+ * message when a value does not match the type of its uniform.
+ *
+ * setUniform() keeps the last value set for every uniform, and skips the
+ * glUniform*() call when a value is set again with the same bits, as values that
+ * never change (a projection matrix) or change rarely are in most loops. use()
+ * likewise skips glUseProgram() for the program already in use. Set uniforms and
+ * programs only through these, or call forgetUniforms() after glUniform*() and
+ * useNone() after glUseProgram(). stats() counts the calls made and skipped.
+ * For uniform blocks, see UniformBuffer.hpp.
+ *
+ * createShaderAsync() starts compiling and linking a program without waiting for
+ * the compiler, so that rendering goes on with another program until isReady().
+ * Drivers with GL_KHR_parallel_shader_compile compile in threads of their own, and
+ * isReady() asks for GL_COMPLETION_STATUS_KHR, which never waits. With other
+ * drivers a compile thread with a context sharing objects with the current one
+ * (util::createSharedContext()) compiles the programs one after the other; call
+ * stopCompileThread() before destroying the context then.
+ *
+ * createStage() makes a separable program of a single stage instead, which a
+ * ProgramPipeline combines with the stages of other programs (see
+ * ProgramPipeline.hpp). Their uniforms are set with glProgramUniform*(), so they
+ * need not be in use.
+ *
+ * createComputeShader() makes a compute program, which dispatch() runs over a grid
+ * of work groups. It reads and writes shader storage buffers (StorageBuffer.hpp)
+ * and images (Texture::bindImage()), and its writes are seen by the commands after
+ * it only once glMemoryBarrier() was called for the kind of access, e.g.
+ * GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT to draw from a buffer it wrote. Call
+ * memoryBarrier() with the bits before each such access: it calls glMemoryBarrier()
+ * only for the bits not waited for since the last dispatch.
  *
  * Authors: Stefan Gustavson (stegu@itn.liu.se) 2014
  *          Martin Falk (martin.falk@liu.se) 2021
@@ -13,7 +62,52 @@
 #pragma once
 
 #include <GLFW/glfw3.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+
+// FNV-1a hash of a uniform name, as used by the uniform table of Shader
+constexpr uint32_t uniformHash(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; ++name) {
+        hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+// The name of a uniform, hashed when it is made from a string literal. Declare it
+// constexpr to be sure that is at compile time.
+struct UniformName {
+    template <size_t N>
+    constexpr UniformName(const char (&name)[N]) : hash(uniformHash(name)), name(name) {}
+
+    uint32_t hash;
+    const char* name;  // For messages
+};
+
+struct UniformInfo {
+    uint32_t hash;  // uniformHash() of the name, without "[0]" for arrays
+    GLint location;      // -1 for members of uniform blocks
+    GLenum type;         // E.g. GL_FLOAT_MAT4 or GL_SAMPLER_2D
+    GLint size;          // The number of elements of arrays, 1 otherwise
+    GLint offset;        // In bytes from the start of the block, -1 outside of blocks
+    GLint matrixStride;  // In bytes between the columns of matrices in blocks
+    bool rowMajor;       // For matrices in blocks stored row by row, with the stride between rows
+    std::string name;
+};
+
+struct UniformBlockInfo {
+    uint32_t hash;
+    GLuint index;
+    GLint dataSize;  // In bytes
+    std::string name;
+    std::vector<UniformInfo> members;  // Sorted by hash
+};
+
+struct ShaderCompileJob;  // A program being compiled, see Shader.cpp
 
 class Shader {
 public:
@@ -21,16 +115,147 @@ public:
     Shader();
 
     // Constructor to create, load and compile a Shader program in one blow.
-    Shader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile);
+    Shader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile,
+           const std::vector<std::string>& defines = {});
 
     // Destructor
     ~Shader();
 
-    // createShader() - create, load, compile and link the GLSL shader objects.
-    void createShader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile);
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    // createShader() - create, load, compile and link the GLSL shader objects,
+    // with the macros 'defines' ("NAME" or "NAME VALUE") defined in both.
+    void createShader(const std::string& vertexshaderfile, const std::string& fragmentshaderfile,
+                      const std::vector<std::string>& defines = {});
+
+    // Start creating the program like createShader(), without waiting for the
+    // compiler. The program is not used, and id() is 0, until isReady().
+    void createShaderAsync(const std::string& vertexshaderfile,
+                           const std::string& fragmentshaderfile,
+                           const std::vector<std::string>& defines = {});
+
+    // Whether the program is compiled and linked, or failed to, which makes it
+    // usable. Never waits for the compiler. True for programs from createShader().
+    bool isReady();
+    // Wait until the program is compiled and linked
+    void wait();
+
+    // How createShaderAsync() compiles
+    enum class AsyncCompile {
+        Driver,    // In the driver's threads where it can (the default), else Thread.
+                   // Some drivers, like Mesa llvmpipe, have the extension but still
+                   // compile in glLinkProgram(), and are better off with Thread.
+        Thread,    // On the compile thread
+        Blocking,  // Right away, like createShader()
+    };
+    static void setAsyncCompile(AsyncCompile mode);
+
+    // Stop the compile thread, if it was started, after it compiled the programs
+    // waiting for it. Call before destroying the OpenGL context.
+    static void stopCompileThread();
+
+    // Create a separable program of one stage, e.g. GL_VERTEX_SHADER, for a
+    // ProgramPipeline. Returns false, after printing why, if the driver has no
+    // separable programs (OpenGL 4.1 or GL_ARB_separate_shader_objects).
+    bool createStage(GLenum type, const std::string& shaderfile,
+                     const std::vector<std::string>& defines = {});
+
+    // The stage of a program from createStage(), 0 for other programs
+    GLenum stage() const { return stage_; }
+
+    // Create a compute program. Returns false, after printing why, if the driver
+    // has no compute shaders (OpenGL 4.3 or GL_ARB_compute_shader).
+    bool createComputeShader(const std::string& computeshaderfile,
+                             const std::vector<std::string>& defines = {});
+
+    // The local size of a compute program, from layout(local_size_x = ...) in
+    const std::array<GLint, 3>& workGroupSize() const { return workGroupSize_; }
+
+    // Run the compute program, using it first, with this many work groups
+    void dispatch(GLuint groupsX, GLuint groupsY = 1, GLuint groupsZ = 1) const;
+    // The same with the work groups needed for this many invocations, rounded up.
+    // The shader skips the invocations past the end (gl_GlobalInvocationID).
+    void dispatchThreads(GLuint x, GLuint y = 1, GLuint z = 1) const;
+
+    // Wait for the writes of the compute programs dispatched before, for the
+    // accesses in 'barriers' (glMemoryBarrier() bits) that were not waited for yet
+    static void memoryBarrier(GLbitfield barriers);
 
     GLuint id() const;
 
+    // Make the program the one in use with glUseProgram(), unless it already is
+    void use() const;
+    // Make no program the one in use
+    static void useNone();
+
+    // The program binary cache. Disabled (the default) if the directory is empty.
+    static void setBinaryCacheDirectory(const std::string& directory);
+
+    // The active uniforms outside of blocks and the active uniform blocks, by hash
+    const std::vector<UniformInfo>& uniforms() const;
+    const std::vector<UniformBlockInfo>& uniformBlocks() const;
+
+    // The uniform with the name, nullptr if it is not active
+    const UniformInfo* findUniform(UniformName name) const;
+
+    // Set a uniform of the program, which must be in use (use()) unless it is a
+    // stage. Nothing is done if the uniform already has the value.
+    void setUniform(UniformName name, GLfloat value) const;
+    void setUniform(UniformName name, GLfloat x, GLfloat y) const;
+    void setUniform(UniformName name, GLfloat x, GLfloat y, GLfloat z) const;
+    void setUniform(UniformName name, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const;
+    void setUniform(UniformName name, GLint value) const;  // int, bool or sampler
+    void setUniform(UniformName name, const std::array<GLfloat, 16>& matrix) const;  // mat4
+
+    // Forget the values set, after uniforms were set with glUniform*() directly
+    void forgetUniforms();
+
+    // Bind a uniform block to the uniform buffer binding point 'binding'
+    void bindUniformBlock(UniformName name, GLuint binding) const;
+
+    // The uniform block with the name, nullptr if it is not active
+    const UniformBlockInfo* findUniformBlock(UniformName name) const;
+
+    // Bind a shader storage block to the storage buffer binding point 'binding'
+    void bindStorageBlock(UniformName name, GLuint binding) const;
+
+    // Counted over all programs since the start or resetStats()
+    struct Stats {
+        size_t uniformCalls = 0;         // glUniform*() calls made by setUniform()
+        size_t uniformCallsSkipped = 0;  // setUniform() calls with the value already set
+        size_t programBinds = 0;         // glUseProgram() calls made by use() or useNone()
+        size_t programBindsSkipped = 0;  // use() calls with the program already in use
+        size_t dispatches = 0;           // glDispatchCompute() calls
+        size_t barriers = 0;             // glMemoryBarrier() calls made by memoryBarrier()
+        size_t barriersSkipped = 0;      // memoryBarrier() calls with nothing to wait for
+    };
+    static const Stats& stats();
+    static void resetStats();
+
 private:
+    // Fill the uniform tables from the linked program
+    void reflectUniforms();
+    // The location of the uniform, or -1 if it is not active or already has the
+    // value. Checks the type in debug builds.
+    GLint update(UniformName name, GLenum type, const void* value, size_t size) const;
+    // Delete the program, and stop using it first
+    void deleteProgram();
+    // Replace the program by the one of the job: load it from the binary cache if it
+    // is there, else compile it as 'mode' says
+    void compile(std::shared_ptr<ShaderCompileJob> job, AsyncCompile mode);
+    // Make the compiled program 'pending_' the program: print errors, cache and reflect it
+    void finishCompile();
+
     GLuint programID_;
+    GLenum stage_;  // See stage()
+    std::array<GLint, 3> workGroupSize_;  // See workGroupSize()
+    std::shared_ptr<ShaderCompileJob> pending_;  // While compiling in the background
+    std::vector<UniformInfo> uniforms_;  // Sorted by hash
+    std::vector<UniformBlockInfo> uniformBlocks_;
+    mutable std::vector<unsigned char> values_;  // The last value set, for each uniform
+    mutable std::vector<bool> valueSet_;
 };
+
+// Read the contents of a text file, returns an empty string on errors
+std::string readFile(const std::string& filename);
@@ -0,0 +1,85 @@
+/*
+ * A cache of shader programs specialized by feature masks.
+ *
+ * This code is in the public domain.
+ */
+#include "ShaderPermutations.hpp"
+
+#include <iostream>
+
+ShaderPermutations::ShaderPermutations(const std::string& vertexshaderfile,
+                                       const std::string& fragmentshaderfile,
+                                       const std::vector<std::string>& features,
+                                       const std::vector<std::string>& defines) {
+    create(vertexshaderfile, fragmentshaderfile, features, defines);
+}
+
+void ShaderPermutations::create(const std::string& vertexshaderfile,
+                                const std::string& fragmentshaderfile,
+                                const std::vector<std::string>& features,
+                                const std::vector<std::string>& defines) {
+    clear();
+    vertexFile_ = vertexshaderfile;
+    fragmentFile_ = fragmentshaderfile;
+    features_ = features;
+    defines_ = defines;
+    if (features_.size() > 32) {
+        std::cerr << "Only the first 32 of " << features_.size() << " shader features are used ('"
+                  << fragmentshaderfile << "')\n";
+        features_.resize(32);
+    }
+}
+
+uint32_t ShaderPermutations::feature(const std::string& name) const {
+    for (size_t i = 0; i < features_.size(); ++i) {
+        if (features_[i] == name) {
+            return uint32_t(1) << i;
+        }
+    }
+    return 0;
+}
+
+const Shader& ShaderPermutations::get(uint32_t features) {
+    Shader& shader = program(features, false);
+    shader.wait();
+    return shader;
+}
+
+const Shader& ShaderPermutations::get(uint32_t features, const Shader& fallback) {
+    Shader& shader = program(features, true);
+    if (shader.isReady()) {
+        return shader;
+    }
+    ++stats_.fallbacks;
+    return fallback;
+}
+
+void ShaderPermutations::prepare(uint32_t features) { program(features, true); }
+
+Shader& ShaderPermutations::program(uint32_t features, bool async) {
+    if (features_.size() < 32) {
+        features &= (uint32_t(1) << features_.size()) - 1;
+    }
+    std::unique_ptr<Shader>& entry = programs_[features];
+    if (entry) {
+        ++stats_.hits;
+        return *entry;
+    }
+
+    // Every feature is defined, as 0 or 1, so that shaders can default the ones
+    // not defined with #ifndef when they are compiled without this cache
+    std::vector<std::string> defines = defines_;
+    for (size_t i = 0; i < features_.size(); ++i) {
+        defines.push_back(features_[i] + ((features >> i) & 1 ? " 1" : " 0"));
+    }
+    entry = std::make_unique<Shader>();
+    if (async) {
+        entry->createShaderAsync(vertexFile_, fragmentFile_, defines);
+    } else {
+        entry->createShader(vertexFile_, fragmentFile_, defines);
+    }
+    ++stats_.builds;
+    return *entry;
+}
+
+void ShaderPermutations::clear() { programs_.clear(); }
@@ -0,0 +1,91 @@
+/*
+ * A cache of specialized variants of one shader program, compiled for the
+ * combinations of optional features that are actually drawn with.
+ *
+ * Usage: construct with the vertex and fragment shader files and the names of up
+ *        to 32 features. Feature i is bit i of a mask, and get() returns the
+ *        program compiled with "#define NAME 1" for every feature in the mask and
+ *        "#define NAME 0" for the others, which the shaders test with "#if NAME":
+ *
+ *            ShaderPermutations lit("vertex.glsl", "fragment.glsl",
+ *                                   {"TEXTURED", "SPECULAR"});
+ *            const uint32_t textured = lit.feature("TEXTURED");
+ *            lit.get(textured).use();  // Textured and diffuse only
+ *
+ * A program is built the first time its mask is asked for, and kept until clear()
+ * or the destructor. Features an object does not need are left out of its program,
+ * instead of being branched around or computed and thrown away in every pixel.
+ * Only the combinations drawn with are compiled, and with the binary cache of
+ * Shader (Shader::setBinaryCacheDirectory()) later runs load them from disk.
+ *
+ * get() with a fallback program does not wait for the compiler: a program not built
+ * yet is started with Shader::createShaderAsync() and the fallback is returned
+ * until it is ready, so that frames go on being drawn, with the fallback, while
+ * it compiles. prepare() starts programs before they are drawn with.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include "Shader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderPermutations {
+public:
+    ShaderPermutations() = default;
+    ShaderPermutations(const std::string& vertexshaderfile, const std::string& fragmentshaderfile,
+                       const std::vector<std::string>& features,
+                       const std::vector<std::string>& defines = {});
+
+    ShaderPermutations(const ShaderPermutations&) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+    // Set the files and features, deleting the programs built for the previous ones.
+    // 'defines' are macros ("NAME" or "NAME VALUE") defined in every program.
+    void create(const std::string& vertexshaderfile, const std::string& fragmentshaderfile,
+                const std::vector<std::string>& features,
+                const std::vector<std::string>& defines = {});
+
+    // The bit of a feature, 0 if there is no feature with the name
+    uint32_t feature(const std::string& name) const;
+
+    // The program with the features in the mask, built now if it was not before.
+    // Bits above the last feature are ignored.
+    const Shader& get(uint32_t features);
+
+    // The same without waiting: 'fallback' while the program is compiling
+    const Shader& get(uint32_t features, const Shader& fallback);
+
+    // Start compiling the program with the features in the mask in the background
+    void prepare(uint32_t features);
+
+    // Delete all programs, to build them again from changed files
+    void clear();
+
+    // The number of programs built
+    size_t size() const { return programs_.size(); }
+
+    struct Stats {
+        size_t builds = 0;     // get() or prepare() calls which built a program
+        size_t hits = 0;       // get() calls which found it built
+        size_t fallbacks = 0;  // get() calls which returned the fallback
+    };
+    const Stats& stats() const { return stats_; }
+
+private:
+    // The program for the mask, created now if needed, in the background if 'async'
+    Shader& program(uint32_t features, bool async);
+
+    std::string vertexFile_;
+    std::string fragmentFile_;
+    std::vector<std::string> features_;
+    std::vector<std::string> defines_;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> programs_;  // By mask
+    Stats stats_;
+};
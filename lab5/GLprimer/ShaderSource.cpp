@@ -0,0 +1,178 @@
+/*
+ * GLSL preprocessing: #include and macros defined by the program.
+ *
+ * This code is in the public domain.
+ */
+#include "ShaderSource.hpp"
+#include "Shader.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+namespace {
+
+enum class Directive { None, Version, Include };
+
+size_t skipSpace(const std::string& line, size_t i) {
+    while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) {
+        ++i;
+    }
+    return i;
+}
+
+/*
+ * The directive on a line, if it is #version or #include. For #include, 'name' is
+ * set to the file name between the quotes, or left empty if there is none.
+ */
+Directive parseLine(const std::string& line, std::string& name) {
+    size_t i = skipSpace(line, 0);
+    if (i == line.size() || line[i] != '#') {
+        return Directive::None;
+    }
+    i = skipSpace(line, i + 1);
+    if (line.compare(i, 7, "version") == 0) {
+        return Directive::Version;
+    }
+    if (line.compare(i, 7, "include") != 0) {
+        return Directive::None;
+    }
+    name.clear();
+    i = skipSpace(line, i + 7);
+    if (i < line.size() && (line[i] == '"' || line[i] == '<')) {
+        const char close = line[i] == '"' ? '"' : '>';
+        const size_t end = line.find(close, i + 1);
+        if (end != std::string::npos) {
+            name = line.substr(i + 1, end - i - 1);
+        }
+    }
+    return Directive::Include;
+}
+
+// Splits a file into lines, without their line endings
+std::vector<std::string> splitLines(std::string text) {
+    // readFile() adds a terminating null character
+    while (!text.empty() && text.back() == '\0') {
+        text.pop_back();
+    }
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        size_t length = end - begin;
+        if (length > 0 && text[begin + length - 1] == '\r') {
+            --length;
+        }
+        lines.push_back(text.substr(begin, length));
+        begin = end + 1;
+    }
+    return lines;
+}
+
+struct Preprocessor {
+    ShaderSource& source;
+    std::string defines;                // The #define lines
+    std::vector<std::string> included;  // Absolute paths of the files included so far
+
+    /*
+     * Append the file to the text as source string 'index', with its includes.
+     * Returns false, after printing why, on errors.
+     */
+    bool append(const std::filesystem::path& path, int index) {
+        const std::string contents = readFile(path.string());
+        if (contents.empty()) {
+            return false;
+        }
+        const std::vector<std::string> lines = splitLines(contents);
+        const std::string fileNumber = std::to_string(index);
+
+        // The macros go after #version in the shader file, or before everything if
+        // it has none
+        size_t definesAfter = 0;
+        if (index == 0 && !defines.empty()) {
+            std::string name;
+            for (size_t i = 0; i < lines.size(); ++i) {
+                if (parseLine(lines[i], name) == Directive::Version) {
+                    definesAfter = i + 1;
+                    break;
+                }
+            }
+            if (definesAfter == 0) {
+                source.text += defines + "#line 1 0\n";
+            }
+        }
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            const std::string lineNumber = std::to_string(i + 2);  // Of the next line
+            std::string name;
+            if (parseLine(lines[i], name) != Directive::Include) {
+                source.text += lines[i];
+                source.text += '\n';
+                if (index == 0 && i + 1 == definesAfter) {
+                    source.text += defines + "#line " + lineNumber + " 0\n";
+                }
+                continue;
+            }
+            if (name.empty()) {
+                std::cerr << "Error: Malformed #include on line " << i + 1 << " ('"
+                          << path.string() << "')\n";
+                return false;
+            }
+
+            const std::filesystem::path includePath =
+                (path.parent_path() / name).lexically_normal();
+            std::error_code error;
+            const std::string absolute =
+                std::filesystem::absolute(includePath, error).lexically_normal().string();
+            if (std::find(included.begin(), included.end(), absolute) != included.end()) {
+                source.text += '\n';  // Already included, possibly by itself
+                continue;
+            }
+            included.push_back(absolute);
+
+            const int includeIndex = static_cast<int>(source.files.size());
+            source.files.push_back(includePath.string());
+            source.text += "#line 1 " + std::to_string(includeIndex) + "\n";
+            if (!append(includePath, includeIndex)) {
+                std::cerr << "Error: Could not include '" << name << "' on line " << i + 1
+                          << " ('" << path.string() << "')\n";
+                return false;
+            }
+            source.text += "#line " + lineNumber + " " + fileNumber + "\n";
+        }
+        return true;
+    }
+};
+
+}  // namespace
+
+ShaderSource preprocessShader(const std::string& filename,
+                              const std::vector<std::string>& defines) {
+    ShaderSource source;
+    source.files.push_back(filename);
+
+    Preprocessor preprocessor{source, {}, {}};
+    for (const std::string& define : defines) {
+        preprocessor.defines += "#define " + define + "\n";
+    }
+    std::error_code error;
+    preprocessor.included.push_back(
+        std::filesystem::absolute(filename, error).lexically_normal().string());
+
+    if (!preprocessor.append(filename, 0)) {
+        source.text.clear();
+    }
+    return source;
+}
+
+std::string sourceFileList(const ShaderSource& source) {
+    std::string list;
+    for (size_t i = 0; i < source.files.size(); ++i) {
+        list += (i > 0 ? ", " : "") + std::to_string(i) + " '" + source.files[i] + "'";
+    }
+    return list;
+}
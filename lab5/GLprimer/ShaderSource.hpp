@@ -0,0 +1,40 @@
+/*
+ * Preprocessing of GLSL shader files before they are compiled: #include of other
+ * files and macros defined by the program.
+ *
+ * Usage: call preprocessShader() with a shader file and a list of macros, each a
+ *        name or a name and a value ("SPECULAR", "LIGHTS 4"), and pass the text
+ *        to glShaderSource(). Shader::createShader() does this for its files.
+ *
+ * GLSL has no #include, so the lines
+ *
+ *     #include "lighting.glsl"
+ *
+ * are replaced here by the contents of the files, which are found relative to the
+ * file including them. Every file is included at most once per shader, as if it
+ * began with "#pragma once", which also stops include cycles. Includes are
+ * replaced before the GLSL compiler sees the text, so also inside #if blocks.
+ * The macros are defined right after the #version line, which must come first.
+ * #line directives keep the line numbers of compiler messages right, with the
+ * number of the file in 'files' as the source string number: "1:12(5): error"
+ * is line 12 of files[1].
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct ShaderSource {
+    std::string text;                // Empty on errors
+    std::vector<std::string> files;  // By source string number, the shader file first
+};
+
+// Read a shader file and the files it includes, with the macros 'defines' defined.
+// Errors are printed, and leave the text empty.
+ShaderSource preprocessShader(const std::string& filename,
+                              const std::vector<std::string>& defines = {});
+
+// The files as a list of source string numbers and names, for compiler messages
+std::string sourceFileList(const ShaderSource& source);
@@ -0,0 +1,68 @@
+/*
+ * A shader storage buffer for compute programs.
+ *
+ * This code is in the public domain.
+ */
+#include <GL/glew.h>
+
+#include "StorageBuffer.hpp"
+#include "Shader.hpp"
+
+#include <iostream>
+
+StorageBuffer::StorageBuffer() : bufferID_(0), size_(0) {}
+
+StorageBuffer::~StorageBuffer() {
+    if (bufferID_ != 0) {
+        glDeleteBuffers(1, &bufferID_);
+    }
+}
+
+bool StorageBuffer::create(size_t size, const void* data, GLenum usage) {
+    if (!GLEW_ARB_shader_storage_buffer_object) {
+        std::cerr << "Storage buffers need OpenGL 4.3 or GL_ARB_shader_storage_buffer_object\n";
+        return false;
+    }
+    if (bufferID_ == 0) {
+        glGenBuffers(1, &bufferID_);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferID_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(size), data, usage);
+    if (!data) {
+        // glBufferData() leaves the contents undefined
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R8, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    size_ = size;
+    return true;
+}
+
+void StorageBuffer::upload(const void* data, size_t size, size_t offset) {
+    if (bufferID_ == 0 || offset + size > size_) {
+        return;
+    }
+    Shader::memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferID_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(offset),
+                    static_cast<GLsizeiptr>(size), data);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    ++stats_.uploads;
+    stats_.bytesUploaded += size;
+}
+
+void StorageBuffer::download(void* data, size_t size, size_t offset) const {
+    if (bufferID_ == 0 || offset + size > size_) {
+        return;
+    }
+    Shader::memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferID_);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(offset),
+                       static_cast<GLsizeiptr>(size), data);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    ++stats_.downloads;
+    stats_.bytesDownloaded += size;
+}
+
+void StorageBuffer::bind(GLuint binding) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, bufferID_);
+}
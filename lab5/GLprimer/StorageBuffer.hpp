@@ -0,0 +1,65 @@
+/*
+ * A shader storage buffer, which compute programs read and write as the arrays of
+ * their "buffer" blocks, and which can be drawn from as a vertex buffer too.
+ *
+ * Usage: create() the buffer with its size and, optionally, its contents, bind() it
+ *        to the binding point of a block (layout(binding = N) or
+ *        Shader::bindStorageBlock()) and dispatch a compute program:
+ *
+ *            StorageBuffer particles;
+ *            particles.create(sizeof(Particle) * count, initial.data());
+ *            particles.bind(0);
+ *            update.dispatchThreads(count);
+ *            Shader::memoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+ *            glBindBuffer(GL_ARRAY_BUFFER, particles.id());  // Draw from it
+ *
+ * upload() and download() copy to and from memory, and wait for the writes of the
+ * compute programs dispatched before (Shader::memoryBarrier()). download() waits
+ * for the GPU to finish them, so keep it out of the rendering loop.
+ *
+ * Buffers need OpenGL 4.3 or GL_ARB_shader_storage_buffer_object.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <cstddef>
+
+class StorageBuffer {
+public:
+    StorageBuffer();
+    ~StorageBuffer();
+
+    StorageBuffer(const StorageBuffer&) = delete;
+    StorageBuffer& operator=(const StorageBuffer&) = delete;
+
+    // Create the buffer with 'size' bytes from 'data', or all zeros if it is nullptr.
+    // 'usage' is a hint for glBufferData(), GL_DYNAMIC_COPY for data which stays on
+    // the GPU. Returns false, after printing why, if the driver has no storage buffers.
+    bool create(size_t size, const void* data = nullptr, GLenum usage = GL_DYNAMIC_COPY);
+
+    // Copy 'size' bytes from 'data' to 'offset' in the buffer
+    void upload(const void* data, size_t size, size_t offset = 0);
+    // Copy 'size' bytes from 'offset' in the buffer to 'data', waiting for the GPU
+    void download(void* data, size_t size, size_t offset = 0) const;
+
+    // Bind the buffer to the shader storage buffer binding point 'binding'
+    void bind(GLuint binding) const;
+
+    GLuint id() const { return bufferID_; }
+    size_t size() const { return size_; }
+
+    struct Stats {
+        size_t uploads = 0;          // glBufferSubData() calls
+        size_t bytesUploaded = 0;    // By those calls
+        size_t downloads = 0;        // glGetBufferSubData() calls
+        size_t bytesDownloaded = 0;  // By those calls
+    };
+    const Stats& stats() const { return stats_; }
+
+private:
+    GLuint bufferID_;
+    size_t size_;
+    mutable Stats stats_;
+};
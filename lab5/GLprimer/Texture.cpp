@@ -1,5 +1,5 @@
 /*
- * OpenGL texture, and load texture data from a TGA file.
+ * OpenGL texture, and load texture data from a TGA, PNG or JPEG file.
  *
  * Authors: Stefan Gustavson (stegu@itn.liu.se) 2014
  *          Martin Falk (martin.falk@liu.se) 2021
@@ -7,18 +7,27 @@
  * This code is in the public domain.
  */
 #include <cstdio>   // For file I/O
-#include <cstring>  // For memcmp()
+#include <cstring>  // For memcpy()
 #include <iostream>
-#include <fstream>
 #include <algorithm>
 #include <array>
 
 #include <GL/glew.h>
 
 #include "Texture.hpp"
+#include "BlockCompress.hpp"
+#include "ImageCodec.hpp"
+#include "MappedFile.hpp"
+#include "MipChain.hpp"
+#include "Noise.hpp"
+#include "TextureContainer.hpp"
 
 /* Constructor to load and intialize the texture all at once */
-Texture::Texture(const std::string& filename) : textureID_(0) { createTexture(filename); }
+Texture::Texture(const std::string& filename) : textureID_(0), internalFormat_(0), numLevels_(0) {
+    if (!filename.empty()) {
+        createTexture(filename);
+    }
+}
 
 /* Destructor */
 Texture::~Texture() {
@@ -35,130 +44,615 @@ GLuint Texture::height() const { return image_.height; }
 
 GLuint Texture::type() const { return image_.type; }
 
-/*
- * Open and test the file to make sure it is a valid TGA file
- *
- * roughly based on NeHe's TGA loading code
- */
-Texture::ImageData Texture::loadUncompressedTGA(const std::string& filename) const {
-    std::ifstream in(filename, std::ios_base::in | std::ios_base::binary);
+GLuint Texture::numLevels() const { return numLevels_; }
 
-    if (!in.is_open()) {
-        std::cerr << "Could not open texture file ('" << filename << "')\n";
-        return {};  // return an empty image
+bool Texture::bindImage(GLuint unit, GLenum access, GLuint level) const {
+    if (internalFormat_ != GL_RGBA8) {
+        std::cerr << "Texture " << textureID_ << " of format 0x" << std::hex << internalFormat_
+                  << std::dec << " can not be bound as an RGBA image\n";
+        return false;
     }
+    if (level >= numLevels_) {
+        std::cerr << "Texture " << textureID_ << " has no mipmap level " << level << "\n";
+        return false;
+    }
+    glBindImageTexture(unit, textureID_, static_cast<GLint>(level), GL_FALSE, 0, access,
+                       GL_RGBA8);
+    return true;
+}
+
+size_t Texture::memorySize() const {
+    // Uncompressed textures are stored as GL_RGBA8, 4 bytes per pixel also for RGB.
+    // The 4 x 4 blocks of BC1 and BC4 take 8 bytes, those of the others 16.
+    const bool compressed = internalFormat_ != GL_RGBA8;
+    const size_t blockBytes = internalFormat_ == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ||
+                                      internalFormat_ == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ||
+                                      internalFormat_ == GL_COMPRESSED_RED_RGTC1
+                                  ? 8
+                                  : 16;
+    size_t bytes = 0;
+    for (GLuint i = 0; i < numLevels_; ++i) {
+        const size_t width = std::max(1u, image_.width >> i);
+        const size_t height = std::max(1u, image_.height >> i);
+        if (compressed) {
+            bytes += (width + 3) / 4 * ((height + 3) / 4) * blockBytes;
+        } else {
+            bytes += width * height * 4;
+        }
+    }
+    return bytes;
+}
+
+namespace {
 
-    // Attempt to read 12 byte file header
-    std::array<char, 12> tgaheader;
+// See Texture::setCompression()
+Texture::Compression textureCompression = Texture::Compression::None;
 
-    in.read(tgaheader.data(), sizeof(tgaheader));
-    if (in.fail()) {
+// Where the pixels are in a TGA file, and how they are stored
+struct TGALayout {
+    GLuint width = 0;
+    GLuint height = 0;
+    GLuint type = 0;    // GL_RGB or GL_RGBA
+    GLuint format = 0;  // GL_BGR or GL_BGRA, the byte order in the file
+    GLuint bytesPerPixel = 0;
+    bool rle = false;   // Run length encoded
+    size_t offset = 0;  // Start of the pixel data
+    size_t size = 0;    // Size of the decoded pixel data in bytes
+};
+
+/*
+ * Test the file contents to make sure it is a valid TGA file
+ *
+ * roughly based on NeHe's TGA loading code
+ */
+bool parseTGAHeader(const MappedFile& file, const std::string& filename, TGALayout& layout) {
+    // The 18 byte header. Byte 0 is the length of the image ID following it,
+    // byte 1 tells if there is a color map and byte 2 is the image type.
+    const size_t headerSize = 18;
+    if (file.size() < headerSize) {
         std::cerr << "Could not read file header ('" << filename << "')\n";
-        return {};  // return an empty image
+        return false;
     }
+    const GLubyte* tgaheader = file.data();
 
-    // headers for compressed and uncompressed TGAs
-    const std::array<char, 12> uncompressedTGA = {{0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
-    const std::array<char, 12> compressedTGA = {{0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+    // Image types for uncompressed and RLE compressed true-color TGAs
+    const GLubyte uncompressedTGA = 2;
+    const GLubyte compressedTGA = 10;
 
-    if (tgaheader == compressedTGA) {
-        std::cerr << "RLE compressed TGA files are not supported ('" << filename << "')\n";
-        return {};
-    } else if (tgaheader != uncompressedTGA) {
+    if (tgaheader[1] != 0 ||
+        (tgaheader[2] != uncompressedTGA && tgaheader[2] != compressedTGA)) {
         std::cerr << "Unsupported image file format ('" << filename << "')\n";
-        return {};
-    }
-
-    std::array<GLubyte, 6> header;  // First 6 useful bytes from the header
-    // std::ifstream::read() only reads 'char', thus we need a type cast for tga.header
-    in.read(reinterpret_cast<char*>(header.data()), sizeof(header));
-    if (in.fail()) {
-        std::cerr << "Could not read TGA header ('" << filename << "')\n";
-        return {};
+        return false;
     }
+    layout.rle = tgaheader[2] == compressedTGA;
 
-    ImageData image;
+    const GLubyte* header = tgaheader + 12;  // The 6 useful bytes at the end of the header
 
     // Determine the TGA width (highbyte*256 + lowbyte)
-    image.width = header[1] * 256 + header[0];
+    layout.width = header[1] * 256 + header[0];
     // Determine the TGA height	(highbyte*256 + lowbyte)
-    image.height = header[3] * 256 + header[2];
+    layout.height = header[3] * 256 + header[2];
 
     // Make sure all information is valid
-    if ((image.width <= 0) || (image.height <= 0)) {
+    if ((layout.width <= 0) || (layout.height <= 0)) {
         std::cerr << "Invalid image dimensions ('" << filename << "')\n";
-        return {};
+        return false;
     }
 
     // Determine the bits per pixel
     const GLuint bpp = header[4];
     // Compute the number of BYTES per pixel
-    const GLuint bytesPerPixel = (bpp / 8);
-    // Compute the total amount of memory needed
-    const GLuint imageSize = (bytesPerPixel * image.width * image.height);
+    layout.bytesPerPixel = (bpp / 8);
 
+    // The pixels are kept in the BGR(A) byte order of the file. OpenGL reorders
+    // them during the upload, so there is no need to swap the bytes here.
     switch (bpp) {
         case 24:
-            image.type = GL_RGB;
+            layout.type = GL_RGB;
+            layout.format = GL_BGR;
             std::cout << "Texture type is GL_RGB ('" << filename << "')\n";
             break;
         case 32:
-            image.type = GL_RGBA;
-            std::cout << "Texture type is GL_RGB ('" << filename << "')\n";
+            layout.type = GL_RGBA;
+            layout.format = GL_BGRA;
+            std::cout << "Texture type is GL_RGBA ('" << filename << "')\n";
             break;
         default:
             std::cerr << "Unsupported number of bits per pixel (" << bpp << ") ('" << filename
                       << "')\n";
-            return {};
+            return false;
     }
 
-    image.data.resize(imageSize);  // Allocate memory for image data
+    // Compute the total amount of memory needed
+    layout.offset = headerSize + tgaheader[0];  // Skip the image ID
+    layout.size = size_t(layout.bytesPerPixel) * layout.width * layout.height;
+    if (file.size() < layout.offset || (!layout.rle && file.size() - layout.offset < layout.size)) {
+        std::cerr << "Could not read image data ('" << filename << "')\n";
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Decode run length encoded pixels into 'out', which has room for 'numPixels'
+ * pixels. Every packet starts with a byte: the low 7 bits are the number of
+ * pixels minus one, and the high bit is set for a run of one repeated pixel,
+ * which follows, or clear for raw pixels, which follow. Packets may continue
+ * across rows. Returns false if the data ends early.
+ */
+template <size_t BytesPerPixel>
+bool decodeRLE(const GLubyte* in, const GLubyte* end, GLubyte* out, size_t numPixels) {
+    GLubyte* const outEnd = out + numPixels * BytesPerPixel;
+    // A packet holds at most 128 pixels. While this much input and output is left,
+    // raw packets are copied in whole 16 byte chunks (some bytes are written twice
+    // or read past the packet) and runs are filled 4 pixels at a time, which avoids
+    // calls to memcpy() with a variable size and loops over every byte.
+    const size_t maxPacket = 128 * BytesPerPixel + 16;
+    while (out < outEnd) {
+        const size_t outLeft = static_cast<size_t>(outEnd - out);
+        const size_t inLeft = static_cast<size_t>(end - in);
+        if (inLeft == 0) {
+            return false;
+        }
+        const GLubyte packet = *in++;
+        // Never write past the image, even if the last packet is too long
+        const size_t count = std::min<size_t>((packet & 0x7f) + 1, outLeft / BytesPerPixel);
+        const bool fast = outLeft >= maxPacket && inLeft > maxPacket;
+        if (packet & 0x80) {
+            if (inLeft - 1 < BytesPerPixel) {
+                return false;
+            }
+            GLubyte pixels[4 * BytesPerPixel];
+            for (size_t i = 0; i < 4; ++i) {
+                std::memcpy(pixels + i * BytesPerPixel, in, BytesPerPixel);
+            }
+            in += BytesPerPixel;
+            if (fast) {
+                for (size_t i = 0; i < count; i += 4) {
+                    std::memcpy(out + i * BytesPerPixel, pixels, sizeof(pixels));
+                }
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    std::memcpy(out + i * BytesPerPixel, pixels, BytesPerPixel);
+                }
+            }
+            out += count * BytesPerPixel;
+        } else {
+            const size_t bytes = count * BytesPerPixel;
+            if (inLeft - 1 < bytes) {
+                return false;
+            }
+            if (fast) {
+                for (size_t i = 0; i < bytes; i += 16) {
+                    std::memcpy(out + i, in + i, 16);
+                }
+            } else {
+                std::memcpy(out, in, bytes);
+            }
+            in += bytes;
+            out += bytes;
+        }
+    }
+    return true;
+}
 
-    // Attempt to read image data
-    // std::ifstream::read() only reads 'char', thus we need a type cast for tga.header
-    in.read(reinterpret_cast<char*>(image.data.data()), imageSize);
-    if (in.gcount() != imageSize) {
+/*
+ * Decode the pixels of a TGA file into 'out', which has room for 'layout.size' bytes
+ */
+bool decodeTGA(const MappedFile& file, const TGALayout& layout, const std::string& filename,
+               GLubyte* out) {
+    const GLubyte* in = file.data() + layout.offset;
+    const GLubyte* end = file.data() + file.size();
+    const size_t numPixels = size_t(layout.width) * layout.height;
+    bool ok;
+    if (!layout.rle) {
+        std::memcpy(out, in, layout.size);
+        ok = true;
+    } else if (layout.bytesPerPixel == 3) {
+        ok = decodeRLE<3>(in, end, out, numPixels);
+    } else {
+        ok = decodeRLE<4>(in, end, out, numPixels);
+    }
+    if (!ok) {
         std::cerr << "Could not read image data ('" << filename << "')\n";
-        return {};
     }
+    return ok;
+}
 
-    // Swap the BGR(A) byte order in the TGA file to the standard RGB(A) byte order for OpenGL.
-    for (size_t cswap = 0; cswap < imageSize; cswap += bytesPerPixel) {
-        std::swap(image.data[cswap], image.data[cswap + 2]);
+/*
+ * The mipmap levels below the base level, filtered on the CPU or read from the mip cache
+ */
+std::vector<MipLevel> mipLevels(const std::string& filename, const GLubyte* pixels, GLuint width,
+                                GLuint height, GLuint channels) {
+    std::vector<MipLevel> mipmaps;
+    if (!readMipCache(filename, width, height, channels, mipmaps)) {
+        mipmaps = buildMipChain(pixels, width, height, channels);
+        writeMipCache(filename, width, height, channels, mipmaps);
     }
+    return mipmaps;
+}
+
+// True if createTexture() block compresses images, with the format for 'channels'
+bool useCompression(GLuint channels, BlockFormat& format) {
+    format = channels == 4 ? BlockFormat::BC3 : BlockFormat::BC1;
+    return textureCompression != Texture::Compression::None && GLEW_EXT_texture_compression_s3tc;
+}
 
+/*
+ * All levels, the base level too, block compressed or read from the mip cache
+ */
+std::vector<MipLevel> compressedLevels(const std::string& filename, const GLubyte* pixels,
+                                       GLuint width, GLuint height, GLuint channels,
+                                       BlockFormat format) {
+    const BlockQuality quality =
+        textureCompression == Texture::Compression::High ? BlockQuality::High : BlockQuality::Fast;
+    // Cached separately from the uncompressed levels, and for each quality
+    const uint32_t encoding =
+        blockFormatGL(format) | (quality == BlockQuality::High ? 0x10000u : 0u);
+
+    std::vector<MipLevel> levels;
+    if (!readMipCache(filename, width, height, channels, levels, encoding)) {
+        const std::vector<MipLevel> mipmaps = mipLevels(filename, pixels, width, height, channels);
+        levels.resize(mipmaps.size() + 1);
+        levels[0].width = width;
+        levels[0].height = height;
+        levels[0].data = compressBlocks(pixels, width, height, channels, format, quality);
+        for (size_t i = 0; i < mipmaps.size(); ++i) {
+            levels[i + 1].width = mipmaps[i].width;
+            levels[i + 1].height = mipmaps[i].height;
+            levels[i + 1].data = compressBlocks(mipmaps[i].data.data(), mipmaps[i].width,
+                                                mipmaps[i].height, channels, format, quality);
+        }
+        writeMipCache(filename, width, height, channels, levels, encoding);
+    }
+    return levels;
+}
+
+}  // namespace
+
+/*
+ * Load an uncompressed or RLE compressed TGA file into memory
+ */
+Texture::ImageData Texture::loadTGA(const std::string& filename) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Could not open texture file ('" << filename << "')\n";
+        return {};  // return an empty image
+    }
+
+    TGALayout layout;
+    if (!parseTGAHeader(file, filename, layout)) {
+        return {};
+    }
+
+    ImageData image;
+    image.width = layout.width;
+    image.height = layout.height;
+    image.type = layout.type;
+    image.format = layout.format;
+    image.data.resize(layout.size);  // The final buffer, decoded into directly
+    if (!decodeTGA(file, layout, filename, image.data.data())) {
+        return {};
+    }
     return image;
 }
 
 /*
- * Load and activate a 2D texture from a TGA file
+ * Find the pixels of an uncompressed TGA file in its memory mapping
+ */
+const GLubyte* Texture::mapTGA(const MappedFile& file, const std::string& filename,
+                               ImageData& image) {
+    TGALayout layout;
+    if (!parseTGAHeader(file, filename, layout)) {
+        return nullptr;
+    }
+    if (layout.rle) {
+        std::cerr << "RLE compressed TGA files can not be mapped ('" << filename << "')\n";
+        return nullptr;
+    }
+    image = ImageData();
+    image.width = layout.width;
+    image.height = layout.height;
+    image.type = layout.type;
+    image.format = layout.format;
+    return file.data() + layout.offset;
+}
+
+/*
+ * Load and activate a 2D texture from a TGA file, or any format with an image codec
+ */
+void Texture::createTexture(const std::string& filename, GLuint skipLevels) {
+    if (skipLevels > 0) {
+        createReducedTexture(filename, skipLevels);
+        return;
+    }
+
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Could not open texture file ('" << filename << "')\n";
+        return;
+    }
+
+    // DDS and KTX2 files already hold every level in a format OpenGL takes as it is,
+    // they are uploaded straight from the mapped file
+    if (isTextureContainer(file)) {
+        ContainerInfo info;
+        if (!parseTextureContainer(file, filename, info)) {
+            return;
+        }
+        setImage(info);
+        bindNewTexture(textureID_);
+        uploadLevels(info, file.data());
+        return;
+    }
+
+    // Other formats, such as PNG and JPEG, are decoded into a temporary buffer in the
+    // same layout as TGA files
+    const GLubyte* pixels = nullptr;
+    std::vector<GLubyte> decoded;
+    GLuint channels = 0;
+    if (const ImageCodec* codec = findImageCodec(file.data(), file.size())) {
+        DecodedImage image;
+        if (!codec->decode(file.data(), file.size(), filename, image)) {
+            return;
+        }
+        image_ = ImageData();
+        image_.width = image.width;
+        image_.height = image.height;
+        image_.type = image.channels == 4 ? GL_RGBA : GL_RGB;
+        image_.format = image.channels == 4 ? GL_BGRA : GL_BGR;
+        channels = image.channels;
+        decoded = std::move(image.pixels);
+        pixels = decoded.data();
+    } else {
+        TGALayout layout;
+        if (!parseTGAHeader(file, filename, layout)) {
+            return;
+        }
+        image_ = ImageData();
+        image_.width = layout.width;
+        image_.height = layout.height;
+        image_.type = layout.type;
+        image_.format = layout.format;
+        channels = layout.bytesPerPixel;
+
+        // Uncompressed pixels are uploaded straight from the mapped file, without
+        // copying them first. RLE compressed pixels are decoded into a temporary buffer.
+        pixels = file.data() + layout.offset;
+        if (layout.rle) {
+            decoded.resize(layout.size);
+            if (!decodeTGA(file, layout, filename, decoded.data())) {
+                return;
+            }
+            pixels = decoded.data();
+        }
+    }
+
+    uploadImage(filename, pixels, channels);
+}
+
+/*
+ * Create a 2D texture from pixels in memory, in the layout of an uncompressed TGA file
+ */
+void Texture::createTexture(const GLubyte* pixels, GLuint width, GLuint height,
+                            GLuint channels) {
+    image_ = ImageData();
+    image_.width = width;
+    image_.height = height;
+    image_.type = channels == 4 ? GL_RGBA : GL_RGB;
+    image_.format = channels == 4 ? GL_BGRA : GL_BGR;
+    uploadImage("", pixels, channels);
+}
+
+/*
+ * Create a 2D texture of procedural noise
  */
-void Texture::createTexture(const std::string& filename) {
-    image_ = loadUncompressedTGA(filename);
+void Texture::createNoiseTexture(const NoiseSettings& settings) {
+    const std::vector<GLubyte> pixels = generateNoise(settings);
+    if (pixels.empty()) {
+        std::cerr << "Could not create a noise texture of " << settings.width << " x "
+                  << settings.height << " pixels\n";
+        return;
+    }
+    createTexture(pixels.data(), settings.width, settings.height, 3);
+}
+
+/*
+ * Upload 'pixels', with the size and format in image_, and their mipmap levels
+ */
+void Texture::uploadImage(const std::string& filename, const GLubyte* pixels, GLuint channels) {
+    bindNewTexture(textureID_);
+
+    // Upload the texture data to the GPU, one level at a time.
+    // The rows are tightly packed, without padding.
+    BlockFormat format;
+    if (useCompression(channels, format)) {
+        const std::vector<MipLevel> levels =
+            compressedLevels(filename, pixels, image_.width, image_.height, channels, format);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t i = 0; i < levels.size(); ++i) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), blockFormatGL(format),
+                                   levels[i].width, levels[i].height, 0,
+                                   static_cast<GLsizei>(levels[i].data.size()),
+                                   levels[i].data.data());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size() - 1));
+        internalFormat_ = blockFormatGL(format);
+        numLevels_ = static_cast<GLuint>(levels.size());
+    } else {
+        if (textureCompression != Compression::None) {
+            std::cerr << "Block compressed textures are not supported, using GL_RGBA8 ('"
+                      << filename << "')\n";
+        }
+        const std::vector<MipLevel> mipmaps =
+            mipLevels(filename, pixels, image_.width, image_.height, channels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image_.width, image_.height, 0, image_.format,
+                     GL_UNSIGNED_BYTE, pixels);
+        for (size_t i = 0; i < mipmaps.size(); ++i) {
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1), GL_RGBA8, mipmaps[i].width,
+                         mipmaps[i].height, 0, image_.format, GL_UNSIGNED_BYTE,
+                         mipmaps[i].data.data());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(mipmaps.size()));
+        internalFormat_ = GL_RGBA8;
+        numLevels_ = static_cast<GLuint>(mipmaps.size() + 1);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
 
-    if (image_.data.empty()) {
+/*
+ * Load a texture without its largest levels, through loadLevels()
+ */
+void Texture::createReducedTexture(const std::string& filename, GLuint skipLevels) {
+    ContainerInfo info;
+    std::vector<MipLevel> levels;
+    if (!loadLevels(filename, info, levels)) {
         return;
     }
+    const size_t skip = std::min<size_t>(skipLevels, levels.size() - 1);
+    info.levels.erase(info.levels.begin(), info.levels.begin() + skip);
+    levels.erase(levels.begin(), levels.begin() + skip);
 
-    if (textureID_ == 0) {
-        glGenTextures(1, &textureID_);  // Create the texture ID if it does not exist
+    std::vector<GLubyte> packed;
+    for (size_t i = 0; i < levels.size(); ++i) {
+        info.levels[i].offset = packed.size();
+        packed.insert(packed.end(), levels[i].data.begin(), levels[i].data.end());
     }
+    setImage(info);
+    bindNewTexture(textureID_);
+    uploadLevels(info, packed.data());
+}
 
-    glBindTexture(GL_TEXTURE_2D, textureID_);
+/*
+ * Decode all levels of a texture file on the CPU, without OpenGL calls
+ */
+bool Texture::loadLevels(const std::string& filename, ContainerInfo& info,
+                         std::vector<MipLevel>& levels) {
+    levels.clear();
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Could not open texture file ('" << filename << "')\n";
+        return false;
+    }
+
+    if (isTextureContainer(file)) {
+        if (!parseTextureContainer(file, filename, info)) {
+            return false;
+        }
+        for (const ContainerLevel& level : info.levels) {
+            MipLevel copy;
+            copy.width = level.width;
+            copy.height = level.height;
+            copy.data.assign(file.data() + level.offset, file.data() + level.offset + level.size);
+            levels.push_back(std::move(copy));
+        }
+        return true;
+    }
+
+    MipLevel base;
+    GLuint channels;
+    GLenum pixelFormat;
+    if (const ImageCodec* codec = findImageCodec(file.data(), file.size())) {
+        DecodedImage image;
+        if (!codec->decode(file.data(), file.size(), filename, image)) {
+            return false;
+        }
+        base.width = image.width;
+        base.height = image.height;
+        base.data = std::move(image.pixels);
+        channels = image.channels;
+        pixelFormat = image.channels == 4 ? GL_BGRA : GL_BGR;
+    } else {
+        TGALayout layout;
+        if (!parseTGAHeader(file, filename, layout)) {
+            return false;
+        }
+        base.width = layout.width;
+        base.height = layout.height;
+        base.data.resize(layout.size);
+        if (!decodeTGA(file, layout, filename, base.data.data())) {
+            return false;
+        }
+        channels = layout.bytesPerPixel;
+        pixelFormat = layout.format;
+    }
+
+    info = ContainerInfo();
+    BlockFormat format;
+    if (useCompression(channels, format)) {
+        info.compressed = true;
+        info.internalFormat = blockFormatGL(format);
+        levels = compressedLevels(filename, base.data.data(), base.width, base.height, channels,
+                                  format);
+    } else {
+        info.internalFormat = GL_RGBA8;
+        info.format = pixelFormat;
+        info.channels = channels;
+        std::vector<MipLevel> mipmaps =
+            mipLevels(filename, base.data.data(), base.width, base.height, channels);
+        levels.push_back(std::move(base));
+        for (MipLevel& mipmap : mipmaps) {
+            levels.push_back(std::move(mipmap));
+        }
+    }
+    for (const MipLevel& level : levels) {
+        ContainerLevel where;
+        where.width = level.width;
+        where.height = level.height;
+        where.size = level.data.size();
+        info.levels.push_back(where);  // The offsets are up to the caller
+    }
+    return true;
+}
+
+void Texture::setCompression(Compression compression) { textureCompression = compression; }
+
+void Texture::bindNewTexture(GLuint& textureID) {
+    if (textureID == 0) {
+        glGenTextures(1, &textureID);  // Create the texture ID if it does not exist
+    }
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
     // Set parameters to determine how the texture is resized
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     // Set parameters to determine how the texture wraps at edges
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // Read the texture data from file and upload it to the GPU
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_.width, image_.height, 0, image_.type,
-                 GL_UNSIGNED_BYTE, image_.data.data());
+    // Show all levels, also of a texture object which was streamed progressively before
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, -1000.0f);
+}
 
-    glEnable(GL_TEXTURE_2D);  // Required for glGenerateMipmap() to work
-    glGenerateMipmap(GL_TEXTURE_2D);
+void Texture::uploadLevels(const ContainerInfo& info, const GLubyte* base) {
+    // Levels missing from the data are left out by limiting the levels OpenGL samples
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < info.levels.size(); ++i) {
+        const ContainerLevel& level = info.levels[i];
+        const GLubyte* data = base + level.offset;
+        if (info.compressed) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), info.internalFormat,
+                                   level.width, level.height, 0, static_cast<GLsizei>(level.size),
+                                   data);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), info.internalFormat, level.width,
+                         level.height, 0, info.format, GL_UNSIGNED_BYTE, data);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                    static_cast<GLint>(info.levels.size() - 1));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
 
-    // Image data was copied to the GPU, release contents of the std::vector
-    // When using clear() the std::vector would still hold on to the memory.
-    image_.data = std::vector<GLubyte>();
+void Texture::setImage(const ContainerInfo& info) {
+    image_ = ImageData();
+    image_.width = info.levels[0].width;
+    image_.height = info.levels[0].height;
+    image_.type = info.channels == 3 || info.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                      ? GL_RGB
+                      : GL_RGBA;
+    image_.format = info.format;
+    internalFormat_ = info.internalFormat;
+    numLevels_ = static_cast<GLuint>(info.levels.size());
 }
@@ -4,8 +4,20 @@
  * Modified, stripped-down and cleaned-up version of the TGA loader from NeHe tutorial 33.
  *
  * Usage: Call createTexture() with a TGA file as argument to load a texture,
- *        or use the constructor with a file name argument. Uncompressed RGB or RGBA only.
+ *        or use the constructor with a file name argument. RGB or RGBA only,
+ *        uncompressed or RLE compressed. PNG and JPEG files, and any other
+ *        format with an image codec (see ImageCodec.hpp), are loaded too. Files
+ *        are told apart by their contents, not by their names.
  *        Call glBindTexture() with the public member textureID as argument.
+ *        All mipmap levels are filtered on the CPU (see MipChain.hpp) and uploaded
+ *        explicitly. Call setMipCacheDirectory() first to keep them on disk.
+ *        Call setCompression() first to store textures block compressed on the GPU
+ *        (see BlockCompress.hpp), which takes a fourth to an eighth of the memory.
+ *        DDS and KTX2 files are loaded too, with the levels they hold (see
+ *        TextureContainer.hpp), which skips all of the above.
+ *        To load textures without stalling the rendering, see TextureStream.hpp.
+ *        createNoiseTexture() makes a texture of procedural noise (see Noise.hpp),
+ *        and createTexture() with pixels uploads any image made in memory.
  *
  * Authors: Stefan Gustavson (stegu@itn.liu.se) 2014
  *          Martin Falk (martin.falk@liu.se) 2021
@@ -15,9 +27,15 @@
 #pragma once
 
 #include <GLFW/glfw3.h>
+#include <cstddef>
 #include <string>
 #include <vector>
 
+class MappedFile;
+struct ContainerInfo;
+struct MipLevel;
+struct NoiseSettings;
+
 class Texture {
 public:
 
@@ -27,8 +45,18 @@ public:
     /* Destructor */
     ~Texture();
 
-    // The external entry point for loading a texture from a TGA file
-    void createTexture(const std::string& filename);  // Load GL texture from file
+    // The external entry point for loading a texture from a TGA, PNG, JPEG, DDS or KTX2 file.
+    // 'skipLevels' leaves out that many of the largest mipmap levels (but not the
+    // smallest), to save memory.
+    void createTexture(const std::string& filename, GLuint skipLevels = 0);
+
+    // Create the texture from 'channels' (3 or 4) bytes per pixel in B, G, R(, A) order,
+    // the bottom row first, as in a TGA file. The mipmaps are made as for files, but
+    // they are not kept in the mip cache.
+    void createTexture(const GLubyte* pixels, GLuint width, GLuint height, GLuint channels);
+
+    // Create a texture of procedural noise, generated in parallel threads
+    void createNoiseTexture(const NoiseSettings& settings);
 
     // returns the OpenGL texture ID
     GLuint id() const;
@@ -39,17 +67,68 @@ public:
     // returns the type of the texture (GL_RGB or GL_RGBA)
     GLuint type() const;
 
-private:
+    // The number of mipmap levels, including the base level
+    GLuint numLevels() const;
+
+    // The estimated GPU memory used by all levels, in bytes
+    size_t memorySize() const;
+
+    // Bind a level to the image unit 'unit' for image load/store in compute shaders,
+    // as a layout(rgba8) image, with 'access' GL_READ_ONLY, GL_WRITE_ONLY or
+    // GL_READ_WRITE. Returns false, after printing why, for textures of other
+    // formats, such as compressed ones, which can not be images.
+    bool bindImage(GLuint unit, GLenum access, GLuint level = 0) const;
+
     struct ImageData {
         GLuint width = 0;                // Image width
         GLuint height = 0;               // Image height
         GLuint type = 0;                 // Image type (3 bytes per pixel: GL_RGB, 4 bytes: GL_RGBA)
+        GLuint format = 0;               // Byte order of the data (GL_BGR or GL_BGRA for TGA)
         std::vector<GLubyte> data;  // Image data (3 or 4 bytes per pixel)
     };
 
-    // Load data from an uncompressed TGA file
-    ImageData loadUncompressedTGA(const std::string& filename) const;
+    // How createTexture() stores textures on the GPU, for textures created afterwards.
+    // Compressed levels are kept in the mip cache too, if it is enabled.
+    enum class Compression {
+        None,  // GL_RGBA8, 4 bytes per pixel (the default)
+        Fast,  // BC1 for RGB (0.5 bytes per pixel) or BC3 for RGBA (1 byte per pixel)
+        High,  // The same, with a slower encoder of better quality
+    };
+    static void setCompression(Compression compression);
+
+    // Load data from an uncompressed or RLE compressed TGA file. The pixels are kept in
+    // the file's BGR(A) byte order, pass 'format' to glTexImage2D() to upload them.
+    static ImageData loadTGA(const std::string& filename);
+
+    // Find the pixels of an uncompressed TGA file in 'file' without reading them, for
+    // images too large to load. 'image' gets everything but the data. Returns nullptr
+    // for RLE compressed or invalid files.
+    static const GLubyte* mapTGA(const MappedFile& file, const std::string& filename,
+                                 ImageData& image);
+
+    // Decode all levels of an image file into 'levels' the way createTexture()
+    // would upload them, without any OpenGL calls, so it can run in any thread (see
+    // TextureStream.hpp). 'info' describes the levels, except for their offsets.
+    static bool loadLevels(const std::string& filename, ContainerInfo& info,
+                           std::vector<MipLevel>& levels);
+
+private:
+    friend class TextureStreamer;
+
+    // Create the texture if 'textureID' is 0, bind it and set its filtering and wrapping
+    static void bindNewTexture(GLuint& textureID);
+    // Load all but the largest 'skipLevels' levels
+    void createReducedTexture(const std::string& filename, GLuint skipLevels);
+    // Upload 'pixels' and their mipmaps, with the size and format in image_. An empty
+    // 'filename' keeps them out of the mip cache.
+    void uploadImage(const std::string& filename, const GLubyte* pixels, GLuint channels);
+    // Upload the levels in 'info' to the bound texture, from 'base' + the level offsets
+    static void uploadLevels(const ContainerInfo& info, const GLubyte* base);
+    // Set the image size and type from the levels
+    void setImage(const ContainerInfo& info);
 
     GLuint textureID_;  // Texture ID for OpenGL
     ImageData image_;
+    GLuint internalFormat_;  // GL_RGBA8 or a compressed format
+    GLuint numLevels_;
 };
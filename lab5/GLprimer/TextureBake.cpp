@@ -0,0 +1,163 @@
+/*
+ * tnm046-texbake - a command line tool to prebake TGA textures into KTX2 files.
+ *
+ * Usage: tnm046-texbake input.tga output.ktx2 [--bc fast|high]
+ *        tnm046-texbake input.tga output.vtex [--tile N]
+ *        tnm046-texbake --raw WIDTHxHEIGHTxCHANNELS input.raw output.vtex [--tile N]
+ *
+ * Builds the full mipmap chain the same way Texture::createTexture() does (see
+ * MipChain.hpp) and writes it with the base level to a KTX2 file, which
+ * Texture::createTexture() then uploads as it is, without decoding, filtering or
+ * compressing anything at load time. With --bc every level is block compressed,
+ * BC1 for RGB and BC3 for RGBA (see BlockCompress.hpp), otherwise the pixels are
+ * stored as they are in the TGA file. No OpenGL context is needed.
+ *
+ * With a .vtex output file the image is baked into a virtual texture instead (see
+ * VirtualTexture.hpp), with tiles of N x N pixels (128 by default). The input is
+ * read through a memory mapping, a band of rows at a time, so it can be larger than
+ * the memory: an uncompressed TGA file, or for images larger than TGA allows, a raw
+ * file of tightly packed B, G, R(, A) pixels, bottom row first.
+ *
+ * This code is in the public domain.
+ */
+#include <GL/glew.h>
+
+#include "BlockCompress.hpp"
+#include "MappedFile.hpp"
+#include "MipChain.hpp"
+#include "Texture.hpp"
+#include "TextureContainer.hpp"
+#include "VirtualTexture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Bake a TGA or raw image into a virtual texture, without loading it into memory
+int bakeVirtual(const std::string& input, const std::string& output, const std::string& raw,
+                unsigned int tileSize) {
+    const auto start = std::chrono::steady_clock::now();
+    MappedFile file(input);
+    if (!file.isOpen()) {
+        std::fprintf(stderr, "Could not open '%s'\n", input.c_str());
+        return 1;
+    }
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int channels = 0;
+    const unsigned char* pixels = nullptr;
+    if (raw.empty()) {
+        Texture::ImageData image;
+        pixels = Texture::mapTGA(file, input, image);
+        width = image.width;
+        height = image.height;
+        channels = image.type == GL_RGBA ? 4 : 3;
+    } else if (std::sscanf(raw.c_str(), "%ux%ux%u", &width, &height, &channels) == 3 &&
+               width > 0 && height > 0 && (channels == 3 || channels == 4) &&
+               file.size() / channels / width / height >= 1) {
+        pixels = file.data();
+    } else {
+        std::fprintf(stderr, "'%s' does not hold %s pixels\n", input.c_str(), raw.c_str());
+        return 1;
+    }
+    if (!pixels || !bakeVirtualTexture(pixels, width, height, channels, output, tileSize)) {
+        return 1;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    std::printf("%s: %ux%u, %ux%u tiles, %.1f ms\n", output.c_str(), width, height, tileSize,
+                tileSize, ms);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    bool compressed = false;
+    BlockQuality quality = BlockQuality::Fast;
+    std::string raw;
+    unsigned int tileSize = 128;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--raw" && i + 1 < argc) {
+            raw = argv[++i];
+        } else if (arg == "--tile" && i + 1 < argc) {
+            tileSize = static_cast<unsigned int>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--bc" && i + 1 < argc) {
+            const std::string value = argv[++i];
+            if (value != "fast" && value != "high") {
+                std::fprintf(stderr, "Unknown quality '%s', use fast or high\n", value.c_str());
+                return 1;
+            }
+            compressed = true;
+            quality = value == "high" ? BlockQuality::High : BlockQuality::Fast;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() != 2 || (!raw.empty() && !endsWith(files[1], ".vtex"))) {
+        std::fprintf(stderr,
+                     "Usage: %s input.tga output.ktx2 [--bc fast|high]\n"
+                     "       %s [--raw WIDTHxHEIGHTxCHANNELS] input output.vtex [--tile N]\n",
+                     argv[0], argv[0]);
+        return 1;
+    }
+    if (endsWith(files[1], ".vtex")) {
+        return bakeVirtual(files[0], files[1], raw, tileSize);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const Texture::ImageData image = Texture::loadTGA(files[0]);
+    if (image.data.empty()) {
+        return 1;
+    }
+    const unsigned int channels = image.type == GL_RGBA ? 4 : 3;
+
+    std::vector<MipLevel> levels(1);
+    levels[0].width = image.width;
+    levels[0].height = image.height;
+    levels[0].data = image.data;
+    std::vector<MipLevel> mipmaps =
+        buildMipChain(image.data.data(), image.width, image.height, channels);
+    for (MipLevel& mipmap : mipmaps) {
+        levels.push_back(std::move(mipmap));
+    }
+
+    const BlockFormat format = channels == 4 ? BlockFormat::BC3 : BlockFormat::BC1;
+    if (compressed) {
+        for (MipLevel& level : levels) {
+            level.data = compressBlocks(level.data.data(), level.width, level.height, channels,
+                                        format, quality);
+        }
+    }
+
+    if (!writeKTX2(files[1], levels, compressed, compressed ? blockFormatGL(format) : 0,
+                   channels)) {
+        return 1;
+    }
+    size_t bytes = 0;
+    for (const MipLevel& level : levels) {
+        bytes += level.data.size();
+    }
+    const double ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    std::printf("%s: %ux%u, %zu levels, %s, %.2f MB of pixels, %.1f ms\n", files[1].c_str(),
+                image.width, image.height, levels.size(),
+                compressed ? (channels == 4 ? "BC3" : "BC1") : (channels == 4 ? "BGRA8" : "BGR8"),
+                static_cast<double>(bytes) / (1024.0 * 1024.0), ms);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * A registry of loaded textures, shared by everything that uses the same file,
+ * with a budget for the GPU memory they take.
+ *
+ * This code is in the public domain.
+ */
+#include <GL/glew.h>
+
+#include "TextureCache.hpp"
+#include "Texture.hpp"
+#include "TextureStream.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+TextureCache::TextureCache(size_t budget, TextureStreamer* streamer)
+    : budget_(budget), streamer_(streamer) {}
+
+std::shared_ptr<Texture> TextureCache::get(const std::string& filename) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    std::string key = fs::weakly_canonical(filename, error).string();
+    if (error) {
+        key = filename;
+    }
+    const fs::file_time_type modified = fs::last_write_time(filename, error);
+    const int64_t modifiedCount =
+        error ? 0 : static_cast<int64_t>(modified.time_since_epoch().count());
+
+    Entry& entry = entries_[key];
+    entry.lastUse = ++clock_;
+    if (entry.texture && entry.modified == modifiedCount) {
+        ++stats_.hits;
+        return entry.texture;
+    }
+    if (!entry.texture) {
+        entry.texture = std::make_shared<Texture>();
+        entry.filename = filename;
+        byTexture_[entry.texture.get()] = &entry;
+    }
+    entry.modified = modifiedCount;
+    entry.skipLevels = 0;
+    load(entry);
+
+    // Hold on to the texture, so that trim() does not evict it before it is returned
+    std::shared_ptr<Texture> texture = entry.texture;
+    trim();
+    return texture;
+}
+
+void TextureCache::touch(const Texture& texture) {
+    const auto it = byTexture_.find(&texture);
+    if (it != byTexture_.end()) {
+        it->second->lastUse = ++clock_;
+    }
+}
+
+void TextureCache::setBudget(size_t budget) {
+    budget_ = budget;
+    trim();
+}
+
+void TextureCache::trim() {
+    if (budget_ == 0) {
+        return;
+    }
+    size_t total = memoryUsage();
+
+    // First delete the least recently used textures which nobody holds
+    while (total > budget_) {
+        auto victim = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->second.texture.use_count() == 1 && !isStreaming(it->second) &&
+                (victim == entries_.end() || it->second.lastUse < victim->second.lastUse)) {
+                victim = it;
+            }
+        }
+        if (victim == entries_.end()) {
+            break;
+        }
+        total -= victim->second.texture->memorySize();
+        byTexture_.erase(victim->second.texture.get());
+        entries_.erase(victim);
+        ++stats_.evictions;
+    }
+
+    // Then drop the largest level of the least recently used textures in use.
+    // Textures still streaming in are left alone, as their memory is not final.
+    while (total > budget_) {
+        Entry* victim = nullptr;
+        for (auto& [key, entry] : entries_) {
+            if (entry.texture->numLevels() > 1 && !isStreaming(entry) &&
+                (!victim || entry.lastUse < victim->lastUse)) {
+                victim = &entry;
+            }
+        }
+        if (!victim) {
+            break;
+        }
+        const size_t before = victim->texture->memorySize();
+        ++victim->skipLevels;
+        if (streamer_) {
+            // Loaded again in the background. Until then count the memory it will
+            // take, a quarter of what it takes now, so that other textures are not
+            // reduced for it.
+            streamer_->request(*victim->texture, victim->filename, victim->skipLevels);
+            total -= before - before / 4;
+            ++stats_.reductions;
+            continue;
+        }
+        victim->texture->createTexture(victim->filename, victim->skipLevels);
+        const size_t after = victim->texture->memorySize();
+        if (after >= before) {
+            break;  // The file could not be loaded again
+        }
+        total -= before - after;
+        ++stats_.reductions;
+    }
+}
+
+size_t TextureCache::memoryUsage() const {
+    size_t total = 0;
+    for (const auto& [key, entry] : entries_) {
+        total += entry.texture->memorySize();
+    }
+    return total;
+}
+
+void TextureCache::load(Entry& entry) {
+    if (streamer_) {
+        streamer_->request(*entry.texture, entry.filename, entry.skipLevels);
+    } else {
+        entry.texture->createTexture(entry.filename, entry.skipLevels);
+    }
+    ++stats_.loads;
+}
+
+bool TextureCache::isStreaming(const Entry& entry) const {
+    return streamer_ && streamer_->isPending(*entry.texture);
+}
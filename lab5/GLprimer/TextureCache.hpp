@@ -0,0 +1,91 @@
+/*
+ * A registry of loaded textures, shared by everything that uses the same file,
+ * with a budget for the GPU memory they take.
+ *
+ * Usage: create one TextureCache after the OpenGL context and call get() with
+ *        a file name instead of creating a Texture. Every call for the same file
+ *        returns the same Texture, as long as some user still holds it (or it
+ *        has not been evicted), so a file is loaded and uploaded only once.
+ *        Call touch() for the textures drawn in a frame to keep them recently
+ *        used, or rely on get() alone.
+ *
+ * Files are identified by their canonical path, so "textures/earth.tga" and
+ * "./textures/../textures/earth.tga" are the same texture. If a file has been
+ * modified since it was loaded, get() loads it again into the same Texture.
+ *
+ * With a budget set (in bytes, see Texture::memorySize()), textures are evicted
+ * when the total goes over it, least recently used first:
+ *   - Textures nobody holds any more are deleted.
+ *   - If that is not enough, the largest mipmap level of textures still in use
+ *     is dropped (the texture is loaded again without it), which saves three
+ *     quarters of its memory, until only 1 x 1 levels are left.
+ *
+ * With a TextureStreamer (see TextureStream.hpp) new textures are loaded in the
+ * background through it, and so are textures reduced to fewer levels. Their
+ * memory counts once they are resident. Textures which are still streaming in
+ * are neither evicted nor reduced.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class Texture;
+class TextureStreamer;
+
+class TextureCache {
+public:
+    // 'budget' in bytes, 0 for no limit
+    explicit TextureCache(size_t budget = 0, TextureStreamer* streamer = nullptr);
+
+    // The texture for 'filename', loaded if it is not in the cache
+    std::shared_ptr<Texture> get(const std::string& filename);
+
+    // Mark a texture as used now
+    void touch(const Texture& texture);
+
+    // Change the budget, evicting textures if it is exceeded
+    void setBudget(size_t budget);
+    size_t budget() const { return budget_; }
+
+    // Evict textures until the total memory is within the budget. get() does
+    // this after loading, call it again after textures have been released.
+    void trim();
+
+    // The number of textures, and the GPU memory they use in bytes
+    size_t size() const { return entries_.size(); }
+    size_t memoryUsage() const;
+
+    struct Stats {
+        size_t hits = 0;        // get() calls answered from the cache
+        size_t loads = 0;       // Files loaded, or loaded again after a change
+        size_t evictions = 0;   // Textures deleted
+        size_t reductions = 0;  // Mipmap levels dropped
+    };
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Entry {
+        std::shared_ptr<Texture> texture;
+        std::string filename;       // As first given to get(), for loading again
+        int64_t modified = 0;       // Modification time of the file when loaded
+        uint64_t lastUse = 0;       // The value of 'clock_' when last used
+        unsigned int skipLevels = 0;  // Largest levels dropped
+    };
+
+    void load(Entry& entry);
+    // True if the streamer has not finished loading the texture
+    bool isStreaming(const Entry& entry) const;
+
+    size_t budget_;
+    TextureStreamer* streamer_;
+    std::unordered_map<std::string, Entry> entries_;  // By canonical path
+    std::unordered_map<const Texture*, Entry*> byTexture_;
+    uint64_t clock_ = 0;
+    Stats stats_;
+};
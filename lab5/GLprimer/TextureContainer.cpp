@@ -0,0 +1,423 @@
+/*
+ * Reading of DDS and KTX2 texture containers, and writing of KTX2 files.
+ *
+ * This code is in the public domain.
+ */
+#include "TextureContainer.hpp"
+#include "MappedFile.hpp"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const unsigned char ddsMagic[4] = {'D', 'D', 'S', ' '};
+const unsigned char ktx2Magic[12] = {0xAB, 'K', 'T', 'X', ' ', '2',
+                                     '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+// The largest texture size accepted, larger values are taken for a broken header
+const unsigned int maxSize = 16384;
+
+uint32_t read32(const unsigned char* p) {
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+uint64_t read64(const unsigned char* p) { return read32(p) | uint64_t(read32(p + 4)) << 32; }
+
+// How the pixels of a level are stored
+struct Format {
+    bool compressed;
+    unsigned int internalFormat;
+    unsigned int format;       // Uncompressed only
+    unsigned int blockBytes;   // Bytes per 4 x 4 block, or per pixel if uncompressed
+};
+
+const Format bc1 = {true, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, 8};
+const Format bc1a = {true, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 8};
+const Format bc2 = {true, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 16};
+const Format bc3 = {true, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 16};
+const Format bc4 = {true, GL_COMPRESSED_RED_RGTC1, 0, 8};
+const Format bc5 = {true, GL_COMPRESSED_RG_RGTC2, 0, 16};
+const Format bc7 = {true, GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 16};
+const Format rgb8 = {false, GL_RGBA8, GL_RGB, 3};
+const Format bgr8 = {false, GL_RGBA8, GL_BGR, 3};
+const Format rgba8 = {false, GL_RGBA8, GL_RGBA, 4};
+const Format bgra8 = {false, GL_RGBA8, GL_BGRA, 4};
+
+size_t levelSize(const Format& format, unsigned int width, unsigned int height) {
+    if (format.compressed) {
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * format.blockBytes;
+    }
+    return size_t(width) * height * format.blockBytes;
+}
+
+// True if OpenGL can upload the format, as some of the compressed ones are extensions
+bool formatSupported(const Format& format, const std::string& filename) {
+    bool supported = true;
+    if (format.internalFormat >= GL_COMPRESSED_RGB_S3TC_DXT1_EXT &&
+        format.internalFormat <= GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+        supported = GLEW_EXT_texture_compression_s3tc;
+    } else if (format.internalFormat == GL_COMPRESSED_RGBA_BPTC_UNORM) {
+        supported = GLEW_ARB_texture_compression_bptc;
+    }
+    if (!supported) {
+        std::cerr << "The texture format is not supported by this OpenGL ('" << filename
+                  << "')\n";
+    }
+    return supported;
+}
+
+/*
+ * Set up 'info' for 'numLevels' levels starting at 'offset', one after the other,
+ * checking that they fit in the file
+ */
+bool consecutiveLevels(const MappedFile& file, const std::string& filename, const Format& format,
+                       unsigned int width, unsigned int height, unsigned int numLevels,
+                       size_t offset, ContainerInfo& info) {
+    for (unsigned int i = 0; i < numLevels; ++i) {
+        ContainerLevel level;
+        level.width = std::max(1u, width >> i);
+        level.height = std::max(1u, height >> i);
+        level.offset = offset;
+        level.size = levelSize(format, level.width, level.height);
+        if (level.offset > file.size() || file.size() - level.offset < level.size) {
+            std::cerr << "Mipmap level " << i << " is outside the file ('" << filename << "')\n";
+            return false;
+        }
+        offset += level.size;
+        info.levels.push_back(level);
+        if (level.width == 1 && level.height == 1) {
+            break;  // Ignore a mipmap count larger than the chain
+        }
+    }
+    return true;
+}
+
+void setFormat(const Format& format, ContainerInfo& info) {
+    info.compressed = format.compressed;
+    info.internalFormat = format.internalFormat;
+    info.format = format.format;
+    info.channels = format.compressed ? 0 : format.blockBytes;
+}
+
+/*
+ * DDS: a 4 byte signature, a 124 byte header and for newer formats a 20 byte
+ * DX10 header, followed by the levels, largest first
+ */
+bool parseDDS(const MappedFile& file, const std::string& filename, ContainerInfo& info) {
+    const unsigned char* data = file.data();
+    if (file.size() < 128 || read32(data + 4) != 124 || read32(data + 76) != 32) {
+        std::cerr << "Invalid DDS header ('" << filename << "')\n";
+        return false;
+    }
+    const unsigned int height = read32(data + 12);
+    const unsigned int width = read32(data + 16);
+    const unsigned int numLevels = std::max(1u, read32(data + 28));
+    const uint32_t pixelFlags = read32(data + 80);
+    const uint32_t fourCC = read32(data + 84);
+    const uint32_t caps2 = read32(data + 112);
+    if (width == 0 || height == 0 || width > maxSize || height > maxSize) {
+        std::cerr << "Invalid image dimensions ('" << filename << "')\n";
+        return false;
+    }
+    if (caps2 & (0x200 | 0x200000)) {  // DDSCAPS2_CUBEMAP, DDSCAPS2_VOLUME
+        std::cerr << "Only 2D DDS textures are supported ('" << filename << "')\n";
+        return false;
+    }
+
+    auto code = [](const char* s) { return read32(reinterpret_cast<const unsigned char*>(s)); };
+    const Format* format = nullptr;
+    size_t offset = 128;
+    if (pixelFlags & 0x4) {  // DDPF_FOURCC
+        if (fourCC == code("DXT1")) {
+            format = (pixelFlags & 0x1) ? &bc1a : &bc1;  // DDPF_ALPHAPIXELS
+        } else if (fourCC == code("DXT2") || fourCC == code("DXT3")) {
+            format = &bc2;
+        } else if (fourCC == code("DXT4") || fourCC == code("DXT5")) {
+            format = &bc3;
+        } else if (fourCC == code("ATI1") || fourCC == code("BC4U")) {
+            format = &bc4;
+        } else if (fourCC == code("ATI2") || fourCC == code("BC5U")) {
+            format = &bc5;
+        } else if (fourCC == code("DX10")) {
+            if (file.size() < 148) {
+                std::cerr << "Invalid DDS header ('" << filename << "')\n";
+                return false;
+            }
+            offset = 148;
+            const uint32_t dxgiFormat = read32(data + 128);
+            const uint32_t dimension = read32(data + 132);
+            const uint32_t miscFlags = read32(data + 136);
+            const uint32_t arraySize = read32(data + 140);
+            if (dimension != 3 || (miscFlags & 0x4) || arraySize > 1) {  // TEXTURE2D, not a cube
+                std::cerr << "Only 2D DDS textures are supported ('" << filename << "')\n";
+                return false;
+            }
+            switch (dxgiFormat) {  // The sRGB variants are loaded as linear
+                case 28: case 29: format = &rgba8; break;  // R8G8B8A8_UNORM(_SRGB)
+                case 87: case 91: format = &bgra8; break;  // B8G8R8A8_UNORM(_SRGB)
+                case 71: case 72: format = &bc1a; break;   // BC1_UNORM(_SRGB)
+                case 74: case 75: format = &bc2; break;    // BC2_UNORM(_SRGB)
+                case 77: case 78: format = &bc3; break;    // BC3_UNORM(_SRGB)
+                case 80: format = &bc4; break;             // BC4_UNORM
+                case 83: format = &bc5; break;             // BC5_UNORM
+                case 98: case 99: format = &bc7; break;    // BC7_UNORM(_SRGB)
+                default: break;
+            }
+        }
+    } else if (pixelFlags & 0x40) {  // DDPF_RGB, uncompressed with channel masks
+        const uint32_t bits = read32(data + 88);
+        const uint32_t redMask = read32(data + 92);
+        const uint32_t alphaMask = (pixelFlags & 0x1) ? read32(data + 104) : 0;
+        if (bits == 32 && redMask == 0x00ff0000 && alphaMask == 0xff000000) {
+            format = &bgra8;
+        } else if (bits == 32 && redMask == 0x000000ff && alphaMask == 0xff000000) {
+            format = &rgba8;
+        } else if (bits == 24 && redMask == 0x00ff0000) {
+            format = &bgr8;
+        } else if (bits == 24 && redMask == 0x000000ff) {
+            format = &rgb8;
+        }
+    }
+    if (!format) {
+        std::cerr << "Unsupported DDS pixel format ('" << filename << "')\n";
+        return false;
+    }
+    if (!formatSupported(*format, filename)) {
+        return false;
+    }
+    setFormat(*format, info);
+    return consecutiveLevels(file, filename, *format, width, height, numLevels, offset, info);
+}
+
+/*
+ * KTX2: an 80 byte header, an index of the levels (level 0 first) and a data
+ * format descriptor, followed by the levels, smallest first
+ */
+bool parseKTX2(const MappedFile& file, const std::string& filename, ContainerInfo& info) {
+    const unsigned char* data = file.data();
+    if (file.size() < 80) {
+        std::cerr << "Invalid KTX2 header ('" << filename << "')\n";
+        return false;
+    }
+    const uint32_t vkFormat = read32(data + 12);
+    const unsigned int width = read32(data + 20);
+    const unsigned int height = read32(data + 24);
+    const uint32_t depth = read32(data + 28);
+    const uint32_t layers = read32(data + 32);
+    const uint32_t faces = read32(data + 36);
+    const unsigned int numLevels = std::max(1u, read32(data + 40));
+    const uint32_t supercompression = read32(data + 44);
+    if (width == 0 || height == 0 || width > maxSize || height > maxSize) {
+        std::cerr << "Invalid image dimensions ('" << filename << "')\n";
+        return false;
+    }
+    if (depth != 0 || layers > 1 || faces != 1) {
+        std::cerr << "Only 2D KTX2 textures are supported ('" << filename << "')\n";
+        return false;
+    }
+    if (supercompression != 0) {
+        std::cerr << "Supercompressed KTX2 files are not supported ('" << filename << "')\n";
+        return false;
+    }
+
+    const Format* format = nullptr;
+    switch (vkFormat) {  // The sRGB variants are loaded as linear
+        case 23: case 29: format = &rgb8; break;     // R8G8B8_UNORM(_SRGB)
+        case 30: case 36: format = &bgr8; break;     // B8G8R8_UNORM(_SRGB)
+        case 37: case 43: format = &rgba8; break;    // R8G8B8A8_UNORM(_SRGB)
+        case 44: case 50: format = &bgra8; break;    // B8G8R8A8_UNORM(_SRGB)
+        case 131: case 132: format = &bc1; break;    // BC1_RGB_UNORM(_SRGB)_BLOCK
+        case 133: case 134: format = &bc1a; break;   // BC1_RGBA_UNORM(_SRGB)_BLOCK
+        case 135: case 136: format = &bc2; break;    // BC2_UNORM(_SRGB)_BLOCK
+        case 137: case 138: format = &bc3; break;    // BC3_UNORM(_SRGB)_BLOCK
+        case 139: format = &bc4; break;              // BC4_UNORM_BLOCK
+        case 141: format = &bc5; break;              // BC5_UNORM_BLOCK
+        case 145: case 146: format = &bc7; break;    // BC7_UNORM(_SRGB)_BLOCK
+        default: break;
+    }
+    if (!format) {
+        std::cerr << "Unsupported KTX2 format " << vkFormat << " ('" << filename << "')\n";
+        return false;
+    }
+    if (!formatSupported(*format, filename)) {
+        return false;
+    }
+    setFormat(*format, info);
+
+    const size_t indexSize = size_t(numLevels) * 24;
+    if (numLevels > 32 || file.size() - 80 < indexSize) {
+        std::cerr << "Invalid KTX2 level index ('" << filename << "')\n";
+        return false;
+    }
+    for (unsigned int i = 0; i < numLevels; ++i) {
+        const unsigned char* entry = data + 80 + size_t(i) * 24;
+        const uint64_t offset = read64(entry);
+        const uint64_t length = read64(entry + 8);
+        ContainerLevel level;
+        level.width = std::max(1u, width >> i);
+        level.height = std::max(1u, height >> i);
+        level.offset = static_cast<size_t>(offset);
+        level.size = levelSize(*format, level.width, level.height);
+        if (length != level.size || offset > file.size() || file.size() - offset < length) {
+            std::cerr << "Mipmap level " << i << " is invalid or outside the file ('" << filename
+                      << "')\n";
+            return false;
+        }
+        info.levels.push_back(level);
+    }
+    return true;
+}
+
+void write32(std::vector<unsigned char>& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+void write64(std::vector<unsigned char>& out, uint64_t value) {
+    write32(out, static_cast<uint32_t>(value));
+    write32(out, static_cast<uint32_t>(value >> 32));
+}
+
+}  // namespace
+
+bool isTextureContainer(const MappedFile& file) {
+    return (file.size() >= sizeof(ddsMagic) &&
+            std::memcmp(file.data(), ddsMagic, sizeof(ddsMagic)) == 0) ||
+           (file.size() >= sizeof(ktx2Magic) &&
+            std::memcmp(file.data(), ktx2Magic, sizeof(ktx2Magic)) == 0);
+}
+
+bool parseTextureContainer(const MappedFile& file, const std::string& filename,
+                           ContainerInfo& info) {
+    info = ContainerInfo();
+    if (file.size() >= sizeof(ddsMagic) &&
+        std::memcmp(file.data(), ddsMagic, sizeof(ddsMagic)) == 0) {
+        return parseDDS(file, filename, info);
+    }
+    if (file.size() >= sizeof(ktx2Magic) &&
+        std::memcmp(file.data(), ktx2Magic, sizeof(ktx2Magic)) == 0) {
+        return parseKTX2(file, filename, info);
+    }
+    std::cerr << "Not a DDS or KTX2 file ('" << filename << "')\n";
+    return false;
+}
+
+bool writeKTX2(const std::string& filename, const std::vector<MipLevel>& levels, bool compressed,
+               unsigned int internalFormat, unsigned int channels) {
+    if (levels.empty()) {
+        return false;
+    }
+
+    // The Vulkan format, and the data format descriptor: color model, bytes per
+    // block and the samples (bit offset, bit length, channel)
+    uint32_t vkFormat;
+    uint8_t colorModel;
+    uint8_t blockBytes;
+    std::vector<std::array<uint32_t, 3>> samples;
+    if (compressed && internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+        vkFormat = 131;  // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+        colorModel = 128;  // KHR_DF_MODEL_BC1A
+        blockBytes = 8;
+        samples = {{0, 64, 0}};
+    } else if (compressed && internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+        vkFormat = 137;  // VK_FORMAT_BC3_UNORM_BLOCK
+        colorModel = 130;  // KHR_DF_MODEL_BC3
+        blockBytes = 16;
+        samples = {{0, 64, 15}, {64, 64, 0}};  // Alpha, then color
+    } else if (!compressed && channels == 3) {
+        vkFormat = 30;  // VK_FORMAT_B8G8R8_UNORM
+        colorModel = 1;  // KHR_DF_MODEL_RGBSDA
+        blockBytes = 3;
+        samples = {{0, 8, 2}, {8, 8, 1}, {16, 8, 0}};
+    } else if (!compressed && channels == 4) {
+        vkFormat = 44;  // VK_FORMAT_B8G8R8A8_UNORM
+        colorModel = 1;
+        blockBytes = 4;
+        samples = {{0, 8, 2}, {8, 8, 1}, {16, 8, 0}, {24, 8, 15}};
+    } else {
+        std::cerr << "Unsupported format for KTX2 file ('" << filename << "')\n";
+        return false;
+    }
+
+    const uint32_t numLevels = static_cast<uint32_t>(levels.size());
+    const uint32_t dfdOffset = 80 + 24 * numLevels;
+    const uint32_t dfdSize = 4 + 24 + 16 * static_cast<uint32_t>(samples.size());
+
+    std::vector<unsigned char> header(ktx2Magic, ktx2Magic + sizeof(ktx2Magic));
+    write32(header, vkFormat);
+    write32(header, 1);  // typeSize
+    write32(header, levels[0].width);
+    write32(header, levels[0].height);
+    write32(header, 0);  // pixelDepth
+    write32(header, 0);  // layerCount
+    write32(header, 1);  // faceCount
+    write32(header, numLevels);
+    write32(header, 0);  // supercompressionScheme
+    write32(header, dfdOffset);
+    write32(header, dfdSize);
+    write32(header, 0);  // No key/value data
+    write32(header, 0);
+    write64(header, 0);  // No supercompression global data
+    write64(header, 0);
+
+    // The levels are stored smallest first, each aligned to a multiple of both
+    // the block size and 4 bytes
+    const size_t alignment = blockBytes == 3 ? 12 : std::max<size_t>(blockBytes, 4);
+    std::vector<size_t> offsets(numLevels);
+    size_t offset = dfdOffset + dfdSize;
+    for (size_t i = numLevels; i-- > 0;) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        offsets[i] = offset;
+        offset += levels[i].data.size();
+    }
+    for (size_t i = 0; i < numLevels; ++i) {
+        write64(header, offsets[i]);
+        write64(header, levels[i].data.size());
+        write64(header, levels[i].data.size());  // uncompressedByteLength
+    }
+
+    write32(header, dfdSize);
+    write32(header, 0);                                 // vendorId, descriptorType
+    write32(header, 2 | (dfdSize - 4) << 16);           // versionNumber, descriptorBlockSize
+    header.push_back(colorModel);
+    header.push_back(1);                                // colorPrimaries BT709
+    header.push_back(1);                                // transferFunction linear
+    header.push_back(0);                                // flags: straight alpha
+    write32(header, compressed ? 0x00000303 : 0);       // texelBlockDimension - 1
+    write32(header, blockBytes);                        // bytesPlane0..3
+    write32(header, 0);                                 // bytesPlane4..7
+    for (const std::array<uint32_t, 3>& sample : samples) {
+        write32(header, sample[0] | (sample[1] - 1) << 16 | sample[2] << 24);
+        write32(header, 0);                                  // samplePosition
+        write32(header, 0);                                  // sampleLower
+        write32(header, sample[1] == 8 ? 255 : 0xffffffff);  // sampleUpper
+    }
+
+    FILE* out = std::fopen(filename.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Could not create '" << filename << "'\n";
+        return false;
+    }
+    std::fwrite(header.data(), 1, header.size(), out);
+    size_t written = header.size();
+    const unsigned char padding[16] = {};
+    for (size_t i = numLevels; i-- > 0;) {
+        std::fwrite(padding, 1, offsets[i] - written, out);
+        std::fwrite(levels[i].data.data(), 1, levels[i].data.size(), out);
+        written = offsets[i] + levels[i].data.size();
+    }
+    const bool ok = !std::ferror(out);
+    std::fclose(out);
+    if (!ok) {
+        std::cerr << "Could not write '" << filename << "'\n";
+    }
+    return ok;
+}
@@ -0,0 +1,62 @@
+/*
+ * Reading of DDS and KTX2 texture containers, and writing of KTX2 files.
+ *
+ * Usage: Texture::createTexture() calls parseTextureContainer() for files which
+ *        start with a DDS or KTX2 signature and uploads every level in the file
+ *        straight from the memory mapping, so loading costs little more than the
+ *        I/O. Use writeKTX2() (or the tnm046-texbake tool) to prebake TGA files,
+ *        with their mipmaps and optionally block compressed.
+ *
+ * Supported are 2D textures (no arrays, cube maps or volumes) without
+ * supercompression, in these formats:
+ *   8-bit RGB(A) and BGR(A), BC1, BC2, BC3, BC4, BC5 and BC7.
+ * sRGB formats are loaded as their linear counterparts, the same way TGA files
+ * are, so textures look the same whatever the file format.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include "MipChain.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Where one mipmap level is in the file
+struct ContainerLevel {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+struct ContainerInfo {
+    bool compressed = false;
+    unsigned int internalFormat = 0;  // For glTexImage2D() or glCompressedTexImage2D()
+    unsigned int format = 0;          // For uncompressed data: GL_RGB, GL_BGRA, ...
+    unsigned int channels = 0;        // For uncompressed data: bytes per pixel
+    std::vector<ContainerLevel> levels;  // Level 0 first
+};
+
+// True if the file starts with the signature of a DDS or KTX2 file
+bool isTextureContainer(const MappedFile& file);
+
+/*
+ * Validate the headers of a DDS or KTX2 file and find its levels, all of which are
+ * checked to be inside the file. Returns false, after printing why, for invalid or
+ * unsupported files.
+ */
+bool parseTextureContainer(const MappedFile& file, const std::string& filename,
+                           ContainerInfo& info);
+
+/*
+ * Write a KTX2 file with the given levels (level 0 first), which are either 'channels'
+ * bytes per pixel in B, G, R(, A) order, or blocks of the compressed format
+ * 'internalFormat' (from blockFormatGL()) if 'compressed' is true.
+ * Returns false if the file could not be written.
+ */
+bool writeKTX2(const std::string& filename, const std::vector<MipLevel>& levels, bool compressed,
+               unsigned int internalFormat, unsigned int channels);
@@ -0,0 +1,283 @@
+/*
+ * Packing of many textures into a few array textures, so that objects with
+ * different textures can be drawn without binding a texture for each of them.
+ *
+ * This code is in the public domain.
+ */
+#include "TexturePack.hpp"
+#include "Texture.hpp"
+#include "TextureContainer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+namespace {
+
+// Atlas textures are placed at multiples of kGutter pixels, with kGutter pixels of
+// copies of their edges around them. Atlas pages have kAtlasLevels levels, which
+// leaves one pixel of gutter in the last one.
+constexpr GLuint kGutter = 16;
+constexpr size_t kAtlasLevels = 5;
+
+struct Source {
+    size_t index = 0;  // Of the file in the packer
+    ContainerInfo info;
+    std::vector<MipLevel> levels;
+};
+
+// Textures with the same key can be the layers of one array texture
+struct GroupKey {
+    GLuint width = 0;
+    GLuint height = 0;
+    bool compressed = false;
+    GLuint internalFormat = 0;
+    size_t numLevels = 0;
+
+    bool operator<(const GroupKey& other) const {
+        return std::tie(width, height, compressed, internalFormat, numLevels) <
+               std::tie(other.width, other.height, other.compressed, other.internalFormat,
+                        other.numLevels);
+    }
+};
+
+struct Placement {
+    const Source* source;
+    GLuint page;
+    GLuint x;  // Of the gutter around the texture, in pixels of level 0
+    GLuint y;
+    GLuint width;  // Including the gutter
+    GLuint height;
+};
+
+GLuint roundUp(GLuint value, GLuint multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+/*
+ * Create and bind an array texture of 'layers' layers with levels of the given sizes
+ * (for compressed formats, 'size' is the size of one layer). Returns its ID and adds
+ * its memory to 'memorySize'.
+ */
+GLuint createArray(const std::vector<ContainerLevel>& levels, GLsizei layers, bool compressed,
+                   GLenum internalFormat, GLint wrap, size_t& memorySize) {
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL,
+                    static_cast<GLint>(levels.size() - 1));
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const ContainerLevel& level = levels[i];
+        if (compressed) {
+            const size_t size = level.size * static_cast<size_t>(layers);
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), internalFormat,
+                                   level.width, level.height, layers, 0,
+                                   static_cast<GLsizei>(size), nullptr);
+            memorySize += size;
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), internalFormat, level.width,
+                         level.height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            memorySize += size_t{4} * level.width * level.height * static_cast<size_t>(layers);
+        }
+    }
+    return id;
+}
+
+// Upload all levels of a texture to one layer of the bound array texture
+void uploadLayer(const Source& source, GLint layer) {
+    for (size_t i = 0; i < source.levels.size(); ++i) {
+        const MipLevel& level = source.levels[i];
+        if (source.info.compressed) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), 0, 0, layer,
+                                      level.width, level.height, 1, source.info.internalFormat,
+                                      static_cast<GLsizei>(level.data.size()), level.data.data());
+        } else {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), 0, 0, layer, level.width,
+                            level.height, 1, source.info.format, GL_UNSIGNED_BYTE,
+                            level.data.data());
+        }
+    }
+}
+
+/*
+ * Copy level 'l' of a placed texture into a page of BGRA pixels, 'pageWidth' pixels
+ * wide at that level, and fill its gutter with its edge pixels
+ */
+void copyToPage(const Placement& placement, size_t l, GLuint pageWidth, GLubyte* page) {
+    const ContainerInfo& info = placement.source->info;
+    const MipLevel& level = placement.source->levels[l];
+    const bool rgbOrder = info.format == GL_RGB || info.format == GL_RGBA;
+    const GLuint channels = info.channels;
+    const int gutter = static_cast<int>(kGutter >> l);
+    const GLuint x0 = placement.x >> l;
+    const GLuint y0 = placement.y >> l;
+    const int maxX = static_cast<int>(level.width) - 1;
+    const int maxY = static_cast<int>(level.height) - 1;
+    for (GLuint y = 0; y < (placement.height >> l); ++y) {
+        const int sy = std::clamp(static_cast<int>(y) - gutter, 0, maxY);
+        const GLubyte* row = level.data.data() + static_cast<size_t>(sy) * level.width * channels;
+        GLubyte* out = page + ((static_cast<size_t>(y0) + y) * pageWidth + x0) * 4;
+        for (GLuint x = 0; x < (placement.width >> l); ++x, out += 4) {
+            const int sx = std::clamp(static_cast<int>(x) - gutter, 0, maxX);
+            const GLubyte* in = row + static_cast<size_t>(sx) * channels;
+            out[0] = in[rgbOrder ? 2 : 0];
+            out[1] = in[1];
+            out[2] = in[rgbOrder ? 0 : 2];
+            out[3] = channels == 4 ? in[3] : 255;
+        }
+    }
+}
+
+}  // namespace
+
+TexturePacker::TexturePacker(GLuint atlasSize) : atlasSize_(atlasSize) {}
+
+TexturePacker::~TexturePacker() { deleteTextures(); }
+
+size_t TexturePacker::add(const std::string& filename) {
+    files_.push_back(filename);
+    slots_.emplace_back();
+    return files_.size() - 1;
+}
+
+bool TexturePacker::pack() {
+    deleteTextures();
+    slots_.assign(files_.size(), TextureSlot());
+
+    bool ok = true;
+    std::vector<Source> sources(files_.size());
+    std::map<GroupKey, std::vector<const Source*>> groups;
+    for (size_t i = 0; i < files_.size(); ++i) {
+        Source& source = sources[i];
+        source.index = i;
+        if (!Texture::loadLevels(files_[i], source.info, source.levels)) {
+            ok = false;
+            continue;
+        }
+        GroupKey key;
+        key.width = source.levels[0].width;
+        key.height = source.levels[0].height;
+        key.compressed = source.info.compressed;
+        key.internalFormat = source.info.internalFormat;
+        key.numLevels = source.levels.size();
+        groups[key].push_back(&source);
+    }
+
+    GLint maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Textures which share their size and format with others become layers of an
+    // array texture, the others go into the atlas if they can
+    std::vector<const Source*> atlas;
+    for (const auto& [key, members] : groups) {
+        const Source& first = *members.front();
+        const GLuint paddedWidth = roundUp(key.width + 2 * kGutter, kGutter);
+        const GLuint paddedHeight = roundUp(key.height + 2 * kGutter, kGutter);
+        if (members.size() == 1 && !key.compressed &&
+            (first.info.channels == 3 || first.info.channels == 4) &&
+            key.numLevels >= kAtlasLevels && paddedWidth <= atlasSize_ &&
+            paddedHeight <= atlasSize_) {
+            atlas.push_back(&first);
+            continue;
+        }
+        for (size_t start = 0; start < members.size(); start += static_cast<size_t>(maxLayers)) {
+            const size_t count = std::min(members.size() - start, static_cast<size_t>(maxLayers));
+            const GLuint id =
+                createArray(first.info.levels, static_cast<GLsizei>(count), key.compressed,
+                            key.internalFormat, GL_REPEAT, memorySize_);
+            textures_.push_back(id);
+            for (size_t layer = 0; layer < count; ++layer) {
+                const Source& source = *members[start + layer];
+                uploadLayer(source, static_cast<GLint>(layer));
+                slots_[source.index].texture = id;
+                slots_[source.index].layer = static_cast<GLint>(layer);
+            }
+        }
+    }
+
+    if (!atlas.empty()) {
+        // Shelf packing, tallest first, into as many pages as needed
+        std::stable_sort(atlas.begin(), atlas.end(), [](const Source* a, const Source* b) {
+            return a->levels[0].height > b->levels[0].height;
+        });
+        std::vector<Placement> placements;
+        GLuint page = 0, x = 0, y = 0, shelfHeight = 0, usedWidth = 0, usedHeight = 0;
+        for (const Source* source : atlas) {
+            const GLuint width = roundUp(source->levels[0].width + 2 * kGutter, kGutter);
+            const GLuint height = roundUp(source->levels[0].height + 2 * kGutter, kGutter);
+            if (x + width > atlasSize_) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (y + height > atlasSize_) {
+                ++page;
+                x = y = shelfHeight = 0;
+            }
+            placements.push_back({source, page, x, y, width, height});
+            x += width;
+            shelfHeight = std::max(shelfHeight, height);
+            usedWidth = std::max(usedWidth, x);
+            usedHeight = std::max(usedHeight, y + height);
+        }
+        // A single page is only as large as it needs to be
+        const GLuint pageWidth = page == 0 ? usedWidth : atlasSize_;
+        const GLuint pageHeight = page == 0 ? usedHeight : atlasSize_;
+
+        std::vector<ContainerLevel> levels(kAtlasLevels);
+        for (size_t l = 0; l < kAtlasLevels; ++l) {
+            levels[l].width = std::max(1u, pageWidth >> l);
+            levels[l].height = std::max(1u, pageHeight >> l);
+        }
+        const GLuint id = createArray(levels, static_cast<GLsizei>(page + 1), false, GL_RGBA,
+                                      GL_CLAMP_TO_EDGE, memorySize_);
+        textures_.push_back(id);
+
+        std::vector<GLubyte> pixels;
+        for (GLuint p = 0; p <= page; ++p) {
+            for (size_t l = 0; l < kAtlasLevels; ++l) {
+                pixels.assign(size_t{4} * levels[l].width * levels[l].height, 0);
+                for (const Placement& placement : placements) {
+                    if (placement.page == p) {
+                        copyToPage(placement, l, levels[l].width, pixels.data());
+                    }
+                }
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(l), 0, 0,
+                                static_cast<GLint>(p), levels[l].width, levels[l].height, 1,
+                                GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+            }
+        }
+
+        for (const Placement& placement : placements) {
+            const MipLevel& base = placement.source->levels[0];
+            TextureSlot& slot = slots_[placement.source->index];
+            slot.texture = id;
+            slot.layer = static_cast<GLint>(placement.page);
+            slot.transform[0] = static_cast<GLfloat>(base.width) / static_cast<GLfloat>(pageWidth);
+            slot.transform[1] =
+                static_cast<GLfloat>(base.height) / static_cast<GLfloat>(pageHeight);
+            slot.transform[2] = static_cast<GLfloat>(placement.x + kGutter) /
+                                static_cast<GLfloat>(pageWidth);
+            slot.transform[3] = static_cast<GLfloat>(placement.y + kGutter) /
+                                static_cast<GLfloat>(pageHeight);
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return ok;
+}
+
+void TexturePacker::deleteTextures() {
+    if (!textures_.empty()) {
+        glDeleteTextures(static_cast<GLsizei>(textures_.size()), textures_.data());
+    }
+    textures_.clear();
+    memorySize_ = 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Packing of many textures into a few array textures, so that objects with
+ * different textures can be drawn without binding a texture for each of them.
+ *
+ * Usage: create a TexturePacker after the OpenGL context, add() every texture
+ *        file and call pack(). Each file then has a TextureSlot: an array
+ *        texture (GL_TEXTURE_2D_ARRAY), a layer in it and a transform of the
+ *        texture coordinates. Bind each of textures() once, and give every
+ *        object its layer and transform instead of a texture ID. In the shader,
+ *        declare the texture as a sampler2DArray and sample it with
+ *            texture(tex, vec3(st * transform.xy + transform.zw, layer))
+ *        (see ../shaders/fragment_array.glsl).
+ *
+ * Textures of the same size and format, with the same number of mipmap levels,
+ * become the layers of one array texture, with their own levels (see
+ * Texture::loadLevels()), and their transform is the identity. Textures which
+ * share their size with no other texture are put side by side into atlas pages
+ * instead, which are the layers of one more array texture, in GL_RGBA. Their
+ * transform maps [0, 1] to their part of the page. Each of them is surrounded
+ * by a gutter of copies of its edge pixels, wide enough for linear filtering in
+ * the first few mipmap levels, and atlas pages only have those levels, so the
+ * textures do not bleed into each other. Texture coordinates outside [0, 1]
+ * are clamped for atlas textures instead of repeated.
+ * Textures which can not go into an atlas (block compressed, too large for a
+ * page or with too few levels) get an array texture of their own.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Where a texture file ended up after TexturePacker::pack()
+struct TextureSlot {
+    GLuint texture = 0;  // A GL_TEXTURE_2D_ARRAY, 0 if the file could not be loaded
+    GLint layer = 0;
+    // The texture coordinates of the layer are st * (scale s, scale t) + (offset s, offset t)
+    GLfloat transform[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+};
+
+class TexturePacker {
+public:
+    // Atlas pages are at most 'atlasSize' x 'atlasSize' pixels
+    explicit TexturePacker(GLuint atlasSize = 2048);
+    ~TexturePacker();
+
+    TexturePacker(const TexturePacker&) = delete;
+    TexturePacker& operator=(const TexturePacker&) = delete;
+
+    // Add a texture file to pack. Returns its index for slot().
+    size_t add(const std::string& filename);
+
+    // Load all added files and pack them, replacing any earlier array textures.
+    // Returns false if some file could not be loaded; its slot is empty.
+    bool pack();
+
+    const TextureSlot& slot(size_t index) const { return slots_[index]; }
+    size_t size() const { return files_.size(); }
+
+    // The array textures created by pack()
+    const std::vector<GLuint>& textures() const { return textures_; }
+
+    // The estimated GPU memory used by all array textures, in bytes
+    size_t memorySize() const { return memorySize_; }
+
+private:
+    void deleteTextures();
+
+    const GLuint atlasSize_;
+    std::vector<std::string> files_;
+    std::vector<TextureSlot> slots_;
+    std::vector<GLuint> textures_;
+    size_t memorySize_ = 0;
+};
@@ -0,0 +1,420 @@
+/*
+ * Asynchronous texture loading through pixel buffer objects.
+ *
+ * This code is in the public domain.
+ */
+#include "TextureStream.hpp"
+#include "MipChain.hpp"
+#include "Texture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Levels start at multiples of this in a buffer
+const size_t levelAlignment = 16;
+
+// How much GL_TEXTURE_MIN_LOD drops per update() while a new level fades in
+const float lodFadeStep = 0.125f;
+
+}  // namespace
+
+TextureStreamer::TextureStreamer(unsigned int numBuffers, size_t bufferSize, unsigned int threads)
+    : bufferSize_(bufferSize) {
+    persistent_ = GLEW_ARB_buffer_storage;
+    buffers_.resize(std::max(1u, numBuffers));
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+        Buffer& buffer = buffers_[i];
+        glGenBuffers(1, &buffer.id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+        if (persistent_) {
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize_, nullptr,
+                            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize_, nullptr, GL_STREAM_DRAW);
+        }
+        buffer.mapped = mapBuffer(buffer);
+        if (buffer.mapped) {
+            freeBuffers_.push_back(static_cast<int>(i));
+            ++numMapped_;
+        } else {
+            std::cerr << "Could not map a pixel buffer for texture streaming\n";
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (threads == 0) {
+        threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    for (unsigned int i = 0; i < threads; ++i) {
+        threads_.emplace_back(&TextureStreamer::work, this);
+    }
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    jobQueued_.notify_all();
+    bufferFreed_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+
+    if (current_) {
+        uploading_.push_back(std::move(current_));
+    }
+    for (const std::unique_ptr<Job>& job : uploading_) {
+        for (const Job::LevelFence& fence : job->fences) {
+            glDeleteSync(fence.fence);
+        }
+        if (!job->shown) {
+            glDeleteTextures(1, &job->textureID);
+        }
+    }
+    for (Buffer& buffer : buffers_) {
+        if (buffer.mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        glDeleteBuffers(1, &buffer.id);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamer::request(Texture& texture, const std::string& filename,
+                              unsigned int skipLevels) {
+    if (texture.textureID_ == 0) {
+        // A placeholder until the real texture is resident
+        const GLubyte gray[4] = {128, 128, 128, 255};
+        Texture::bindNewTexture(texture.textureID_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        texture.image_ = Texture::ImageData();
+        texture.image_.width = 1;
+        texture.image_.height = 1;
+        texture.image_.type = GL_RGBA;
+        texture.internalFormat_ = GL_RGBA8;
+        texture.numLevels_ = 1;
+    }
+
+    std::unique_ptr<Job> job(new Job);
+    job->texture = &texture;
+    job->filename = filename;
+    job->skipLevels = skipLevels;
+    job->progressive = progressive_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.push_back(std::move(job));
+    }
+    ++pending_;
+    ++pendingTextures_[&texture];
+    jobQueued_.notify_one();
+}
+
+void TextureStreamer::update(size_t uploadBudget) {
+    // Show the levels whose uploads have finished, and retire finished textures
+    if (current_) {
+        advance(*current_);
+    }
+    for (size_t i = 0; i < uploading_.size();) {
+        if (advance(*uploading_[i])) {
+            uploading_.erase(uploading_.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+
+    // Upload decoded textures in bands of rows, as many as the budget allows,
+    // continuing with a partly uploaded texture first
+    size_t uploaded = 0;
+    bool fenced = false;
+    while (uploaded < uploadBudget) {
+        if (!current_) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (decoded_.empty()) {
+                    break;
+                }
+                current_ = std::move(decoded_.front());
+                decoded_.pop_front();
+            }
+            if (!current_->ok) {
+                retire(*current_);  // The texture keeps its placeholder
+                current_.reset();
+                continue;
+            }
+            startUpload(*current_);
+        }
+
+        Job& job = *current_;
+        const size_t numFences = job.fences.size();
+        uploaded += uploadRows(job, uploadBudget - uploaded);
+        fenced = fenced || job.fences.size() > numFences;
+
+        if (job.step == job.info.levels.size()) {
+            uploading_.push_back(std::move(current_));
+        }
+    }
+    if (fenced) {
+        glFlush();  // Make sure the fences get signaled without waiting for the next frame
+    }
+}
+
+void TextureStreamer::startUpload(Job& job) {
+    if (job.buffer >= 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[job.buffer].id);
+        if (persistent_) {
+            glFlushMappedBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, job.size);
+        } else {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            buffers_[job.buffer].mapped = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    Texture::bindNewTexture(job.textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                    static_cast<GLint>(job.info.levels.size() - 1));
+    job.step = 0;
+    job.row = 0;
+}
+
+size_t TextureStreamer::uploadRows(Job& job, size_t budget) {
+    const ContainerInfo& info = job.info;
+    const size_t numLevels = info.levels.size();
+    const GLuint buffer = job.buffer >= 0 ? buffers_[job.buffer].id : 0;
+    // The offsets are into the buffer if there is one
+    const GLubyte* base = buffer ? nullptr : job.memory.data();
+    size_t uploaded = 0;
+    glBindTexture(GL_TEXTURE_2D, job.textureID);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // At least one band per call, so that every texture gets uploaded eventually
+    while (job.step < numLevels && (uploaded == 0 || uploaded < budget)) {
+        // Progressive textures are uploaded smallest level first
+        const size_t levelIndex = job.progressive ? numLevels - 1 - job.step : job.step;
+        const GLint levelGL = static_cast<GLint>(levelIndex);
+        const ContainerLevel& level = info.levels[levelIndex];
+
+        // Allocate each level, without data, before its first band. Allocating
+        // them as they come spreads the cost, as some drivers clear the memory.
+        if (job.row == 0) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            if (info.compressed) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, levelGL, info.internalFormat, level.width,
+                                       level.height, 0, static_cast<GLsizei>(level.size),
+                                       nullptr);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, levelGL, info.internalFormat, level.width,
+                             level.height, 0, info.format, GL_UNSIGNED_BYTE, nullptr);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        }
+
+        // Compressed levels are uploaded in rows of 4 x 4 blocks
+        const unsigned int rowHeight = info.compressed ? 4 : 1;
+        const unsigned int numRows = (level.height + rowHeight - 1) / rowHeight;
+        const size_t rowSize = level.size / numRows;
+        const size_t rowsInBudget = std::max<size_t>(1, (budget - uploaded) / rowSize);
+        const unsigned int rows =
+            static_cast<unsigned int>(std::min<size_t>(numRows - job.row, rowsInBudget));
+        const GLint y = static_cast<GLint>(job.row * rowHeight);
+        const GLsizei height = static_cast<GLsizei>(std::min(level.height - y, rows * rowHeight));
+        const GLubyte* data = base + level.offset + job.row * rowSize;
+        if (info.compressed) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, levelGL, 0, y, level.width, height,
+                                      info.internalFormat, static_cast<GLsizei>(rows * rowSize),
+                                      data);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, levelGL, 0, y, level.width, height, info.format,
+                            GL_UNSIGNED_BYTE, data);
+        }
+        uploaded += rows * rowSize;
+
+        job.row += rows;
+        if (job.row == numRows) {
+            ++job.step;
+            job.row = 0;
+            // Every level can be shown once it is on the GPU if progressive, otherwise
+            // the texture is shown when all levels are
+            if (job.progressive || job.step == numLevels) {
+                const size_t shownLevel = job.progressive ? levelIndex : 0;
+                job.fences.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), shownLevel});
+            }
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return uploaded;
+}
+
+bool TextureStreamer::advance(Job& job) {
+    const size_t oldBaseLevel = job.baseLevel;
+    bool shown = false;
+    while (!job.fences.empty()) {
+        const GLenum status = glClientWaitSync(job.fences.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(job.fences.front().fence);
+        job.baseLevel = job.fences.front().level;
+        job.fences.pop_front();
+        shown = true;
+    }
+
+    if (shown) {
+        Texture& texture = *job.texture;
+        if (!job.shown) {  // Swap out the placeholder
+            glDeleteTextures(1, &texture.textureID_);
+            texture.textureID_ = job.textureID;
+            texture.setImage(job.info);
+            job.shown = true;
+        } else {
+            // Fade in the new levels from the level of detail shown so far, which
+            // GL_TEXTURE_MIN_LOD gives relative to the base level
+            job.minLod += static_cast<float>(oldBaseLevel - job.baseLevel);
+        }
+        // Never sample levels which are not on the GPU yet
+        glBindTexture(GL_TEXTURE_2D, job.textureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(job.baseLevel));
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, job.minLod);
+    } else if (job.minLod > 0.0f) {
+        job.minLod = std::max(0.0f, job.minLod - lodFadeStep);
+        glBindTexture(GL_TEXTURE_2D, job.textureID);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, job.minLod);
+    }
+
+    if (job.step < job.info.levels.size() || !job.fences.empty() || job.minLod > 0.0f) {
+        return false;
+    }
+    if (job.buffer >= 0) {
+        releaseBuffer(job.buffer);
+        job.buffer = -1;
+    }
+    retire(job);
+    return true;
+}
+
+void TextureStreamer::finish() {
+    while (pending_ > 0) {
+        update(static_cast<size_t>(-1));
+        GLsync fence = nullptr;
+        for (const std::unique_ptr<Job>& job : uploading_) {
+            if (!job->fences.empty()) {
+                fence = job->fences.front().fence;
+                break;
+            }
+        }
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } else if (pending_ > uploading_.size()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobDecoded_.wait_for(lock, std::chrono::milliseconds(1),
+                                 [this] { return !decoded_.empty(); });
+        }
+    }
+}
+
+void TextureStreamer::work() {
+    for (;;) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobQueued_.wait(lock, [this] { return stop_ || !queued_.empty(); });
+            if (stop_) {
+                return;
+            }
+            job = std::move(queued_.front());
+            queued_.pop_front();
+        }
+
+        std::vector<MipLevel> levels;
+        job->ok = Texture::loadLevels(job->filename, job->info, levels);
+        if (job->ok) {
+            const size_t skip = std::min<size_t>(job->skipLevels, levels.size() - 1);
+            job->info.levels.erase(job->info.levels.begin(), job->info.levels.begin() + skip);
+            levels.erase(levels.begin(), levels.begin() + skip);
+
+            size_t size = 0;
+            for (ContainerLevel& level : job->info.levels) {
+                level.offset = size;
+                size = (size + level.size + levelAlignment - 1) / levelAlignment * levelAlignment;
+            }
+            job->size = size;
+
+            GLubyte* out = nullptr;
+            if (size <= bufferSize_) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                bufferFreed_.wait(lock, [this] {
+                    return stop_ || !freeBuffers_.empty() || numMapped_ == 0;
+                });
+                if (stop_) {
+                    return;
+                }
+                if (!freeBuffers_.empty()) {
+                    job->buffer = freeBuffers_.back();
+                    freeBuffers_.pop_back();
+                    out = buffers_[job->buffer].mapped;
+                }
+            }
+            if (!out) {
+                job->memory.resize(size);
+                out = job->memory.data();
+            }
+            for (size_t i = 0; i < levels.size(); ++i) {
+                std::memcpy(out + job->info.levels[i].offset, levels[i].data.data(),
+                            levels[i].data.size());
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            decoded_.push_back(std::move(job));
+        }
+        jobDecoded_.notify_all();
+    }
+}
+
+GLubyte* TextureStreamer::mapBuffer(const Buffer& buffer) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+    const GLbitfield access =
+        persistent_ ? GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT
+                    // The previous upload has finished, so there is nothing to wait for
+                    : GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    return static_cast<GLubyte*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize_, access));
+}
+
+void TextureStreamer::releaseBuffer(int index) {
+    Buffer& buffer = buffers_[index];
+    if (!persistent_) {
+        buffer.mapped = mapBuffer(buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!buffer.mapped) {
+            std::cerr << "Could not map a pixel buffer for texture streaming\n";
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --numMapped_;
+            }
+            bufferFreed_.notify_all();  // Without buffers, the workers use memory instead
+            return;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeBuffers_.push_back(index);
+    }
+    bufferFreed_.notify_one();
+}
+
+void TextureStreamer::retire(const Job& job) {
+    --pending_;
+    const auto it = pendingTextures_.find(job.texture);
+    if (--it->second == 0) {
+        pendingTextures_.erase(it);
+    }
+}
@@ -0,0 +1,153 @@
+/*
+ * Asynchronous texture loading through pixel buffer objects.
+ *
+ * Usage: create one TextureStreamer after the OpenGL context, call request()
+ *        with a Texture and a file name, and call update() once per frame.
+ *        Until its levels are on the GPU the texture shows a 1 x 1 gray
+ *        placeholder (or, if it was loaded before, its old image).
+ *        finish() waits until every requested texture is resident.
+ *
+ * Files are decoded (see Texture::loadLevels()) in worker threads, which write
+ * the levels into a pool of mapped pixel unpack buffers. update() only issues
+ * the uploads from those buffers, which lets the driver copy the data while the
+ * frame goes on, and puts a fence after them. Only once the fence has passed is
+ * the new texture swapped in and the buffer reused, so no draw call waits for an
+ * upload. Textures larger than a buffer are uploaded from ordinary memory instead.
+ * update() uploads about 'uploadBudget' bytes per call, in bands of rows, so
+ * large textures are spread over several frames. Drivers which copy the data
+ * right away (such as software renderers) take time in proportion to the budget.
+ *
+ * In progressive mode (see setProgressive()) the smallest level is uploaded first
+ * and the texture is shown as soon as that one is on the GPU. Then each larger
+ * level is uploaded and shown in turn, by lowering GL_TEXTURE_BASE_LEVEL, so
+ * levels which are not there yet are never sampled. A new level is faded in over
+ * a few frames with GL_TEXTURE_MIN_LOD, instead of popping in. A whole scene thus
+ * appears at once at a low resolution, and is sharp after (total bytes / budget)
+ * frames.
+ *
+ * With ARB_buffer_storage the buffers stay mapped all the time, otherwise each
+ * buffer is mapped again once its upload has finished.
+ *
+ * Note: id() of a streamed texture changes when it becomes resident, so look it
+ * up every frame. The Texture objects must outlive their requests, or at least
+ * the last call to update() or finish(), and the streamer must be destroyed
+ * while its OpenGL context is still current.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <GL/glew.h>
+
+#include "TextureContainer.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Texture;
+
+class TextureStreamer {
+public:
+    // 'numBuffers' pixel buffers of 'bufferSize' bytes each, and 'threads' decoding
+    // threads (0 for one less than the number of cores, but at least one)
+    explicit TextureStreamer(unsigned int numBuffers = 4, size_t bufferSize = 16 << 20,
+                             unsigned int threads = 0);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Start loading 'filename' into 'texture', without the largest 'skipLevels'
+    // mipmap levels (but not the smallest)
+    void request(Texture& texture, const std::string& filename, unsigned int skipLevels = 0);
+
+    // Show the textures of later requests level by level, smallest first, instead
+    // of all at once
+    void setProgressive(bool progressive) { progressive_ = progressive; }
+
+    // Upload decoded textures and swap in the ones whose uploads have finished.
+    // Call once per frame from the thread with the OpenGL context.
+    void update(size_t uploadBudget = 1 << 20);
+
+    // Wait until all requested textures are resident (or failed to load)
+    void finish();
+
+    // The number of requests that are not resident yet (or still fading in)
+    size_t numPending() const { return pending_; }
+
+    // True if a request for 'texture' is not resident yet (or still fading in)
+    bool isPending(const Texture& texture) const {
+        return pendingTextures_.count(&texture) != 0;
+    }
+
+private:
+    struct Buffer {
+        GLuint id = 0;
+        GLubyte* mapped = nullptr;
+    };
+
+    struct Job {
+        struct LevelFence {
+            GLsync fence;
+            size_t level;  // The level to show once the fence has passed
+        };
+
+        Texture* texture = nullptr;
+        std::string filename;
+        unsigned int skipLevels = 0;
+        bool progressive = false;
+        bool ok = false;
+        ContainerInfo info;            // Offsets are into the buffer or 'memory'
+        int buffer = -1;               // Index in buffers_, or -1 to use 'memory'
+        size_t size = 0;               // Bytes used in the buffer
+        std::vector<GLubyte> memory;   // For textures too large for a buffer
+        GLuint textureID = 0;          // The new texture, swapped in when shown
+        bool shown = false;
+        size_t step = 0;               // The number of levels uploaded
+        unsigned int row = 0;          // In rows of pixels, or of blocks if compressed
+        std::deque<LevelFence> fences;
+        size_t baseLevel = 0;          // The largest level shown
+        float minLod = 0.0f;           // While fading in the base level
+    };
+
+    void work();
+    // Take the levels from the worker threads and allocate the new texture
+    void startUpload(Job& job);
+    // Upload about 'budget' bytes of rows of the job's texture. Returns the bytes.
+    size_t uploadRows(Job& job, size_t budget);
+    // Show the levels whose fences have passed. Returns true when the job is done.
+    bool advance(Job& job);
+    GLubyte* mapBuffer(const Buffer& buffer);
+    void releaseBuffer(int index);
+    // Count a request as no longer pending
+    void retire(const Job& job);
+
+    const size_t bufferSize_;
+    bool persistent_ = false;
+    bool progressive_ = false;
+    std::vector<Buffer> buffers_;
+
+    std::mutex mutex_;                       // Guards everything up to 'stop_'
+    std::condition_variable jobQueued_;      // For worker threads waiting for a job
+    std::condition_variable bufferFreed_;    // For worker threads waiting for a buffer
+    std::condition_variable jobDecoded_;     // For finish()
+    std::deque<std::unique_ptr<Job>> queued_;
+    std::deque<std::unique_ptr<Job>> decoded_;
+    std::vector<int> freeBuffers_;
+    size_t numMapped_ = 0;  // Buffers in use or free, not those which failed to map
+    bool stop_ = false;
+
+    // Only used by the OpenGL thread
+    std::unique_ptr<Job> current_;                 // Partly uploaded
+    std::vector<std::unique_ptr<Job>> uploading_;  // Waiting for fences or fading in
+    size_t pending_ = 0;
+    std::unordered_map<const Texture*, size_t> pendingTextures_;  // Requests per texture
+    std::vector<std::thread> threads_;
+};
@@ -14,6 +14,8 @@
 #include <GL/glew.h>
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <algorithm>
 
@@ -27,17 +29,19 @@ TriangleSoup::~TriangleSoup() { clean(); }
 
 /* Clean up, remembering to de-allocate arrays and GL resources */
 void TriangleSoup::clean() {
-    if (glIsVertexArray(vao_)) {
+    // The checks against 0 keep this safe for CPU-only objects (see loadOBJ()),
+    // which may live without any OpenGL context at all.
+    if (vao_ != 0 && glIsVertexArray(vao_)) {
         glDeleteVertexArrays(1, &vao_);
         vao_ = 0;
     }
 
-    if (glIsBuffer(vertexbuffer_)) {
+    if (vertexbuffer_ != 0 && glIsBuffer(vertexbuffer_)) {
         glDeleteBuffers(1, &vertexbuffer_);
         vertexbuffer_ = 0;
     }
 
-    if (glIsBuffer(indexbuffer_)) {
+    if (indexbuffer_ != 0 && glIsBuffer(indexbuffer_)) {
         glDeleteBuffers(1, &indexbuffer_);
         indexbuffer_ = 0;
     }
@@ -395,49 +399,133 @@ void TriangleSoup::createSphere(float radius, int segments) {
  * This code is in the public domain.
  */
 void TriangleSoup::readOBJ(const std::string& filename) {
+    if (loadOBJ(filename)) {
+        upload();
+    }
+}
+
+/*
+ * loadOBJ(const std::string& filename)
+ *
+ * Read the OBJ file into the CPU-side vertex and index arrays, but do not
+ * create any OpenGL objects. This works without an OpenGL context, which
+ * makes it usable from command line tools. Returns false on errors.
+ */
+bool TriangleSoup::loadOBJ(const std::string& filename) {
+    // Delete any previous content in the TriangleSoup object
+    clean();
+
+    OBJData data;
+    if (!parseOBJ(filename, data)) {
+        std::cerr << "Mesh read error: No mesh data generated\n";
+        return false;
+    }
+    buildOBJ(data);
+    return true;
+}
+
+namespace {
+
+enum class OBJTag { Other, Vertex, Normal, TexCoord, Face };
+
+// Classify an OBJ line by its leading keyword, and advance 'p' past the keyword
+OBJTag readTag(const char*& p) {
+    while (*p == ' ' || *p == '\t') {
+        ++p;
+    }
+    OBJTag tag = OBJTag::Other;
+    if (p[0] == 'v') {
+        if (p[1] == ' ' || p[1] == '\t') {
+            tag = OBJTag::Vertex;
+        } else if (p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            tag = OBJTag::Normal;
+        } else if (p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            tag = OBJTag::TexCoord;
+        }
+    } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+        tag = OBJTag::Face;
+    }
+    if (tag != OBJTag::Other) {
+        p += (tag == OBJTag::Vertex || tag == OBJTag::Face) ? 1 : 2;
+    }
+    return tag;
+}
+
+// Read 'count' floats from 'p' into 'dest'. Returns false if there were fewer numbers.
+bool readFloats(const char* p, int count, float* dest) {
+    for (int i = 0; i < count; ++i) {
+        char* end;
+        dest[i] = std::strtof(p, &end);
+        if (end == p) {
+            return false;
+        }
+        p = end;
+    }
+    return true;
+}
+
+// Convert an OBJ index (starting at 1, or negative to count backwards from the last element
+// read so far) to a zero-based index. Returns -1 if the index is 0 or out of range.
+int resolveIndex(long index, int numRead, int numTotal) {
+    if (index == 0) {
+        return -1;  // OBJ has no index 0
+    }
+    const long resolved = index > 0 ? index - 1 : numRead + index;
+    return (resolved >= 0 && resolved < numTotal) ? static_cast<int>(resolved) : -1;
+}
+
+}  // namespace
+
+/*
+ * parseOBJ(const std::string& filename, OBJData& data)
+ *
+ * Read the vertex, normal, texture coordinate and face data of an OBJ file.
+ * Faces may be given as "f v v v", "f v/t v/t v/t", "f v//n v//n v//n" or
+ * "f v/t/n v/t/n v/t/n". Only triangles are accepted.
+ */
+bool TriangleSoup::parseOBJ(const std::string& filename, OBJData& data) {
     FILE* objfile = fopen(filename.c_str(), "r");
 
     if (!objfile) {
         std::cerr << "File not found: " << filename << "\n";
-        return;
+        return false;
     }
 
     // Scan through the file to count the number of data elements
     char line[256];
-    char tag[3];
 
     int numverts = 0;
     int numnormals = 0;
     int numtexcoords = 0;
     int numfaces = 0;
     while (fgets(line, 256, objfile)) {
-        sscanf(line, "%2s ", tag);
-        if (!strcmp(tag, "v")) {
-            numverts++;
-        } else if (!strcmp(tag, "vn")) {
-            numnormals++;
-        } else if (!strcmp(tag, "vt")) {
-            numtexcoords++;
-        } else if (!strcmp(tag, "f")) {
-            numfaces++;
+        const char* p = line;
+        switch (readTag(p)) {
+            case OBJTag::Vertex:
+                numverts++;
+                break;
+            case OBJTag::Normal:
+                numnormals++;
+                break;
+            case OBJTag::TexCoord:
+                numtexcoords++;
+                break;
+            case OBJTag::Face:
+                numfaces++;
+                break;
+            default:
+                break;
         }
-        // else {
-        //     std::cout << "Ignoring line starting with \"" << tag << "\"\n";
-        // }
     }
 
     std::cout << "loadObj(\"" << filename << "\"): found " << numverts << " vertices, "
               << numnormals << " normals, " << numtexcoords << " texcoords, " << numfaces
               << " faces.\n";
 
-    std::vector<float> verts(3 * numverts);
-    std::vector<float> normals(3 * numnormals);
-    std::vector<float> texcoords(2 * numtexcoords);
-
-    vertexarray_.resize(8 * 3 * numfaces);
-    indexarray_.resize(3 * numfaces);
-    nverts_ = 3 * numfaces;
-    ntris_ = numfaces;
+    data.verts.resize(3 * static_cast<size_t>(numverts));
+    data.normals.resize(3 * static_cast<size_t>(numnormals));
+    data.texcoords.resize(2 * static_cast<size_t>(numtexcoords));
+    data.faces.resize(9 * static_cast<size_t>(numfaces));
 
     rewind(objfile);  // Start from the top again to read data
 
@@ -446,112 +534,155 @@ void TriangleSoup::readOBJ(const std::string& filename) {
     int i_t = 0;
     int i_f = 0;
 
-    int readerror = 0;
-    while (fgets(line, 256, objfile)) {
-        tag[0] = '\0';
-        sscanf(line, "%2s ", tag);
-        if (!strcmp(tag, "v")) {
-            // A vertex with three coordinates
-            // std::cout << "Reading vertex " << i_v + 1 << "\n";
-
-            int numargs = sscanf(line, "v %f %f %f", &verts[3 * i_v], &verts[3 * i_v + 1],
-                                 &verts[3 * i_v + 2]);
-            if (numargs != 3) {
-                std::cerr << "Malformed vertex data found at vertex " << i_v + 1 << "\nAborting\n";
-                readerror = 1;
+    bool readerror = false;
+    while (!readerror && fgets(line, 256, objfile)) {
+        const char* p = line;
+        switch (readTag(p)) {
+            case OBJTag::Vertex:
+                // A vertex with three coordinates
+                if (!readFloats(p, 3, &data.verts[3 * static_cast<size_t>(i_v)])) {
+                    std::cerr << "Malformed vertex data found at vertex " << i_v + 1
+                              << "\nAborting\n";
+                    readerror = true;
+                }
+                i_v++;
                 break;
-            }
-            i_v++;
-        } else if (!strcmp(tag, "vn")) {
-            // A vertex normal with three components
-            // std::cout << "Reading normal " << i_n + 1 << "\n";
-
-            int numargs = sscanf(line, "vn %f %f %f", &normals[3 * i_n], &normals[3 * i_n + 1],
-                                 &normals[3 * i_n + 2]);
-            if (numargs != 3) {
-                std::cerr << "Malformed normal data found at normal" << i_n + 1 << "\nAborting\n";
-                readerror = 1;
+            case OBJTag::Normal:
+                // A vertex normal with three components
+                if (!readFloats(p, 3, &data.normals[3 * static_cast<size_t>(i_n)])) {
+                    std::cerr << "Malformed normal data found at normal" << i_n + 1
+                              << "\nAborting\n";
+                    readerror = true;
+                }
+                i_n++;
                 break;
-            }
-            i_n++;
-        } else if (!strcmp(tag, "vt")) {
-            // A vertex texture coordinate, two components
-            // std::cout << "Reading texcoord " << i_t + 1 << "\n";
-
-            int numargs = sscanf(line, "vt %f %f", &texcoords[2 * i_t], &texcoords[2 * i_t + 1]);
-            if (numargs != 2) {
-                std::cerr << "Malformed texcoord data found at texcoord " << i_t + 1
-                          << "\nAborting\n";
-                readerror = 1;
+            case OBJTag::TexCoord:
+                // A vertex texture coordinate, two components
+                if (!readFloats(p, 2, &data.texcoords[2 * static_cast<size_t>(i_t)])) {
+                    std::cerr << "Malformed texcoord data found at texcoord " << i_t + 1
+                              << "\nAborting\n";
+                    readerror = true;
+                }
+                i_t++;
                 break;
-            }
-            i_t++;
-        } else if (!strcmp(tag, "f")) {
-            // A face with three or more vertex indices
-            // std::cout << "Reading face " << i_f + 1 << "\n";
-
-            int v1, v2, v3, n1, n2, n3, t1, t2, t3;
-            int numargs = sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d", &v1, &t1, &n1, &v2, &t2, &n2,
-                                 &v3, &t3, &n3);
-            if (numargs != 9) {  // Accept only triangles. Quads cause an error.
-                std::cerr << "Malformed face data found at vertex " << i_f + 1 << "\nAborting\n";
-                readerror = 1;
+            case OBJTag::Face: {
+                // A face with three vertex references v, v/t, v//n or v/t/n
+                int* face = &data.faces[9 * static_cast<size_t>(i_f)];
+                int corners = 0;
+                while (!readerror) {
+                    while (*p == ' ' || *p == '\t') {
+                        ++p;
+                    }
+                    if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') {
+                        break;
+                    }
+                    if (corners == 3) {  // Accept only triangles. Quads cause an error.
+                        readerror = true;
+                        break;
+                    }
+                    char* end;
+                    int* vtn = face + 3 * corners;
+                    vtn[0] = resolveIndex(std::strtol(p, &end, 10), i_v, numverts);
+                    vtn[1] = -1;
+                    vtn[2] = -1;
+                    readerror = (end == p) || vtn[0] < 0;
+                    p = end;
+                    if (!readerror && *p == '/') {
+                        ++p;
+                        if (*p != '/') {  // texture coordinate index
+                            vtn[1] = resolveIndex(std::strtol(p, &end, 10), i_t, numtexcoords);
+                            readerror = (end == p) || vtn[1] < 0;
+                            p = end;
+                        }
+                        if (!readerror && *p == '/') {  // normal index
+                            ++p;
+                            vtn[2] = resolveIndex(std::strtol(p, &end, 10), i_n, numnormals);
+                            readerror = (end == p) || vtn[2] < 0;
+                            p = end;
+                        }
+                    }
+                    ++corners;
+                }
+                if (readerror || corners != 3) {
+                    std::cerr << "Malformed face data found at vertex " << i_f + 1
+                              << "\nAborting\n";
+                    readerror = true;
+                }
+                i_f++;
                 break;
             }
-            //			printf("Read vertex data %d/%d/%d %d/%d/%d %d/%d/%d\n",
-            //			v1, t1, n1, v2, t2, n2, v3, t3, n3);
-            // Indices in OBJ files start at 1, but C++ arrays start at index 0.
-            --v1;
-            --v2;
-            --v3;
-            --n1;
-            --n2;
-            --n3;
-            --t1;
-            --t2;
-            --t3;
-
-            const int currentv = 8 * 3 * i_f;
-            vertexarray_[currentv] = verts[3 * v1];
-            vertexarray_[currentv + 1] = verts[3 * v1 + 1];
-            vertexarray_[currentv + 2] = verts[3 * v1 + 2];
-            vertexarray_[currentv + 3] = normals[3 * n1];
-            vertexarray_[currentv + 4] = normals[3 * n1 + 1];
-            vertexarray_[currentv + 5] = normals[3 * n1 + 2];
-            vertexarray_[currentv + 6] = texcoords[2 * t1];
-            vertexarray_[currentv + 7] = texcoords[2 * t1 + 1];
-            vertexarray_[currentv + 8] = verts[3 * v2];
-            vertexarray_[currentv + 9] = verts[3 * v2 + 1];
-            vertexarray_[currentv + 10] = verts[3 * v2 + 2];
-            vertexarray_[currentv + 11] = normals[3 * n2];
-            vertexarray_[currentv + 12] = normals[3 * n2 + 1];
-            vertexarray_[currentv + 13] = normals[3 * n2 + 2];
-            vertexarray_[currentv + 14] = texcoords[2 * t2];
-            vertexarray_[currentv + 15] = texcoords[2 * t2 + 1];
-            vertexarray_[currentv + 16] = verts[3 * v3];
-            vertexarray_[currentv + 17] = verts[3 * v3 + 1];
-            vertexarray_[currentv + 18] = verts[3 * v3 + 2];
-            vertexarray_[currentv + 19] = normals[3 * n3];
-            vertexarray_[currentv + 20] = normals[3 * n3 + 1];
-            vertexarray_[currentv + 21] = normals[3 * n3 + 2];
-            vertexarray_[currentv + 22] = texcoords[2 * t3];
-            vertexarray_[currentv + 23] = texcoords[2 * t3 + 1];
-            indexarray_[3 * i_f] = 3 * i_f;
-            indexarray_[3 * i_f + 1] = 3 * i_f + 1;
-            indexarray_[3 * i_f + 2] = 3 * i_f + 2;
-            i_f++;
+            default:
+                break;
         }
     }
 
-    // Clean up the temporary arrays we created
     fclose(objfile);
 
-    if (readerror) {  // Delete corrupt data and bail out if a read error occured
-        std::cerr << "Mesh read error: No mesh data generated\n";
-        clean();
-        return;
+    return !readerror;
+}
+
+/*
+ * buildOBJ(const OBJData& data)
+ *
+ * Build the interleaved vertex array and the index array from parsed OBJ data.
+ * Missing normals are replaced by the face normal, missing texture coordinates by (0, 0).
+ */
+void TriangleSoup::buildOBJ(const OBJData& data) {
+    const size_t numfaces = data.faces.size() / 9;
+
+    vertexarray_.resize(8 * 3 * numfaces);
+    indexarray_.resize(3 * numfaces);
+    nverts_ = static_cast<int>(3 * numfaces);
+    ntris_ = static_cast<int>(numfaces);
+
+    for (size_t i_f = 0; i_f < numfaces; ++i_f) {
+        const int* face = &data.faces[9 * i_f];
+        const float* p0 = &data.verts[3 * static_cast<size_t>(face[0])];
+        const float* p1 = &data.verts[3 * static_cast<size_t>(face[3])];
+        const float* p2 = &data.verts[3 * static_cast<size_t>(face[6])];
+
+        // Face normal, only used for corners without a normal index
+        const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float facenormal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                               e1[0] * e2[1] - e1[1] * e2[0]};
+        const float len = std::sqrt(facenormal[0] * facenormal[0] +
+                                    facenormal[1] * facenormal[1] +
+                                    facenormal[2] * facenormal[2]);
+        if (len > 0.0f) {
+            facenormal[0] /= len;
+            facenormal[1] /= len;
+            facenormal[2] /= len;
+        }
+
+        for (size_t corner = 0; corner < 3; ++corner) {
+            const int* vtn = face + 3 * corner;
+            const float* pos = &data.verts[3 * static_cast<size_t>(vtn[0])];
+            const float* normal =
+                vtn[2] >= 0 ? &data.normals[3 * static_cast<size_t>(vtn[2])] : facenormal;
+
+            const size_t vertex = 3 * i_f + corner;
+            GLfloat* dest = &vertexarray_[8 * vertex];
+            dest[0] = pos[0];
+            dest[1] = pos[1];
+            dest[2] = pos[2];
+            dest[3] = normal[0];
+            dest[4] = normal[1];
+            dest[5] = normal[2];
+            if (vtn[1] >= 0) {
+                dest[6] = data.texcoords[2 * static_cast<size_t>(vtn[1])];
+                dest[7] = data.texcoords[2 * static_cast<size_t>(vtn[1]) + 1];
+            } else {
+                dest[6] = 0.0f;
+                dest[7] = 0.0f;
+            }
+            indexarray_[vertex] = static_cast<GLuint>(vertex);
+        }
     }
+}
 
+/* Upload the CPU-side vertex and index arrays to OpenGL buffers in a new VAO */
+void TriangleSoup::upload() {
     // Generate one vertex array object (VAO) and bind it
     glGenVertexArrays(1, &vao_);
     glBindVertexArray(vao_);
@@ -596,8 +727,6 @@ void TriangleSoup::readOBJ(const std::string& filename) {
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-    return;
 }
 
 /* Print data from a TriangleSoup object, for debugging purposes */
@@ -647,8 +776,16 @@ void TriangleSoup::printInfo() {
     printf("zmax: %8.2f\n", zmax);
 }
 
+int TriangleSoup::numVertices() const { return nverts_; }
+
+int TriangleSoup::numTriangles() const { return ntris_; }
+
+const std::vector<GLfloat>& TriangleSoup::vertexArray() const { return vertexarray_; }
+
+const std::vector<GLuint>& TriangleSoup::indexArray() const { return indexarray_; }
+
 /* Render the geometry in a TriangleSoup object */
-void TriangleSoup::render() {
+void TriangleSoup::render() const {
     glBindVertexArray(vao_);
     glDrawElements(GL_TRIANGLES, 3 * ntris_, GL_UNSIGNED_INT, (void*)0);
     // (mode, vertex count, type, element array buffer offset)
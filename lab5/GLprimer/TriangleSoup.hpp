@@ -42,6 +42,24 @@ public:
     /* Load geometry from an OBJ file */
     void readOBJ(const std::string& filename);
 
+    /* Load geometry from an OBJ file into the CPU-side arrays only (no OpenGL calls) */
+    bool loadOBJ(const std::string& filename);
+
+    /* Raw data from an OBJ file, before it is expanded to the interleaved vertex array */
+    struct OBJData {
+        std::vector<float> verts;      // 3 floats per vertex
+        std::vector<float> normals;    // 3 floats per normal
+        std::vector<float> texcoords;  // 2 floats per texture coordinate
+        std::vector<int> faces;  // 9 zero-based indices v/t/n per triangle, -1 if not given
+    };
+
+    /* The two steps of loadOBJ(): read an OBJ file, and build the vertex and index arrays */
+    static bool parseOBJ(const std::string& filename, OBJData& data);
+    void buildOBJ(const OBJData& data);
+
+    /* Create the VAO and buffers from the CPU-side arrays */
+    void upload();
+
     /* Print data from a triangleSoup object, for debugging purposes */
     void print();
 
@@ -49,7 +67,14 @@ public:
     void printInfo();
 
     /* Render the geometry in a triangleSoup object */
-    void render();
+    void render() const;
+
+    int numVertices() const;
+    int numTriangles() const;
+
+    // Interleaved vertex array (8 floats per vertex: x y z nx ny nz s t) and index array
+    const std::vector<GLfloat>& vertexArray() const;
+    const std::vector<GLuint>& indexArray() const;
 
 private:
     void printError(const char* errtype, const char* errmsg);
@@ -0,0 +1,144 @@
+/*
+ * A uniform buffer with a copy of its contents, uploading only what changed.
+ *
+ * This code is in the public domain.
+ */
+#include <GL/glew.h>
+
+#include "UniformBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+UniformBuffer::UniformBuffer() : bufferID_(0), dirtyBegin_(0), dirtyEnd_(0) {}
+
+UniformBuffer::~UniformBuffer() {
+    if (bufferID_ != 0) {
+        glDeleteBuffers(1, &bufferID_);
+    }
+}
+
+bool UniformBuffer::create(const Shader& shader, UniformName block) {
+    const UniformBlockInfo* info = shader.findUniformBlock(block);
+    if (!info) {
+        std::cerr << "No active uniform block '" << block.name << "' in program " << shader.id()
+                  << "\n";
+        return false;
+    }
+    members_ = info->members;
+    data_.assign(static_cast<size_t>(info->dataSize), 0);
+    if (bufferID_ == 0) {
+        glGenBuffers(1, &bufferID_);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, bufferID_);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(data_.size()), data_.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    dirtyBegin_ = 0;
+    dirtyEnd_ = 0;
+    return true;
+}
+
+bool UniformBuffer::write(size_t offset, const void* value, size_t size) {
+    if (offset + size > data_.size() || std::memcmp(&data_[offset], value, size) == 0) {
+        return false;
+    }
+    std::memcpy(&data_[offset], value, size);
+    if (dirtyBegin_ >= dirtyEnd_) {
+        dirtyBegin_ = offset;
+        dirtyEnd_ = offset + size;
+    } else {
+        dirtyBegin_ = std::min(dirtyBegin_, offset);
+        dirtyEnd_ = std::max(dirtyEnd_, offset + size);
+    }
+    return true;
+}
+
+void UniformBuffer::setMember(UniformName member, GLenum type, const void* value, size_t size) {
+    auto it = std::lower_bound(
+        members_.begin(), members_.end(), member.hash,
+        [](const UniformInfo& info, uint32_t hash) { return info.hash < hash; });
+    if (it == members_.end() || it->hash != member.hash || it->offset < 0) {
+        return;
+    }
+#ifndef NDEBUG
+    if (it->type != type && !(it->type == GL_BOOL && type == GL_INT)) {
+        std::cerr << "Uniform block member '" << member.name << "' is of type 0x" << std::hex
+                  << it->type << ", not 0x" << type << std::dec << "\n";
+        return;
+    }
+#endif
+    const size_t offset = static_cast<size_t>(it->offset);
+    bool changed = false;
+    if (type == GL_FLOAT_MAT4) {
+        // Columns, or rows of row_major members, are 'matrixStride' bytes apart,
+        // which is 16 with std140 but may be more with the shared layout
+        const size_t stride = it->matrixStride > 0 ? static_cast<size_t>(it->matrixStride) : 16;
+        const GLfloat* vectors = static_cast<const GLfloat*>(value);
+        std::array<GLfloat, 16> rows;
+        if (it->rowMajor) {
+            for (size_t r = 0; r < 4; ++r) {
+                for (size_t c = 0; c < 4; ++c) {
+                    rows[r * 4 + c] = vectors[c * 4 + r];
+                }
+            }
+            vectors = rows.data();
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            changed |= write(offset + i * stride, vectors + i * 4, 16);
+        }
+    } else {
+        changed = write(offset, value, size);
+    }
+    if (changed) {
+        ++stats_.sets;
+    } else {
+        ++stats_.setsSkipped;
+    }
+}
+
+void UniformBuffer::set(UniformName member, GLfloat value) {
+    setMember(member, GL_FLOAT, &value, sizeof(value));
+}
+
+void UniformBuffer::set(UniformName member, GLfloat x, GLfloat y) {
+    const GLfloat value[] = {x, y};
+    setMember(member, GL_FLOAT_VEC2, value, sizeof(value));
+}
+
+void UniformBuffer::set(UniformName member, GLfloat x, GLfloat y, GLfloat z) {
+    const GLfloat value[] = {x, y, z};
+    setMember(member, GL_FLOAT_VEC3, value, sizeof(value));
+}
+
+void UniformBuffer::set(UniformName member, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+    const GLfloat value[] = {x, y, z, w};
+    setMember(member, GL_FLOAT_VEC4, value, sizeof(value));
+}
+
+void UniformBuffer::set(UniformName member, GLint value) {
+    setMember(member, GL_INT, &value, sizeof(value));
+}
+
+void UniformBuffer::set(UniformName member, const std::array<GLfloat, 16>& matrix) {
+    setMember(member, GL_FLOAT_MAT4, matrix.data(), sizeof(matrix));
+}
+
+void UniformBuffer::upload() {
+    if (bufferID_ == 0 || dirtyBegin_ >= dirtyEnd_) {
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, bufferID_);
+    glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(dirtyBegin_),
+                    static_cast<GLsizeiptr>(dirtyEnd_ - dirtyBegin_), &data_[dirtyBegin_]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ++stats_.uploads;
+    stats_.bytesUploaded += dirtyEnd_ - dirtyBegin_;
+    dirtyBegin_ = 0;
+    dirtyEnd_ = 0;
+}
+
+void UniformBuffer::bind(GLuint binding) const {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, bufferID_);
+}
@@ -0,0 +1,81 @@
+/*
+ * A uniform buffer holding the values of a uniform block, with a copy of its
+ * contents in memory so that only what changed is uploaded.
+ *
+ * Usage: call create() with a Shader and the name of one of its uniform blocks,
+ *        which takes the layout of the block from the program. set() the members
+ *        by name, then call upload() once before drawing and bind() the buffer to
+ *        the binding point the block was bound to (Shader::bindUniformBlock()).
+ *        The buffer works with every program whose block has the same layout,
+ *        such as a std140 block declared the same way in several shaders.
+ *
+ * Matrices are given column by column, as to Shader::setUniform(), and stored the
+ * way the block lays them out, row by row for row_major members.
+ *
+ * set() compares each value with the copy and marks only the bytes dirty which
+ * changed. upload() sends the range from the first to the last dirty byte with
+ * one glBufferSubData() call, or nothing if no value changed since the last one.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include "Shader.hpp"
+
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+class UniformBuffer {
+public:
+    UniformBuffer();
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // Create the buffer for the block 'block' of the program, all zeros. Returns
+    // false, after printing why, if the program has no such active block.
+    bool create(const Shader& shader, UniformName block);
+
+    // Set a member of the block, in the copy in memory. Members which are not in
+    // the block are skipped, type mismatches are printed in debug builds.
+    void set(UniformName member, GLfloat value);
+    void set(UniformName member, GLfloat x, GLfloat y);
+    void set(UniformName member, GLfloat x, GLfloat y, GLfloat z);
+    void set(UniformName member, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+    void set(UniformName member, GLint value);
+    void set(UniformName member, const std::array<GLfloat, 16>& matrix);  // mat4
+
+    // Upload the bytes changed since the last upload
+    void upload();
+
+    // Bind the buffer to the uniform buffer binding point 'binding'
+    void bind(GLuint binding) const;
+
+    GLuint id() const { return bufferID_; }
+    size_t size() const { return data_.size(); }
+
+    struct Stats {
+        size_t sets = 0;           // set() calls which changed the value
+        size_t setsSkipped = 0;    // set() calls with the value already set
+        size_t uploads = 0;        // glBufferSubData() calls
+        size_t bytesUploaded = 0;  // By those calls
+    };
+    const Stats& stats() const { return stats_; }
+    void resetStats() { stats_ = Stats(); }
+
+private:
+    // Copy 'size' bytes to 'offset' in the copy in memory, if they differ from it
+    bool write(size_t offset, const void* value, size_t size);
+    // Write a member, column by column for matrices
+    void setMember(UniformName member, GLenum type, const void* value, size_t size);
+
+    GLuint bufferID_;
+    std::vector<unsigned char> data_;
+    size_t dirtyBegin_;  // The dirty range of 'data_', empty if begin >= end
+    size_t dirtyEnd_;
+    std::vector<UniformInfo> members_;  // Sorted by hash
+    Stats stats_;
+};
@@ -8,9 +8,61 @@
  */
 #include "Utilities.hpp"
 
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <cstdio>
+#include <filesystem>
 #include <iostream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef TNM046_USE_EGL
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+
+GLFWwindow* hiddenWindow = nullptr;  // The window from createHiddenContext(), if any
+
+#ifdef TNM046_USE_EGL
+EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+EGLContext eglContext = EGL_NO_CONTEXT;
+
+// An OpenGL 3.3 core context without any surface, using the Mesa surfaceless platform
+bool createSurfacelessContext() {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (!getPlatformDisplay) {
+        return false;
+    }
+    eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr)) {
+        eglDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                 3,
+                                 EGL_CONTEXT_MINOR_VERSION,
+                                 3,
+                                 EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                 EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                 EGL_NONE};
+    eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (eglContext == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        util::destroyHiddenContext();
+        return false;
+    }
+    return true;
+}
+#endif
+
+}  // namespace
 
 namespace util {
 
@@ -42,4 +94,190 @@ double displayFPS(GLFWwindow* window) {
     return fps;
 }
 
+bool createHiddenContext(int width, int height) {
+    if (glfwInit()) {
+        // Same context as in the labs: OpenGL 3.3 core, but without showing the window
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        hiddenWindow = glfwCreateWindow(width, height, "TNM046 (hidden)", nullptr, nullptr);
+        if (hiddenWindow) {
+            glfwMakeContextCurrent(hiddenWindow);
+        } else {
+            glfwTerminate();
+        }
+    }
+
+#ifdef TNM046_USE_EGL
+    if (!hiddenWindow && !createSurfacelessContext()) {
+        std::cerr << "Unable to create a hidden window or an EGL surfaceless context.\n";
+        return false;
+    }
+#else
+    if (!hiddenWindow) {
+        std::cerr << "Unable to create a hidden OpenGL window.\n";
+        return false;
+    }
+#endif
+
+    glewExperimental = GL_TRUE;  // Needed to get all entry points in a core profile
+    GLenum err = glewInit();
+    if (GLEW_OK != err) {
+        std::cerr << "Error: " << glewGetErrorString(err) << "\n";
+        destroyHiddenContext();
+        return false;
+    }
+    return true;
+}
+
+void destroyHiddenContext() {
+    if (hiddenWindow) {
+        glfwDestroyWindow(hiddenWindow);
+        glfwTerminate();
+        hiddenWindow = nullptr;
+    }
+#ifdef TNM046_USE_EGL
+    if (eglDisplay != EGL_NO_DISPLAY) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (eglContext != EGL_NO_CONTEXT) {
+            eglDestroyContext(eglDisplay, eglContext);
+        }
+        eglTerminate(eglDisplay);
+        eglDisplay = EGL_NO_DISPLAY;
+        eglContext = EGL_NO_CONTEXT;
+    }
+#endif
+}
+
+struct SharedContext {
+    GLFWwindow* window = nullptr;
+#ifdef TNM046_USE_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+};
+
+SharedContext* createSharedContext() {
+#ifdef TNM046_USE_EGL
+    // The surfaceless context of createHiddenContext(), shared on the same display
+    if (eglContext != EGL_NO_CONTEXT && eglGetCurrentContext() == eglContext) {
+        const EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                     3,
+                                     EGL_CONTEXT_MINOR_VERSION,
+                                     3,
+                                     EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                     EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                     EGL_NONE};
+        const EGLContext context =
+            eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, eglContext, attributes);
+        if (context == EGL_NO_CONTEXT) {
+            std::cerr << "Unable to create a shared EGL context.\n";
+            return nullptr;
+        }
+        SharedContext* shared = new SharedContext;
+        shared->display = eglDisplay;
+        shared->context = context;
+        return shared;
+    }
+#endif
+    GLFWwindow* current = glfwGetCurrentContext();
+    if (!current) {
+        std::cerr << "Unable to create a shared context without a current context.\n";
+        return nullptr;
+    }
+    // The same context as the one sharing its objects, see createHiddenContext()
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(1, 1, "TNM046 (shared)", nullptr, current);
+    glfwDefaultWindowHints();
+    if (!window) {
+        std::cerr << "Unable to create a shared OpenGL context.\n";
+        return nullptr;
+    }
+    SharedContext* shared = new SharedContext;
+    shared->window = window;
+    return shared;
+}
+
+void destroySharedContext(SharedContext* context) {
+    if (!context) {
+        return;
+    }
+    if (context->window) {
+        glfwDestroyWindow(context->window);
+    }
+#ifdef TNM046_USE_EGL
+    if (context->context != EGL_NO_CONTEXT) {
+        eglDestroyContext(context->display, context->context);
+    }
+#endif
+    delete context;
+}
+
+bool setSharedContextCurrent(SharedContext* context, bool current) {
+    if (context->window) {
+        glfwMakeContextCurrent(current ? context->window : nullptr);
+        return true;
+    }
+#ifdef TNM046_USE_EGL
+    // The bound API is a setting of each thread
+    eglBindAPI(EGL_OPENGL_API);
+    return eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                          current ? context->context : EGL_NO_CONTEXT) == EGL_TRUE;
+#else
+    return false;
+#endif
+}
+
+void parallelFor(size_t count, size_t minChunk, unsigned int threads,
+                 const std::function<void(size_t begin, size_t end)>& fn) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const size_t chunks = std::clamp<size_t>(count / std::max<size_t>(1, minChunk), 1, threads);
+    if (chunks == 1) {
+        fn(0, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        workers.emplace_back(fn, count * chunk / chunks, count * (chunk + 1) / chunks);
+    }
+    fn(0, count / chunks);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool writeFileReplacing(const std::string& filename,
+                        const std::function<void(std::FILE* out)>& write) {
+    const std::string tempname = filename + ".tmp";
+    std::FILE* out = std::fopen(tempname.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    write(out);
+    // fclose() flushes the buffered data, so it can fail too
+    bool ok = !std::ferror(out);
+    ok = std::fclose(out) == 0 && ok;
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(tempname, filename, error);
+    }
+    if (!ok || error) {
+        std::filesystem::remove(tempname, error);
+        return false;
+    }
+    return true;
+}
+
 }  // namespace util
@@ -8,6 +8,11 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+
 struct GLFWwindow;
 
 namespace util {
@@ -23,4 +28,49 @@ namespace util {
  */
 double displayFPS(GLFWwindow* window);
 
+/*
+ * createHiddenContext() - Create an invisible OpenGL 3.3 core profile context and make
+ * it current, for tools and benchmarks which need OpenGL but have nothing to show.
+ * This is a hidden GLFW window, or in builds with TNM046_USE_EGL an EGL surfaceless
+ * context when there is no window system (e.g. a server running Mesa llvmpipe).
+ * There is no usable default framebuffer, so render into a framebuffer object.
+ * Returns false if no context could be created. Call destroyHiddenContext() when done.
+ */
+bool createHiddenContext(int width, int height);
+void destroyHiddenContext();
+
+/*
+ * createSharedContext() - Create an invisible context which shares its objects
+ * (buffers, textures, programs) with the current one, for a worker thread to make
+ * current with setSharedContextCurrent(). This is a hidden GLFW window, or an EGL
+ * context if the current one is the EGL context of createHiddenContext(). Create
+ * and destroy it on the thread whose context is current, which GLFW requires to be
+ * the main thread. Returns nullptr if no context could be created.
+ */
+struct SharedContext;
+SharedContext* createSharedContext();
+void destroySharedContext(SharedContext* context);
+
+// Make the context current in the calling thread, or release it with 'current' false
+bool setSharedContextCurrent(SharedContext* context, bool current);
+
+/*
+ * parallelFor() - Split the range [0, count) into contiguous chunks and call
+ * fn(begin, end) once for each chunk, in up to 'threads' threads (0 for one per core).
+ * The calling thread takes the first chunk and waits for the others. Chunks hold at
+ * least 'minChunk' items, so small ranges are not worth starting threads for and
+ * stay on the calling thread.
+ */
+void parallelFor(size_t count, size_t minChunk, unsigned int threads,
+                 const std::function<void(size_t begin, size_t end)>& fn);
+
+/*
+ * writeFileReplacing() - Write 'filename' with write(), through a temporary file
+ * "filename.tmp" which replaces it only once all of it is written and closed, so
+ * readers never see a partial file. Returns false, and removes the temporary file,
+ * if it could not be opened, written, closed or renamed.
+ */
+bool writeFileReplacing(const std::string& filename,
+                        const std::function<void(std::FILE* out)>& write);
+
 }  // namespace util
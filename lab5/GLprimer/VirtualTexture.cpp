@@ -0,0 +1,679 @@
+/*
+ * Sparse virtual texturing, for textures far larger than the GPU memory.
+ *
+ * This code is in the public domain.
+ */
+#include "VirtualTexture.hpp"
+#include "MipChain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+
+// The file starts with this header, followed by the tiles of every level, level 0
+// first, each level row by row from the bottom, and each tile bottom row first
+struct FileHeader {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t tileSize;
+    uint32_t border;
+    uint32_t numLevels;
+};
+
+const char fileMagic[8] = {'T', 'N', 'M', 'V', 'T', 'E', 'X', '1'};
+
+// Tiles read ahead by the background thread but not uploaded yet
+const size_t maxLoadedTiles = 64;
+
+struct LevelSize {
+    unsigned int width;
+    unsigned int height;
+    unsigned int tilesX;
+    unsigned int tilesY;
+};
+
+// The levels of an image, from the full size down to the first that fits in one tile
+std::vector<LevelSize> levelSizes(unsigned int width, unsigned int height,
+                                  unsigned int tileSize) {
+    std::vector<LevelSize> sizes;
+    for (;;) {
+        sizes.push_back({width, height, (width + tileSize - 1) / tileSize,
+                         (height + tileSize - 1) / tileSize});
+        if (width <= tileSize && height <= tileSize) {
+            return sizes;
+        }
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+}
+
+/*
+ * Copy tile (tx, ty) of a level, with its border, into 'tile'. Pixels outside the
+ * level repeat its edge.
+ */
+void copyTile(const unsigned char* level, const LevelSize& size, unsigned int tx,
+              unsigned int ty, unsigned int tileSize, unsigned int border, unsigned int channels,
+              unsigned char* tile) {
+    const unsigned int tileWidth = tileSize + 2 * border;
+    const int64_t x0 = int64_t(tx) * tileSize - border;
+    const int64_t y0 = int64_t(ty) * tileSize - border;
+    for (unsigned int y = 0; y < tileWidth; ++y) {
+        const int64_t sy = std::clamp<int64_t>(y0 + y, 0, size.height - 1);
+        const unsigned char* row = level + size_t(sy) * size.width * channels;
+        unsigned char* out = tile + size_t(y) * tileWidth * channels;
+        for (unsigned int x = 0; x < tileWidth; ++x, out += channels) {
+            const int64_t sx = std::clamp<int64_t>(x0 + x, 0, size.width - 1);
+            std::memcpy(out, row + size_t(sx) * channels, channels);
+        }
+    }
+}
+
+unsigned int nextPowerOfTwo(unsigned int value) {
+    unsigned int power = 1;
+    while (power < value) {
+        power *= 2;
+    }
+    return power;
+}
+
+}  // namespace
+
+bool bakeVirtualTexture(const unsigned char* pixels, unsigned int width, unsigned int height,
+                        unsigned int channels, const std::string& filename, unsigned int tileSize,
+                        unsigned int border) {
+    if (!pixels || width == 0 || height == 0 || (channels != 3 && channels != 4) ||
+        tileSize == 0 || border >= tileSize) {
+        std::cerr << "Invalid image or tile size for a virtual texture ('" << filename << "')\n";
+        return false;
+    }
+    const std::vector<LevelSize> sizes = levelSizes(width, height, tileSize);
+
+    FILE* out = std::fopen(filename.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Could not create '" << filename << "'\n";
+        return false;
+    }
+    FileHeader header;
+    std::memcpy(header.magic, fileMagic, sizeof fileMagic);
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    header.tileSize = tileSize;
+    header.border = border;
+    header.numLevels = static_cast<uint32_t>(sizes.size());
+    std::fwrite(&header, sizeof header, 1, out);
+
+    // Each level after the first is filtered into a temporary file, from the level
+    // before it, and read back through a memory mapping
+    const std::string temporary[2] = {filename + ".0.tmp", filename + ".1.tmp"};
+    MappedFile levelFile;
+    const unsigned char* level = pixels;
+    const unsigned int tileWidth = tileSize + 2 * border;
+    std::vector<unsigned char> tile(size_t(tileWidth) * tileWidth * channels);
+    bool ok = true;
+    for (size_t l = 0; l < sizes.size() && ok; ++l) {
+        const LevelSize& size = sizes[l];
+        for (unsigned int ty = 0; ty < size.tilesY; ++ty) {
+            for (unsigned int tx = 0; tx < size.tilesX; ++tx) {
+                copyTile(level, size, tx, ty, tileSize, border, channels, tile.data());
+                std::fwrite(tile.data(), 1, tile.size(), out);
+            }
+        }
+        if (l + 1 == sizes.size()) {
+            break;
+        }
+
+        // Two rows of this level make one of the next, so bands of rows can be
+        // filtered one at a time
+        const std::string& next = temporary[l % 2];
+        FILE* band = std::fopen(next.c_str(), "wb");
+        if (!band) {
+            std::cerr << "Could not create '" << next << "'\n";
+            ok = false;
+            break;
+        }
+        const unsigned int bandRows = 64;
+        const size_t stride = size_t(size.width) * channels;
+        for (unsigned int y = 0; y < sizes[l + 1].height; y += bandRows) {
+            const unsigned int rows = std::min(bandRows, sizes[l + 1].height - y);
+            const unsigned int sourceRows = std::min(2 * rows, size.height - 2 * y);
+            const MipLevel filtered =
+                filterMipLevel(level + 2 * size_t(y) * stride, size.width, sourceRows, channels);
+            std::fwrite(filtered.data.data(), 1, filtered.data.size(), band);
+        }
+        if (std::fclose(band) != 0 || !levelFile.open(next)) {
+            std::cerr << "Could not write '" << next << "'\n";
+            ok = false;
+            break;
+        }
+        level = levelFile.data();
+    }
+    levelFile.close();
+    std::remove(temporary[0].c_str());
+    std::remove(temporary[1].c_str());
+
+    if (std::ferror(out) || std::fclose(out) != 0) {
+        std::cerr << "Could not write '" << filename << "'\n";
+        return false;
+    }
+    return ok;
+}
+
+VirtualTexture::VirtualTexture(const std::string& filename, unsigned int physicalTiles)
+    : physicalTiles_(physicalTiles) {
+    if (!filename.empty()) {
+        open(filename);
+    }
+}
+
+VirtualTexture::~VirtualTexture() { close(); }
+
+bool VirtualTexture::open(const std::string& filename) {
+    close();
+    if (!file_.open(filename)) {
+        std::cerr << "Could not open virtual texture file ('" << filename << "')\n";
+        return false;
+    }
+    FileHeader header;
+    if (file_.size() < sizeof header) {
+        std::cerr << "Could not read file header ('" << filename << "')\n";
+        file_.close();
+        return false;
+    }
+    std::memcpy(&header, file_.data(), sizeof header);
+    if (std::memcmp(header.magic, fileMagic, sizeof fileMagic) != 0 || header.width == 0 ||
+        header.height == 0 || (header.channels != 3 && header.channels != 4) ||
+        header.tileSize == 0 || header.border >= header.tileSize) {
+        std::cerr << "Not a virtual texture file ('" << filename << "')\n";
+        file_.close();
+        return false;
+    }
+    const std::vector<LevelSize> sizes = levelSizes(header.width, header.height, header.tileSize);
+    const unsigned int slotSize = header.tileSize + 2 * header.border;
+    const size_t tileBytes = size_t(slotSize) * slotSize * header.channels;
+    size_t numTiles = 0;
+    for (const LevelSize& size : sizes) {
+        numTiles += size_t(size.tilesX) * size.tilesY;
+    }
+    if (sizes.size() != header.numLevels ||
+        (file_.size() - sizeof header) / tileBytes < numTiles) {
+        std::cerr << "Virtual texture file is truncated ('" << filename << "')\n";
+        file_.close();
+        return false;
+    }
+
+    // The page table is a mipmapped texture whose levels must halve in size, so its
+    // levels get at least as many texels as there are tiles
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    unsigned int tableWidth = nextPowerOfTwo(sizes[0].tilesX);
+    const unsigned int tableHeight = nextPowerOfTwo(sizes[0].tilesY);
+    while (std::max(tableWidth, tableHeight) < (1u << (sizes.size() - 1))) {
+        tableWidth *= 2;
+    }
+    if (std::max(tableWidth, tableHeight) > static_cast<unsigned int>(maxSize) ||
+        slotSize > static_cast<unsigned int>(maxSize)) {
+        std::cerr << "Virtual texture is too large for this GPU ('" << filename << "')\n";
+        file_.close();
+        return false;
+    }
+
+    width_ = header.width;
+    height_ = header.height;
+    channels_ = header.channels;
+    tileSize_ = header.tileSize;
+    border_ = header.border;
+    const GLubyte coarsest[4] = {0, 0, static_cast<GLubyte>(sizes.size() - 1), 255};
+    size_t firstTile = 0;
+    for (size_t l = 0; l < sizes.size(); ++l) {
+        Level level;
+        level.width = sizes[l].width;
+        level.height = sizes[l].height;
+        level.tilesX = sizes[l].tilesX;
+        level.tilesY = sizes[l].tilesY;
+        level.firstTile = firstTile;
+        firstTile += size_t(level.tilesX) * level.tilesY;
+        level.tableWidth = std::max(1u, tableWidth >> l);
+        level.tableHeight = std::max(1u, tableHeight >> l);
+        level.table.resize(size_t(level.tableWidth) * level.tableHeight * 4);
+        for (size_t i = 0; i < level.table.size(); i += 4) {
+            std::memcpy(&level.table[i], coarsest, 4);
+        }
+        levels_.push_back(std::move(level));
+    }
+
+    // At most 256 slots per side, as the page table stores their positions in bytes
+    slotsPerSide_ = std::clamp(physicalTiles_, 1u,
+                               std::min(256u, static_cast<unsigned int>(maxSize) / slotSize));
+    const GLsizei physicalSize = static_cast<GLsizei>(slotsPerSide_ * slotSize);
+    glGenTextures(1, &physical_);
+    glBindTexture(GL_TEXTURE_2D, physical_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, physicalSize, physicalSize, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+
+    glGenTextures(1, &pageTable_);
+    glBindTexture(GL_TEXTURE_2D, pageTable_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels_.size() - 1));
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(l), GL_RGBA8UI, levels_[l].tableWidth,
+                     levels_[l].tableHeight, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                     levels_[l].table.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The coarsest tile goes into slot 0, where it stays
+    slots_.assign(size_t(slotsPerSide_) * slotsPerSide_, Slot());
+    LoadedTile tile;
+    tile.key = tileKey(static_cast<unsigned int>(levels_.size() - 1), 0, 0);
+    readTile(tile.key, tile.pixels);
+    uploadTile(tile, 0);
+    slots_[0].key = tile.key;
+    slots_[0].used = true;
+    slots_[0].lastUse = std::numeric_limits<uint64_t>::max();
+    resident_[tile.key] = 0;
+    stats_ = Stats();
+    stats_.resident = 1;
+    stats_.uploads = 1;
+
+    stop_ = false;
+    thread_ = std::thread(&VirtualTexture::work, this);
+    return true;
+}
+
+void VirtualTexture::close() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+    requests_.clear();
+    loaded_.clear();
+
+    for (GLsync& fence : readFences_) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (readBuffers_[0]) {
+        glDeleteBuffers(2, readBuffers_);
+        readBuffers_[0] = readBuffers_[1] = 0;
+    }
+    if (feedbackFramebuffer_) {
+        glDeleteFramebuffers(1, &feedbackFramebuffer_);
+        glDeleteRenderbuffers(2, feedbackRenderbuffers_);
+        feedbackFramebuffer_ = 0;
+        feedbackRenderbuffers_[0] = feedbackRenderbuffers_[1] = 0;
+    }
+    feedbackWidth_ = feedbackHeight_ = 0;
+    if (physical_) {
+        glDeleteTextures(1, &physical_);
+        glDeleteTextures(1, &pageTable_);
+        physical_ = pageTable_ = 0;
+    }
+
+    levels_.clear();
+    slots_.clear();
+    resident_.clear();
+    file_.close();
+}
+
+void VirtualTexture::beginFeedback(int width, int height) {
+    if (!isOpen()) {
+        return;
+    }
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer_);
+    glGetIntegerv(GL_VIEWPORT, previousViewport_);
+
+    const int w = std::max(1, width / feedbackScale);
+    const int h = std::max(1, height / feedbackScale);
+    if (w != feedbackWidth_ || h != feedbackHeight_) {
+        if (!feedbackFramebuffer_) {
+            glGenFramebuffers(1, &feedbackFramebuffer_);
+            glGenRenderbuffers(2, feedbackRenderbuffers_);
+            glGenBuffers(2, readBuffers_);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackRenderbuffers_[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16UI, w, h);
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackRenderbuffers_[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer_);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                                  feedbackRenderbuffers_[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                                  feedbackRenderbuffers_[1]);
+        // Readbacks of the old size are of no use any more
+        for (int i = 0; i < 2; ++i) {
+            if (readFences_[i]) {
+                glDeleteSync(readFences_[i]);
+                readFences_[i] = nullptr;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers_[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(w) * h * 4 * sizeof(GLushort),
+                         nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        feedbackWidth_ = w;
+        feedbackHeight_ = h;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer_);
+    glViewport(0, 0, w, h);
+    const GLuint nothing[4] = {0, 0, 0, 0};  // Alpha 0 marks pixels without the texture
+    glClearBufferuiv(GL_COLOR, 0, nothing);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTexture::endFeedback() {
+    if (!isOpen()) {
+        return;
+    }
+    // Read the feedback into a pixel buffer without waiting for it. A readback
+    // which update() has not picked up yet is replaced.
+    const int i = nextRead_;
+    if (readFences_[i]) {
+        glDeleteSync(readFences_[i]);
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers_[i]);
+    glReadPixels(0, 0, feedbackWidth_, feedbackHeight_, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT,
+                 nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readFences_[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    nextRead_ = 1 - i;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer_));
+    glViewport(previousViewport_[0], previousViewport_[1], previousViewport_[2],
+               previousViewport_[3]);
+}
+
+void VirtualTexture::update(unsigned int maxUploads) {
+    if (!isOpen()) {
+        return;
+    }
+    ++frame_;
+
+    // The newest readback which has finished, if any
+    for (int k = 1; k <= 2; ++k) {
+        const int i = (nextRead_ + k) % 2;
+        if (!readFences_[i] || glClientWaitSync(readFences_[i], 0, 0) == GL_TIMEOUT_EXPIRED) {
+            continue;
+        }
+        for (GLsync& fence : readFences_) {  // Older readbacks are out of date
+            if (fence) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        const size_t count = size_t(feedbackWidth_) * feedbackHeight_;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers_[i]);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                              GLsizeiptr(count * 4 * sizeof(GLushort)),
+                                              GL_MAP_READ_BIT);
+        if (pixels) {
+            processFeedback(static_cast<const GLushort*>(pixels), count);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        break;
+    }
+
+    std::vector<LoadedTile> tiles;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!loaded_.empty() && tiles.size() < maxUploads) {
+            tiles.push_back(std::move(loaded_.front()));
+            loaded_.pop_front();
+        }
+    }
+    wake_.notify_one();
+
+    for (const LoadedTile& tile : tiles) {
+        if (resident_.count(tile.key)) {
+            continue;
+        }
+        // A free slot, or else the one least recently needed, but not by the last feedback
+        size_t victim = 0;
+        for (size_t s = 1; s < slots_.size(); ++s) {
+            if (!slots_[s].used) {
+                victim = s;
+                break;
+            }
+            if (slots_[s].lastUse < feedbackFrame_ &&
+                (victim == 0 || slots_[s].lastUse < slots_[victim].lastUse)) {
+                victim = s;
+            }
+        }
+        if (victim == 0) {
+            break;  // Every slot holds a tile in view; the rest show coarser tiles
+        }
+        Slot& slot = slots_[victim];
+        if (slot.used) {
+            resident_.erase(slot.key);
+            mapTile(slot.key, nullptr);
+            ++stats_.evictions;
+        }
+        uploadTile(tile, static_cast<unsigned int>(victim));
+        slot.key = tile.key;
+        slot.used = true;
+        slot.lastUse = frame_;
+        resident_[tile.key] = static_cast<unsigned int>(victim);
+        ++stats_.uploads;
+    }
+    stats_.resident = resident_.size();
+    uploadPageTable();
+}
+
+void VirtualTexture::bind(const Shader& program, GLuint unit, bool feedback) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, physical_);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, pageTable_);
+    glActiveTexture(GL_TEXTURE0);
+
+    const GLfloat slotSize = static_cast<GLfloat>(tileSize_ + 2 * border_);
+    program.setUniform("vtPhysical", static_cast<GLint>(unit));
+    program.setUniform("vtPageTable", static_cast<GLint>(unit + 1));
+    program.setUniform("vtInfo", static_cast<GLfloat>(width_), static_cast<GLfloat>(height_),
+                       static_cast<GLfloat>(tileSize_), static_cast<GLfloat>(levels_.size()));
+    program.setUniform("vtLayout", static_cast<GLfloat>(border_), slotSize,
+                       slotSize * static_cast<GLfloat>(slotsPerSide_));
+    // The feedback pass has 'feedbackScale' times larger derivatives than the frame
+    program.setUniform("vtLodBias",
+                       feedback ? -std::log2(static_cast<float>(feedbackScale)) : 0.0f);
+}
+
+size_t VirtualTexture::memorySize() const {
+    const size_t slotSize = tileSize_ + 2 * border_;
+    size_t total = slots_.size() * slotSize * slotSize * 4;
+    for (const Level& level : levels_) {
+        total += level.table.size();
+    }
+    return total;
+}
+
+void VirtualTexture::work() {
+    for (;;) {
+        uint64_t key;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] {
+                return stop_ || (!requests_.empty() && loaded_.size() < maxLoadedTiles);
+            });
+            if (stop_) {
+                return;
+            }
+            key = requests_.front();
+            requests_.pop_front();
+        }
+        // Touching the mapped pages reads them from the disk, here and not in update()
+        LoadedTile tile;
+        tile.key = key;
+        readTile(key, tile.pixels);
+        std::lock_guard<std::mutex> lock(mutex_);
+        loaded_.push_back(std::move(tile));
+    }
+}
+
+void VirtualTexture::readTile(uint64_t key, std::vector<GLubyte>& pixels) const {
+    const Level& level = levels_[key >> 48];
+    const size_t x = key & 0xffffff;
+    const size_t y = (key >> 24) & 0xffffff;
+    const size_t slotSize = tileSize_ + 2 * border_;
+    const size_t tileBytes = slotSize * slotSize * channels_;
+    const GLubyte* data =
+        file_.data() + sizeof(FileHeader) + (level.firstTile + y * level.tilesX + x) * tileBytes;
+    pixels.assign(data, data + tileBytes);
+}
+
+void VirtualTexture::processFeedback(const GLushort* pixels, size_t count) {
+    feedbackFrame_ = frame_;
+
+    // Every tile in view and its coarser tiles, which show while it is missing
+    std::unordered_set<uint64_t> seen;
+    std::vector<uint64_t> missing;
+    for (size_t i = 0; i < count; ++i) {
+        const GLushort* p = pixels + 4 * i;
+        if (p[3] == 0 || p[2] >= levels_.size() || p[0] >= levels_[p[2]].tilesX ||
+            p[1] >= levels_[p[2]].tilesY) {
+            continue;
+        }
+        unsigned int x = p[0];
+        unsigned int y = p[1];
+        for (unsigned int l = p[2]; l < levels_.size(); ++l, x /= 2, y /= 2) {
+            const uint64_t key = tileKey(l, x, y);
+            if (!seen.insert(key).second) {
+                break;  // And so were its coarser tiles
+            }
+            const auto it = resident_.find(key);
+            if (it == resident_.end()) {
+                missing.push_back(key);
+            } else if (it->second != 0) {
+                slots_[it->second].lastUse = frame_;
+            }
+        }
+    }
+    stats_.missing = missing.size();
+
+    // Coarsest first, as they show for the most tiles. The level is in the high bits.
+    std::sort(missing.begin(), missing.end(), std::greater<uint64_t>());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_.clear();
+        for (uint64_t key : missing) {
+            const bool loaded = std::any_of(loaded_.begin(), loaded_.end(),
+                                            [key](const LoadedTile& t) { return t.key == key; });
+            if (!loaded) {
+                requests_.push_back(key);
+            }
+        }
+    }
+    wake_.notify_one();
+}
+
+void VirtualTexture::uploadTile(const LoadedTile& tile, unsigned int slot) {
+    const GLsizei slotSize = static_cast<GLsizei>(tileSize_ + 2 * border_);
+    const GLint x = static_cast<GLint>(slot % slotsPerSide_) * slotSize;
+    const GLint y = static_cast<GLint>(slot / slotsPerSide_) * slotSize;
+    glBindTexture(GL_TEXTURE_2D, physical_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, slotSize, slotSize, channels_ == 4 ? GL_BGRA : GL_BGR,
+                    GL_UNSIGNED_BYTE, tile.pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const GLubyte entry[4] = {static_cast<GLubyte>(slot % slotsPerSide_),
+                              static_cast<GLubyte>(slot / slotsPerSide_),
+                              static_cast<GLubyte>(tile.key >> 48), 255};
+    mapTile(tile.key, entry);
+}
+
+void VirtualTexture::mapTile(uint64_t key, const GLubyte* entry) {
+    const unsigned int level = static_cast<unsigned int>(key >> 48);
+    const unsigned int x = key & 0xffffff;
+    const unsigned int y = (key >> 24) & 0xffffff;
+    // An evicted tile is replaced by whatever its parent shows. The coarsest tile
+    // is never evicted, so there is always a parent.
+    GLubyte parent[4];
+    const bool evicted = entry == nullptr;
+    if (evicted) {
+        const Level& up = levels_[level + 1];
+        std::memcpy(parent, &up.table[(size_t(y / 2) * up.tableWidth + x / 2) * 4], 4);
+        entry = parent;
+    }
+
+    // The tile covers a square of 2^n x 2^n tiles n levels further down. Those that
+    // showed a coarser tile now show this one, and those that showed this one show
+    // the parent's tile after an eviction.
+    for (unsigned int j = level + 1; j-- > 0;) {
+        Level& fine = levels_[j];
+        const unsigned int shift = level - j;
+        if ((uint64_t(x) << shift) >= fine.tilesX || (uint64_t(y) << shift) >= fine.tilesY) {
+            continue;
+        }
+        const unsigned int x0 = x << shift;
+        const unsigned int y0 = y << shift;
+        const unsigned int x1 =
+            static_cast<unsigned int>(std::min<uint64_t>(uint64_t(x + 1) << shift, fine.tilesX));
+        const unsigned int y1 =
+            static_cast<unsigned int>(std::min<uint64_t>(uint64_t(y + 1) << shift, fine.tilesY));
+        for (unsigned int ty = y0; ty < y1; ++ty) {
+            GLubyte* e = &fine.table[(size_t(ty) * fine.tableWidth + x0) * 4];
+            for (unsigned int tx = x0; tx < x1; ++tx, e += 4) {
+                if (j == level || (evicted ? e[2] == level : e[2] > level)) {
+                    std::memcpy(e, entry, 4);
+                }
+            }
+        }
+        if (fine.dirtyX1 == 0) {
+            fine.dirtyX0 = x0;
+            fine.dirtyY0 = y0;
+            fine.dirtyX1 = x1;
+            fine.dirtyY1 = y1;
+        } else {
+            fine.dirtyX0 = std::min(fine.dirtyX0, x0);
+            fine.dirtyY0 = std::min(fine.dirtyY0, y0);
+            fine.dirtyX1 = std::max(fine.dirtyX1, x1);
+            fine.dirtyY1 = std::max(fine.dirtyY1, y1);
+        }
+    }
+}
+
+void VirtualTexture::uploadPageTable() {
+    glBindTexture(GL_TEXTURE_2D, pageTable_);
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        Level& level = levels_[l];
+        if (level.dirtyX1 == 0) {
+            continue;
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(level.tableWidth));
+        glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(l), level.dirtyX0, level.dirtyY0,
+                        level.dirtyX1 - level.dirtyX0, level.dirtyY1 - level.dirtyY0,
+                        GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                        &level.table[(size_t(level.dirtyY0) * level.tableWidth + level.dirtyX0) *
+                                     4]);
+        level.dirtyX0 = level.dirtyY0 = level.dirtyX1 = level.dirtyY1 = 0;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
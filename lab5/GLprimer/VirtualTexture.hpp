@@ -0,0 +1,190 @@
+/*
+ * Sparse virtual texturing, for textures far larger than the GPU memory.
+ *
+ * Usage: bake the image into a tiled file once, with bakeVirtualTexture() or
+ *        "tnm046-texbake image.tga image.vtex". Create a VirtualTexture with the
+ *        file after the OpenGL context, then every frame:
+ *          1. Call beginFeedback() with the window size, draw the objects with
+ *             ../shaders/feedback_virtual.glsl as their fragment shader, after
+ *             bind() with 'feedback' true, and call endFeedback().
+ *          2. Call update(), which loads the tiles the feedback asked for.
+ *          3. Draw the objects with a shader which samples the texture with
+ *             vtSample() (see ../shaders/fragment_virtual.glsl), after bind().
+ *
+ * The file holds every mipmap level, down to one that fits in a single tile,
+ * cut into tiles of tileSize x tileSize pixels with a border of pixels copied
+ * from the neighbouring tiles, so bilinear filtering needs no other tile.
+ * Only a fixed number of tiles are on the GPU at a time, in the slots of one
+ * physical texture. A page table texture, with one texel per tile of every
+ * level, tells the shader which slot holds the tile. For tiles which are not
+ * resident it points to the nearest resident tile of a coarser level, so a
+ * missing tile shows up blurred rather than black. The single tile of the
+ * coarsest level is always resident.
+ *
+ * The feedback pass renders the objects at 1 / feedbackScale of the window
+ * size into an integer framebuffer which records the level and tile every
+ * pixel needs. It is read back through pixel buffers a frame or two later, so
+ * the pass never waits for the GPU. update() touches the resident tiles which
+ * are needed and has a background thread read the missing ones from the
+ * memory mapped file, coarsest first. It uploads up to 'maxUploads' of them per
+ * call, replacing the least recently needed tiles once all slots are in use.
+ *
+ * GPU memory is fixed when the file is opened: physicalTiles^2 slots of
+ * (tileSize + 2 * border)^2 pixels in GL_RGBA8, plus 4 bytes per texel of the
+ * page table. Tiles are filtered bilinearly within the level the shader picks,
+ * without blending between levels.
+ *
+ * This code is in the public domain.
+ */
+#pragma once
+
+#include <GL/glew.h>
+
+#include "MappedFile.hpp"
+#include "Shader.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Write 'width' x 'height' pixels with 'channels' bytes each (3 or 4, in B, G, R(, A)
+ * order, bottom row first as in a TGA file) to a virtual texture file, with all
+ * mipmap levels (see MipChain.hpp) cut into tiles. The image is read a band of
+ * rows at a time, and the smaller levels go through temporary files next to
+ * 'filename', so it may be larger than the memory. Returns false if a file could
+ * not be written.
+ */
+bool bakeVirtualTexture(const unsigned char* pixels, unsigned int width, unsigned int height,
+                        unsigned int channels, const std::string& filename,
+                        unsigned int tileSize = 128, unsigned int border = 1);
+
+class VirtualTexture {
+public:
+    // The feedback pass renders at 1 / feedbackScale of the window size
+    static const int feedbackScale = 8;
+
+    // 'physicalTiles' x 'physicalTiles' tiles are resident at most
+    explicit VirtualTexture(const std::string& filename = "", unsigned int physicalTiles = 16);
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    // Open a file from bakeVirtualTexture() and create the textures. Returns false,
+    // after printing why, if the file is not a valid virtual texture.
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const { return !levels_.empty(); }
+
+    unsigned int width() const { return width_; }
+    unsigned int height() const { return height_; }
+    unsigned int numLevels() const { return static_cast<unsigned int>(levels_.size()); }
+
+    // Render the feedback pass into an internal framebuffer between these calls,
+    // for a window of 'width' x 'height' pixels
+    void beginFeedback(int width, int height);
+    void endFeedback();
+
+    // Read the latest feedback that is ready and upload up to 'maxUploads' tiles.
+    // Call once per frame.
+    void update(unsigned int maxUploads = 16);
+
+    // Bind the physical texture to texture unit 'unit' and the page table to the
+    // next one, and set the uniforms of 'program', which must be in use.
+    // 'feedback' is true for the feedback pass.
+    void bind(const Shader& program, GLuint unit = 0, bool feedback = false) const;
+
+    // The GPU memory of the physical texture and the page table, in bytes
+    size_t memorySize() const;
+
+    struct Stats {
+        size_t resident = 0;   // Tiles on the GPU
+        size_t missing = 0;    // Tiles needed by the last feedback but not resident
+        size_t uploads = 0;    // Tiles uploaded in total
+        size_t evictions = 0;  // Tiles replaced by others in total
+    };
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Level {
+        unsigned int width = 0;  // In pixels
+        unsigned int height = 0;
+        unsigned int tilesX = 0;
+        unsigned int tilesY = 0;
+        size_t firstTile = 0;  // Index of the level's first tile in the file
+        // The page table, which may have more texels than there are tiles, so that
+        // its levels form a mipmap chain: slot x, slot y and level of the tile to use
+        unsigned int tableWidth = 0;
+        unsigned int tableHeight = 0;
+        std::vector<GLubyte> table;
+        // The part of the table changed since it was last uploaded
+        unsigned int dirtyX0 = 0, dirtyY0 = 0, dirtyX1 = 0, dirtyY1 = 0;
+    };
+
+    struct Slot {
+        uint64_t key = 0;      // Of the resident tile, see tileKey()
+        bool used = false;
+        uint64_t lastUse = 0;  // The value of 'frame_' when last needed
+    };
+
+    struct LoadedTile {
+        uint64_t key;
+        std::vector<GLubyte> pixels;
+    };
+
+    static uint64_t tileKey(unsigned int level, unsigned int x, unsigned int y) {
+        return (uint64_t(level) << 48) | (uint64_t(y) << 24) | x;
+    }
+
+    void work();
+    void readTile(uint64_t key, std::vector<GLubyte>& pixels) const;
+    void processFeedback(const GLushort* pixels, size_t count);
+    void uploadTile(const LoadedTile& tile, unsigned int slot);
+    // Point the page table entries of a tile and of the finer tiles which show it
+    // to 'entry', or back to its parent's entry if 'entry' is null
+    void mapTile(uint64_t key, const GLubyte* entry);
+    void uploadPageTable();
+
+    MappedFile file_;
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+    unsigned int channels_ = 0;
+    unsigned int tileSize_ = 0;
+    unsigned int border_ = 0;
+    std::vector<Level> levels_;
+
+    unsigned int physicalTiles_;   // Per side, as requested
+    unsigned int slotsPerSide_ = 0;  // As fits into a texture
+    GLuint physical_ = 0;
+    GLuint pageTable_ = 0;
+    std::vector<Slot> slots_;  // Slot 0 holds the coarsest tile for good
+    std::unordered_map<uint64_t, unsigned int> resident_;  // Tile key to slot
+    uint64_t frame_ = 0;
+    uint64_t feedbackFrame_ = 0;  // When the last feedback was processed
+
+    GLuint feedbackFramebuffer_ = 0;
+    GLuint feedbackRenderbuffers_[2] = {0, 0};  // Color and depth
+    int feedbackWidth_ = 0;
+    int feedbackHeight_ = 0;
+    GLuint readBuffers_[2] = {0, 0};
+    GLsync readFences_[2] = {nullptr, nullptr};
+    int nextRead_ = 0;
+    GLint previousFramebuffer_ = 0;
+    GLint previousViewport_[4] = {0, 0, 0, 0};
+
+    std::mutex mutex_;  // Guards everything up to 'stop_'
+    std::condition_variable wake_;
+    std::deque<uint64_t> requests_;
+    std::deque<LoadedTile> loaded_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    Stats stats_;
+};
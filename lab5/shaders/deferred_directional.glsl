@@ -0,0 +1,17 @@
+#version 330 core
+
+// The first lighting pass of the deferred renderer: the ambient and directional
+// light of the forward shaders (lighting.glsl), for every pixel with a surface
+
+#include "gbuffer.glsl"
+#include "lighting.glsl"
+
+out vec4 finalcolor;
+
+void main() {
+	Surface s = readGBuffer(ivec2(gl_FragCoord.xy));
+	if (!s.present) {
+		discard;
+	}
+	finalcolor = vec4(shade(s.color, s.N), 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// A point light of the deferred renderer, added to the pixels of the screen
+// rectangle around its sphere of influence
+
+#include "gbuffer.glsl"
+
+uniform vec3 lightPosition;  // In view space
+uniform vec3 lightColor;
+uniform float lightRadius;   // Where the light falls off to nothing
+
+out vec4 finalcolor;
+
+void main() {
+	Surface s = readGBuffer(ivec2(gl_FragCoord.xy));
+	vec3 toLight = lightPosition - s.position;
+	float d = length(toLight);
+	if (!s.present || d >= lightRadius) {
+		discard;
+	}
+	float falloff = 1.0 - d / lightRadius;
+	float dotNL = max(dot(s.N, toLight / d), 0.0);
+	finalcolor = vec4(lightColor * s.color * dotNL * falloff * falloff, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// The feedback pass of a virtual texture (see VirtualTexture.hpp): which tile
+// of which level every pixel needs
+
+#include "virtual_texture.glsl"
+
+in vec2 st;
+
+out uvec4 feedback;      // Tile x, tile y, level and 1 for "needed"
+
+void main() {
+	int level = vtLevel(st);
+
+	ivec2 size = max(ivec2(vtInfo.xy) >> level, ivec2(1));
+	ivec2 pixel = min(ivec2(fract(st) * vec2(size)), size - 1);
+	feedback = uvec4(uvec2(pixel / int(vtInfo.z)), uint(level), 1u);
+}
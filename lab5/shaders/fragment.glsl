@@ -1,48 +1,39 @@
 #version 330 core
 
+// Features of the program, defined as 0 or 1 by ShaderPermutations. Without it,
+// the surface is textured.
+#ifndef TEXTURED
+#define TEXTURED 1
+#endif
+
+#include "lighting.glsl"
+
 //uniform float time;
-uniform mat4 T;
 
 out vec4 finalcolor;
 
 in vec3 interpolatedNormal;
+#if TEXTURED
 uniform sampler2D tex; // A uniform variable to identify the texture
 in vec2 st;
+#else
+uniform vec3 color;    // The color of the surface
+#endif
 
 void main() {
 	
-	vec3 L = normalize(mat3(T) * vec3(0.0f, 0.0f, 1.0f));
-	vec3 V = vec3(0.0f,0.0f,1.0f);
-	vec3 N = interpolatedNormal;
-
 	//vec3 colorRGB = vec3(0.7f, 0.0f, 0.7f);
+#if TEXTURED
 	vec3 colorRGB = vec3(texture(tex, st));
-	vec3 colorGreyScale = vec3(1.0f, 1.0f, 1.0f);
-
-	float n = 500;
-
-	vec3 ka = 0.9f * colorRGB;
-	vec3 Ia = 0.5f * colorGreyScale;
-	vec3 kd = 1.0f * colorRGB;
-	vec3 Id = 0.8f * colorGreyScale;
-	vec3 ks = 0.1f * colorGreyScale;
-	vec3 Is = 0.9f * colorGreyScale;
-
-	// This assumes that N, L and V are normalized.
-	N = normalize(N);
-	L = normalize(L);
-	V = normalize(V);
-	vec3 R = 2.0 * dot(N, L) * N - L;   // Could also have used the function reflect()
-	float dotNL = max(dot(N, L), 0.0);  // If negative, set to zero
-	float dotRV = max(dot(R, V), 0.0);
-	if (dotNL == 0.0) {
-		dotRV = 0.0;  // Do not show highlight on the dark side
-	}
-	vec3 shadedcolor = Ia * ka + Id * kd * dotNL + Is * ks * pow(dotRV, n);
+#else
+	vec3 colorRGB = color;
+#endif
+
+	vec3 shadedcolor = shade(colorRGB, interpolatedNormal);
 	finalcolor = vec4(shadedcolor, 1.0);
 	//guuuuuuuuuh?!
 	
 
 	//finalcolor = vec4(interpolatedNormal * 0.5 + 0.5, 1);
 	//finalcolor = texture(tex, st); // Use the texture to set the surface color
-}
\ No newline at end of file
+}
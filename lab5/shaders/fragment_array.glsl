@@ -0,0 +1,16 @@
+#version 330 core
+
+#include "lighting.glsl"
+
+out vec4 finalcolor;
+
+in vec3 interpolatedNormal;
+uniform sampler2DArray tex; // The array texture with the object's texture (see TexturePack.hpp)
+uniform int layer;          // The layer of the object's texture
+uniform vec4 stTransform;   // Its part of the layer: st * xy + zw
+in vec2 st;
+
+void main() {
+	vec3 colorRGB = vec3(texture(tex, vec3(st * stTransform.xy + stTransform.zw, layer)));
+	finalcolor = vec4(shade(colorRGB, interpolatedNormal), 1.0);
+}
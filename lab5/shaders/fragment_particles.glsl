@@ -0,0 +1,9 @@
+#version 330 core
+
+in vec3 particleColor;
+
+out vec4 finalcolor;
+
+void main() {
+	finalcolor = vec4(particleColor, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 330 core
+
+#include "lighting.glsl"
+
+out vec4 finalcolor;
+
+in vec3 interpolatedNormal;
+in vec2 st;
+
+// A virtual texture (see VirtualTexture.hpp)
+#include "virtual_texture.glsl"
+uniform sampler2D vtPhysical;    // The resident tiles
+uniform usampler2D vtPageTable;  // Slot x, slot y and level of the tile to use
+uniform vec3 vtLayout;           // Tile border, slot size and physical texture size in pixels
+
+vec4 vtSample(vec2 uv) {
+	int level = vtLevel(uv);
+
+	// The tile to use, which may be of a coarser level than the one wanted
+	int tileSize = int(vtInfo.z);
+	ivec2 size = max(ivec2(vtInfo.xy) >> level, ivec2(1));
+	ivec2 pixel = min(ivec2(fract(uv) * vec2(size)), size - 1);
+	uvec4 entry = texelFetch(vtPageTable, pixel / tileSize, level);
+
+	vec2 mapped = fract(uv) * vec2(max(ivec2(vtInfo.xy) >> int(entry.z), ivec2(1)));
+	vec2 inTile = mapped - floor(mapped / vtInfo.z) * vtInfo.z;
+	vec2 physical = vec2(entry.xy) * vtLayout.y + vtLayout.x + inTile;
+	return textureLod(vtPhysical, physical / vtLayout.z, 0.0);
+}
+
+void main() {
+	vec3 colorRGB = vtSample(st).rgb;
+	finalcolor = vec4(shade(colorRGB, interpolatedNormal), 1.0);
+}
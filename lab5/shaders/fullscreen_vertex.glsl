@@ -0,0 +1,9 @@
+#version 330 core
+
+// A triangle covering the viewport, drawn with glDrawArrays(GL_TRIANGLES, 0, 3)
+// and no vertex attributes
+
+void main() {
+	vec2 corner = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+	gl_Position = vec4(corner, 0.0, 1.0);
+}
@@ -0,0 +1,45 @@
+// The G-buffer of the deferred renderer (see DeferredRenderer.hpp), with
+// #include "gbuffer.glsl": writing it in the geometry pass and reading it in
+// the lighting passes
+
+// Normals are stored in two 16-bit channels, as the octahedral mapping of the unit
+// sphere onto a square, scaled to [0, 1]
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 signs = mix(vec2(-1.0), vec2(1.0), greaterThanEqual(n.xy, vec2(0.0)));
+	vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+	return e * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 e) {
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+
+uniform sampler2D gAlbedo;  // rgb: surface color, a: 1 where there is a surface
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform vec4 projection;    // P[0][0], P[1][1], P[2][2] and P[3][2] of the projection
+
+struct Surface {
+	bool present;   // False for the background
+	vec3 color;
+	vec3 N;         // In view space, like the rest
+	vec3 position;
+};
+
+// The surface seen in a pixel, its position reconstructed from the depth
+Surface readGBuffer(ivec2 pixel) {
+	Surface s;
+	vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+	s.present = albedo.a > 0.0;
+	s.color = albedo.rgb;
+	s.N = decodeNormal(texelFetch(gNormal, pixel, 0).rg);
+	vec2 ndc = (vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0;
+	float z = -projection.w / (texelFetch(gDepth, pixel, 0).r * 2.0 - 1.0 + projection.z);
+	s.position = vec3(ndc * -z / projection.xy, z);
+	return s;
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+// The geometry pass of the deferred renderer: the color and normal of the surface,
+// shaded later for all lights at once (see DeferredRenderer.hpp)
+
+#include "gbuffer.glsl"
+
+uniform sampler2D tex;
+
+in vec3 interpolatedNormal;
+in vec2 st;
+
+layout(location = 0) out vec4 albedo;
+layout(location = 1) out vec2 normal;
+
+void main() {
+	albedo = vec4(texture(tex, st).rgb, 1.0);
+	normal = encodeNormal(normalize(interpolatedNormal));
+}
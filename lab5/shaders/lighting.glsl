@@ -0,0 +1,44 @@
+// The Phong lighting shared by the fragment shaders, with #include "lighting.glsl"
+// (see ShaderSource.hpp)
+
+// Features of the program, defined as 0 or 1 by ShaderPermutations. Without it,
+// the full model is used.
+#ifndef SPECULAR
+#define SPECULAR 1
+#endif
+
+uniform mat4 T;
+
+// The color of a surface with the color 'colorRGB' and the normal 'N', lit by a
+// white light from the direction of the camera, rotated by T
+vec3 shade(vec3 colorRGB, vec3 N) {
+	vec3 L = normalize(mat3(T) * vec3(0.0f, 0.0f, 1.0f));
+	vec3 V = vec3(0.0f,0.0f,1.0f);
+	vec3 colorGreyScale = vec3(1.0f, 1.0f, 1.0f);
+
+	vec3 ka = 0.9f * colorRGB;
+	vec3 Ia = 0.5f * colorGreyScale;
+	vec3 kd = 1.0f * colorRGB;
+	vec3 Id = 0.8f * colorGreyScale;
+
+	// This assumes that N, L and V are normalized.
+	N = normalize(N);
+	L = normalize(L);
+	V = normalize(V);
+	float dotNL = max(dot(N, L), 0.0);  // If negative, set to zero
+	vec3 shadedcolor = Ia * ka + Id * kd * dotNL;
+
+#if SPECULAR
+	float n = 500;
+	vec3 ks = 0.1f * colorGreyScale;
+	vec3 Is = 0.9f * colorGreyScale;
+
+	vec3 R = 2.0 * dot(N, L) * N - L;   // Could also have used the function reflect()
+	float dotRV = max(dot(R, V), 0.0);
+	if (dotNL == 0.0) {
+		dotRV = 0.0;  // Do not show highlight on the dark side
+	}
+	shadedcolor += Is * ks * pow(dotRV, n);
+#endif
+	return shadedcolor;
+}
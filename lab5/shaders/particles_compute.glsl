@@ -0,0 +1,35 @@
+#version 430 core
+
+// Moves particles by their velocities, under gravity, and bounces them off the
+// walls of the cube from -1 to 1. One invocation for each particle.
+
+layout(local_size_x = 64) in;
+
+struct Particle {
+	vec4 position; // xyz, w unused, so that it can be drawn as a vec4 attribute
+	vec4 velocity;
+};
+
+layout(std430, binding = 0) buffer Particles {
+	Particle particles[];
+};
+
+uniform int count;       // The number of particles, the last invocations skip
+uniform float timestep;  // In seconds
+
+const vec3 gravity = vec3(0.0, -2.0, 0.0);
+
+void main() {
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= uint(count)) return;
+
+	vec3 p = particles[i].position.xyz;
+	vec3 v = particles[i].velocity.xyz + gravity * timestep;
+	p += v * timestep;
+	// Reflect off the walls, losing a little speed
+	bvec3 outside = greaterThan(abs(p), vec3(1.0));
+	p = clamp(p, -1.0, 1.0);
+	v = mix(v, -0.9 * v, outside);
+	particles[i].position.xyz = p;
+	particles[i].velocity.xyz = v;
+}
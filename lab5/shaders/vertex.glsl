@@ -1,10 +1,23 @@
 #version 330 core
 
+// Defined as 1 by ShaderPermutations to take the matrices from a uniform buffer
+// (see UniformBuffer.hpp) instead of from separate uniforms
+#ifndef TRANSFORM_BLOCK
+#define TRANSFORM_BLOCK 0
+#endif
+
 uniform float time;
 uniform mat4 T;
 
+#if TRANSFORM_BLOCK
+layout(std140) uniform Transforms {
+	mat4 MV;
+	mat4 P;
+};
+#else
 uniform mat4 MV;
 uniform mat4 P;
+#endif
 
 layout(location=0) in vec3 Position;
 layout(location=1) in vec3 Normal;
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Draws the particles of particles_compute.glsl as points, from its storage buffer
+// bound as a vertex buffer
+
+uniform mat4 MV;
+uniform mat4 P;
+
+layout(location=0) in vec4 Position;
+layout(location=1) in vec4 Velocity;
+
+out vec3 particleColor;
+
+void main() {
+	gl_Position = P * MV * vec4(Position.xyz, 1.0);
+	// Slow particles are blue, fast ones white
+	particleColor = mix(vec3(0.2, 0.4, 1.0), vec3(1.0), clamp(length(Velocity.xyz) / 4.0, 0.0, 1.0));
+}
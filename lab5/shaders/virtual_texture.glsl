@@ -0,0 +1,14 @@
+// The level selection shared by the passes of a virtual texture (see
+// VirtualTexture.hpp), with #include "virtual_texture.glsl"
+
+uniform vec4 vtInfo;     // Width and height in pixels, tile size, number of levels
+uniform float vtLodBias;
+
+// The mipmap level for the texture coordinates, from their screen space derivatives
+int vtLevel(vec2 uv) {
+	vec2 texel = uv * vtInfo.xy;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vtLodBias;
+	return clamp(int(floor(lod + 0.5)), 0, int(vtInfo.w) - 1);
+}